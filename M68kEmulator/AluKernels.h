@@ -0,0 +1,162 @@
+#pragma once
+#include <cstdint>
+#include "M68kDefinitions.h"
+
+// The 68000's integer operations with their condition codes, shared by the interpreter, its lazy
+// condition code evaluation and the C++ written by StaticRecompiler. Flags come back as XNZVC in
+// their SR bit positions and are worked out with masks and shifts rather than tests, so nothing
+// here branches on the data. Operands are masked to the operand size before use.
+
+// The host integer types of each operand size, for the overflow intrinsics
+template<int Size> struct AluTypes;
+template<> struct AluTypes<SIZE_BYTE> { typedef uint8_t Unsigned; typedef int8_t Signed; };
+template<> struct AluTypes<SIZE_WORD> { typedef uint16_t Unsigned; typedef int16_t Signed; };
+template<> struct AluTypes<SIZE_LONG> { typedef uint32_t Unsigned; typedef int32_t Signed; };
+
+// N and Z of a result, with V and C clear, as MOVE, CLR and the logical operations set them
+inline uint16_t logicalFlags(int size, uint32_t result)
+{
+    result &= sizeMask(size);
+    return ((result == 0) << SR_CCR_ZERO) | (((result >> ((8 << size) - 1)) & 1) << SR_CCR_NEGATIVE);
+}
+
+// The condition codes of destination + source (+ X) worked out from the operands and the result,
+// which is all the lazy evaluation keeps. X is set with C.
+inline uint16_t additionFlags(int size, uint32_t source, uint32_t destination, uint32_t result)
+{
+    const int top = (8 << size) - 1;
+    uint32_t carry = ((source & destination) | ((source | destination) & ~result)) >> top;
+    uint32_t overflow = ((source ^ result) & (destination ^ result)) >> top;
+
+    return logicalFlags(size, result) | ((carry & 1) * ((1 << SR_CCR_CARRY) | (1 << SR_CCR_EXTEND)))
+        | ((overflow & 1) << SR_CCR_OVERFLOW);
+}
+
+// The condition codes of destination - source (- X), as for additionFlags. C is the borrow.
+inline uint16_t subtractionFlags(int size, uint32_t source, uint32_t destination, uint32_t result)
+{
+    const int top = (8 << size) - 1;
+    uint32_t borrow = ((source & ~destination) | ((source | ~destination) & result)) >> top;
+    uint32_t overflow = ((source ^ destination) & (result ^ destination)) >> top;
+
+    return logicalFlags(size, result) | ((borrow & 1) * ((1 << SR_CCR_CARRY) | (1 << SR_CCR_EXTEND)))
+        | ((overflow & 1) << SR_CCR_OVERFLOW);
+}
+
+// Returns destination + source + extend and sets flags to its condition codes. GCC and Clang take
+// C and V from the host's own carry and overflow flags.
+template<int Size>
+inline uint32_t aluAdd(uint32_t source, uint32_t destination, uint32_t extend, uint16_t &flags)
+{
+#if defined(__GNUC__)
+    typedef typename AluTypes<Size>::Unsigned Unsigned;
+    typedef typename AluTypes<Size>::Signed Signed;
+    Unsigned partial, result;
+    Signed signedPartial, signedResult;
+    // Only one of the two steps can carry. Both can overflow, bringing the sum back in range.
+    bool carry = __builtin_add_overflow((Unsigned)destination, (Unsigned)source, &partial)
+        | __builtin_add_overflow(partial, (Unsigned)extend, &result);
+    bool overflow = __builtin_add_overflow((Signed)destination, (Signed)source, &signedPartial)
+        ^ __builtin_add_overflow(signedPartial, (Signed)extend, &signedResult);
+
+    flags = logicalFlags(Size, result) | (carry * ((1 << SR_CCR_CARRY) | (1 << SR_CCR_EXTEND)))
+        | (overflow << SR_CCR_OVERFLOW);
+    return result;
+#else
+    source &= sizeMask(Size);
+    destination &= sizeMask(Size);
+    uint32_t result = (destination + source + extend) & sizeMask(Size);
+    flags = additionFlags(Size, source, destination, result);
+    return result;
+#endif
+}
+
+// Returns destination - source - extend and sets flags to its condition codes
+template<int Size>
+inline uint32_t aluSubtract(uint32_t source, uint32_t destination, uint32_t extend, uint16_t &flags)
+{
+#if defined(__GNUC__)
+    typedef typename AluTypes<Size>::Unsigned Unsigned;
+    typedef typename AluTypes<Size>::Signed Signed;
+    Unsigned partial, result;
+    Signed signedPartial, signedResult;
+    bool borrow = __builtin_sub_overflow((Unsigned)destination, (Unsigned)source, &partial)
+        | __builtin_sub_overflow(partial, (Unsigned)extend, &result);
+    bool overflow = __builtin_sub_overflow((Signed)destination, (Signed)source, &signedPartial)
+        ^ __builtin_sub_overflow(signedPartial, (Signed)extend, &signedResult);
+
+    flags = logicalFlags(Size, result) | (borrow * ((1 << SR_CCR_CARRY) | (1 << SR_CCR_EXTEND)))
+        | (overflow << SR_CCR_OVERFLOW);
+    return result;
+#else
+    source &= sizeMask(Size);
+    destination &= sizeMask(Size);
+    uint32_t result = (destination - source - extend) & sizeMask(Size);
+    flags = subtractionFlags(Size, source, destination, result);
+    return result;
+#endif
+}
+
+// Shifts or rotates a value by a count of 0 to 63 and sets flags to the condition codes, given the
+// X flag going in. C is the last bit shifted out, and X follows it except for ROL and ROR, which
+// leave X as it was. A count of zero clears C, or copies X to it for ROXL and ROXR, and leaves X
+// alone. Only ASL sets V, when the sign changes along the way. The value is worked on in 64 bits,
+// wide enough for every count to shift by without a test on it.
+template<int Type, int Left, int Size>
+inline uint32_t aluShift(uint32_t value, int count, uint32_t extend, uint16_t &flags)
+{
+    const int bits = 8 << Size;
+    const uint64_t mask = sizeMask(Size);
+    const uint64_t operand = value & mask;
+    uint64_t result;
+    uint64_t carry;
+    uint64_t overflow = 0;
+    uint64_t shifted = count != 0;
+
+    if (Type == ROTATE_EXTEND) {
+        // A rotate through X is a rotate of a value one bit wider
+        const int width = bits + 1;
+        const uint64_t wideMask = (mask << 1) | 1;
+        uint64_t wide = operand | ((uint64_t)extend << bits);
+        int places = count % width;
+        if (Left)
+            wide = ((wide << places) | (wide >> (width - places))) & wideMask;
+        else
+            wide = ((wide >> places) | (wide << (width - places))) & wideMask;
+        result = wide & mask;
+        carry = wide >> bits;
+        extend = (uint32_t)carry;
+    }
+    else if (Type == ROTATE) {
+        int places = count & (bits - 1);
+        if (Left)
+            result = ((operand << places) | (operand >> ((bits - places) & (bits - 1)))) & mask;
+        else
+            result = ((operand >> places) | (operand << ((bits - places) & (bits - 1)))) & mask;
+        carry = shifted & (Left ? result : result >> (bits - 1));
+    }
+    else if (Left) {
+        result = (operand << count) & mask;
+        carry = (operand << count) >> bits;
+        if (Type == SHIFT_ARITHMETIC) {
+            // The top count + 1 bits, with zeros below the value, must all be the same
+            int64_t top = (int64_t)(operand << (64 - bits)) >> (63 - count);
+            overflow = (uint64_t)(top + 1) > 1;
+        }
+        extend = (uint32_t)((carry & shifted) | (extend & (shifted ^ 1)));
+    }
+    else {
+        // An arithmetic shift works on the value sign extended to 64 bits, a logical one on it
+        // zero extended, and either way the bit below the result is the last one shifted out
+        uint64_t wide = operand;
+        if (Type == SHIFT_ARITHMETIC)
+            wide = (uint64_t)((int64_t)(operand << (64 - bits)) >> (64 - bits));
+        result = (Type == SHIFT_ARITHMETIC ? (uint64_t)((int64_t)wide >> count) : wide >> count) & mask;
+        carry = Type == SHIFT_ARITHMETIC ? (uint64_t)((int64_t)(wide << 1) >> count) : (wide << 1) >> count;
+        extend = (uint32_t)((carry & shifted) | (extend & (shifted ^ 1)));
+    }
+
+    flags = logicalFlags(Size, (uint32_t)result) | ((carry & 1) << SR_CCR_CARRY) | ((overflow & 1) << SR_CCR_OVERFLOW)
+        | ((extend & 1) << SR_CCR_EXTEND);
+    return (uint32_t)result;
+}
@@ -1,9 +1,19 @@
 #include "CPUCore.h"
+#include "M68kDefinitions.h"
+#include "AluKernels.h"
+#include "JitCompiler.h"
+#include <algorithm>
 #include <iostream>
 #include <iomanip>
+#include <iterator>
 #include <bitset>
 #include <string>
-#include <sstream>
+#include <thread>
+#include <mutex>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#include <type_traits>
 #ifdef _DEBUG
 #define DEBUG_MODE 1
 #else
@@ -11,100 +21,112 @@
 #endif
 #ifdef WIN32
 #include <windows.h>
+#include <malloc.h>
+#else
+#include <termios.h>
+#include <unistd.h>
 #endif
 
-//Status Register flags
-#define SR_CCR_CARRY 0
-#define SR_CCR_OVERFLOW 1
-#define SR_CCR_ZERO 2
-#define SR_CCR_NEGATIVE 3
-#define SR_CCR_EXTEND 4
-#define SR_INT0 8
-#define SR_INT1 9
-#define SR_INT2 10
-#define SR_SUPERVISOR_MODE 13
-#define SR_TRACE_MODE 15
-
-//Instructions
-#define ADD 0xD000
-#define ADDA 0xD000
-#define ADDI 0x0600
-#define ADDQ 0x5000
-#define Bcc 0x6000
-#define BRA 0x6000
-#define BSR 0x6100
-#define CLR 0x4200
-#define CMP_B 0xB000
-#define CMP_W 0xB040
-#define CMP_L 0xB080
-#define CMPA_W 0xB0C0
-#define CMPA_L 0xB1C0
-#define EXG 0xC100
-#define JMP 0x4EC0
-#define LEA 0x41C0
-#define MOVE_B 0x1000
-#define MOVE_W 0x3000
-#define MOVE_L 0x2000
-#define MOVE_FROM_SR 0x40C0
-#define MOVEQ 0x7000
-#define MOVEM 0x4880
-#define NOP 0x4E71
-#define RTS 0x4E75
-#define STOP 0x4E72
-#define SWAP 0x4840
-#define TRAP 0x4E40
-
-//Addressing modes
-#define ADDRESS_MODE_DATA_REGISTER_DIRECT 0
-#define ADDRESS_MODE_ADDRESS_REGISTER_DIRECT 1
-#define ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT 2
-#define ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_POSTINCREMENT 3
-#define ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_PREDECREMENT 4
-#define ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_DISPLACEMENT 5
-#define ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_INDEX 6
-//Mode = 7 and address register = :
-#define ADDRESS_MODE_OTHERS 7
-#define ADDRESS_MODE_ABSOLUTE_SHORT 0
-#define ADDRESS_MODE_ABSOLUTE_LONG 1
-#define ADDRESS_MODE_PROGRAM_COUNTER_WITH_DISPLACEMENT 2
-#define ADDRESS_MODE_PROGRAM_COUNTER_WITH_INDEX 3
-#define ADDRESS_MODE_IMMEDIATE_OR_STATUS_REGISTER 4
-
-//Size codes
-#define SIZE_BYTE 0
-#define SIZE_WORD 1
-#define SIZE_LONG 2
-
-//Index size codes
-#define INDEX_SIZE_WORD 0
-#define INDEX_SIZE_LONG 0x8
-
-//Conditional tests
-#define CONDITIONAL_TRUE 0
-#define CONDITIONAL_FALSE 1
-#define CONDITIONAL_HIGH 2
-#define CONDITIONAL_LOW_OR_SAME 3
-#define CONDITIONAL_CARRY_CLEAR 4
-#define CONDITIONAL_CARRY_SET 5
-#define CONDITIONAL_NOT_EQUAL 6
-#define CONDITIONAL_EQUAL 7
-#define CONDITIONAL_OVERFLOW_CLEAR 8
-#define CONDITIONAL_OVERFLOW_SET 9
-#define CONDITIONAL_PLUS 10
-#define CONDITIONAL_MINUS 11
-#define CONDITIONAL_GREATER_OR_EQUAL 12
-#define CONDITIONAL_LESS_THAN 13
-#define CONDITIONAL_GREATER_THAN 14
-#define CONDITIONAL_LESS_OR_EQUAL 15
+static_assert(std::is_trivially_copyable<CPUState>::value, "CPU state must copy as a block of bytes");
+static_assert(offsetof(CPUState, A) == offsetof(CPUState, registers) + 8 * sizeof(uint32_t),
+    "address registers must follow the data registers");
+
+//Instruction cache
+#define INSTRUCTION_CACHE_SIZE 8192 // Entries, a power of two
+#define INSTRUCTION_CACHE_EMPTY 0xFFFFFFFF // Odd, so never the address of an instruction
+
+//Labels runThreaded jumps to
+#define THREADED_EXECUTE 0 // Handlers that never stop the CPU
+#define THREADED_EXECUTE_AND_TEST 1 // Handlers that can stop it, whose result is tested
+
+//Basic blocks
+#define BLOCK_MAX_INSTRUCTIONS 64
+#define BLOCK_CHAIN_LIMIT 256 // Chained blocks run before returning to the caller
+#define BLOCK_PAGE_SHIFT 8
+#define JIT_THRESHOLD 16 // Executions of a translated block before it is compiled
+#define JIT_LOOP_LIMIT 65536 // Iterations of a block branching to itself before compiled code returns to the interpreter
+#define TIERED_TRANSLATE_THRESHOLD 4 // Times a block start is stepped through before it is translated
+#define IDLE_WAIT_MICROSECONDS 1000 // Host sleep when the program spins in an idle loop during a budgeted run
+
+// Loops over memory that translated blocks run on the host in one go
+#define IDIOM_NONE 0
+#define IDIOM_FILL 1 // MOVE #imm or Dn to (An)+, counted down in a data register
+#define IDIOM_COPY 2 // MOVE (An)+,(Am)+, counted down in a data register
+#define IDIOM_STRING_LENGTH 3 // MOVE.B (An)+,Dn until a zero byte
+#define IDIOM_FIND 4 // CMP.B (An)+,Dn until a byte matches
+#define IDIOM_COMPARE 5 // MOVE.B (An)+,Dn then CMP.B (Am)+,Dn for as long as the bytes match
+
+//Bit operations, as encoded in bits 7-6 of BTST, BCHG, BCLR and BSET
+#define BIT_TEST 0
+#define BIT_CHANGE 1
+#define BIT_CLEAR 2
+#define BIT_SET 3
+
+//Where an instruction pattern takes its operand size from
+#define SIZE_FIELD_NONE 0 // Unsized, or an address, and taken as a long
+#define SIZE_FIELD_BYTE 1
+#define SIZE_FIELD_WORD 2
+#define SIZE_FIELD_STANDARD 3 // Bits 7-6: byte, word or long
+#define SIZE_FIELD_MOVE 4 // Bits 13-12 of MOVE, which also has a destination in bits 11-6
+#define SIZE_FIELD_ADDRESS 5 // Bit 8: word or long, as for ADDA, SUBA and CMPA
+#define SIZE_FIELD_BIT_6 6 // Bit 6: word or long, as for MOVEM, EXT and MOVEP
+
+//Extension words an instruction pattern has before those of its effective address
+#define EXTENSION_NONE 0
+#define EXTENSION_WORD 1 // A displacement, bit number, register mask or immediate word
+#define EXTENSION_IMMEDIATE 2 // An immediate of the operand size
+#define EXTENSION_BRANCH 3 // A word displacement when the low byte of the opcode is zero
+
+//68000 clock cycles charged on top of the timing an instruction's dispatch entry gives
+#define EXCEPTION_CYCLES 30 // Taking an exception, so that TRAP, TRAPV and illegal instructions take 34 in all
+#define DIVIDE_BY_ZERO_CYCLES 8 // A division by zero up to its exception, making 38 with it
+#define DIVU_CYCLES 140 // The longest unsigned and signed divisions, charged for every division
+#define DIVS_CYCLES 158
+#define INTERRUPT_CYCLES 44 // Taking an autovectored interrupt, charged between instructions
+
+//Operations recorded for the lazily evaluated condition codes, besides the ones above
+#define FLAGS_LOGICAL 3 // MOVE, CLR and the like: N and Z from the result, V and C cleared
+#define FLAGS_EVALUATED 4 // SR holds the condition codes
 
 using namespace std;
 
 CPUCore::CPUCore(Memory *memory, int model = 68000)
 {
-    //TODO: Check for valid model number
-    this->model = (models)model;
+    switch (model) {
+    case MC68010:
+    case MC68020:
+    case MC68040:
+    case MC68060:
+        this->model = (models)model;
+        break;
+    default:
+        this->model = MC68000;
+    }
     this->memory = memory;
 
+    // The dispatch table only depends on the opcode encoding and the model, so each model's is
+    // built once and shared
+    instructionTable = sharedInstructionTable(this->model);
+    exceptionFormatWord = this->model != MC68000;
+    indexScaleMask = this->model >= MC68020 ? 3 : 0;
+
+    DecodedInstruction emptyEntry = {};
+    emptyEntry.address = INSTRUCTION_CACHE_EMPTY;
+    instructionCache.assign(INSTRUCTION_CACHE_SIZE, emptyEntry);
+
+    translateThreshold = TIERED_TRANSLATE_THRESHOLD;
+    compileThreshold = JIT_THRESHOLD;
+
+    // Writes over decoded instructions must drop them so that self-modifying code and newly loaded programs run correctly
+    if (memory != nullptr)
+        memory->setCodeWriteHandler([this](uint32_t address) {
+            invalidateInstructions(address);
+            invalidateBlocks(address);
+        });
+    // The 68000 and 68010 have 24 address lines, the 68020 and later 32
+    if (memory != nullptr)
+        memory->setAddressMask(this->model >= MC68020 ? 0xFFFFFFFF : 0x00FFFFFF);
+
     D[0] = 0;
     D[1] = 0;
     D[2] = 0;
@@ -121,8 +143,13 @@ CPUCore::CPUCore(Memory *memory, int model = 68000)
     A[5] = 0;
     A[6] = 0;
     SP = 0x0000FFFF;
+    inactiveStackPointer = 0;
     SR = 1 << SR_SUPERVISOR_MODE;
+    flagOperation = FLAGS_EVALUATED;
     PC = 0;
+    tracing = DEBUG_MODE == 1;
+    resumeAddress = INSTRUCTION_CACHE_EMPTY;
+    input = &cin;
 }
 
 
@@ -130,4178 +157,3349 @@ CPUCore::~CPUCore()
 {
 }
 
+void *CPUCore::operator new(size_t size)
+{
+    void *pointer;
+#ifdef WIN32
+    pointer = _aligned_malloc(size, alignof(CPUCore));
+#else
+    if (posix_memalign(&pointer, alignof(CPUCore), size) != 0)
+        pointer = nullptr;
+#endif
+    if (pointer == nullptr)
+        throw std::bad_alloc();
+    return pointer;
+}
+
+void CPUCore::operator delete(void *pointer)
+{
+#ifdef WIN32
+    _aligned_free(pointer);
+#else
+    free(pointer);
+#endif
+}
+
+// Executes the instruction at PC, decoding it first unless it is already in the instruction cache.
+// Returns true when successful and false otherwise
 bool CPUCore::startNextCycle()
 {
-    uint16_t instruction = memory->readWordFromMemory(PC);
-    if (decodeInstruction(instruction)) {
-        PC += 2;
-        return true;
+    DecodedInstruction &decoded = decodedInstructionAt(PC);
+
+    if (tracing)
+        traceInstruction(decoded);
+
+    nextExtensionWord = decoded.extensionWords;
+    PC += 2;
+    cycleCount += decoded.cycles;
+    return (this->*decoded.handler)(decoded.opcode);
+}
+
+// Returns the instruction cache entry for an address, decoding the instruction there on a miss
+inline CPUCore::DecodedInstruction &CPUCore::decodedInstructionAt(uint32_t address)
+{
+    DecodedInstruction &decoded = instructionCache[(address >> 1) & (INSTRUCTION_CACHE_SIZE - 1)];
+
+    if (decoded.address == address) {
+        instructionCacheHits++;
     }
     else {
-        return false;
+        instructionCacheMisses++;
+        predecodeInstruction(address, decoded);
     }
+    return decoded;
 }
 
-
-// Decodes and executes instruction. Returns true when successful and false otherwise
-bool CPUCore::decodeInstruction(uint16_t instruction)
+// Decodes the instruction at an address into an instruction cache entry. The opcode and its
+// extension words are read from memory here and nowhere else, and their page is marked as code
+// so that later writes to it reach invalidateInstructions.
+void CPUCore::predecodeInstruction(uint32_t address, DecodedInstruction &decoded)
 {
-    uint32_t data = 0;
-    uint32_t data2 = 0;
-    uint32_t result = 0;
-    bool mostSignificantBitSource = 0;
-    bool mostSignificantBitDestination = 0;
-    bool mostSignificantBitResult = 0;
-    int16_t displacement = 0;
-    int32_t longDisplacement = 0;
-    uint32_t absoluteAddress = 0;
-    uint8_t indexRegister = 0;
-    uint8_t indexSize = 0;
-    // debugging variables
-    string descriptiveInstruction = "";
-    string descriptiveSize = "";
-    string descriptiveAddressingMode = "";
-    ostringstream operand1;
-    ostringstream operand2;
-    ostringstream fullInstruction;
-
-    if (DEBUG_MODE)
-        cout << hex << uppercase << "Instruction: "<< instruction << endl << "PC: " << PC << dec << endl;
-    
-    // CLR (Clear an Operand)
-    if ((instruction & 0xFF00) == CLR) {
-        SR |= 1 << SR_CCR_ZERO;
-        SR &= ~(1 << SR_CCR_NEGATIVE);
-        SR &= ~(1 << SR_CCR_OVERFLOW);
-        SR &= ~(1 << SR_CCR_CARRY);
-        
-        int size = ((instruction >> 6) & 3);
-        int mode = ((instruction >> 3) & 7);
-        int reg = (instruction & 7);
-
-        if (DEBUG_MODE) {
-            descriptiveInstruction = "Clear";
-            switch (size) {
-            case SIZE_BYTE:
-                descriptiveSize = "Byte";
-                break;
-            case SIZE_WORD:
-                descriptiveSize = "Word";
-                break;
-            case SIZE_LONG:
-                descriptiveSize = "Long";
-                break;
-            default:
-                descriptiveSize = "? *Illegal size*";
-            }
-            switch (mode) {
-            case ADDRESS_MODE_DATA_REGISTER_DIRECT:
-                descriptiveAddressingMode = "Data register direct";
-                operand1 << "D" << reg;
-                break;
-            case ADDRESS_MODE_ADDRESS_REGISTER_DIRECT:
-                descriptiveAddressingMode = "Address register direct *Illegal address mode*";
-                break;
-            case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT:
-                descriptiveAddressingMode = "Address register indirect";
-                operand1 << "(A" << reg << ")";
-                break;
-            case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_POSTINCREMENT:
-                descriptiveAddressingMode = "Address register indirect with postincrement";
-                operand1 << "(A" << reg << ")+";
-                break;
-            case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_PREDECREMENT:
-                descriptiveAddressingMode = "Address register indirect with predecrement";
-                operand1 << "-(A" << reg << ")";
-                break;
-            case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_DISPLACEMENT:
-                descriptiveAddressingMode = "Address register indirect with displacement";
-                displacement = memory->readWordFromMemory(PC);
-                operand1 << displacement << "(A" << reg << ")";
-                break;
-            case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_INDEX:
-                descriptiveAddressingMode = "Address register indirect with displacement";
-                displacement = memory->readWordFromMemory(PC);
-                operand1 << displacement << "(A" << reg << ")";
-                break;
-            }
+    uint16_t opcode = memory->readWordFromMemory(address);
+    const InstructionEntry &entry = instructionTable[opcode];
+
+    decoded.handler = handlerFor(opcode);
+    decoded.address = address;
+    decoded.opcode = opcode;
+    decoded.length = 2 + 2 * entry.extensionWords;
+    decoded.threadedLabel = entry.canStop ? THREADED_EXECUTE_AND_TEST : THREADED_EXECUTE;
+    decoded.cycles = entry.cycles;
+    for (int i = 0; i < entry.extensionWords; i++)
+        decoded.extensionWords[i] = memory->readWordFromMemory(address + 2 + 2 * i);
+
+    // A branch closing an idle loop waits for an event when stepped, as executeBlock does for a block
+    uint32_t target;
+    size_t loopInstructions;
+    uint32_t loopCycles;
+    if ((entry.instruction == INSTRUCTION_BRA || entry.instruction == INSTRUCTION_BCC)
+        && branchTarget(memory, address, opcode, entry.instruction, target)
+        && idleLoopEndingAt(address, opcode, target, loopInstructions, loopCycles)) {
+        decoded.handler = &CPUCore::executeIdleBranch;
+        decoded.threadedLabel = THREADED_EXECUTE_AND_TEST;
+    }
 
-            fullInstruction << "CLR." << descriptiveSize[0] << " " << operand1.str();
+    // A breakpoint is an instruction that stops first, so checking for one costs nothing once decoded
+    if (!breakpoints.empty() && breakpoints.count(address) != 0) {
+        decoded.handler = &CPUCore::executeBreakpoint;
+        decoded.threadedLabel = THREADED_EXECUTE_AND_TEST;
+    }
 
-            cout << "Instruction description: " << descriptiveInstruction << endl;
-            cout << "Size: " << hex << uppercase << size << endl;
-            cout << "Size description: " << descriptiveSize << endl;
-            cout << "Mode: " << hex << uppercase << mode << endl;
-            cout << "Mode description: " << descriptiveAddressingMode << endl;
-            cout << "Address register: " << hex << uppercase << reg << endl;
-            cout << "Full instruction: " << fullInstruction.str() << endl << endl;
-        }
+    memory->markCode(address, decoded.length);
+}
 
-        switch (mode) {
-        case ADDRESS_MODE_DATA_REGISTER_DIRECT:
-            if (size == SIZE_BYTE)
-                writeByteToDataRegister(0, reg);
-            else if (size == SIZE_WORD)
-                writeWordToDataRegister(0, reg);
-            else
-                writeLongToDataRegister(0, reg);
-            return true;
-            break;
-        case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT:
-            if (size == SIZE_BYTE)
-                memory->writeByteToMemory(0, A[reg]);
-            else if (size == SIZE_WORD)
-                memory->writeWordToMemory(0, A[reg]);
-            else
-                memory->writeLongToMemory(0, A[reg]);
-            return true;
-            break;
-        case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_POSTINCREMENT:
-            if (size == SIZE_BYTE) {
-                memory->writeByteToMemory(0, A[reg]);
-                A[reg]++;
-            }
-            else if (size == SIZE_WORD) {
-                memory->writeWordToMemory(0, A[reg]);
-                A[reg] += 2;
-            }
-            else {
-                memory->writeLongToMemory(0, A[reg]);
-                A[reg] += 4;
-            }
-            return true;
-            break;
-        case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_PREDECREMENT:
-            if (size == SIZE_BYTE) {
-                A[reg]--;
-                memory->writeByteToMemory(0, A[reg]);
-            } 
-            else if (size == SIZE_WORD) {
-                A[reg] -= 2;
-                memory->writeWordToMemory(0, A[reg]);
-            }
-            else {
-                A[reg] -= 4;
-                memory->writeLongToMemory(0, A[reg]);
-            }
+// Finds where a branch, call or jump to a fixed address goes. Jumps through registers, returns
+// and everything else return false.
+bool CPUCore::branchTarget(Memory *memory, uint32_t address, uint16_t opcode, uint8_t instruction, uint32_t &target)
+{
+    switch (instruction) {
+    case INSTRUCTION_BCC:
+    case INSTRUCTION_BRA:
+    case INSTRUCTION_BSR:
+        if ((opcode & 0xFF) == 0)
+            target = address + 2 + (int16_t)memory->readWordFromMemory(address + 2);
+        else
+            target = address + 2 + (int8_t)(opcode & 0xFF);
+        return true;
+    case INSTRUCTION_DBCC:
+        target = address + 2 + (int16_t)memory->readWordFromMemory(address + 2);
+        return true;
+    case INSTRUCTION_JMP:
+    case INSTRUCTION_JSR:
+        switch (EA_MODE((opcode >> 3) & 7, opcode & 7)) {
+        case EA_ABSOLUTE_SHORT:
+            target = (int16_t)memory->readWordFromMemory(address + 2);
             return true;
-            break;
-        case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_DISPLACEMENT:
-            PC += 2;
-            displacement = memory->readWordFromMemory(PC);
-            if (DEBUG_MODE)
-                cout << "Displacement: " << displacement << endl;
-            if (size == SIZE_BYTE)
-                memory->writeByteToMemory(0, A[reg], displacement);
-            else if (size == SIZE_WORD)
-                memory->writeWordToMemory(0, A[reg], displacement);
-            else
-                memory->writeLongToMemory(0, A[reg], displacement);
+        case EA_ABSOLUTE_LONG:
+            target = memory->readLongFromMemory(address + 2);
             return true;
-            break;
-        case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_INDEX:
-            PC += 2;
-            indexRegister = (memory->readByteFromMemory(PC) >> 4) & 0x0F;
-            indexSize = memory->readByteFromMemory(PC) & 0x0F;
-            longDisplacement = memory->readByteFromMemory(PC + 1);
-            if (indexRegister <= 7) {
-                if (indexSize == INDEX_SIZE_WORD) {
-                    longDisplacement += (int16_t)D[indexRegister];
-                } else
-                    longDisplacement += D[indexRegister];
-            } else {
-                if (indexSize == INDEX_SIZE_WORD) {
-                    longDisplacement += (int16_t)A[indexRegister - 8];
-                }
-                else
-                    longDisplacement += D[indexRegister - 8];
-            }
-            
-            if (size == SIZE_BYTE)
-                memory->writeByteToMemory(0, A[reg], longDisplacement);
-            else if (size == SIZE_WORD)
-                memory->writeWordToMemory(0, A[reg], longDisplacement);
-            else
-                memory->writeLongToMemory(0, A[reg], longDisplacement);
+        case EA_PROGRAM_COUNTER_WITH_DISPLACEMENT:
+            target = address + 2 + (int16_t)memory->readWordFromMemory(address + 2);
             return true;
-            break;
-        case ADDRESS_MODE_OTHERS:
-            switch (reg) {
-            case ADDRESS_MODE_ABSOLUTE_SHORT:
-                PC += 2;
-                absoluteAddress = memory->readWordFromMemory(PC);
-                if (size == SIZE_BYTE)
-                    memory->writeByteToMemory(0, absoluteAddress);
-                else if (size == SIZE_WORD)
-                    memory->writeWordToMemory(0, absoluteAddress);
-                else
-                    memory->writeLongToMemory(0, absoluteAddress);
-                return true;
-                break;
-            case ADDRESS_MODE_ABSOLUTE_LONG:
-                PC += 2;
-                absoluteAddress = memory->readLongFromMemory(PC);
-                if (size == SIZE_BYTE)
-                    memory->writeByteToMemory(0, absoluteAddress);
-                else if (size == SIZE_WORD)
-                    memory->writeWordToMemory(0, absoluteAddress);
-                else
-                    memory->writeLongToMemory(0, absoluteAddress);
-                PC += 2;
-                return true;
-                break;
-            default:
-                cout << "Invalid addressing mode" << endl;
-                return false;
-                break;
-            }
-            break;
-
         default:
-            cout << "Unrecognised addressing mode" << endl;
             return false;
-            break;
         }
+    default:
+        return false;
     }
+}
 
-    // JMP (Jump)
-    if ((instruction & 0xFFC0) == JMP) {
-        int mode = ((instruction >> 3) & 7);
-        int reg = (instruction & 7);
-
-        if (DEBUG_MODE) {
-            cout << "JUMPING" << endl;
-            cout << "Mode is: " << mode << endl;
-            cout << "Address register is: " << reg << endl << endl;
-        }
-
-        switch (mode) {
-        case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT:
-            PC = A[reg] - 2;
-            return true;
-            break;
-        case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_DISPLACEMENT:
-            PC += 2;
-            displacement = memory->readWordFromMemory(PC);
-            if (DEBUG_MODE)
-                cout << "Displacement: " << displacement << endl;
-            PC = A[reg] + displacement - 2;
-            return true;
-            break;
-        case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_INDEX:
-            PC += 2;
-            indexRegister = (memory->readByteFromMemory(PC) >> 4) & 0x0F;
-            indexSize = memory->readByteFromMemory(PC) & 0x0F;
-            longDisplacement = memory->readByteFromMemory(PC + 1);
-            if (indexRegister <= 7) {
-                if (indexSize == INDEX_SIZE_WORD) {
-                    longDisplacement += (int16_t)D[indexRegister];
-                }
-                else
-                    longDisplacement += D[indexRegister];
-            }
-            else {
-                if (indexSize == INDEX_SIZE_WORD) {
-                    longDisplacement += (int16_t)A[indexRegister - 8];
-                }
-                else
-                    longDisplacement += D[indexRegister - 8];
-            }
+// Returns true for instructions after which the program never goes on to the next instruction
+bool CPUCore::endsControlFlow(uint8_t instruction)
+{
+    return instruction == INSTRUCTION_BRA || instruction == INSTRUCTION_JMP || instruction == INSTRUCTION_RTS
+        || instruction == INSTRUCTION_RTE || instruction == INSTRUCTION_RTR || instruction == INSTRUCTION_STOP
+        || instruction == INSTRUCTION_ILLEGAL;
+}
 
-            PC = A[reg] + longDisplacement - 2;
-            return true;
-            break;
-        case ADDRESS_MODE_OTHERS:
-            switch (reg) {
-            case ADDRESS_MODE_ABSOLUTE_SHORT:
-                PC += 2;
-                absoluteAddress = memory->readWordFromMemory(PC);
-                PC = absoluteAddress - 2;
-                return true;
-                break;
-            case ADDRESS_MODE_ABSOLUTE_LONG:
-                PC += 2;
-                absoluteAddress = memory->readLongFromMemory(PC);
-                PC = absoluteAddress - 2;
-                PC += 2;
+size_t CPUCore::predecodeReachable(uint32_t entryPoint, const std::vector<std::pair<uint32_t, uint32_t>> &ranges)
+{
+    auto isLoaded = [&ranges](uint32_t address, uint32_t length) {
+        for (const std::pair<uint32_t, uint32_t> &range : ranges) {
+            if (address >= range.first && address + length <= range.first + range.second)
                 return true;
+        }
+        return false;
+    };
+    // The walk is breadth first from the entry point, and the first instruction found for a cache
+    // entry is the one decoded into it, so the code nearest the entry wins entries that farther
+    // code shares. It stops once it has found as many instructions as the cache holds.
+    std::unordered_set<uint32_t> found;
+    std::vector<bool> claimed(INSTRUCTION_CACHE_SIZE);
+    std::vector<uint32_t> pending(1, entryPoint);
+
+    for (size_t next = 0; next < pending.size() && found.size() < INSTRUCTION_CACHE_SIZE; next++) {
+        uint32_t address = pending[next];
+
+        // Straight-line code is followed until it ends, leaves the ranges or joins code already found
+        while ((address & 1) == 0 && found.size() < INSTRUCTION_CACHE_SIZE && found.count(address) == 0
+            && isLoaded(address, 2)) {
+            uint16_t opcode = memory->readWordFromMemory(address);
+            const InstructionEntry &entry = instructionTable[opcode];
+            uint8_t length = 2 + 2 * entry.extensionWords;
+            uint32_t index = (address >> 1) & (INSTRUCTION_CACHE_SIZE - 1);
+            uint32_t target;
+
+            if (!isLoaded(address, length))
+                break;
+            found.insert(address);
+            if (!claimed[index]) {
+                claimed[index] = true;
+                predecodeInstruction(address, instructionCache[index]);
+            }
+            if (branchTarget(memory, address, opcode, entry.instruction, target))
+                pending.push_back(target);
+            address += length;
+            if (endsControlFlow(entry.instruction))
                 break;
-            case ADDRESS_MODE_PROGRAM_COUNTER_WITH_DISPLACEMENT:
-                PC += 2;
-                displacement = memory->readWordFromMemory(PC);
-                if (DEBUG_MODE)
-                    cout << "Displacement: " << displacement << endl;
-                PC += displacement - 2;;
-                break;
-            case ADDRESS_MODE_PROGRAM_COUNTER_WITH_INDEX:
-                PC += 2;
-                indexRegister = (memory->readByteFromMemory(PC) >> 4) & 0x0F;
-                indexSize = memory->readByteFromMemory(PC) & 0x0F;
-                longDisplacement = memory->readByteFromMemory(PC + 1);
-                if (indexRegister <= 7) {
-                    if (indexSize == INDEX_SIZE_WORD) {
-                        longDisplacement += (int16_t)D[indexRegister];
-                    }
-                    else
-                        longDisplacement += D[indexRegister];
-                }
-                else {
-                    if (indexSize == INDEX_SIZE_WORD) {
-                        longDisplacement += (int16_t)A[indexRegister - 8];
-                    }
-                    else
-                        longDisplacement += D[indexRegister - 8];
-                }
-                PC += longDisplacement - 2;
-                break;
-            default:
-                cout << "Invalid addressing mode" << endl;
-                return false;
-                break;
-            }
-            break;
-        default:
-            cout << "Unrecognised addressing mode" << endl;
-            return false;
-            break;
         }
     }
 
-    // MOVE.B (Move byte from source to destination)
-    if ((instruction & 0xF000) == MOVE_B) {
-        SR &= ~(1 << SR_CCR_OVERFLOW);
-        SR &= ~(1 << SR_CCR_CARRY);
-        
-        int sourceMode = ((instruction >> 3) & 7);
-        int sourceReg = (instruction & 7);
-        int destinationMode = ((instruction >> 6) & 7);
-        int destinationReg = ((instruction >> 9) & 7);
-
-        if (DEBUG_MODE) {
-            cout << "WE HAVE A MOVE BYTE" << endl;
-            cout << "Source mode is: " << sourceMode << endl;
-            cout << "Source address register is: " << sourceReg << endl;
-            cout << "Destination mode is: " << destinationMode << endl;
-            cout << "Destination address register is: " << destinationReg << endl << endl;
-        }
+    return found.size();
+}
 
-        switch (sourceMode) {
-        case ADDRESS_MODE_DATA_REGISTER_DIRECT:
-            data = D[sourceReg];
-            break;
-        case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT:
-            data = memory->readByteFromMemory(A[sourceReg]);
-            break;
-        case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_POSTINCREMENT:
-            data = memory->readByteFromMemory(A[sourceReg]);
-            A[sourceReg]++;
-            break;
-        case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_PREDECREMENT:
-            A[sourceReg]--;
-            data = memory->readByteFromMemory(A[sourceReg]);
-            break;
-        case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_DISPLACEMENT:
-            PC += 2;
-            displacement = memory->readWordFromMemory(PC);
-            if (DEBUG_MODE)
-                cout << "Displacement: " << displacement << endl;
-            data = memory->readByteFromMemory(A[sourceReg], displacement);
-            break;
-        case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_INDEX:
-            PC += 2;
-            indexRegister = (memory->readByteFromMemory(PC) >> 4) & 0x0F;
-            indexSize = memory->readByteFromMemory(PC) & 0x0F;
-            longDisplacement = memory->readByteFromMemory(PC + 1);
-            if (indexRegister <= 7) {
-                if (indexSize == INDEX_SIZE_WORD) {
-                    longDisplacement += (int16_t)D[indexRegister];
-                }
-                else
-                    longDisplacement += D[indexRegister];
-            }
-            else {
-                if (indexSize == INDEX_SIZE_WORD) {
-                    longDisplacement += (int16_t)A[indexRegister - 8];
-                }
-                else
-                    longDisplacement += D[indexRegister - 8];
-            }
-            data = memory->readByteFromMemory(A[sourceReg], longDisplacement);
-            break;
-        case ADDRESS_MODE_OTHERS:
-            switch (sourceReg) {
-            case ADDRESS_MODE_ABSOLUTE_SHORT:
-                PC += 2;
-                absoluteAddress = memory->readWordFromMemory(PC);
-                data = memory->readByteFromMemory(absoluteAddress);
-                break;
-            case ADDRESS_MODE_ABSOLUTE_LONG:
-                PC += 2;
-                absoluteAddress = memory->readLongFromMemory(PC);
-                data = memory->readByteFromMemory(absoluteAddress);
-                PC += 2;
-                break;
-            case ADDRESS_MODE_PROGRAM_COUNTER_WITH_DISPLACEMENT:
-                PC += 2;
-                displacement = memory->readWordFromMemory(PC);
-                if (DEBUG_MODE)
-                    cout << "Displacement: " << displacement << endl;
-                data = memory->readByteFromMemory(PC, displacement);
-                break;
-            case ADDRESS_MODE_PROGRAM_COUNTER_WITH_INDEX:
-                PC += 2;
-                indexRegister = (memory->readByteFromMemory(PC) >> 4) & 0x0F;
-                indexSize = memory->readByteFromMemory(PC) & 0x0F;
-                longDisplacement = memory->readByteFromMemory(PC + 1);
-                if (indexRegister <= 7) {
-                    if (indexSize == INDEX_SIZE_WORD) {
-                        longDisplacement += (int16_t)D[indexRegister];
-                    }
-                    else
-                        longDisplacement += D[indexRegister];
-                }
-                else {
-                    if (indexSize == INDEX_SIZE_WORD) {
-                        longDisplacement += (int16_t)A[indexRegister - 8];
-                    }
-                    else
-                        longDisplacement += D[indexRegister - 8];
-                }
-                data = memory->readByteFromMemory(PC, longDisplacement);
-                break;
-            case ADDRESS_MODE_IMMEDIATE_OR_STATUS_REGISTER:
-                PC += 2;
-                data = memory->readWordFromMemory(PC);
-                break;
-            default:
-                cout << "Invalid addressing mode" << endl;
-                return false;
-                break;
-            }
-            break;
+// Returns the handler an opcode is decoded to: its dispatch table handler, or executeHostHandler
+// for a TRAP, A-line or F-line opcode the host has bound a function to
+CPUCore::InstructionHandler CPUCore::handlerFor(uint16_t opcode)
+{
+    const InstructionEntry &entry = instructionTable[opcode];
 
-        default:
-            cout << "Unrecognised addressing mode" << endl;
-            return false;
-            break;
-        }
+    if (!hostHandlers.empty() && (entry.instruction == INSTRUCTION_TRAP || entry.instruction == INSTRUCTION_LINE_A
+        || entry.instruction == INSTRUCTION_LINE_F) && hostHandlers.count(opcode) != 0)
+        return &CPUCore::executeHostHandler;
+    return entry.handler;
+}
 
-        data == 0 ? SR |= 1 << SR_CCR_ZERO : SR &= ~(1 << SR_CCR_ZERO);
-        ((data >> 7) & 1) == 1 ? SR |= 1 << SR_CCR_NEGATIVE : SR &= ~(1 << SR_CCR_NEGATIVE);
-        
-        switch (destinationMode) {
-        case ADDRESS_MODE_DATA_REGISTER_DIRECT:
-            writeByteToDataRegister(data, destinationReg);
-            return true;
-            break;
-        case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT:
-            memory->writeByteToMemory(data, A[destinationReg]);
-            return true;
-            break;
-        case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_POSTINCREMENT:
-            memory->writeByteToMemory(data, A[destinationReg]);
-            A[destinationReg]++;
-            return true;
-            break;
-        case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_PREDECREMENT:
-            A[destinationReg]--;
-            memory->writeByteToMemory(data, A[destinationReg]);
-            return true;
-            break;
-        case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_DISPLACEMENT:
-            PC += 2;
-            displacement = memory->readWordFromMemory(PC);
-            cout << "Displacement: " << displacement << endl;
-            memory->writeByteToMemory(data, A[destinationReg], displacement);
-            return true;
-            break;
-        case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_INDEX:
-            PC += 2;
-            indexRegister = (memory->readByteFromMemory(PC) >> 4) & 0x0F;
-            indexSize = memory->readByteFromMemory(PC) & 0x0F;
-            longDisplacement = memory->readByteFromMemory(PC + 1);
-            if (indexRegister <= 7) {
-                if (indexSize == INDEX_SIZE_WORD) {
-                    longDisplacement += (int16_t)D[indexRegister];
-                }
-                else
-                    longDisplacement += D[indexRegister];
-            }
-            else {
-                if (indexSize == INDEX_SIZE_WORD) {
-                    longDisplacement += (int16_t)A[indexRegister - 8];
-                }
-                else
-                    longDisplacement += D[indexRegister - 8];
-            }
-            memory->writeByteToMemory(data, A[destinationReg], longDisplacement);
-            return true;
-            break;
-        case ADDRESS_MODE_OTHERS:
-            switch (destinationReg) {
-            case ADDRESS_MODE_ABSOLUTE_SHORT:
-                PC += 2;
-                absoluteAddress = memory->readWordFromMemory(PC);
-                memory->writeByteToMemory(data, absoluteAddress);
-                return true;
-                break;
-            case ADDRESS_MODE_ABSOLUTE_LONG:
-                PC += 2;
-                absoluteAddress = memory->readLongFromMemory(PC);
-                memory->writeByteToMemory(data, absoluteAddress);
-                PC += 2;
-                return true;
-                break;
-            default:
-                cout << "Invalid addressing mode" << endl;
-                return false;
-                break;
-            }
-            break;
+// Drops every cached instruction overlapping a write. The write is taken to be a long, the widest
+// access, so the instructions starting in the four bytes from the address are dropped along with
+// those starting before it that are long enough to reach it. An odd address reaches the instruction
+// starting three bytes on.
+void CPUCore::invalidateInstructions(uint32_t address)
+{
+    const uint32_t longestInstruction = 2 + 2 * MAX_EXTENSION_WORDS;
 
-        default:
-            cout << "Unrecognised addressing mode" << endl;
-            return false;
-            break;
-        }
+    for (uint32_t start = (address - longestInstruction + 2) & ~1; start != ((address + 3) & ~1) + 2; start += 2) {
+        DecodedInstruction &decoded = instructionCache[(start >> 1) & (INSTRUCTION_CACHE_SIZE - 1)];
+        if (decoded.address == start && address < start + decoded.length)
+            decoded.address = INSTRUCTION_CACHE_EMPTY;
     }
+}
 
-    // MOVE.W/MOV.L (Move word or long from source to destination)
-    if (((instruction & 0xF000) == MOVE_W) || ((instruction & 0xF000) == MOVE_L)) {
-        int size = SIZE_LONG;
-        if ((instruction & MOVE_W) == MOVE_W)
-            size = SIZE_WORD;
-
-        SR &= ~(1 << SR_CCR_OVERFLOW);
-        SR &= ~(1 << SR_CCR_CARRY);
-        
-        int sourceMode = ((instruction >> 3) & 7);
-        int sourceReg = (instruction & 7);
-        int destinationMode = ((instruction >> 6) & 7);
-        int destinationReg = ((instruction >> 9) & 7);
-
-        if (DEBUG_MODE) {
-            cout << "WE HAVE A MOVE" << endl;
-            cout << "Source mode is: " << sourceMode << endl;
-            cout << "Source address register is: " << sourceReg << endl;
-            cout << "Destination mode is: " << destinationMode << endl;
-            cout << "Destination address register is: " << destinationReg << endl << endl;
-        }
+// Runs instructions from the instruction cache until the CPU stops or the instruction budget is
+// used up. Rather than returning to a loop after each instruction, the end of each one jumps
+// straight to the code for the next through a label address (a GCC and Clang extension), and only
+// handlers that can stop the CPU have their result tested.
+void CPUCore::runThreaded()
+{
+#if defined(__GNUC__)
+    static const void *const labels[] = { &&execute, &&executeAndTest };
+    DecodedInstruction *decoded;
+
+#define DISPATCH() do { \
+        if (instructionBudget == 0 || (cycleCount >= nextDeadline && !reachDeadline())) \
+            return; \
+        instructionBudget--; \
+        decoded = &decodedInstructionAt(PC); \
+        nextExtensionWord = decoded->extensionWords; \
+        PC += 2; \
+        cycleCount += decoded->cycles; \
+        goto *labels[decoded->threadedLabel]; \
+    } while (0)
+
+    DISPATCH();
+execute:
+    (this->*decoded->handler)(decoded->opcode);
+    DISPATCH();
+executeAndTest:
+    if ((this->*decoded->handler)(decoded->opcode))
+        DISPATCH();
+    return;
+
+#undef DISPATCH
+#else
+    while (instructionBudget != 0 && (cycleCount < nextDeadline || reachDeadline())) {
+        instructionBudget--;
+        if (!startNextCycle())
+            return;
+    }
+#endif
+}
 
-        switch (sourceMode) {
-        case ADDRESS_MODE_DATA_REGISTER_DIRECT:
-            data = D[sourceReg];
-            break;
-        case ADDRESS_MODE_ADDRESS_REGISTER_DIRECT:
-            data = A[sourceReg];
-            break;
-        case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT:
-            if (size == SIZE_WORD)
-                data = memory->readWordFromMemory(A[sourceReg]);
-            else
-                data = memory->readLongFromMemory(A[sourceReg]);
-            break;
-        case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_POSTINCREMENT:
-            if (size == SIZE_WORD) {
-                data = memory->readWordFromMemory(A[sourceReg]);
-                A[sourceReg] += 2;
-            }
-            else {
-                data = memory->readLongFromMemory(A[sourceReg]);
-                A[sourceReg] += 4;
-            }
-            break;
-        case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_PREDECREMENT:
-            if (size == SIZE_WORD) {
-                A[sourceReg] -= 2;
-                data = memory->readWordFromMemory(A[sourceReg]);
-            }
-            else {
-                A[sourceReg] -= 4;
-                data = memory->readLongFromMemory(A[sourceReg]);
-            }
-            break;
-        case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_DISPLACEMENT:
-            PC += 2;
-            displacement = memory->readWordFromMemory(PC);
-            if (DEBUG_MODE)
-                cout << "Displacement: " << displacement << endl;
-            if (size == SIZE_WORD)
-                data = memory->readWordFromMemory(A[sourceReg], displacement);
-            else
-                data = memory->readLongFromMemory(A[sourceReg], displacement);
-            break;
-        case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_INDEX:
-            PC += 2;
-            indexRegister = (memory->readByteFromMemory(PC) >> 4) & 0x0F;
-            indexSize = memory->readByteFromMemory(PC) & 0x0F;
-            longDisplacement = memory->readByteFromMemory(PC + 1);
-            if (indexRegister <= 7) {
-                if (indexSize == INDEX_SIZE_WORD) {
-                    longDisplacement += (int16_t)D[indexRegister];
-                }
-                else
-                    longDisplacement += D[indexRegister];
-            }
-            else {
-                if (indexSize == INDEX_SIZE_WORD) {
-                    longDisplacement += (int16_t)A[indexRegister - 8];
-                }
-                else
-                    longDisplacement += D[indexRegister - 8];
-            }
-            if (size == SIZE_WORD)
-                data = memory->readWordFromMemory(A[sourceReg], longDisplacement);
-            else
-                data = memory->readLongFromMemory(A[sourceReg], longDisplacement);
-            break;
-        case ADDRESS_MODE_OTHERS:
-            switch (sourceReg) {
-            case ADDRESS_MODE_ABSOLUTE_SHORT:
-                PC += 2;
-                absoluteAddress = memory->readWordFromMemory(PC);
-                if (size == SIZE_WORD) {
-                    data = memory->readWordFromMemory(absoluteAddress);
-                }
-                else {
-                    data = memory->readLongFromMemory(absoluteAddress);
-                }
-                break;
-            case ADDRESS_MODE_ABSOLUTE_LONG:
-                PC += 2;
-                absoluteAddress = memory->readLongFromMemory(PC);
-                if (size == SIZE_WORD) {
-                    data = memory->readWordFromMemory(absoluteAddress);
-                }
-                else {
-                    data = memory->readLongFromMemory(absoluteAddress);
-                }
-                PC += 2;
-                break;
-            case ADDRESS_MODE_PROGRAM_COUNTER_WITH_DISPLACEMENT:
-                PC += 2;
-                displacement = memory->readWordFromMemory(PC);
-                if (DEBUG_MODE)
-                    cout << "Displacement: " << displacement << endl;
-                if (size == SIZE_WORD) {
-                    data = memory->readWordFromMemory(PC, displacement);
-                }
-                else {
-                    data = memory->readLongFromMemory(PC, displacement);
-                    PC += 2;
-                }
-                break;
-            case ADDRESS_MODE_PROGRAM_COUNTER_WITH_INDEX:
-                PC += 2;
-                indexRegister = (memory->readByteFromMemory(PC) >> 4) & 0x0F;
-                indexSize = memory->readByteFromMemory(PC) & 0x0F;
-                longDisplacement = memory->readByteFromMemory(PC + 1);
-                if (indexRegister <= 7) {
-                    if (indexSize == INDEX_SIZE_WORD) {
-                        longDisplacement += (int16_t)D[indexRegister];
-                    }
-                    else
-                        longDisplacement += D[indexRegister];
-                }
-                else {
-                    if (indexSize == INDEX_SIZE_WORD) {
-                        longDisplacement += (int16_t)A[indexRegister - 8];
-                    }
-                    else
-                        longDisplacement += D[indexRegister - 8];
-                }
-                if (size == SIZE_WORD) {
-                    data = memory->readWordFromMemory(PC, longDisplacement);
-                }
-                else {
-                    data = memory->readLongFromMemory(PC, longDisplacement);
-                    PC += 2;
-                }
-                break;
-            case ADDRESS_MODE_IMMEDIATE_OR_STATUS_REGISTER:
-                PC += 2;
-                if (size == SIZE_WORD) {
-                    data = memory->readWordFromMemory(PC);
-                }
-                else {
-                    data = memory->readLongFromMemory(PC);
-                    PC += 2;
-                }
-                break;
-            default:
-                cout << "Invalid addressing mode" << endl;
-                return false;
-                break;
-            }
-            break;
+void CPUCore::setInterpreter(interpreters interpreter)
+{
+    this->interpreter = interpreter;
 
-        default:
-            cout << "Unrecognised addressing mode" << endl;
-            return false;
-            break;
-        }
+    // Blocks may hold code from the compiler being replaced. The tiered interpreter compiles on a
+    // background thread and the JIT interpreter compiles as it goes.
+    bool useJit = (interpreter == INTERPRETER_JIT || interpreter == INTERPRETER_TIERED) && JitCompiler::isSupported();
+    flushBlocks();
+    jit.reset(useJit ? new JitCompiler(this, interpreter == INTERPRETER_TIERED) : nullptr);
+}
 
-        data == 0 ? SR |= 1 << SR_CCR_ZERO : SR &= ~(1 << SR_CCR_ZERO);
+void CPUCore::setTierThresholds(unsigned int translateThreshold, unsigned int compileThreshold)
+{
+    this->translateThreshold = translateThreshold;
+    this->compileThreshold = compileThreshold;
+}
 
-        if (size == SIZE_WORD)
-            ((data >> 15) & 1) == 1 ? SR |= 1 << SR_CCR_NEGATIVE : SR &= ~(1 << SR_CCR_NEGATIVE);
-        else
-            ((data >> 31) & 1) == 1 ? SR |= 1 << SR_CCR_NEGATIVE : SR &= ~(1 << SR_CCR_NEGATIVE);
+CPUCore::stopReasons CPUCore::run(uint64_t budget, budgetUnits units)
+{
+    instructionBudget = units == BUDGET_INSTRUCTIONS ? budget : RUN_UNLIMITED;
+    instructionBudgetGiven = instructionBudget != RUN_UNLIMITED;
+    cycleLimit = units == BUDGET_CYCLES && budget < RUN_UNLIMITED - cycleCount ? cycleCount + budget : RUN_UNLIMITED;
+    updateDeadline();
+    stopReason = STOP_BUDGET_EXHAUSTED;
+    resumeAddress = PC;
+
+    // A CPU stopped by STOP only carries on once an interrupt is taken
+    if (stopped)
+        waitForInterrupt();
+
+    // Only stepping sees every instruction, so tracing always runs the program that way
+    if (stopped)
+        stopReason = STOP_STOPPED;
+    else switch (tracing ? INTERPRETER_STEP : interpreter) {
+    case INTERPRETER_STEP:
+        while (instructionBudget != 0 && (cycleCount < nextDeadline || reachDeadline())) {
+            instructionBudget--;
+            if (!startNextCycle())
+                break;
+        }
+        break;
+    case INTERPRETER_BLOCKS:
+    case INTERPRETER_JIT:
+        while (executeBlock());
+        break;
+    case INTERPRETER_TIERED:
+        runTiered();
+        break;
+    default:
+        runThreaded();
+        break;
+    }
 
-        switch (destinationMode) {
-        case ADDRESS_MODE_DATA_REGISTER_DIRECT:
-            if (size == SIZE_WORD)
-                writeWordToDataRegister(data, destinationReg);
-            else
-                writeLongToDataRegister(data, destinationReg);
-            return true;
-            break;
-        case ADDRESS_MODE_ADDRESS_REGISTER_DIRECT:
-            if (size == SIZE_WORD)
-                writeWordToAddressRegister(data, destinationReg);
-            else
-                writeLongToAddressRegister(data, destinationReg);
-            return true;
-            break;
-        case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT:
-            if (size == SIZE_WORD)
-                memory->writeWordToMemory(data, A[destinationReg]);
-            else
-                memory->writeLongToMemory(data, A[destinationReg]);
-            return true;
-            break;
-        case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_POSTINCREMENT:
-            if (size == SIZE_WORD) {
-                memory->writeWordToMemory(data, A[destinationReg]);
-                A[destinationReg] += 2;
-            }
-            else {
-                memory->writeLongToMemory(data, A[destinationReg]);
-                A[destinationReg] += 4;
-            }
-            return true;
-            break;
-        case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_PREDECREMENT:
-            if (size == SIZE_WORD) {
-                A[destinationReg] += 2;
-                memory->writeWordToMemory(data, A[destinationReg]);
-            }
-            else {
-                A[destinationReg] += 4;
-                memory->writeLongToMemory(data, A[destinationReg]);
-            }
-            return true;
-            break;
-        case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_DISPLACEMENT:
-            PC += 2;
-            displacement = memory->readWordFromMemory(PC);
-            if (DEBUG_MODE)
-                cout << "Displacement: " << displacement << endl;
-            if (size == SIZE_WORD)
-                memory->writeWordToMemory(data, A[destinationReg], displacement);
-            else
-                memory->writeLongToMemory(data, A[destinationReg], displacement);
-            return true;
-            break;
-        case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_INDEX:
-            PC += 2;
-            indexRegister = (memory->readByteFromMemory(PC) >> 4) & 0x0F;
-            indexSize = memory->readByteFromMemory(PC) & 0x0F;
-            longDisplacement = memory->readByteFromMemory(PC + 1);
-            if (indexRegister <= 7) {
-                if (indexSize == INDEX_SIZE_WORD) {
-                    longDisplacement += (int16_t)D[indexRegister];
-                }
-                else
-                    longDisplacement += D[indexRegister];
-            }
-            else {
-                if (indexSize == INDEX_SIZE_WORD) {
-                    longDisplacement += (int16_t)A[indexRegister - 8];
-                }
-                else
-                    longDisplacement += D[indexRegister - 8];
-            }
-            if (size == SIZE_WORD)
-                memory->writeWordToMemory(data, A[destinationReg], longDisplacement);
-            else
-                memory->writeLongToMemory(data, A[destinationReg], longDisplacement);
-            return true;
-            break;
-        case ADDRESS_MODE_OTHERS:
-            switch (destinationReg) {
-            case ADDRESS_MODE_ABSOLUTE_SHORT:
-                PC += 2;
-                absoluteAddress = memory->readWordFromMemory(PC);
-                if (size == SIZE_WORD)
-                    memory->writeWordToMemory(data, absoluteAddress);
-                else
-                    memory->writeLongToMemory(data, absoluteAddress);
-                return true;
-                break;
-            case ADDRESS_MODE_ABSOLUTE_LONG:
-                PC += 2;
-                absoluteAddress = memory->readLongFromMemory(PC);
-                if (size == SIZE_WORD)
-                    memory->writeWordToMemory(data, absoluteAddress);
-                else
-                    memory->writeLongToMemory(data, absoluteAddress);
-                PC += 2;
-                return true;
-                break;
-            default:
-                cout << "Invalid addressing mode" << endl;
-                return false;
-                break;
-            }
-            break;
+    // Blocks run outside run are not held to a budget
+    instructionBudget = RUN_UNLIMITED;
+    instructionBudgetGiven = false;
+    cycleLimit = RUN_UNLIMITED;
+    updateDeadline();
+    resumeAddress = INSTRUCTION_CACHE_EMPTY;
+    return stopReason;
+}
 
-        default:
-            cout << "Unrecognised addressing mode" << endl;
-            return false;
-            break;
-        }
+uint64_t CPUCore::scheduleEvent(uint64_t cycle, EventScheduler::Callback callback)
+{
+    uint64_t id = scheduler.schedule(cycle, std::move(callback));
+    updateDeadline();
+    return id;
+}
+
+bool CPUCore::cancelEvent(uint64_t id)
+{
+    bool cancelled = scheduler.cancel(id);
+    updateDeadline();
+    return cancelled;
+}
+
+// Events keep their deadline even when run is given no cycle budget, so the run loops have a
+// single cycle count to compare with. A pending interrupt makes it zero, which is always reached.
+void CPUCore::updateDeadline()
+{
+    nextDeadline = interruptPending ? 0 : std::min(cycleLimit, scheduler.nextDeadline());
+}
+
+// Called when the cycle count reaches nextDeadline. Runs the events now due, then takes any
+// interrupt pending, which leaves PC in its handler. Returns false when execution stops there or
+// the cycle budget of run is used up.
+bool CPUCore::reachDeadline()
+{
+    scheduler.runDue(cycleCount);
+    if (interruptPending && !takeInterrupt())
+        return false;
+    updateDeadline();
+    return cycleCount < cycleLimit;
+}
+
+void CPUCore::assertInterrupt(int level)
+{
+    if (level == 7 && (interruptLevels & (1 << 7)) == 0)
+        nonMaskableInterrupt = true;
+    interruptLevels |= 1 << level;
+    updateInterruptPending();
+}
+
+void CPUCore::clearInterrupt(int level)
+{
+    interruptLevels &= ~(1 << level);
+    updateInterruptPending();
+}
+
+// Checks the asserted levels against the interrupt mask, whenever either changes
+void CPUCore::updateInterruptPending()
+{
+    int mask = (SR & SR_INTERRUPT_MASK) >> SR_INT0;
+    interruptPending = nonMaskableInterrupt || (interruptLevels >> (mask + 1)) != 0;
+    updateDeadline();
+}
+
+// Takes the highest interrupt asserted through its autovector, raising the interrupt mask to its
+// level so that only a higher one can interrupt the handler
+bool CPUCore::takeInterrupt()
+{
+    int level = 7;
+    while ((interruptLevels & (1 << level)) == 0)
+        level--;
+    if (level == 7)
+        nonMaskableInterrupt = false;
+
+    stopped = false;
+    if (!exception(VECTOR_SPURIOUS_INTERRUPT + level, PC))
+        return false;
+    cycleCount += INTERRUPT_CYCLES - EXCEPTION_CYCLES;
+    SR = (SR & ~SR_INTERRUPT_MASK) | (level << SR_INT0);
+    updateInterruptPending();
+    return true;
+}
+
+// Passes the time after STOP from one scheduled event to the next until one of them raises an
+// interrupt the mask lets through. With a cycle budget and no interrupt, the CPU stays stopped
+// for the whole of it.
+void CPUCore::waitForInterrupt()
+{
+    while (!interruptPending && scheduler.size() != 0 && nextDeadline != cycleLimit) {
+        cycleCount = std::max(cycleCount, nextDeadline);
+        scheduler.runDue(cycleCount);
+        updateDeadline();
     }
+    if (!interruptPending && cycleLimit != RUN_UNLIMITED)
+        cycleCount = std::max(cycleCount, cycleLimit);
+    stopped = !interruptPending;
+}
 
-    // MOVEQ (Move quick)
-    if ((instruction & 0xF000) == MOVEQ) {
-
-        SR &= ~(1 << SR_CCR_OVERFLOW);
-        SR &= ~(1 << SR_CCR_CARRY);
-        data = instruction & 0xFF;
-        int destinationReg = ((instruction >> 9) & 7);
-        if (DEBUG_MODE) {
-            cout << "WE HAVE A MOVE QUICK" << endl;
-            cout << "Data is: " << hex << data << dec << endl;
-            cout << "Destination register is: " << destinationReg << endl;
-        }
+void CPUCore::addBreakpoint(uint32_t address)
+{
+    breakpoints.insert(address);
+    invalidateInstructions(address);
+    flushBlocks();
+}
 
-        data == 0 ? SR |= 1 << SR_CCR_ZERO : SR &= ~(1 << SR_CCR_ZERO);
-        ((data >> 7) & 0x1) == 1 ? SR |= 1 << SR_CCR_NEGATIVE : SR &= ~(1 << SR_CCR_NEGATIVE);
+void CPUCore::removeBreakpoint(uint32_t address)
+{
+    breakpoints.erase(address);
+    invalidateInstructions(address);
+    flushBlocks();
+}
+
+void CPUCore::bindTrap(int vector, HostHandler handler)
+{
+    bindHostHandler(TRAP | (vector & 15), std::move(handler));
+}
 
-        writeByteToDataRegister(data, destinationReg);
+bool CPUCore::bindLineOpcode(uint16_t opcode, HostHandler handler)
+{
+    if ((opcode & 0xF000) != LINE_A && (opcode & 0xF000) != LINE_F)
+        return false;
+    bindHostHandler(opcode, std::move(handler));
+    return true;
+}
 
-        return true;
+// Binds or unbinds a host function, dropping the decoded copies of the opcode. Translated blocks
+// are only flushed between instructions, as a handler may bind others while its block runs.
+void CPUCore::bindHostHandler(uint16_t opcode, HostHandler handler)
+{
+    if (handler)
+        hostHandlers[opcode] = std::move(handler);
+    else
+        hostHandlers.erase(opcode);
+
+    for (DecodedInstruction &decoded : instructionCache) {
+        if (decoded.opcode == opcode)
+            decoded.address = INSTRUCTION_CACHE_EMPTY;
     }
+    blockFlushPending = true;
+}
 
-    // TRAP
-    if ((instruction & 0xFFF0) == TRAP) {
-        uint8_t vector = instruction & 15;
-        if (DEBUG_MODE)
-            cout << "TRAP" << endl;
-
-        switch (vector) {
-        case 15:
-            /* IO (Compatible with Easy68k)
-            0	 Display string at (A1), D1.W bytes long (max 255) with carriage return and line feed (CR, LF). (see task 13)
-            1	 Display string at (A1), D1.W bytes long (max 255) without CR, LF. (see task 14)
-            2	 Read string from keyboard and store at (A1), NULL terminated, length retuned in D1.W (max 80)
-            3	 Display signed number in D1.L in decimal in smallest field. (see task 15 & 20)
-            4	 Read a number from the keyboard into D1.L.
-            5	 Read single character from the keyboard into D1.B.
-            6	 Display single character in D1.B.
-            7
-            Set D1.B to 1 if keyboard input is pending, otherwise set to 0.
-            Use code 5 to read pending key.
-
-            8	 Return time in hundredths of a second since midnight in D1.L.
-            9	 Terminate the program. (Halts the simulator)
-            10
-            Print the NULL terminated string at (A1) to the default printer. (Not Teesside compatible.)
-            Always send a Form Feed character to end printing. (See below.)
-            11
-            Position the cursor at ROW, COL.
-            The high byte of D1.W holds the COL number (0-79),
-            The low byte holds the ROW number (0-31).
-            0,0 is top left 79,31 is the bottom right.
-            Out of range coordinates are ignored.
-            Clear Screen : Set D1.W to $FF00.
-            12
-            Keyboard Echo.
-            D1.B = 0 to turn off keyboard echo.
-            D1.B = non zero to enable it (default).
-            Echo is restored on 'Reset' or when a new file is loaded.
-            13	 Display the NULL terminated string at (A1) with CR, LF.
-            14	 Display the NULL terminated string at (A1) without CR, LF.
-            15
-            Display the unsigned number in D1.L converted to number base (2 through 36) contained in D2.B.
-            For example, to display D1.L in base16 put 16 in D2.B
-            Values of D2.B outside the range 2 to 36 inclusive are ignored.
-            16	 Adjust display properties
-            D1.B = 0 to turn off the display of the input prompt.
-            D1.B = 1 to turn on the display of the input prompt. (default)
-            D1.B = 2 do not display a line feed when Enter pressed during Trap task #2 input
-            D1.B = 3 display a line feed when Enter key pressed during Trap task #2 input (default)
-            Other values of D1 reserved for future use.
-            Input prompt display is enabled by default and by 'Reset' or when a new file is loaded.
-            17
-            Combination of Trap codes 14 & 3.
-            Display the NULL terminated string at (A1) without CR, LF then
-            Display the decimal number in D1.L.
-            18	 Combination of Trap codes 14 & 4.
-            Display the NULL terminated string at (A1) without CR, LF then
-            Read a number from the keyboard into D1.L.
-            19	 Returns current state of up to 4 specified keys or returns key scan code.
-            Pre: D1.L = four 1-byte key codes
-            Post: D1.L contains four 1-byte Booleans.
-            $FF = corresponding key is pressed, $00 = corresponding key not pressed.
-            Pre: D1.L = $00000000
-            Post: D1.B contains key code of last key pressed
-            20	 Display signed number in D1.L in decimal in field D2.B columns wide.
-            21	 Set Font Color
-            D1.L = color as $00BBGGRR
-            BB is amount of blue from $00 to $FF
-            GG is amount of green from $00 to $FF
-            RR is amount of red from $00 to $FF
-            D2.B = style by bits,  0 = off, 1 = on
-            bit0 is Bold
-            bit1 is Italic
-            bit2 is Underline
-            bit3 is StrikeOut
-            22
-            Read char at Row,Col of text screen.
-            Pre: D1.L = High 16 bits = Row
-            Low 16 bits = Col
-            Post: D1.B contains ASCII code of character.
-            */
-            switch (D[0] & 0xFF) {
-            case 0:
-            {
-                int length = (uint16_t)D[1];
-                for (int i = 0; i < length; i++)
-                    cout << memory->readByteFromMemory(A[1], i);
-                cout << endl;
-                break;
-            }
-            case 1:
-            {
-                int length = (uint16_t)D[1];
-                for (int i = 0; i < length; i++)
-                    cout << memory->readByteFromMemory(A[1], i);
-                break;
-            }
-            case 2:
-            {
-                string inputString;
-                cin >> inputString;
+void CPUCore::setInput(std::istream *stream, bool waitForInput)
+{
+    input = stream;
+    this->waitForInput = waitForInput;
+}
 
-                writeWordToDataRegister((uint16_t)inputString.length(), 1);
+void CPUCore::setTracing(bool enabled)
+{
+    tracing = enabled;
+}
 
-                int index = 0;
+// Prints an instruction about to run
+void CPUCore::traceInstruction(const DecodedInstruction &decoded)
+{
+    cout << hex << uppercase << "Instruction: " << decoded.opcode << endl << "PC: " << decoded.address << dec << endl;
+}
 
-                for (char character : inputString) {
-                    memory->writeByteToMemory(character, A[1], index);
-                    index++;
-                }
+// Runs code in three tiers. Code starts out stepped an instruction at a time from the instruction
+// cache, a block whose start has been reached translateThreshold times is translated, and a
+// translated block run compileThreshold times is compiled on the background thread, carrying on
+// in the block interpreter until its code is ready.
+void CPUCore::runTiered()
+{
+    for (;;) {
+        if (blockFlushPending)
+            flushBlocks();
+        if (jit)
+            jit->installCompiledBlocks();
+
+        if (translatedBlocks.find(PC) == translatedBlocks.end() && ++blockHotness[PC] < translateThreshold) {
+            // Step to the end of the block, where the next block start is counted
+            tierExecutions[TIER_INTERPRETED]++;
+            for (int count = 0; count < BLOCK_MAX_INSTRUCTIONS; count++) {
+                if (instructionBudget == 0 || (cycleCount >= nextDeadline && !reachDeadline()))
+                    return;
+                instructionBudget--;
+                const DecodedInstruction &decoded = decodedInstructionAt(PC);
+                nextExtensionWord = decoded.extensionWords;
+                PC += 2;
+                cycleCount += decoded.cycles;
+                if (!(this->*decoded.handler)(decoded.opcode))
+                    return;
+                if (instructionTable[decoded.opcode].endsBlock)
+                    break;
+            }
+        }
+        else if (!executeBlock()) {
+            return;
+        }
+    }
+}
 
-                memory->writeByteToMemory(0, A[1], index);
-                break;
-            }
-            case 3:
-            {
-                int32_t number = D[1];
-                cout << number;
-                break;
-            }
-            case 4:
-                int number;
-                cin >> number;
-                writeLongToDataRegister(number, 1);
-                break;
-            case 5:
-            {
-                char character;
-                cin >> character;
-                writeByteToDataRegister(character, 1);
-                break;
-            }
-            case 6:
-                cout << (char)D[1];
-                break;
-            case 9:
-                return false;
-                break;
-            case 11:
-            {
-                if ((uint16_t)D[1] == 0xFF00) {
-                    // Clear screen
-#ifdef WIN32
-                    system("cls");
-#endif
-                }
-                else {
-                    uint16_t row = D[1] & 0xFF;
-                    uint16_t column = (D[1] >> 8) & 0xFF;
-#ifdef WIN32
-                    COORD coord;
-                    coord.X = column;
-                    coord.Y = row;
-                    SetConsoleCursorPosition(
-                        GetStdHandle(STD_OUTPUT_HANDLE),
-                        coord
-                        );
-#endif
-                }
-                break;
-            }
-            case 12:
-#ifdef WIN32
-            {
-                HANDLE hStdin = GetStdHandle(STD_INPUT_HANDLE);
-                DWORD mode;
-                GetConsoleMode(hStdin, &mode);
+// Runs the basic block at PC, then follows each block's exit to the block after it without
+// returning, until BLOCK_CHAIN_LIMIT blocks have run. Returns true when successful and false when
+// execution stops or the instruction budget is used up. A loop run in one go as an idiom or in
+// compiled code is only started with the budget for all its passes, so the budget is never overrun.
+bool CPUCore::executeBlock()
+{
+    if (blockFlushPending)
+        flushBlocks();
 
-                if (D[1] == 0)
-                    mode &= ~ENABLE_ECHO_INPUT;
-                else
-                    mode |= ENABLE_ECHO_INPUT;
+    TranslatedBlock *block = findBlock(PC);
 
-                SetConsoleMode(hStdin, mode);
-            }
+    for (int chained = 0; chained < BLOCK_CHAIN_LIMIT; chained++) {
+        if (cycleCount >= nextDeadline) {
+            if (!reachDeadline())
+                return false;
+            // An interrupt or event has taken PC or written over code
+            if (PC != block->address || blockFlushPending)
+                return true;
+        }
 
-#else
-                struct termios tty;
-                tcgetattr(STDIN_FILENO, &tty);
-                if (!enable)
-                    tty.c_lflag &= ~ECHO;
-                else
-                    tty.c_lflag |= ECHO;
-
-                (void)tcsetattr(STDIN_FILENO, TCSANOW, &tty);
-#endif
-                break;
-            case 13:
-            {
-                char character = memory->readByteFromMemory(A[1]);
-                unsigned int characterIndex = 0;
-                while (character != 0) {
-                    cout << character;
-                    characterIndex++;
-                    character = memory->readByteFromMemory(A[1] + characterIndex);
-                }
-                cout << endl;
-                break;
+        // Loops run in one go stop short of the next event, which then runs between instructions
+        size_t first = 0;
+        uint64_t passes = instructionBudget / block->instructions.size();
+        if (passes > (nextDeadline - cycleCount) / block->cycles)
+            passes = (nextDeadline - cycleCount) / block->cycles;
+
+        tierExecutions[block->native != nullptr ? TIER_COMPILED : TIER_TRANSLATED]++;
+        if (block->idiom.kind != IDIOM_NONE && passes != 0) {
+            uint64_t iterations = executeIdiom(*block, passes);
+            if (iterations != 0) {
+                instructionBudget -= iterations * block->instructions.size();
+                cycleCount += iterations * block->cycles + fallThroughCycles(*block);
+                block = successorBlock(block);
+                if (block == nullptr)
+                    return true;
+                continue;
+            }
+        }
+
+        if (block->native != nullptr && passes != 0) {
+            // Compiled code keeps the condition codes in SR
+            uint32_t loopLimit = passes < JIT_LOOP_LIMIT ? (uint32_t)passes : JIT_LOOP_LIMIT;
+            evaluateFlags();
+            nativeLoopCounter = loopLimit;
+            block->native(registers);
+            // The counter is left at zero when the loop limit is reached, having made every pass,
+            // and otherwise counts down once for each pass but the last
+            uint64_t made = nativeLoopCounter == 0 ? loopLimit : loopLimit - nativeLoopCounter + 1;
+            uint64_t ran = made * block->nativeInstructionCount;
+            uint64_t cycles = made * block->nativeCycles;
+            if (blockFlushPending) {
+                // A write over translated code left the last pass just after the instruction that
+                // made it, with PC at the next, so only the instructions before PC ran in that pass
+                ran -= block->nativeInstructionCount;
+                cycles -= block->nativeCycles;
+                for (size_t i = 0; i < block->nativeInstructionCount && block->instructions[i].address < PC; i++) {
+                    ran++;
+                    cycles += block->instructions[i].cycles;
+                }
+            }
+            else if (block->nativeInstructionCount == block->instructions.size() && PC == block->endAddress) {
+                cycles += fallThroughCycles(*block);
+            }
+            instructionBudget -= ran < instructionBudget ? ran : instructionBudget;
+            cycleCount += cycles;
+            if (blockFlushPending) {
+                flushBlocks();
+                return true;
             }
-            case 14:
-            {
-                char character = memory->readByteFromMemory(A[1]);
-                unsigned int characterIndex = 0;
-                while (character != 0) {
-                    cout << character;
-                    characterIndex++;
-                    character = memory->readByteFromMemory(A[1] + characterIndex);
-                }
-                break;
+            first = block->nativeInstructionCount;
+        }
+        else if (jit && ++block->executionCount == compileThreshold) {
+            if (interpreter == INTERPRETER_TIERED)
+                jit->compileInBackground(block);
+            else
+                jit->compile(block);
+        }
+
+        for (size_t i = first; i < block->instructions.size(); i++) {
+            if (instructionBudget == 0)
+                return false;
+            const DecodedInstruction &decoded = block->instructions[i];
+            if (cycleCount >= nextDeadline) {
+                if (!reachDeadline())
+                    return false;
+                if (PC != decoded.address || blockFlushPending)
+                    return true;
             }
-            default:
-                cout << "Unknown IO task" << endl;
+            instructionBudget--;
+            nextExtensionWord = decoded.extensionWords;
+            PC += 2;
+            cycleCount += decoded.cycles;
+            if (!(this->*decoded.handler)(decoded.opcode))
                 return false;
-                break;
+
+            // The block has been written over, so carry on from PC with freshly translated code
+            if (blockFlushPending) {
+                flushBlocks();
+                return true;
             }
-            return true;
-        default:
-            cout << "Unknown TRAP task" << endl;
-            return false;
-            break;
         }
+
+        // An idle loop that comes straight back to itself will only ever see the same state again
+        if (block->idle && PC == block->address)
+            return waitForEvent(block->instructions.size(), block->cycles);
+        block = successorBlock(block);
+        if (block == nullptr)
+            return true;
     }
+    return true;
+}
 
-    // NOP (No Operation)
-    if (instruction == NOP) {
-        if (DEBUG_MODE)
-            cout << "NO OPERATION" << endl;
+// Gives up the host CPU while the program waits on memory only something outside the CPU can
+// change, rather than spinning through the same loop at full speed. When a device event is
+// scheduled, the passes the loop would make before it are charged at once instead, so that the
+// event runs next. With nothing scheduled only another thread can end the wait, through wake, so
+// the host sleeps until it is called. Given a budget, run sleeps once at most and then charges the
+// rest of the budget rather than sleeping through every pass it allows. Returns false when woken.
+bool CPUCore::waitForEvent(size_t instructions, uint32_t cycles)
+{
+    if (scheduler.size() == 0) {
+        idleWaits++;
+        std::unique_lock<std::mutex> lock(wakeLock);
+        auto woken = [this]() { return wakeRequested.load(); };
+        if (!instructionBudgetGiven && nextDeadline == RUN_UNLIMITED)
+            wakeSignal.wait(lock, woken);
+        else
+            wakeSignal.wait_for(lock, std::chrono::microseconds(IDLE_WAIT_MICROSECONDS), woken);
+        if (wakeRequested.exchange(false))
+            return stopExecution(STOP_WOKEN);
+    }
 
+    if (cycleCount >= nextDeadline)
         return true;
-    }
+    uint64_t passes = instructionBudget / instructions;
+    if (nextDeadline != RUN_UNLIMITED && passes > (nextDeadline - cycleCount + cycles - 1) / cycles)
+        passes = (nextDeadline - cycleCount + cycles - 1) / cycles;
+    instructionBudget -= passes * instructions;
+    cycleCount += passes * cycles;
+    return true;
+}
 
-    // LEA (Load Effective Addreww)
-    if ((instruction & 0xF1C0) == LEA) {
+void CPUCore::wake()
+{
+    std::lock_guard<std::mutex> lock(wakeLock);
+    wakeRequested = true;
+    wakeSignal.notify_one();
+}
 
-        int sourceMode = ((instruction >> 3) & 7);
-        int sourceReg = (instruction & 7);
-        int destinationReg = ((instruction >> 9) & 7);
+// Returns the cycles to add to a block's total, which times its closing Bcc as taken, when the
+// branch falls through instead, as executeBcc charges them: 2 more for a word branch and 2 fewer
+// for a byte one. Loops run in one go leave through the branch on their last pass.
+int CPUCore::fallThroughCycles(const TranslatedBlock &block)
+{
+    const DecodedInstruction &branch = block.instructions.back();
 
-        if (DEBUG_MODE) {
-            cout << "LOADING EFFECTIVE ADDRESS" << endl;
-            cout << "Source mode is: " << sourceMode << endl;
-            cout << "Source address register is: " << sourceReg << endl;
-            cout << "Destination address register is: " << destinationReg << endl << endl;
-        }
+    if (instructionTable[branch.opcode].instruction != INSTRUCTION_BCC)
+        return 0;
+    return (branch.opcode & 0xFF) == 0 ? 2 : -2;
+}
 
-        switch (sourceMode) {
-        case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT:
-            A[destinationReg] = A[sourceReg];
-            break;
-        case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_DISPLACEMENT:
-            PC += 2;
-            displacement = memory->readWordFromMemory(PC);
-            if (DEBUG_MODE)
-                cout << "Displacement: " << displacement << endl;
-            A[destinationReg] = A[sourceReg] + displacement;
-            break;
-        case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_INDEX:
-            PC += 2;
-            indexRegister = (memory->readByteFromMemory(PC) >> 4) & 0x0F;
-            indexSize = memory->readByteFromMemory(PC) & 0x0F;
-            longDisplacement = memory->readByteFromMemory(PC + 1);
-            if (indexRegister <= 7) {
-                if (indexSize == INDEX_SIZE_WORD) {
-                    longDisplacement += (int16_t)D[indexRegister];
-                }
-                else
-                    longDisplacement += D[indexRegister];
-            }
-            else {
-                if (indexSize == INDEX_SIZE_WORD) {
-                    longDisplacement += (int16_t)A[indexRegister - 8];
-                }
-                else
-                    longDisplacement += D[indexRegister - 8];
-            }
-            A[destinationReg] = A[sourceReg] + longDisplacement;
-            break;
-        case ADDRESS_MODE_OTHERS:
-            switch (sourceReg) {
-            case ADDRESS_MODE_ABSOLUTE_SHORT:
-                PC += 2;
-                absoluteAddress = memory->readWordFromMemory(PC);
-                A[destinationReg] = absoluteAddress;
-                break;
-            case ADDRESS_MODE_ABSOLUTE_LONG:
-                PC += 2;
-                absoluteAddress = memory->readLongFromMemory(PC);
-                A[destinationReg] = absoluteAddress;
-                PC += 2;
-                break;
-            case ADDRESS_MODE_PROGRAM_COUNTER_WITH_DISPLACEMENT:
-                PC += 2;
-                displacement = memory->readWordFromMemory(PC);
-                if (DEBUG_MODE)
-                    cout << "Displacement: " << displacement << endl;
-                A[destinationReg] = PC + displacement;
-                break;
-            case ADDRESS_MODE_PROGRAM_COUNTER_WITH_INDEX:
-                PC += 2;
-                indexRegister = (memory->readByteFromMemory(PC) >> 4) & 0x0F;
-                indexSize = memory->readByteFromMemory(PC) & 0x0F;
-                longDisplacement = memory->readByteFromMemory(PC + 1);
-                if (indexRegister <= 7) {
-                    if (indexSize == INDEX_SIZE_WORD) {
-                        longDisplacement += (int16_t)D[indexRegister];
-                    }
-                    else
-                        longDisplacement += D[indexRegister];
-                }
-                else {
-                    if (indexSize == INDEX_SIZE_WORD) {
-                        longDisplacement += (int16_t)A[indexRegister - 8];
-                    }
-                    else
-                        longDisplacement += D[indexRegister - 8];
-                }
-                A[destinationReg] = PC + longDisplacement;
-                break;
-            default:
-                cout << "Invalid addressing mode" << endl;
-                return false;
-                break;
-            }
-            break;
+// Returns the translated block starting at an address, translating it first if needed
+CPUCore::TranslatedBlock *CPUCore::findBlock(uint32_t address)
+{
+    auto found = translatedBlocks.find(address);
+    if (found != translatedBlocks.end())
+        return found->second.get();
 
-        default:
-            cout << "Unrecognised addressing mode" << endl;
+    return translateBlock(address);
+}
+
+// Decodes the instructions from an address up to and including the first that ends a block
+CPUCore::TranslatedBlock *CPUCore::translateBlock(uint32_t address)
+{
+    std::unique_ptr<TranslatedBlock> block(new TranslatedBlock());
+    DecodedInstruction decoded;
+
+    block->address = address;
+    do {
+        // Instructions already in the instruction cache, such as those predecoded as the program
+        // was loaded, are copied rather than decoded again
+        const DecodedInstruction &cached = instructionCache[(address >> 1) & (INSTRUCTION_CACHE_SIZE - 1)];
+        if (cached.address == address)
+            decoded = cached;
+        else
+            predecodeInstruction(address, decoded);
+        // Blocks check for idle loops themselves, and compiled code never calls the handler
+        if (decoded.handler == &CPUCore::executeIdleBranch) {
+            decoded.handler = handlerFor(decoded.opcode);
+            decoded.threadedLabel = instructionTable[decoded.opcode].canStop ? THREADED_EXECUTE_AND_TEST : THREADED_EXECUTE;
+        }
+        block->instructions.push_back(decoded);
+        block->cycles += decoded.cycles;
+        address += decoded.length;
+    } while (!instructionTable[decoded.opcode].endsBlock && block->instructions.size() < BLOCK_MAX_INSTRUCTIONS);
+    block->endAddress = address;
+    block->idle = isIdleLoop(*block);
+    recogniseIdiom(*block);
+
+    for (uint32_t page = block->address >> BLOCK_PAGE_SHIFT; page <= (block->endAddress - 1) >> BLOCK_PAGE_SHIFT; page++)
+        blocksByPage[page].push_back(block->address);
+
+    TranslatedBlock *translated = block.get();
+    translatedBlocks[block->address] = std::move(block);
+    return translated;
+}
+
+// Returns true for a block that branches back to its own start and only reads registers and
+// memory on the way, such as a loop polling a flag with TST, BTST or a compare. Running it again
+// cannot change anything.
+bool CPUCore::isIdleLoop(const TranslatedBlock &block)
+{
+    for (size_t i = 0; i + 1 < block.instructions.size(); i++) {
+        if (!onlySetsFlags(block.instructions[i].opcode))
             return false;
-            break;
-        }
+    }
+
+    return loopCondition(block) >= 0;
+}
+
+// Returns true for an instruction that changes nothing but the condition codes. Compares, TST and
+// BTST only read their operands, but postincrement and predecrement move the register.
+bool CPUCore::onlySetsFlags(uint16_t opcode)
+{
+    uint8_t instruction = instructionTable[opcode].instruction;
+    int mode = (opcode >> 3) & 7;
 
+    if (instruction == INSTRUCTION_NOP)
         return true;
-    }
+    if (instruction != INSTRUCTION_CMP && instruction != INSTRUCTION_CMPA && instruction != INSTRUCTION_CMPI
+        && instruction != INSTRUCTION_TST && instruction != INSTRUCTION_BTST)
+        return false;
+    return mode != ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_POSTINCREMENT && mode != ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_PREDECREMENT;
+}
 
-    // ADD (Add Binary)
-    if ((instruction & 0xF000) == ADD) {
-        int size = (instruction >> 6) & 7;
+// Walks memory from a branch target up to the branch, returning true when the branch closes an
+// idle loop as isIdleLoop sees one, along with the instructions and cycles of a pass through it
+bool CPUCore::idleLoopEndingAt(uint32_t branch, uint16_t opcode, uint32_t target, size_t &instructions, uint32_t &cycles)
+{
+    if ((target & 1) != 0 || target > branch)
+        return false;
 
-        if (size == 3 || size == 7)
-            goto AddA;
+    instructions = 1;
+    cycles = instructionTable[opcode].cycles;
+    for (uint32_t address = target; address != branch; instructions++) {
+        if (address > branch || instructions == BLOCK_MAX_INSTRUCTIONS)
+            return false;
+        uint16_t bodyOpcode = memory->readWordFromMemory(address);
+        if (!onlySetsFlags(bodyOpcode))
+            return false;
+        cycles += instructionTable[bodyOpcode].cycles;
+        address += 2 + 2 * instructionTable[bodyOpcode].extensionWords;
+    }
+    return true;
+}
 
-        int mode = (instruction >> 3) & 7;
-        int dataReg = (instruction >> 9) & 7;
-        int addressRegister = instruction & 7;
+// Returns the condition of the branch ending a block when it goes back to the block's own start,
+// CONDITIONAL_TRUE for BRA, or -1 when the block does not loop on itself
+int CPUCore::loopCondition(const TranslatedBlock &block)
+{
+    const DecodedInstruction &branch = block.instructions.back();
+    uint8_t instruction = instructionTable[branch.opcode].instruction;
+    int32_t displacement = (int8_t)branch.opcode;
+
+    if (instruction != INSTRUCTION_BRA && instruction != INSTRUCTION_BCC)
+        return -1;
+    if (displacement == 0)
+        displacement = (int16_t)branch.extensionWords[0];
+    return branch.address + 2 + displacement == block.address ? (branch.opcode >> 8) & 0xF : -1;
+}
 
-        bool registerIsSource = false;
+// Returns the block at PC after a block has run. The block remembers the last two blocks that
+// followed it, which covers both ways out of a conditional branch, so a hot loop runs from block
+// to block without looking anything up.
+CPUCore::TranslatedBlock *CPUCore::successorBlock(TranslatedBlock *block)
+{
+    for (TranslatedBlock *successor : block->successors) {
+        if (successor != nullptr && successor->address == PC)
+            return successor;
+    }
 
-        if (size > 3)
-            registerIsSource = true;
+    TranslatedBlock *successor;
+    if (interpreter == INTERPRETER_TIERED) {
+        // Code that has not been translated yet is left to runTiered to step through
+        auto found = translatedBlocks.find(PC);
+        if (found == translatedBlocks.end())
+            return nullptr;
+        successor = found->second.get();
+    }
+    else {
+        successor = findBlock(PC);
+    }
+    block->successors[block->nextSuccessor] = successor;
+    block->nextSuccessor ^= 1;
+    return successor;
+}
 
-        if (DEBUG_MODE) {
-            cout << "WE HAVE AN ADD" << endl;
-            cout << "Mode is: " << mode << endl;
-            cout << "Data register is: " << dataReg << endl;
-            cout << "Address register is: " << addressRegister << endl;
-            if (registerIsSource)
-                cout << "Register is source." << endl << endl;
-            else
-                cout << "Register is not source." << endl << endl;
-        }
+// Schedules all translated blocks to be dropped when a write overlaps any of them. Dropping them
+// all keeps the links between blocks simple, and is rare as code is seldom written over.
+void CPUCore::invalidateBlocks(uint32_t address)
+{
+    for (uint32_t page = address >> BLOCK_PAGE_SHIFT; page <= (address + 3) >> BLOCK_PAGE_SHIFT; page++) {
+        auto blocks = blocksByPage.find(page);
+        if (blocks == blocksByPage.end())
+            continue;
 
-        if (size == SIZE_BYTE || (size - 4) == SIZE_BYTE) {
-            data = (uint8_t)D[dataReg];
-            if (registerIsSource)
-                mostSignificantBitSource = (data >> 7) & 1;
-            else 
-                mostSignificantBitDestination = (data >> 7) & 1;
-        }
-        else if (size == SIZE_WORD || (size - 4) == SIZE_WORD) {
-            data = (uint16_t)D[dataReg];
-            if (registerIsSource)
-                mostSignificantBitSource = (data >> 15) & 1;
-            else
-                mostSignificantBitDestination = (data >> 15) & 1;
-        }
-        else {
-            data = D[dataReg];
-            if (registerIsSource)
-                mostSignificantBitSource = (data >> 31) & 1;
-            else
-                mostSignificantBitDestination = (data >> 31) & 1;
+        for (uint32_t start : blocks->second) {
+            if (address + 3 >= start && address < translatedBlocks[start]->endAddress)
+                blockFlushPending = true;
         }
+    }
+}
 
-        switch (mode) {
-        case ADDRESS_MODE_DATA_REGISTER_DIRECT:
-            if (DEBUG_MODE)
-                cout << "Data: " << data << endl;
-            if (size == SIZE_BYTE || (size - 4) == SIZE_BYTE) {
-                data2 = (uint8_t)D[addressRegister];
-                result = data + data2;
-                mostSignificantBitResult = (result >> 7) & 1;
-                if (registerIsSource) {
-                    mostSignificantBitDestination = (data2 >> 7) & 1;
-                    writeByteToDataRegister((uint8_t)result, addressRegister);
-                }
-                else {
-                    mostSignificantBitSource = (data2 >> 7) & 1;
-                    writeByteToDataRegister((uint8_t)result, dataReg);
-                }
-            }
-            else if (size == SIZE_WORD || (size - 4) == SIZE_WORD) {
-                data2 = (uint16_t)D[addressRegister];
-                result = data + data2;
-                mostSignificantBitResult = (result >> 15) & 1;
-                if (registerIsSource) {
-                    mostSignificantBitDestination = (data2 >> 15) & 1;
-                    writeWordToDataRegister((uint16_t)result, addressRegister);
-                }
-                else {
-                    mostSignificantBitSource = (data2 >> 15) & 1;
-                    writeWordToDataRegister((uint16_t)result, dataReg);
-                }
-            }
-            else {
-                data2 = D[addressRegister];
-                result = data + data2;
-                mostSignificantBitResult = (result >> 31) & 1;
-                if (registerIsSource) {
-                    mostSignificantBitDestination = (data2 >> 31) & 1;
-                    writeLongToDataRegister(result, addressRegister);
-                }
-                else {
-                    mostSignificantBitSource = (data2 >> 31) & 1;
-                    writeLongToDataRegister(result, dataReg);
-                }
-            }
-            break;
-        case ADDRESS_MODE_ADDRESS_REGISTER_DIRECT:
-            if (DEBUG_MODE)
-                cout << "Data: " << data << endl;
-            if (size == SIZE_BYTE || (size - 4) == SIZE_BYTE) {
-                cout << "Invalid addressing mode." << endl;
-                return false;
-            } 
-            else if (size == SIZE_WORD) {
-                data2 = (uint16_t)A[addressRegister];
-                result = data + data2;
-                mostSignificantBitResult = (result >> 15) & 1;
-                if (registerIsSource) {
-                    mostSignificantBitDestination = (data2 >> 15) & 1;
-                    writeWordToDataRegister((uint16_t)result, addressRegister);
-                }
-                else {
-                    mostSignificantBitSource = (data2 >> 15) & 1;
-                    writeWordToDataRegister((uint16_t)result, dataReg);
-                }
-            }
-            else if ((size - 4) == SIZE_WORD) {
-                cout << "Invalid addressing mode." << endl;
-                return false;
-            }
-            else if (size == SIZE_LONG) {
-                data2 = A[addressRegister];
-                result = data + data2;
-                mostSignificantBitResult = (result >> 31) & 1;
-                if (registerIsSource) {
-                    mostSignificantBitDestination = (data2 >> 31) & 1;
-                    writeLongToDataRegister(result, addressRegister);
-                }
-                else {
-                    mostSignificantBitSource = (data2 >> 31) & 1;
-                    writeLongToDataRegister(result, dataReg);
-                }
-            }
-            else {
-                cout << "Invalid addressing mode." << endl;
-                return false;
-            }
-            break;
-        case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT:
-            if (size == SIZE_BYTE) {
-                data2 = memory->readByteFromMemory(A[addressRegister]);
-                result = data + data2;
-                mostSignificantBitResult = (result >> 7) & 1;
-                if (registerIsSource) {
-                    mostSignificantBitDestination = (data2 >> 7) & 1;
-                    memory->writeByteToMemory(result, A[addressRegister]);
-                }
-                else {
-                    mostSignificantBitSource = (data2 >> 7) & 1;
-                    writeByteToDataRegister(result, dataReg);
-                }
-            }
-            else if (size == SIZE_WORD) {
-                data2 = memory->readWordFromMemory(A[addressRegister]);
-                result = data + data2;
-                mostSignificantBitResult = (result >> 15) & 1;
-                if (registerIsSource) {
-                    mostSignificantBitDestination = (data2 >> 15) & 1;
-                    memory->writeWordToMemory(result, A[addressRegister]);
-                }
-                else {
-                    mostSignificantBitSource = (data2 >> 15) & 1;
-                    writeWordToDataRegister(result, dataReg);
-                }
-            }
-            else {
-                data2 = memory->readLongFromMemory(A[addressRegister]);
-                result = data + data2;
-                mostSignificantBitResult = (result >> 31) & 1;
-                if (registerIsSource) {
-                    mostSignificantBitDestination = (data2 >> 31) & 1;
-                    memory->writeLongToMemory(result, A[addressRegister]);
-                }
-                else {
-                    mostSignificantBitSource = (data2 >> 31) & 1;
-                    writeLongToDataRegister(result, dataReg);
-                }
-            }
-            break;
-        case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_POSTINCREMENT:
-            if (size == SIZE_BYTE) {
-                data2 = memory->readByteFromMemory(A[addressRegister]);
-                result = data + data2;
-                mostSignificantBitResult = (result >> 7) & 1;
-                if (registerIsSource) {
-                    mostSignificantBitDestination = (data2 >> 7) & 1;
-                    memory->writeByteToMemory(result, A[addressRegister]);
-                }
-                else {
-                    mostSignificantBitSource = (data2 >> 7) & 1;
-                    writeByteToDataRegister(result, dataReg);
-                }
-                A[addressRegister]++;
-            }
-            else if (size == SIZE_WORD || (size - 4) == SIZE_WORD) {
-                data2 = memory->readWordFromMemory(A[addressRegister]);
-                result = data + data2;
-                mostSignificantBitResult = (result >> 15) & 1;
-                if (registerIsSource) {
-                    mostSignificantBitDestination = (data2 >> 15) & 1;
-                    memory->writeWordToMemory(result, A[addressRegister]);
-                }
-                else {
-                    mostSignificantBitSource = (data2 >> 15) & 1;
-                    writeWordToDataRegister(result, dataReg);
-                }
-                A[addressRegister] += 2;
-            }
-            else {
-                data2 = memory->readLongFromMemory(A[addressRegister]);
-                result = data + data2;
-                mostSignificantBitResult = (result >> 31) & 1;
-                if (registerIsSource) {
-                    mostSignificantBitDestination = (data2 >> 31) & 1;
-                    memory->writeLongToMemory(result, A[addressRegister]);
-                }
-                else {
-                    mostSignificantBitSource = (data2 >> 31) & 1;
-                    writeLongToDataRegister(result, dataReg);
-                }
-                A[addressRegister] += 4;
-            }
-            break;
-        case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_PREDECREMENT:
-            if (size == SIZE_BYTE) {
-                A[addressRegister]--;
-                data2 = memory->readByteFromMemory(A[addressRegister]);
-                result = data + data2;
-                mostSignificantBitResult = (result >> 7) & 1;
-                if (registerIsSource) {
-                    mostSignificantBitDestination = (data2 >> 7) & 1;
-                    memory->writeByteToMemory(result, A[addressRegister]);
-                }
-                else {
-                    mostSignificantBitSource = (data2 >> 7) & 1;
-                    writeByteToDataRegister(result, dataReg);
-                }
-            }
-            else if (size == SIZE_WORD || (size - 4) == SIZE_WORD) {
-                A[addressRegister] -= 2;
-                data2 = memory->readWordFromMemory(A[addressRegister]);
-                result = data + data2;
-                mostSignificantBitResult = (result >> 15) & 1;
-                if (registerIsSource) {
-                    mostSignificantBitDestination = (data2 >> 15) & 1;
-                    memory->writeWordToMemory(result, A[addressRegister]);
-                }
-                else {
-                    mostSignificantBitSource = (data2 >> 15) & 1;
-                    writeWordToDataRegister(result, dataReg);
-                }
-            }
-            else {
-                A[addressRegister] -= 4;
-                data2 = memory->readLongFromMemory(A[addressRegister]);
-                result = data + data2;
-                mostSignificantBitResult = (result >> 31) & 1;
-                if (registerIsSource) {
-                    mostSignificantBitDestination = (data2 >> 31) & 1;
-                    memory->writeLongToMemory(result, A[addressRegister]);
-                }
-                else {
-                    mostSignificantBitSource = (data2 >> 31) & 1;
-                    writeLongToDataRegister(result, dataReg);
-                }
-            }
-            break;
-        case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_DISPLACEMENT:
-            PC += 2;
-            displacement = memory->readWordFromMemory(PC);
-            if (DEBUG_MODE)
-                cout << "Displacement: " << displacement << endl;
-            if (size == SIZE_BYTE || (size - 4) == SIZE_BYTE) {
-                data2 = memory->readByteFromMemory(A[addressRegister], displacement);
-                result = data + data2;
-                mostSignificantBitResult = (result >> 7) & 1;
-                if (registerIsSource) {
-                    mostSignificantBitDestination = (data2 >> 7) & 1;
-                    memory->writeByteToMemory(result, A[addressRegister], displacement);
-                }
-                else {
-                    mostSignificantBitSource = (data2 >> 7) & 1;
-                    writeByteToDataRegister(result, dataReg);
-                }
-            }
-            else if (size == SIZE_WORD || (size - 4) == SIZE_WORD) {
-                data2 = memory->readWordFromMemory(A[addressRegister], displacement);
-                result = data + data2;
-                mostSignificantBitResult = (result >> 15) & 1;
-                if (registerIsSource) {
-                    mostSignificantBitDestination = (data2 >> 15) & 1;
-                    memory->writeWordToMemory(result, A[addressRegister], displacement);
-                }
-                else {
-                    mostSignificantBitSource = (data2 >> 15) & 1;
-                    writeWordToDataRegister(result, dataReg);
-                }
-            }
-            else {
-                data2 = memory->readLongFromMemory(A[addressRegister], displacement);
-                result = data + data2;
-                mostSignificantBitResult = (result >> 31) & 1;
-                if (registerIsSource) {
-                    mostSignificantBitDestination = (data2 >> 31) & 1;
-                    memory->writeLongToMemory(result, A[addressRegister], displacement);
-                }
-                else {
-                    mostSignificantBitSource = (data2 >> 31) & 1;
-                    writeLongToDataRegister(result, dataReg);
-                }
-            }
-            break;
-        case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_INDEX:
-            PC += 2;
-            indexRegister = (memory->readByteFromMemory(PC) >> 4) & 0x0F;
-            indexSize = memory->readByteFromMemory(PC) & 0x0F;
-            longDisplacement = memory->readByteFromMemory(PC + 1);
-            if (indexRegister <= 7) {
-                if (indexSize == INDEX_SIZE_WORD) {
-                    longDisplacement += (int16_t)D[indexRegister];
-                }
-                else
-                    longDisplacement += D[indexRegister];
-            }
-            else {
-                if (indexSize == INDEX_SIZE_WORD) {
-                    longDisplacement += (int16_t)A[indexRegister - 8];
-                }
-                else
-                    longDisplacement += D[indexRegister - 8];
-            }
-            if (size == SIZE_BYTE || (size - 4) == SIZE_BYTE) {
-                data2 = memory->readByteFromMemory(A[addressRegister], longDisplacement);
-                result = data + data2;
-                mostSignificantBitResult = (result >> 7) & 1;
-                if (registerIsSource) {
-                    mostSignificantBitDestination = (data2 >> 7) & 1;
-                    memory->writeByteToMemory(result, A[addressRegister], longDisplacement);
-                }
-                else {
-                    mostSignificantBitSource = (data2 >> 7) & 1;
-                    writeByteToDataRegister(result, dataReg);
-                }
-            }
-            else if (size == SIZE_WORD || (size - 4) == SIZE_WORD) {
-                data2 = memory->readWordFromMemory(A[addressRegister], longDisplacement);
-                result = data + data2;
-                mostSignificantBitResult = (result >> 15) & 1;
-                if (registerIsSource) {
-                    mostSignificantBitDestination = (data2 >> 15) & 1;
-                    memory->writeWordToMemory(result, A[addressRegister], longDisplacement);
-                }
-                else {
-                    mostSignificantBitSource = (data2 >> 15) & 1;
-                    writeWordToDataRegister(result, dataReg);
-                }
-            }
-            else {
-                data2 = memory->readLongFromMemory(A[addressRegister], longDisplacement);
-                result = data + data2;
-                mostSignificantBitResult = (result >> 31) & 1;
-                if (registerIsSource) {
-                    mostSignificantBitDestination = (data2 >> 31) & 1;
-                    memory->writeLongToMemory(result, A[addressRegister], longDisplacement);
-                }
-                else {
-                    mostSignificantBitSource = (data2 >> 31) & 1;
-                    writeLongToDataRegister(result, dataReg);
-                }
-            }
-            break;
-        case ADDRESS_MODE_OTHERS:
-            switch (addressRegister) {
-            case ADDRESS_MODE_ABSOLUTE_SHORT:
-                PC += 2;
-                absoluteAddress = memory->readWordFromMemory(PC);
-                if (size == SIZE_BYTE || (size - 4) == SIZE_BYTE) {
-                    data2 = memory->readByteFromMemory(absoluteAddress);
-                    result = data + data2;
-                    mostSignificantBitResult = (result >> 7) & 1;
-                    if (registerIsSource) {
-                        mostSignificantBitDestination = (data2 >> 7) & 1;
-                        memory->writeByteToMemory(result, absoluteAddress);
-                    }
-                    else {
-                        mostSignificantBitSource = (data2 >> 7) & 1;
-                        writeByteToDataRegister(result, dataReg);
-                    }
-                }
-                else if (size == SIZE_WORD || (size - 4) == SIZE_WORD) {
-                    data2 = memory->readWordFromMemory(absoluteAddress);
-                    result = data + data2;
-                    mostSignificantBitResult = (result >> 15) & 1;
-                    if (registerIsSource) {
-                        mostSignificantBitDestination = (data2 >> 15) & 1;
-                        memory->writeWordToMemory(result, absoluteAddress);
-                    }
-                    else {
-                        mostSignificantBitSource = (data2 >> 15) & 1;
-                        writeWordToDataRegister(result, dataReg);
-                    }
-                }
-                else {
-                    data2 = memory->readLongFromMemory(absoluteAddress);
-                    result = data + data2;
-                    mostSignificantBitResult = (result >> 31) & 1;
-                    if (registerIsSource) {
-                        mostSignificantBitDestination = (data2 >> 31) & 1;
-                        memory->writeLongToMemory(result, absoluteAddress);
-                    }
-                    else {
-                        mostSignificantBitSource = (data2 >> 31) & 1;
-                        writeLongToDataRegister(result, dataReg);
-                    }
-                }
-                break;
-            case ADDRESS_MODE_ABSOLUTE_LONG:
-                PC += 2;
-                absoluteAddress = memory->readLongFromMemory(PC);
-                if (size == SIZE_BYTE || (size - 4) == SIZE_BYTE) {
-                    data2 = memory->readByteFromMemory(absoluteAddress);
-                    result = data + data2;
-                    mostSignificantBitResult = (result >> 7) & 1;
-                    if (registerIsSource) {
-                        mostSignificantBitDestination = (data2 >> 7) & 1;
-                        memory->writeByteToMemory(result, absoluteAddress);
-                    }
-                    else {
-                        mostSignificantBitSource = (data2 >> 7) & 1;
-                        writeByteToDataRegister(result, dataReg);
-                    }
-                }
-                else if (size == SIZE_WORD || (size - 4) == SIZE_WORD) {
-                    data2 = memory->readWordFromMemory(absoluteAddress);
-                    result = data + data2;
-                    mostSignificantBitResult = (result >> 15) & 1;
-                    if (registerIsSource) {
-                        mostSignificantBitDestination = (data2 >> 15) & 1;
-                        memory->writeWordToMemory(result, absoluteAddress);
-                    }
-                    else {
-                        mostSignificantBitSource = (data2 >> 15) & 1;
-                        writeWordToDataRegister(result, dataReg);
-                    }
-                }
-                else {
-                    data2 = memory->readLongFromMemory(absoluteAddress);
-                    result = data + data2;
-                    mostSignificantBitResult = (result >> 31) & 1;
-                    if (registerIsSource) {
-                        mostSignificantBitDestination = (data2 >> 31) & 1;
-                        memory->writeLongToMemory(result, absoluteAddress);
-                    }
-                    else {
-                        mostSignificantBitSource = (data2 >> 31) & 1;
-                        writeLongToDataRegister(result, dataReg);
-                    }
-                }
-                PC += 2;
-                break;
-            case ADDRESS_MODE_PROGRAM_COUNTER_WITH_DISPLACEMENT:
-                PC += 2;
-                displacement = memory->readWordFromMemory(PC);
-                if (DEBUG_MODE)
-                    cout << "Displacement: " << displacement << endl;
-                if (size == SIZE_BYTE) {
-                    data2 = memory->readByteFromMemory(PC, displacement);
-                    result = data + data2;
-                    mostSignificantBitResult = (result >> 7) & 1;
-                    mostSignificantBitSource = (data2 >> 7) & 1;
-                    writeByteToDataRegister(result, dataReg);
-                }
-                else if (size == SIZE_WORD) {
-                    data2 = memory->readWordFromMemory(PC, displacement);
-                    result = data + data2;
-                    mostSignificantBitResult = (result >> 15) & 1;
-                    mostSignificantBitSource = (data2 >> 15) & 1;
-                    writeWordToDataRegister(result, dataReg);
-                }
-                else if (size == SIZE_LONG) {
-                    data2 = memory->readLongFromMemory(PC, displacement);
-                    result = data + data2;
-                    mostSignificantBitResult = (result >> 31) & 1;
-                    mostSignificantBitSource = (data2 >> 31) & 1;
-                    writeLongToDataRegister(result, dataReg);
-                    PC += 2;
-                }
-                else {
-                    cout << "Invalid addressing mode" << endl;
-                    return false;
-                }
-                break;
-            case ADDRESS_MODE_PROGRAM_COUNTER_WITH_INDEX:
-                PC += 2;
-                indexRegister = (memory->readByteFromMemory(PC) >> 4) & 0x0F;
-                indexSize = memory->readByteFromMemory(PC) & 0x0F;
-                longDisplacement = memory->readByteFromMemory(PC + 1);
-                if (indexRegister <= 7) {
-                    if (indexSize == INDEX_SIZE_WORD) {
-                        longDisplacement += (int16_t)D[indexRegister];
-                    }
-                    else
-                        longDisplacement += D[indexRegister];
-                }
-                else {
-                    if (indexSize == INDEX_SIZE_WORD) {
-                        longDisplacement += (int16_t)A[indexRegister - 8];
-                    }
-                    else
-                        longDisplacement += D[indexRegister - 8];
-                }
-                if (size == SIZE_BYTE) {
-                    data2 = memory->readByteFromMemory(PC, longDisplacement);
-                    result = data + data2;
-                    mostSignificantBitResult = (result >> 7) & 1;
-                    mostSignificantBitSource = (data2 >> 7) & 1;
-                    writeByteToDataRegister(result, dataReg);
-                }
-                else if (size == SIZE_WORD) {
-                    data2 = memory->readWordFromMemory(PC, longDisplacement);
-                    result = data + data2;
-                    mostSignificantBitResult = (result >> 15) & 1;
-                    mostSignificantBitSource = (data2 >> 15) & 1;
-                    writeWordToDataRegister(result, dataReg);
-                }
-                else if (size == SIZE_LONG) {
-                    data2 = memory->readLongFromMemory(PC, longDisplacement);
-                    result = data + data2;
-                    mostSignificantBitResult = (result >> 31) & 1;
-                    mostSignificantBitSource = (data2 >> 31) & 1;
-                    writeLongToDataRegister(result, dataReg);
-                    PC += 2;
-                }
-                else {
-                    cout << "Invalid addressing mode" << endl;
-                    return false;
-                }
-                break;
-            case ADDRESS_MODE_IMMEDIATE_OR_STATUS_REGISTER:
-                PC += 2;
-                if (size == SIZE_BYTE) {
-                    data2 = memory->readByteFromMemory(PC+1);
-                    result = data + data2;
-                    mostSignificantBitResult = (result >> 7) & 1;
-                    mostSignificantBitSource = (data2 >> 7) & 1;
-                    writeByteToDataRegister(result, dataReg);
-                }
-                else if (size == SIZE_WORD) {
-                    data2 = memory->readWordFromMemory(PC);
-                    result = data + data2;
-                    mostSignificantBitResult = (result >> 15) & 1;
-                    mostSignificantBitSource = (data2 >> 15) & 1;
-                    writeWordToDataRegister(result, dataReg);
-                }
-                else if (size == SIZE_LONG) {
-                    data2 = memory->readLongFromMemory(PC);
-                    result = data + data2;
-                    mostSignificantBitResult = (result >> 31) & 1;
-                    mostSignificantBitSource = (data2 >> 31) & 1;
-                    writeLongToDataRegister(result, dataReg);
-                    PC += 2;
-                }
-                else {
-                    cout << "Invalid addressing mode" << endl;
-                    return false;
-                }
-                break;
-            default:
-                cout << "Invalid addressing mode" << endl;
-                return false;
+void CPUCore::flushBlocks()
+{
+    translatedBlocks.clear();
+    blocksByPage.clear();
+    blockFlushPending = false;
+    if (jit)
+        jit->reset();
+}
+
+// Returns a model's dispatch table, which is built the first time it is asked for and shared by
+// every CPU of that model and the disassembler
+const CPUCore::InstructionEntry *CPUCore::sharedInstructionTable(int model)
+{
+    switch (model) {
+    case MC68010: {
+        static const InstructionEntry *table = buildInstructionTable(MC68010);
+        return table;
+    }
+    case MC68020: {
+        static const InstructionEntry *table = buildInstructionTable(MC68020);
+        return table;
+    }
+    case MC68040: {
+        static const InstructionEntry *table = buildInstructionTable(MC68040);
+        return table;
+    }
+    case MC68060: {
+        static const InstructionEntry *table = buildInstructionTable(MC68060);
+        return table;
+    }
+    default: {
+        static const InstructionEntry *table = buildInstructionTable(MC68000);
+        return table;
+    }
+    }
+}
+
+// Returns the size of a MOVE, which has its own size encoding
+static int moveSize(uint16_t opcode)
+{
+    if ((opcode & 0xF000) == MOVE_B)
+        return SIZE_BYTE;
+    else if ((opcode & 0xF000) == MOVE_W)
+        return SIZE_WORD;
+    return SIZE_LONG;
+}
+
+// Returns the operand size an opcode has under a pattern's size field, or -1 when the field
+// holds a size the instruction does not have
+static int operandSize(int sizeField, uint16_t opcode)
+{
+    switch (sizeField) {
+    case SIZE_FIELD_BYTE:
+        return SIZE_BYTE;
+    case SIZE_FIELD_WORD:
+        return SIZE_WORD;
+    case SIZE_FIELD_STANDARD:
+        return ((opcode >> 6) & 3) <= SIZE_LONG ? (opcode >> 6) & 3 : -1;
+    case SIZE_FIELD_MOVE:
+        return moveSize(opcode);
+    case SIZE_FIELD_ADDRESS:
+        return ((opcode >> 8) & 1) == 1 ? SIZE_LONG : SIZE_WORD;
+    case SIZE_FIELD_BIT_6:
+        return ((opcode >> 6) & 1) == 1 ? SIZE_LONG : SIZE_WORD;
+    default:
+        return SIZE_LONG;
+    }
+}
+
+// Returns the effective address mode (see EA_MODE) of the opcode's low six bits
+static int sourceMode(uint16_t opcode)
+{
+    return EA_MODE((opcode >> 3) & 7, opcode & 7);
+}
+
+// Returns true when an effective address mode belongs to a category of allowed modes. No byte
+// operation can use an address register directly.
+static bool isAllowedMode(int mode, int category, int size)
+{
+    if (size == SIZE_BYTE)
+        category &= ~(1 << ADDRESS_MODE_ADDRESS_REGISTER_DIRECT);
+    return mode < EA_MODE_COUNT && ((category >> mode) & 1) == 1;
+}
+
+// Returns the number of extension words an effective address mode reads for an operand of the given size
+static int extensionWordCount(int mode, int size)
+{
+    switch (mode) {
+    case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_DISPLACEMENT:
+    case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_INDEX:
+    case EA_ABSOLUTE_SHORT:
+    case EA_PROGRAM_COUNTER_WITH_DISPLACEMENT:
+    case EA_PROGRAM_COUNTER_WITH_INDEX:
+        return 1;
+    case EA_ABSOLUTE_LONG:
+        return 2;
+    case EA_IMMEDIATE:
+        return size == SIZE_LONG ? 2 : 1;
+    default:
+        return 0;
+    }
+}
+
+// Returns the 68000 clock cycles an instruction takes, effective address calculation included, as
+// listed in the M68000 user's manual. Costs that depend on the data, such as a shift count, the
+// registers MOVEM moves, the bits MULU multiplies by or a branch not being taken, are added by
+// the handlers, and divisions are charged the longest they can take.
+static constexpr int instructionCycles(uint8_t instruction, uint16_t opcode, int size, int mode)
+{
+    const int isLong = size == SIZE_LONG ? 1 : 0;
+    const int calculation = effectiveAddressCycles[isLong][mode];
+    const bool isRegister = mode == ADDRESS_MODE_DATA_REGISTER_DIRECT || mode == ADDRESS_MODE_ADDRESS_REGISTER_DIRECT;
+    // Bit 8 sends ADD, SUB, AND and OR to memory, and gives the bit number of a bit operation in a register
+    const bool toMemory = ((opcode >> 8) & 1) == 1;
+    const bool dynamicBit = toMemory;
+
+    switch (instruction) {
+    case INSTRUCTION_ABCD:
+    case INSTRUCTION_SBCD:
+        return (opcode & 8) != 0 ? 18 : 6;
+    case INSTRUCTION_ADD:
+    case INSTRUCTION_SUB:
+    case INSTRUCTION_AND:
+    case INSTRUCTION_OR:
+        if (toMemory)
+            return (isLong ? 12 : 8) + calculation;
+        return (isLong ? (isRegister || mode == EA_IMMEDIATE ? 8 : 6) : 4) + calculation;
+    case INSTRUCTION_EOR:
+        return isRegister ? (isLong ? 8 : 4) : (isLong ? 12 : 8) + calculation;
+    case INSTRUCTION_CMP:
+        return (isLong ? 6 : 4) + calculation;
+    case INSTRUCTION_ADDA:
+    case INSTRUCTION_SUBA:
+        return (isLong ? (isRegister || mode == EA_IMMEDIATE ? 8 : 6) : 8) + calculation;
+    case INSTRUCTION_CMPA:
+        return 6 + calculation;
+    case INSTRUCTION_ADDI:
+    case INSTRUCTION_SUBI:
+    case INSTRUCTION_ANDI:
+    case INSTRUCTION_ORI:
+    case INSTRUCTION_EORI:
+        return isRegister ? (isLong ? 16 : 8) : (isLong ? 20 : 12) + calculation;
+    case INSTRUCTION_CMPI:
+        return isRegister ? (isLong ? 14 : 8) : (isLong ? 12 : 8) + calculation;
+    case INSTRUCTION_ADDQ:
+    case INSTRUCTION_SUBQ:
+        if (mode == ADDRESS_MODE_ADDRESS_REGISTER_DIRECT)
+            return 8;
+        return isRegister ? (isLong ? 8 : 4) : (isLong ? 12 : 8) + calculation;
+    case INSTRUCTION_ADDX:
+    case INSTRUCTION_SUBX:
+        return (opcode & 8) != 0 ? (isLong ? 30 : 18) : (isLong ? 8 : 4);
+    case INSTRUCTION_CMPM:
+        return isLong ? 20 : 12;
+    case INSTRUCTION_CLR:
+    case INSTRUCTION_NEG:
+    case INSTRUCTION_NEGX:
+    case INSTRUCTION_NOT:
+        return isRegister ? (isLong ? 6 : 4) : (isLong ? 12 : 8) + calculation;
+    case INSTRUCTION_NBCD:
+        return isRegister ? 6 : 8 + calculation;
+    case INSTRUCTION_TST:
+        return 4 + calculation;
+    case INSTRUCTION_TAS:
+        return isRegister ? 4 : 14 + calculation;
+    case INSTRUCTION_SCC:
+        return isRegister ? 4 : 8 + calculation;
+    case INSTRUCTION_MOVE:
+        return 4 + calculation + moveDestinationCycles[isLong][EA_MODE((opcode >> 6) & 7, (opcode >> 9) & 7)];
+    case INSTRUCTION_MOVE_FROM_CCR:
+    case INSTRUCTION_MOVE_FROM_SR:
+        return isRegister ? 6 : 8 + calculation;
+    case INSTRUCTION_MOVE_TO_CCR:
+    case INSTRUCTION_MOVE_TO_SR:
+        return 12 + calculation;
+    case INSTRUCTION_MOVEM:
+        // Plus four cycles a word or eight a long for each register moved
+        return ((opcode >> 10) & 1) == 1 ? 8 + effectiveAddressCycles[0][mode] : 4 + moveDestinationCycles[0][mode];
+    case INSTRUCTION_MOVEP:
+        return isLong ? 24 : 16;
+    case INSTRUCTION_JMP:
+        return jumpCycles[mode];
+    case INSTRUCTION_JSR:
+        return jumpToSubroutineCycles[mode];
+    case INSTRUCTION_LEA:
+        return loadEffectiveAddressCycles[mode];
+    case INSTRUCTION_PEA:
+        return pushEffectiveAddressCycles[mode];
+    case INSTRUCTION_BCC:
+    case INSTRUCTION_BRA:
+    case INSTRUCTION_DBCC:
+        // Taken, which executeBcc and executeDBcc adjust when the branch falls through
+        return 10;
+    case INSTRUCTION_BSR:
+        return 18;
+    case INSTRUCTION_RTS:
+        return 16;
+    case INSTRUCTION_RTE:
+    case INSTRUCTION_RTR:
+        return 20;
+    case INSTRUCTION_LINK:
+        return 16;
+    case INSTRUCTION_UNLK:
+        return 12;
+    case INSTRUCTION_EXG:
+        return 6;
+    case INSTRUCTION_RESET:
+        return 132;
+    case INSTRUCTION_ANDI_TO_CCR:
+    case INSTRUCTION_ANDI_TO_SR:
+    case INSTRUCTION_ORI_TO_CCR:
+    case INSTRUCTION_ORI_TO_SR:
+    case INSTRUCTION_EORI_TO_CCR:
+    case INSTRUCTION_EORI_TO_SR:
+        return 20;
+    case INSTRUCTION_CHK:
+        return 10 + calculation;
+    case INSTRUCTION_MULU:
+    case INSTRUCTION_MULS:
+        // Plus two cycles for each one bit, or each change between adjacent bits for MULS, in the source
+        return 38 + calculation;
+    case INSTRUCTION_DIVU:
+        return DIVU_CYCLES + calculation;
+    case INSTRUCTION_DIVS:
+        return DIVS_CYCLES + calculation;
+    case INSTRUCTION_ASD:
+    case INSTRUCTION_LSD:
+    case INSTRUCTION_ROXD:
+    case INSTRUCTION_ROD:
+        // A register shifted n places takes two cycles for each place on top of this
+        if ((opcode & 0x00C0) != 0x00C0)
+            return isLong ? 8 : 6;
+        return 8 + calculation;
+    case INSTRUCTION_BTST:
+        if (isRegister)
+            return dynamicBit ? 6 : 10;
+        return (dynamicBit ? 4 : 8) + calculation;
+    case INSTRUCTION_BCHG:
+    case INSTRUCTION_BSET:
+        if (isRegister)
+            return dynamicBit ? 8 : 12;
+        return (dynamicBit ? 8 : 12) + calculation;
+    case INSTRUCTION_BCLR:
+        if (isRegister)
+            return dynamicBit ? 10 : 14;
+        return (dynamicBit ? 8 : 12) + calculation;
+    default:
+        // MOVEQ, NOP, STOP, SWAP, EXT, MOVE USP and TRAPV, along with the instructions that take
+        // an exception, which adds EXCEPTION_CYCLES
+        return 4;
+    }
+}
+
+// Builds a model's opcode dispatch table from the description of the instruction set below. Every
+// one of the 65536 opcodes is matched once against the instruction patterns, in decoding priority
+// order, with the patterns of the instructions the model changes tried first. The matching pattern
+// says how the opcode encodes its size, which addressing modes its effective address may use and
+// what extension words come before the effective address's own, so the legality of the opcode and
+// the length of the instruction are worked out here in one place, and the pattern's binder only has
+// to pick the handler specialisation for the size and mode. At run time any opcode reaches its
+// handler with a single indexed jump. Opcodes that match no pattern, or whose fields the pattern
+// does not allow, go to illegalInstruction.
+const CPUCore::InstructionEntry *CPUCore::buildInstructionTable(int model)
+{
+    struct InstructionPattern {
+        uint16_t mask;
+        uint16_t match;
+        uint8_t instruction; // Which instruction the pattern is, for the disassembler
+        int sizeField; // Where the operand size comes from, one of the SIZE_FIELD_ values
+        int category; // Modes allowed in the effective address in the low six bits, or 0 when there is none
+        int extension; // Extension words before the effective address's own, one of the EXTENSION_ values
+        // Either a single handler for the whole pattern, or a binder returning the specialisation
+        // for the opcode's fields
+        InstructionHandler handler;
+        InstructionHandler (*bind)(uint16_t opcode, int size, int mode);
+        // Whether the instruction can change the flow of control, by a jump or by taking an
+        // exception, and so ends a basic block
+        bool endsBlock;
+        // Whether the handler can return false to stop the CPU
+        bool canStop;
+    };
+
+    const int control = EA_CATEGORY_CONTROL;
+    const int data = EA_CATEGORY_DATA;
+    const int dataAlterable = EA_CATEGORY_DATA_ALTERABLE;
+    const int memoryAlterable = EA_CATEGORY_MEMORY_ALTERABLE;
+    const int bitSource = EA_CATEGORY_DATA & ~(1 << EA_IMMEDIATE);
+    const int movemToMemory = (EA_CATEGORY_CONTROL & EA_CATEGORY_ALTERABLE) | (1 << ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_PREDECREMENT);
+    const int movemToRegisters = EA_CATEGORY_CONTROL | (1 << ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_POSTINCREMENT);
+
+    static const InstructionPattern patterns[] = {
+        // Bit manipulation, MOVEP and immediate
+        { 0xFFFF, ORI_TO_CCR, INSTRUCTION_ORI_TO_CCR, SIZE_FIELD_BYTE, 0, EXTENSION_WORD, nullptr, &CPUCore::bindLogicalToStatusRegister, false, false },
+        { 0xFFFF, ORI_TO_SR, INSTRUCTION_ORI_TO_SR, SIZE_FIELD_WORD, 0, EXTENSION_WORD, nullptr, &CPUCore::bindLogicalToStatusRegister, true, true },
+        { 0xFFFF, ANDI_TO_CCR, INSTRUCTION_ANDI_TO_CCR, SIZE_FIELD_BYTE, 0, EXTENSION_WORD, nullptr, &CPUCore::bindLogicalToStatusRegister, false, false },
+        { 0xFFFF, ANDI_TO_SR, INSTRUCTION_ANDI_TO_SR, SIZE_FIELD_WORD, 0, EXTENSION_WORD, nullptr, &CPUCore::bindLogicalToStatusRegister, true, true },
+        { 0xFFFF, EORI_TO_CCR, INSTRUCTION_EORI_TO_CCR, SIZE_FIELD_BYTE, 0, EXTENSION_WORD, nullptr, &CPUCore::bindLogicalToStatusRegister, false, false },
+        { 0xFFFF, EORI_TO_SR, INSTRUCTION_EORI_TO_SR, SIZE_FIELD_WORD, 0, EXTENSION_WORD, nullptr, &CPUCore::bindLogicalToStatusRegister, true, true },
+        { 0xFF00, ORI, INSTRUCTION_ORI, SIZE_FIELD_STANDARD, dataAlterable, EXTENSION_IMMEDIATE, nullptr, &CPUCore::bindLogicalImmediate, false, false },
+        { 0xFF00, ANDI, INSTRUCTION_ANDI, SIZE_FIELD_STANDARD, dataAlterable, EXTENSION_IMMEDIATE, nullptr, &CPUCore::bindLogicalImmediate, false, false },
+        { 0xFF00, EORI, INSTRUCTION_EORI, SIZE_FIELD_STANDARD, dataAlterable, EXTENSION_IMMEDIATE, nullptr, &CPUCore::bindLogicalImmediate, false, false },
+        { 0xFF00, ADDI, INSTRUCTION_ADDI, SIZE_FIELD_STANDARD, dataAlterable, EXTENSION_IMMEDIATE, nullptr, &CPUCore::bindArithmeticImmediate, false, false },
+        { 0xFF00, SUBI, INSTRUCTION_SUBI, SIZE_FIELD_STANDARD, dataAlterable, EXTENSION_IMMEDIATE, nullptr, &CPUCore::bindArithmeticImmediate, false, false },
+        { 0xFF00, CMPI, INSTRUCTION_CMPI, SIZE_FIELD_STANDARD, dataAlterable, EXTENSION_IMMEDIATE, nullptr, &CPUCore::bindArithmeticImmediate, false, false },
+        { 0xF138, MOVEP, INSTRUCTION_MOVEP, SIZE_FIELD_BIT_6, 0, EXTENSION_WORD, nullptr, &CPUCore::bindMOVEP, false, false },
+        { 0xFFC0, BIT_STATIC, INSTRUCTION_BTST, SIZE_FIELD_BYTE, bitSource, EXTENSION_WORD, nullptr, &CPUCore::bindBitOperation, false, false },
+        { 0xFFC0, BIT_STATIC | 0x40, INSTRUCTION_BCHG, SIZE_FIELD_BYTE, dataAlterable, EXTENSION_WORD, nullptr, &CPUCore::bindBitOperation, false, false },
+        { 0xFFC0, BIT_STATIC | 0x80, INSTRUCTION_BCLR, SIZE_FIELD_BYTE, dataAlterable, EXTENSION_WORD, nullptr, &CPUCore::bindBitOperation, false, false },
+        { 0xFFC0, BIT_STATIC | 0xC0, INSTRUCTION_BSET, SIZE_FIELD_BYTE, dataAlterable, EXTENSION_WORD, nullptr, &CPUCore::bindBitOperation, false, false },
+        { 0xF1C0, BIT_DYNAMIC, INSTRUCTION_BTST, SIZE_FIELD_BYTE, data, EXTENSION_NONE, nullptr, &CPUCore::bindBitOperation, false, false },
+        { 0xF1C0, BIT_DYNAMIC | 0x40, INSTRUCTION_BCHG, SIZE_FIELD_BYTE, dataAlterable, EXTENSION_NONE, nullptr, &CPUCore::bindBitOperation, false, false },
+        { 0xF1C0, BIT_DYNAMIC | 0x80, INSTRUCTION_BCLR, SIZE_FIELD_BYTE, dataAlterable, EXTENSION_NONE, nullptr, &CPUCore::bindBitOperation, false, false },
+        { 0xF1C0, BIT_DYNAMIC | 0xC0, INSTRUCTION_BSET, SIZE_FIELD_BYTE, dataAlterable, EXTENSION_NONE, nullptr, &CPUCore::bindBitOperation, false, false },
+
+        // MOVE and MOVEA, whose destination is checked against EA_CATEGORY_ALTERABLE
+        { 0xF000, MOVE_B, INSTRUCTION_MOVE, SIZE_FIELD_MOVE, EA_CATEGORY_ALL, EXTENSION_NONE, nullptr, &CPUCore::bindMOVE, false, false },
+        { 0xF000, MOVE_W, INSTRUCTION_MOVE, SIZE_FIELD_MOVE, EA_CATEGORY_ALL, EXTENSION_NONE, nullptr, &CPUCore::bindMOVE, false, false },
+        { 0xF000, MOVE_L, INSTRUCTION_MOVE, SIZE_FIELD_MOVE, EA_CATEGORY_ALL, EXTENSION_NONE, nullptr, &CPUCore::bindMOVE, false, false },
+
+        // Miscellaneous
+        { 0xFFC0, MOVE_FROM_SR, INSTRUCTION_MOVE_FROM_SR, SIZE_FIELD_WORD, dataAlterable, EXTENSION_NONE, nullptr, &CPUCore::bindMOVEFromSR, false, false },
+        { 0xFF00, NEGX, INSTRUCTION_NEGX, SIZE_FIELD_STANDARD, dataAlterable, EXTENSION_NONE, nullptr, &CPUCore::bindNEGX, false, false },
+        { 0xF1C0, CHK, INSTRUCTION_CHK, SIZE_FIELD_WORD, data, EXTENSION_NONE, nullptr, &CPUCore::bindCHK, true, true },
+        { 0xF1C0, LEA, INSTRUCTION_LEA, SIZE_FIELD_NONE, control, EXTENSION_NONE, nullptr, &CPUCore::bindLEA, false, false },
+        { 0xFF00, CLR, INSTRUCTION_CLR, SIZE_FIELD_STANDARD, dataAlterable, EXTENSION_NONE, nullptr, &CPUCore::bindCLR, false, false },
+        { 0xFFC0, MOVE_TO_CCR, INSTRUCTION_MOVE_TO_CCR, SIZE_FIELD_WORD, data, EXTENSION_NONE, nullptr, &CPUCore::bindMOVEToCCR, false, false },
+        { 0xFF00, NEG, INSTRUCTION_NEG, SIZE_FIELD_STANDARD, dataAlterable, EXTENSION_NONE, nullptr, &CPUCore::bindNEG, false, false },
+        { 0xFFC0, MOVE_TO_SR, INSTRUCTION_MOVE_TO_SR, SIZE_FIELD_WORD, data, EXTENSION_NONE, nullptr, &CPUCore::bindMOVEToSR, true, true },
+        { 0xFF00, NOT, INSTRUCTION_NOT, SIZE_FIELD_STANDARD, dataAlterable, EXTENSION_NONE, nullptr, &CPUCore::bindNOT, false, false },
+        { 0xFFC0, NBCD, INSTRUCTION_NBCD, SIZE_FIELD_BYTE, dataAlterable, EXTENSION_NONE, nullptr, &CPUCore::bindNBCD, false, false },
+        { 0xFFF8, SWAP, INSTRUCTION_SWAP, SIZE_FIELD_NONE, 0, EXTENSION_NONE, &CPUCore::executeSWAP, nullptr, false, false },
+        { 0xFFC0, PEA, INSTRUCTION_PEA, SIZE_FIELD_NONE, control, EXTENSION_NONE, nullptr, &CPUCore::bindPEA, false, false },
+        { 0xFFB8, EXT_W, INSTRUCTION_EXT, SIZE_FIELD_BIT_6, 0, EXTENSION_NONE, nullptr, &CPUCore::bindEXT, false, false },
+        { 0xFF80, MOVEM, INSTRUCTION_MOVEM, SIZE_FIELD_BIT_6, movemToMemory, EXTENSION_WORD, nullptr, &CPUCore::bindMOVEM, false, false },
+        { 0xFF80, MOVEM | 0x0400, INSTRUCTION_MOVEM, SIZE_FIELD_BIT_6, movemToRegisters, EXTENSION_WORD, nullptr, &CPUCore::bindMOVEM, false, false },
+        { 0xFFC0, TAS, INSTRUCTION_TAS, SIZE_FIELD_BYTE, dataAlterable, EXTENSION_NONE, nullptr, &CPUCore::bindTAS, false, false },
+        { 0xFF00, TST, INSTRUCTION_TST, SIZE_FIELD_STANDARD, dataAlterable, EXTENSION_NONE, nullptr, &CPUCore::bindTST, false, false },
+        { 0xFFF0, TRAP, INSTRUCTION_TRAP, SIZE_FIELD_NONE, 0, EXTENSION_NONE, &CPUCore::executeTRAP, nullptr, true, true },
+        { 0xFFF8, LINK, INSTRUCTION_LINK, SIZE_FIELD_NONE, 0, EXTENSION_WORD, &CPUCore::executeLINK, nullptr, false, false },
+        { 0xFFF8, UNLK, INSTRUCTION_UNLK, SIZE_FIELD_NONE, 0, EXTENSION_NONE, &CPUCore::executeUNLK, nullptr, false, false },
+        { 0xFFF0, MOVE_USP, INSTRUCTION_MOVE_USP, SIZE_FIELD_NONE, 0, EXTENSION_NONE, &CPUCore::executeMOVEUSP, nullptr, true, true },
+        { 0xFFFF, RESET, INSTRUCTION_RESET, SIZE_FIELD_NONE, 0, EXTENSION_NONE, &CPUCore::executeRESET, nullptr, true, true },
+        { 0xFFFF, NOP, INSTRUCTION_NOP, SIZE_FIELD_NONE, 0, EXTENSION_NONE, &CPUCore::executeNOP, nullptr, false, false },
+        { 0xFFFF, STOP, INSTRUCTION_STOP, SIZE_FIELD_NONE, 0, EXTENSION_WORD, &CPUCore::executeSTOP, nullptr, true, true },
+        { 0xFFFF, RTE, INSTRUCTION_RTE, SIZE_FIELD_NONE, 0, EXTENSION_NONE, &CPUCore::executeRTE, nullptr, true, true },
+        { 0xFFFF, RTS, INSTRUCTION_RTS, SIZE_FIELD_NONE, 0, EXTENSION_NONE, &CPUCore::executeRTS, nullptr, true, false },
+        { 0xFFFF, TRAPV, INSTRUCTION_TRAPV, SIZE_FIELD_NONE, 0, EXTENSION_NONE, &CPUCore::executeTRAPV, nullptr, true, true },
+        { 0xFFFF, RTR, INSTRUCTION_RTR, SIZE_FIELD_NONE, 0, EXTENSION_NONE, &CPUCore::executeRTR, nullptr, true, false },
+        { 0xFFC0, JSR, INSTRUCTION_JSR, SIZE_FIELD_NONE, control, EXTENSION_NONE, nullptr, &CPUCore::bindJSR, true, false },
+        { 0xFFC0, JMP, INSTRUCTION_JMP, SIZE_FIELD_NONE, control, EXTENSION_NONE, nullptr, &CPUCore::bindJMP, true, false },
+
+        // ADDQ, SUBQ, Scc and DBcc
+        { 0xF0F8, DBcc, INSTRUCTION_DBCC, SIZE_FIELD_NONE, 0, EXTENSION_WORD, nullptr, &CPUCore::bindDBcc, true, false },
+        { 0xF0C0, Scc, INSTRUCTION_SCC, SIZE_FIELD_BYTE, dataAlterable, EXTENSION_NONE, nullptr, &CPUCore::bindScc, false, false },
+        { 0xF100, ADDQ, INSTRUCTION_ADDQ, SIZE_FIELD_STANDARD, EA_CATEGORY_ALTERABLE, EXTENSION_NONE, nullptr, &CPUCore::bindArithmeticQuick, false, false },
+        { 0xF100, SUBQ, INSTRUCTION_SUBQ, SIZE_FIELD_STANDARD, EA_CATEGORY_ALTERABLE, EXTENSION_NONE, nullptr, &CPUCore::bindArithmeticQuick, false, false },
+
+        // Branches and MOVEQ
+        { 0xFF00, BSR, INSTRUCTION_BSR, SIZE_FIELD_NONE, 0, EXTENSION_BRANCH, &CPUCore::executeBSR, nullptr, true, false },
+        { 0xFF00, BRA, INSTRUCTION_BRA, SIZE_FIELD_NONE, 0, EXTENSION_BRANCH, &CPUCore::executeBRA, nullptr, true, false },
+        { 0xF000, Bcc, INSTRUCTION_BCC, SIZE_FIELD_NONE, 0, EXTENSION_BRANCH, nullptr, &CPUCore::bindBcc, true, false },
+        { 0xF100, MOVEQ, INSTRUCTION_MOVEQ, SIZE_FIELD_NONE, 0, EXTENSION_NONE, &CPUCore::executeMOVEQ, nullptr, false, false },
+
+        // OR, DIVU, DIVS and SBCD
+        { 0xF1C0, DIVU, INSTRUCTION_DIVU, SIZE_FIELD_WORD, data, EXTENSION_NONE, nullptr, &CPUCore::bindDivide, true, true },
+        { 0xF1C0, DIVS, INSTRUCTION_DIVS, SIZE_FIELD_WORD, data, EXTENSION_NONE, nullptr, &CPUCore::bindDivide, true, true },
+        { 0xF1F0, SBCD, INSTRUCTION_SBCD, SIZE_FIELD_NONE, 0, EXTENSION_NONE, nullptr, &CPUCore::bindBCD, false, false },
+        { 0xF100, OR, INSTRUCTION_OR, SIZE_FIELD_STANDARD, data, EXTENSION_NONE, nullptr, &CPUCore::bindLogicalToRegister, false, false },
+        { 0xF100, OR | 0x0100, INSTRUCTION_OR, SIZE_FIELD_STANDARD, memoryAlterable, EXTENSION_NONE, nullptr, &CPUCore::bindLogicalFromRegister, false, false },
+
+        // SUB, SUBA and SUBX
+        { 0xF0C0, SUBA, INSTRUCTION_SUBA, SIZE_FIELD_ADDRESS, EA_CATEGORY_ALL, EXTENSION_NONE, nullptr, &CPUCore::bindArithmeticToAddress, false, false },
+        { 0xF130, SUBX, INSTRUCTION_SUBX, SIZE_FIELD_STANDARD, 0, EXTENSION_NONE, nullptr, &CPUCore::bindExtendedArithmetic, false, false },
+        { 0xF100, SUB, INSTRUCTION_SUB, SIZE_FIELD_STANDARD, EA_CATEGORY_ALL, EXTENSION_NONE, nullptr, &CPUCore::bindArithmeticToRegister, false, false },
+        { 0xF100, SUB | 0x0100, INSTRUCTION_SUB, SIZE_FIELD_STANDARD, memoryAlterable, EXTENSION_NONE, nullptr, &CPUCore::bindArithmeticToMemory, false, false },
+
+        // CMP, CMPA, CMPM and EOR
+        { 0xF0C0, CMPA, INSTRUCTION_CMPA, SIZE_FIELD_ADDRESS, EA_CATEGORY_ALL, EXTENSION_NONE, nullptr, &CPUCore::bindArithmeticToAddress, false, false },
+        { 0xF138, CMPM, INSTRUCTION_CMPM, SIZE_FIELD_STANDARD, 0, EXTENSION_NONE, nullptr, &CPUCore::bindCMPM, false, false },
+        { 0xF100, EOR, INSTRUCTION_EOR, SIZE_FIELD_STANDARD, dataAlterable, EXTENSION_NONE, nullptr, &CPUCore::bindLogicalFromRegister, false, false },
+        { 0xF100, CMP, INSTRUCTION_CMP, SIZE_FIELD_STANDARD, EA_CATEGORY_ALL, EXTENSION_NONE, nullptr, &CPUCore::bindArithmeticToRegister, false, false },
+
+        // AND, MULU, MULS, ABCD and EXG
+        { 0xF1C0, MULU, INSTRUCTION_MULU, SIZE_FIELD_WORD, data, EXTENSION_NONE, nullptr, &CPUCore::bindMultiply, false, false },
+        { 0xF1C0, MULS, INSTRUCTION_MULS, SIZE_FIELD_WORD, data, EXTENSION_NONE, nullptr, &CPUCore::bindMultiply, false, false },
+        { 0xF1F0, ABCD, INSTRUCTION_ABCD, SIZE_FIELD_NONE, 0, EXTENSION_NONE, nullptr, &CPUCore::bindBCD, false, false },
+        { 0xF1F8, EXG_DATA_REGISTERS, INSTRUCTION_EXG, SIZE_FIELD_NONE, 0, EXTENSION_NONE, &CPUCore::executeEXG, nullptr, false, false },
+        { 0xF1F8, EXG_ADDRESS_REGISTERS, INSTRUCTION_EXG, SIZE_FIELD_NONE, 0, EXTENSION_NONE, &CPUCore::executeEXG, nullptr, false, false },
+        { 0xF1F8, EXG_DATA_AND_ADDRESS_REGISTERS, INSTRUCTION_EXG, SIZE_FIELD_NONE, 0, EXTENSION_NONE, &CPUCore::executeEXG, nullptr, false, false },
+        { 0xF100, AND, INSTRUCTION_AND, SIZE_FIELD_STANDARD, data, EXTENSION_NONE, nullptr, &CPUCore::bindLogicalToRegister, false, false },
+        { 0xF100, AND | 0x0100, INSTRUCTION_AND, SIZE_FIELD_STANDARD, memoryAlterable, EXTENSION_NONE, nullptr, &CPUCore::bindLogicalFromRegister, false, false },
+
+        // ADD, ADDA and ADDX
+        { 0xF0C0, ADDA, INSTRUCTION_ADDA, SIZE_FIELD_ADDRESS, EA_CATEGORY_ALL, EXTENSION_NONE, nullptr, &CPUCore::bindArithmeticToAddress, false, false },
+        { 0xF130, ADDX, INSTRUCTION_ADDX, SIZE_FIELD_STANDARD, 0, EXTENSION_NONE, nullptr, &CPUCore::bindExtendedArithmetic, false, false },
+        { 0xF100, ADD, INSTRUCTION_ADD, SIZE_FIELD_STANDARD, EA_CATEGORY_ALL, EXTENSION_NONE, nullptr, &CPUCore::bindArithmeticToRegister, false, false },
+        { 0xF100, ADD | 0x0100, INSTRUCTION_ADD, SIZE_FIELD_STANDARD, memoryAlterable, EXTENSION_NONE, nullptr, &CPUCore::bindArithmeticToMemory, false, false },
+
+        // Shifts and rotates of a memory word by one, then of data registers, by type
+        { 0xFEC0, SHIFT_MEMORY, INSTRUCTION_ASD, SIZE_FIELD_WORD, memoryAlterable, EXTENSION_NONE, nullptr, &CPUCore::bindShiftMemory, false, false },
+        { 0xFEC0, SHIFT_MEMORY | 0x0200, INSTRUCTION_LSD, SIZE_FIELD_WORD, memoryAlterable, EXTENSION_NONE, nullptr, &CPUCore::bindShiftMemory, false, false },
+        { 0xFEC0, SHIFT_MEMORY | 0x0400, INSTRUCTION_ROXD, SIZE_FIELD_WORD, memoryAlterable, EXTENSION_NONE, nullptr, &CPUCore::bindShiftMemory, false, false },
+        { 0xFEC0, SHIFT_MEMORY | 0x0600, INSTRUCTION_ROD, SIZE_FIELD_WORD, memoryAlterable, EXTENSION_NONE, nullptr, &CPUCore::bindShiftMemory, false, false },
+        { 0xF018, SHIFT_REGISTER, INSTRUCTION_ASD, SIZE_FIELD_STANDARD, 0, EXTENSION_NONE, nullptr, &CPUCore::bindShiftRegister, false, false },
+        { 0xF018, SHIFT_REGISTER | 0x0008, INSTRUCTION_LSD, SIZE_FIELD_STANDARD, 0, EXTENSION_NONE, nullptr, &CPUCore::bindShiftRegister, false, false },
+        { 0xF018, SHIFT_REGISTER | 0x0010, INSTRUCTION_ROXD, SIZE_FIELD_STANDARD, 0, EXTENSION_NONE, nullptr, &CPUCore::bindShiftRegister, false, false },
+        { 0xF018, SHIFT_REGISTER | 0x0018, INSTRUCTION_ROD, SIZE_FIELD_STANDARD, 0, EXTENSION_NONE, nullptr, &CPUCore::bindShiftRegister, false, false },
+
+        // The unimplemented instruction lines, which take exceptions of their own
+        { 0xF000, LINE_A, INSTRUCTION_LINE_A, SIZE_FIELD_NONE, 0, EXTENSION_NONE, &CPUCore::executeLineA, nullptr, true, true },
+        { 0xF000, LINE_F, INSTRUCTION_LINE_F, SIZE_FIELD_NONE, 0, EXTENSION_NONE, &CPUCore::executeLineF, nullptr, true, true }
+    };
+
+    // Where the later models differ from the 68000, for the first to the last model given. These
+    // are matched before the patterns above.
+    struct ModelPattern {
+        int firstModel;
+        int lastModel;
+        InstructionPattern pattern;
+    };
+    static const ModelPattern modelPatterns[] = {
+        // MOVE from SR is privileged from the 68010 on, which adds MOVE from CCR in its place
+        { MC68010, MC68060, { 0xFFC0, MOVE_FROM_SR, INSTRUCTION_MOVE_FROM_SR, SIZE_FIELD_WORD, dataAlterable, EXTENSION_NONE, nullptr, &CPUCore::bindMOVEFromSRPrivileged, true, true } },
+        { MC68010, MC68060, { 0xFFC0, MOVE_FROM_CCR, INSTRUCTION_MOVE_FROM_CCR, SIZE_FIELD_WORD, dataAlterable, EXTENSION_NONE, nullptr, &CPUCore::bindMOVEFromCCR, false, false } },
+        // The 68060 leaves MOVEP to software, through the unimplemented integer instruction exception
+        { MC68060, MC68060, { 0xF138, MOVEP, INSTRUCTION_MOVEP, SIZE_FIELD_NONE, 0, EXTENSION_NONE, &CPUCore::unimplementedInteger, nullptr, true, true } }
+    };
+
+    std::vector<InstructionPattern> modelTable;
+    for (const ModelPattern &modelPattern : modelPatterns) {
+        if (model >= modelPattern.firstModel && model <= modelPattern.lastModel)
+            modelTable.push_back(modelPattern.pattern);
+    }
+    modelTable.insert(modelTable.end(), std::begin(patterns), std::end(patterns));
+
+    // Kept for as long as the program runs, shared by every CPU of the model
+    InstructionEntry *table = new InstructionEntry[0x10000];
+
+    for (uint32_t opcode = 0; opcode <= 0xFFFF; opcode++) {
+        table[opcode] = { &CPUCore::illegalInstruction, 0, true, true, INSTRUCTION_ILLEGAL, 4 };
+        for (const InstructionPattern &pattern : modelTable) {
+            if ((opcode & pattern.mask) != pattern.match)
+                continue;
+
+            int size = operandSize(pattern.sizeField, opcode);
+            int mode = sourceMode(opcode);
+            int extensionWords = 0;
+
+            if (size < 0 || (pattern.category != 0 && !isAllowedMode(mode, pattern.category, size)))
                 break;
+            if (pattern.category != 0)
+                extensionWords += extensionWordCount(mode, size);
+            if (pattern.sizeField == SIZE_FIELD_MOVE) {
+                int destination = EA_MODE((opcode >> 6) & 7, (opcode >> 9) & 7);
+                if (!isAllowedMode(destination, EA_CATEGORY_ALTERABLE, size))
+                    break;
+                extensionWords += extensionWordCount(destination, size);
             }
+
+            if (pattern.extension == EXTENSION_WORD)
+                extensionWords += 1;
+            else if (pattern.extension == EXTENSION_IMMEDIATE)
+                extensionWords += extensionWordCount(EA_IMMEDIATE, size);
+            else if (pattern.extension == EXTENSION_BRANCH && (opcode & 0xFF) == 0)
+                extensionWords += 1;
+
+            InstructionHandler handler = pattern.bind ? pattern.bind(opcode, size, mode) : pattern.handler;
+            uint8_t cycles = (uint8_t)instructionCycles(pattern.instruction, (uint16_t)opcode, size, pattern.category != 0 ? mode : 0);
+            table[opcode] = { handler, extensionWords, pattern.endsBlock, pattern.canStop, pattern.instruction, cycles };
             break;
+        }
+    }
+
+    return table;
+}
+
+// Returns factory(first, second, third) for runtime field values, where the factory receives
+// each value as a std::integral_constant and returns the handler specialised for it. Every
+// combination below the given counts is instantiated once, so the compiler generates one
+// straight-line handler per size and addressing mode while the table is being filled.
+template<int FirstCount, int SecondCount, int ThirdCount, typename Factory>
+CPUCore::InstructionHandler CPUCore::instantiate(Factory factory, int first, int second, int third)
+{
+    return instantiate<SecondCount, ThirdCount>(factory, (first * SecondCount + second) * ThirdCount + third,
+        std::make_integer_sequence<int, FirstCount * SecondCount * ThirdCount>());
+}
+
+template<int SecondCount, int ThirdCount, typename Factory, int... Index>
+CPUCore::InstructionHandler CPUCore::instantiate(Factory factory, int index, std::integer_sequence<int, Index...>)
+{
+    static const InstructionHandler handlers[] = {
+        factory(std::integral_constant<int, Index / (SecondCount * ThirdCount)>(),
+            std::integral_constant<int, (Index / ThirdCount) % SecondCount>(),
+            std::integral_constant<int, Index % ThirdCount>())...
+    };
+    return handlers[index];
+}
+
+// Returns the arithmetic operation of an ADD, SUB or CMP family opcode, immediates and quick forms included
+static int arithmeticOperation(uint16_t opcode)
+{
+    switch (opcode >> 12) {
+    case 0x0:
+        return (opcode & 0x0E00) == (ADDI & 0x0E00) ? OPERATION_ADD : (opcode & 0x0E00) == (SUBI & 0x0E00) ? OPERATION_SUB : OPERATION_CMP;
+    case 0x5:
+        return ((opcode >> 8) & 1) == 0 ? OPERATION_ADD : OPERATION_SUB;
+    case 0x9:
+        return OPERATION_SUB;
+    case 0xD:
+        return OPERATION_ADD;
+    default:
+        return OPERATION_CMP;
+    }
+}
+
+// Returns the logical operation of an AND, OR or EOR family opcode, immediates included
+static int logicalOperation(uint16_t opcode)
+{
+    switch (opcode >> 12) {
+    case 0x0:
+        return (opcode & 0x0E00) == (ORI & 0x0E00) ? LOGICAL_OR : (opcode & 0x0E00) == (ANDI & 0x0E00) ? LOGICAL_AND : LOGICAL_EOR;
+    case 0x8:
+        return LOGICAL_OR;
+    case 0xB:
+        return LOGICAL_EOR;
+    default:
+        return LOGICAL_AND;
+    }
+}
+
+CPUCore::InstructionHandler CPUCore::bindCLR(uint16_t opcode, int size, int mode)
+{
+    return instantiate<1, 3, EA_MODE_COUNT>([](auto, auto size, auto mode) {
+        return &CPUCore::executeCLR<decltype(size)::value, decltype(mode)::value>;
+    }, 0, size, mode);
+}
+
+CPUCore::InstructionHandler CPUCore::bindJMP(uint16_t opcode, int size, int mode)
+{
+    return instantiate<1, 1, EA_MODE_COUNT>([](auto, auto, auto mode) {
+        return &CPUCore::executeJMP<decltype(mode)::value>;
+    }, 0, 0, mode);
+}
+
+CPUCore::InstructionHandler CPUCore::bindJSR(uint16_t opcode, int size, int mode)
+{
+    return instantiate<1, 1, EA_MODE_COUNT>([](auto, auto, auto mode) {
+        return &CPUCore::executeJSR<decltype(mode)::value>;
+    }, 0, 0, mode);
+}
+
+CPUCore::InstructionHandler CPUCore::bindLEA(uint16_t opcode, int size, int mode)
+{
+    return instantiate<1, 1, EA_MODE_COUNT>([](auto, auto, auto mode) {
+        return &CPUCore::executeLEA<decltype(mode)::value>;
+    }, 0, 0, mode);
+}
+
+CPUCore::InstructionHandler CPUCore::bindPEA(uint16_t opcode, int size, int mode)
+{
+    return instantiate<1, 1, EA_MODE_COUNT>([](auto, auto, auto mode) {
+        return &CPUCore::executePEA<decltype(mode)::value>;
+    }, 0, 0, mode);
+}
+
+CPUCore::InstructionHandler CPUCore::bindMOVE(uint16_t opcode, int size, int mode)
+{
+    return instantiate<3, EA_MODE_COUNT, EA_ALTERABLE_MODE_COUNT>([](auto size, auto source, auto destination) {
+        return &CPUCore::executeMOVE<decltype(size)::value, decltype(source)::value, decltype(destination)::value>;
+    }, size, mode, EA_MODE((opcode >> 6) & 7, (opcode >> 9) & 7));
+}
+
+// ADD, SUB and CMP <ea>,Dn
+CPUCore::InstructionHandler CPUCore::bindArithmeticToRegister(uint16_t opcode, int size, int mode)
+{
+    return instantiate<3, 3, EA_MODE_COUNT>([](auto operation, auto size, auto mode) {
+        return &CPUCore::executeArithmeticToRegister<decltype(operation)::value, decltype(size)::value, decltype(mode)::value>;
+    }, arithmeticOperation(opcode), size, mode);
+}
+
+// ADD and SUB Dn,<ea>
+CPUCore::InstructionHandler CPUCore::bindArithmeticToMemory(uint16_t opcode, int size, int mode)
+{
+    return instantiate<2, 3, EA_MODE_COUNT>([](auto operation, auto size, auto mode) {
+        return &CPUCore::executeArithmeticToMemory<decltype(operation)::value, decltype(size)::value, decltype(mode)::value>;
+    }, arithmeticOperation(opcode), size, mode);
+}
+
+// ADDA, SUBA and CMPA
+CPUCore::InstructionHandler CPUCore::bindArithmeticToAddress(uint16_t opcode, int size, int mode)
+{
+    return instantiate<3, 3, EA_MODE_COUNT>([](auto operation, auto size, auto mode) {
+        return &CPUCore::executeArithmeticToAddress<decltype(operation)::value, decltype(size)::value, decltype(mode)::value>;
+    }, arithmeticOperation(opcode), size, mode);
+}
+
+// ADDI, SUBI and CMPI
+CPUCore::InstructionHandler CPUCore::bindArithmeticImmediate(uint16_t opcode, int size, int mode)
+{
+    return instantiate<3, 3, EA_MODE_COUNT>([](auto operation, auto size, auto mode) {
+        return &CPUCore::executeArithmeticImmediate<decltype(operation)::value, decltype(size)::value, decltype(mode)::value>;
+    }, arithmeticOperation(opcode), size, mode);
+}
+
+// ADDQ and SUBQ
+CPUCore::InstructionHandler CPUCore::bindArithmeticQuick(uint16_t opcode, int size, int mode)
+{
+    return instantiate<2, 3, EA_MODE_COUNT>([](auto operation, auto size, auto mode) {
+        return &CPUCore::executeArithmeticQuick<decltype(operation)::value, decltype(size)::value, decltype(mode)::value>;
+    }, arithmeticOperation(opcode), size, mode);
+}
+
+// ADDX and SUBX, between data registers or predecremented memory as bit 3 says
+CPUCore::InstructionHandler CPUCore::bindExtendedArithmetic(uint16_t opcode, int size, int mode)
+{
+    return instantiate<2, 3, 2>([](auto operation, auto size, auto memory) {
+        return &CPUCore::executeExtendedArithmetic<decltype(operation)::value, decltype(size)::value,
+            decltype(memory)::value ? ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_PREDECREMENT : ADDRESS_MODE_DATA_REGISTER_DIRECT>;
+    }, arithmeticOperation(opcode), size, (opcode >> 3) & 1);
+}
+
+CPUCore::InstructionHandler CPUCore::bindCMPM(uint16_t opcode, int size, int mode)
+{
+    return instantiate<1, 1, 3>([](auto, auto, auto size) {
+        return &CPUCore::executeCMPM<decltype(size)::value>;
+    }, 0, 0, size);
+}
+
+// AND and OR <ea>,Dn
+CPUCore::InstructionHandler CPUCore::bindLogicalToRegister(uint16_t opcode, int size, int mode)
+{
+    return instantiate<3, 3, EA_MODE_COUNT>([](auto operation, auto size, auto mode) {
+        return &CPUCore::executeLogicalToRegister<decltype(operation)::value, decltype(size)::value, decltype(mode)::value>;
+    }, logicalOperation(opcode), size, mode);
+}
+
+// AND, OR and EOR Dn,<ea>
+CPUCore::InstructionHandler CPUCore::bindLogicalFromRegister(uint16_t opcode, int size, int mode)
+{
+    return instantiate<3, 3, EA_MODE_COUNT>([](auto operation, auto size, auto mode) {
+        return &CPUCore::executeLogicalFromRegister<decltype(operation)::value, decltype(size)::value, decltype(mode)::value>;
+    }, logicalOperation(opcode), size, mode);
+}
+
+// ANDI, ORI and EORI
+CPUCore::InstructionHandler CPUCore::bindLogicalImmediate(uint16_t opcode, int size, int mode)
+{
+    return instantiate<3, 3, EA_MODE_COUNT>([](auto operation, auto size, auto mode) {
+        return &CPUCore::executeLogicalImmediate<decltype(operation)::value, decltype(size)::value, decltype(mode)::value>;
+    }, logicalOperation(opcode), size, mode);
+}
+
+// ANDI, ORI and EORI to CCR (bytes) and to SR (words)
+CPUCore::InstructionHandler CPUCore::bindLogicalToStatusRegister(uint16_t opcode, int size, int mode)
+{
+    return instantiate<3, 3, 1>([](auto operation, auto size, auto) {
+        return &CPUCore::executeLogicalToStatusRegister<decltype(operation)::value, decltype(size)::value>;
+    }, logicalOperation(opcode), size, 0);
+}
+
+CPUCore::InstructionHandler CPUCore::bindNEG(uint16_t opcode, int size, int mode)
+{
+    return instantiate<1, 3, EA_MODE_COUNT>([](auto, auto size, auto mode) {
+        return &CPUCore::executeNEG<decltype(size)::value, decltype(mode)::value>;
+    }, 0, size, mode);
+}
+
+CPUCore::InstructionHandler CPUCore::bindNEGX(uint16_t opcode, int size, int mode)
+{
+    return instantiate<1, 3, EA_MODE_COUNT>([](auto, auto size, auto mode) {
+        return &CPUCore::executeNEGX<decltype(size)::value, decltype(mode)::value>;
+    }, 0, size, mode);
+}
+
+CPUCore::InstructionHandler CPUCore::bindNOT(uint16_t opcode, int size, int mode)
+{
+    return instantiate<1, 3, EA_MODE_COUNT>([](auto, auto size, auto mode) {
+        return &CPUCore::executeNOT<decltype(size)::value, decltype(mode)::value>;
+    }, 0, size, mode);
+}
+
+CPUCore::InstructionHandler CPUCore::bindTST(uint16_t opcode, int size, int mode)
+{
+    return instantiate<1, 3, EA_MODE_COUNT>([](auto, auto size, auto mode) {
+        return &CPUCore::executeTST<decltype(size)::value, decltype(mode)::value>;
+    }, 0, size, mode);
+}
+
+CPUCore::InstructionHandler CPUCore::bindTAS(uint16_t opcode, int size, int mode)
+{
+    return instantiate<1, 1, EA_MODE_COUNT>([](auto, auto, auto mode) {
+        return &CPUCore::executeTAS<decltype(mode)::value>;
+    }, 0, 0, mode);
+}
+
+CPUCore::InstructionHandler CPUCore::bindNBCD(uint16_t opcode, int size, int mode)
+{
+    return instantiate<1, 1, EA_MODE_COUNT>([](auto, auto, auto mode) {
+        return &CPUCore::executeNBCD<decltype(mode)::value>;
+    }, 0, 0, mode);
+}
+
+// ABCD and SBCD, between data registers or predecremented memory as bit 3 says
+CPUCore::InstructionHandler CPUCore::bindBCD(uint16_t opcode, int size, int mode)
+{
+    int operation = (opcode & 0xF000) == (ABCD & 0xF000) ? OPERATION_ADD : OPERATION_SUB;
+
+    return instantiate<2, 1, 2>([](auto operation, auto, auto memory) {
+        return &CPUCore::executeBCD<decltype(operation)::value,
+            decltype(memory)::value ? ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_PREDECREMENT : ADDRESS_MODE_DATA_REGISTER_DIRECT>;
+    }, operation, 0, (opcode >> 3) & 1);
+}
+
+// MULU and MULS, told apart by bit 8
+CPUCore::InstructionHandler CPUCore::bindMultiply(uint16_t opcode, int size, int mode)
+{
+    return instantiate<1, 2, EA_MODE_COUNT>([](auto, auto isSigned, auto mode) {
+        return &CPUCore::executeMultiply<decltype(isSigned)::value, decltype(mode)::value>;
+    }, 0, (opcode >> 8) & 1, mode);
+}
+
+// DIVU and DIVS, told apart by bit 8
+CPUCore::InstructionHandler CPUCore::bindDivide(uint16_t opcode, int size, int mode)
+{
+    return instantiate<1, 2, EA_MODE_COUNT>([](auto, auto isSigned, auto mode) {
+        return &CPUCore::executeDivide<decltype(isSigned)::value, decltype(mode)::value>;
+    }, 0, (opcode >> 8) & 1, mode);
+}
+
+CPUCore::InstructionHandler CPUCore::bindCHK(uint16_t opcode, int size, int mode)
+{
+    return instantiate<1, 1, EA_MODE_COUNT>([](auto, auto, auto mode) {
+        return &CPUCore::executeCHK<decltype(mode)::value>;
+    }, 0, 0, mode);
+}
+
+CPUCore::InstructionHandler CPUCore::bindEXT(uint16_t opcode, int size, int mode)
+{
+    return instantiate<1, 1, 3>([](auto, auto, auto size) {
+        return &CPUCore::executeEXT<decltype(size)::value>;
+    }, 0, 0, size);
+}
+
+// Shifts and rotates of a data register, with the type in bits 4-3 and the direction in bit 8
+CPUCore::InstructionHandler CPUCore::bindShiftRegister(uint16_t opcode, int size, int mode)
+{
+    return instantiate<4, 2, 3>([](auto type, auto left, auto size) {
+        return &CPUCore::executeShiftRegister<decltype(type)::value, decltype(left)::value, decltype(size)::value>;
+    }, (opcode >> 3) & 3, (opcode >> 8) & 1, size);
+}
+
+// Shifts and rotates of a memory word, with the type in bits 10-9 and the direction in bit 8
+CPUCore::InstructionHandler CPUCore::bindShiftMemory(uint16_t opcode, int size, int mode)
+{
+    return instantiate<4, 2, EA_MODE_COUNT>([](auto type, auto left, auto mode) {
+        return &CPUCore::executeShiftMemory<decltype(type)::value, decltype(left)::value, decltype(mode)::value>;
+    }, (opcode >> 9) & 3, (opcode >> 8) & 1, mode);
+}
+
+// BTST, BCHG, BCLR and BSET, with the operation in bits 7-6 and a bit number from a data register when bit 8 is set
+CPUCore::InstructionHandler CPUCore::bindBitOperation(uint16_t opcode, int size, int mode)
+{
+    return instantiate<4, EA_MODE_COUNT, 2>([](auto operation, auto mode, auto dynamic) {
+        return &CPUCore::executeBitOperation<decltype(operation)::value, decltype(mode)::value, decltype(dynamic)::value>;
+    }, (opcode >> 6) & 3, mode, (opcode >> 8) & 1);
+}
+
+// MOVEP, which moves to memory when bit 7 is set
+CPUCore::InstructionHandler CPUCore::bindMOVEP(uint16_t opcode, int size, int mode)
+{
+    return instantiate<1, 3, 2>([](auto, auto size, auto toMemory) {
+        return &CPUCore::executeMOVEP<decltype(size)::value, decltype(toMemory)::value>;
+    }, 0, size, (opcode >> 7) & 1);
+}
+
+CPUCore::InstructionHandler CPUCore::bindScc(uint16_t opcode, int size, int mode)
+{
+    return instantiate<1, 16, EA_MODE_COUNT>([](auto, auto condition, auto mode) {
+        return &CPUCore::executeScc<decltype(condition)::value, decltype(mode)::value>;
+    }, 0, (opcode >> 8) & 0xF, mode);
+}
+
+CPUCore::InstructionHandler CPUCore::bindDBcc(uint16_t opcode, int size, int mode)
+{
+    return instantiate<1, 1, 16>([](auto, auto, auto condition) {
+        return &CPUCore::executeDBcc<decltype(condition)::value>;
+    }, 0, 0, (opcode >> 8) & 0xF);
+}
+
+CPUCore::InstructionHandler CPUCore::bindBcc(uint16_t opcode, int size, int mode)
+{
+    return instantiate<1, 1, 16>([](auto, auto, auto condition) {
+        return &CPUCore::executeBcc<decltype(condition)::value>;
+    }, 0, 0, (opcode >> 8) & 0xF);
+}
+
+// MOVEM, which loads registers when bit 10 is set
+CPUCore::InstructionHandler CPUCore::bindMOVEM(uint16_t opcode, int size, int mode)
+{
+    if (((opcode >> 10) & 1) == 1) {
+        return instantiate<1, 3, EA_MODE_COUNT>([](auto, auto size, auto mode) {
+            return &CPUCore::executeMOVEMToRegisters<decltype(size)::value, decltype(mode)::value>;
+        }, 0, size, mode);
+    }
+
+    return instantiate<1, 3, EA_MODE_COUNT>([](auto, auto size, auto mode) {
+        return &CPUCore::executeMOVEMToMemory<decltype(size)::value, decltype(mode)::value>;
+    }, 0, size, mode);
+}
+
+CPUCore::InstructionHandler CPUCore::bindMOVEFromSR(uint16_t opcode, int size, int mode)
+{
+    return instantiate<1, 1, EA_MODE_COUNT>([](auto, auto, auto mode) {
+        return &CPUCore::executeMOVEFromSR<decltype(mode)::value, 0>;
+    }, 0, 0, mode);
+}
+
+CPUCore::InstructionHandler CPUCore::bindMOVEFromSRPrivileged(uint16_t opcode, int size, int mode)
+{
+    return instantiate<1, 1, EA_MODE_COUNT>([](auto, auto, auto mode) {
+        return &CPUCore::executeMOVEFromSR<decltype(mode)::value, 1>;
+    }, 0, 0, mode);
+}
+
+CPUCore::InstructionHandler CPUCore::bindMOVEFromCCR(uint16_t opcode, int size, int mode)
+{
+    return instantiate<1, 1, EA_MODE_COUNT>([](auto, auto, auto mode) {
+        return &CPUCore::executeMOVEFromCCR<decltype(mode)::value>;
+    }, 0, 0, mode);
+}
+
+CPUCore::InstructionHandler CPUCore::bindMOVEToCCR(uint16_t opcode, int size, int mode)
+{
+    return instantiate<1, 1, EA_MODE_COUNT>([](auto, auto, auto mode) {
+        return &CPUCore::executeMOVEToCCR<decltype(mode)::value>;
+    }, 0, 0, mode);
+}
+
+CPUCore::InstructionHandler CPUCore::bindMOVEToSR(uint16_t opcode, int size, int mode)
+{
+    return instantiate<1, 1, EA_MODE_COUNT>([](auto, auto, auto mode) {
+        return &CPUCore::executeMOVEToSR<decltype(mode)::value>;
+    }, 0, 0, mode);
+}
+
+// Returns the immediate operand held in the extension words of a decoded instruction
+static uint32_t immediateValue(const uint16_t *words, int size)
+{
+    return size == SIZE_LONG ? (words[0] << 16) | words[1] : words[0] & sizeMask(size);
+}
+
+// Returns true when an instruction steps an address register on by a number of bytes with
+// ADDQ or ADDA, neither of which changes the condition codes
+static bool isAddressIncrement(uint8_t instruction, const uint16_t *words, uint16_t opcode, int reg, uint32_t bytes)
+{
+    if (instruction == INSTRUCTION_ADDQ) {
+        uint32_t data = (opcode >> 9) & 7;
+        return ((opcode >> 3) & 7) == ADDRESS_MODE_ADDRESS_REGISTER_DIRECT && (opcode & 7) == reg && (data == 0 ? 8 : data) == bytes;
+    }
+
+    if (instruction == INSTRUCTION_ADDA && sourceMode(opcode) == EA_IMMEDIATE && ((opcode >> 9) & 7) == reg) {
+        int size = ((opcode >> 8) & 1) == 1 ? SIZE_LONG : SIZE_WORD;
+        uint32_t increment = immediateValue(words, size);
+        return (size == SIZE_WORD ? (uint32_t)(int16_t)increment : increment) == bytes;
+    }
+    return false;
+}
+
+// Returns the data register an instruction decrements by one, as SUBQ #1, SUBI #1 or SUB #1 do,
+// or -1. The size of the decrement is returned through size.
+static int counterDecrement(uint8_t instruction, const uint16_t *words, uint16_t opcode, int &size)
+{
+    size = (opcode >> 6) & 3;
+
+    if (instruction == INSTRUCTION_SUBQ && ((opcode >> 3) & 7) == ADDRESS_MODE_DATA_REGISTER_DIRECT && ((opcode >> 9) & 7) == 1)
+        return opcode & 7;
+    if (instruction == INSTRUCTION_SUBI && ((opcode >> 3) & 7) == ADDRESS_MODE_DATA_REGISTER_DIRECT && immediateValue(words, size) == 1)
+        return opcode & 7;
+    if (instruction == INSTRUCTION_SUB && ((opcode >> 8) & 1) == 0 && sourceMode(opcode) == EA_IMMEDIATE && immediateValue(words, size) == 1)
+        return (opcode >> 9) & 7;
+    return -1;
+}
+
+// Looks for a block that is a whole fill, copy, scan or compare loop, recording what it does
+// so that executeIdiom can run it over memory in one go
+void CPUCore::recogniseIdiom(TranslatedBlock &block)
+{
+    MemoryIdiom &idiom = block.idiom;
+    const std::vector<DecodedInstruction> &instructions = block.instructions;
+    const DecodedInstruction &first = instructions[0];
+    uint8_t firstInstruction = instructionTable[first.opcode].instruction;
+    int condition = loopCondition(block);
+
+    idiom.kind = IDIOM_NONE;
+
+    // Running the loop in one go would step straight over a breakpoint in it
+    for (const DecodedInstruction &decoded : instructions) {
+        if (decoded.handler == &CPUCore::executeBreakpoint)
+            return;
+    }
+
+    // MOVE.B (An)+,Dn / BNE and CMP.B (An)+,Dn / BNE, for strlen and memchr
+    if (instructions.size() == 2 && condition == CONDITIONAL_NOT_EQUAL && (first.opcode & 0x0038) == 0x0018 && (first.opcode & 7) != 7) {
+        idiom.source = first.opcode & 7;
+        idiom.valueRegister = (first.opcode >> 9) & 7;
+        if ((first.opcode & 0xF1C0) == MOVE_B)
+            idiom.kind = IDIOM_STRING_LENGTH;
+        else if (firstInstruction == INSTRUCTION_CMP && ((first.opcode >> 6) & 7) == SIZE_BYTE)
+            idiom.kind = IDIOM_FIND;
+        return;
+    }
+
+    // MOVE.B (An)+,Dn / CMP.B (Am)+,Dn / BEQ, for memcmp
+    if (instructions.size() == 3 && condition == CONDITIONAL_EQUAL) {
+        uint16_t compare = instructions[1].opcode;
+        if ((first.opcode & 0xF1F8) == (MOVE_B | 0x0018) && instructionTable[compare].instruction == INSTRUCTION_CMP && (compare & 0x01F8) == 0x0018 &&
+            ((compare >> 9) & 7) == ((first.opcode >> 9) & 7) && (first.opcode & 7) != 7 && (compare & 7) != 7 && (compare & 7) != (first.opcode & 7)) {
+            idiom.kind = IDIOM_COMPARE;
+            idiom.source = first.opcode & 7;
+            idiom.destination = compare & 7;
+            idiom.valueRegister = (first.opcode >> 9) & 7;
+        }
+        return;
+    }
+
+    // The fill and copy loops end by counting a data register down to zero
+    if (instructions.size() < 3 || instructions.size() > 4 || condition != CONDITIONAL_NOT_EQUAL || firstInstruction != INSTRUCTION_MOVE)
+        return;
+    const DecodedInstruction &decrement = instructions[instructions.size() - 2];
+    idiom.counter = counterDecrement(instructionTable[decrement.opcode].instruction, decrement.extensionWords, decrement.opcode, idiom.counterSize);
+    if (idiom.counter < 0)
+        return;
+
+    idiom.size = moveSize(first.opcode);
+    idiom.destination = (first.opcode >> 9) & 7;
+    int destinationMode = (first.opcode >> 6) & 7;
+    int source = sourceMode(first.opcode);
+
+    // Byte accesses through A7 move it by two, which a plain fill or copy does not do
+    if (idiom.size == SIZE_BYTE && idiom.destination == 7)
+        return;
+
+    if (instructions.size() == 3 && destinationMode == ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_POSTINCREMENT) {
+        if (source == ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_POSTINCREMENT && (idiom.size != SIZE_BYTE || (first.opcode & 7) != 7)) {
+            idiom.kind = IDIOM_COPY;
+            idiom.source = first.opcode & 7;
+            return;
+        }
+    }
+    else if (instructions.size() == 4 && destinationMode == ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT) {
+        const DecodedInstruction &increment = instructions[1];
+        if (!isAddressIncrement(instructionTable[increment.opcode].instruction, increment.extensionWords, increment.opcode, idiom.destination, sizeInBytes(idiom.size)))
+            return;
+    }
+    else {
+        return;
+    }
+
+    if (source == EA_IMMEDIATE) {
+        idiom.kind = IDIOM_FILL;
+        idiom.valueRegister = -1;
+        idiom.value = immediateValue(first.extensionWords, idiom.size);
+    }
+    else if (source == ADDRESS_MODE_DATA_REGISTER_DIRECT && (first.opcode & 7) != idiom.counter) {
+        idiom.kind = IDIOM_FILL;
+        idiom.valueRegister = first.opcode & 7;
+    }
+}
+
+// Runs a block recognised as a memory idiom, leaving the registers, memory and condition codes as
+// running the loop would and PC after it, and returns the number of times the loop ran. Returns 0,
+// having changed nothing, when the loop would run off the end of memory, write to code or run
+// more than maximumIterations times, and the block has to be interpreted.
+uint64_t CPUCore::executeIdiom(const TranslatedBlock &block, uint64_t maximumIterations)
+{
+    const MemoryIdiom &idiom = block.idiom;
+    uint64_t memorySize = memory->getSizeInBytes();
+    uint64_t iterations;
+
+    if (idiom.kind == IDIOM_FILL || idiom.kind == IDIOM_COPY) {
+        uint64_t count = D[idiom.counter] & sizeMask(idiom.counterSize);
+        if (count == 0)
+            count = (uint64_t)sizeMask(idiom.counterSize) + 1;
+        if (count > maximumIterations)
+            return 0;
+        iterations = count;
+
+        uint64_t length = count * sizeInBytes(idiom.size);
+        uint32_t destination = A[idiom.destination];
+        if (destination + length > memorySize || memory->isCode(destination, (uint32_t)length))
+            return 0;
+
+        if (idiom.kind == IDIOM_FILL) {
+            uint32_t value = idiom.valueRegister < 0 ? idiom.value : D[idiom.valueRegister] & sizeMask(idiom.size);
+            memory->fillMemory(value, sizeInBytes(idiom.size), destination, (uint32_t)count);
+        }
+        else {
+            // Overlapping copies repeat what they have already copied, which memcpy does not
+            uint32_t source = A[idiom.source];
+            if (source + length > memorySize || (source < destination + length && destination < source + length))
+                return 0;
+            memory->copyMemory(destination, source, (uint32_t)length);
+            A[idiom.source] += (uint32_t)length;
+        }
+        A[idiom.destination] += (uint32_t)length;
+
+        // The loop ended with the counter's SUB #1 taking it from 1 to 0
+        D[idiom.counter] &= ~sizeMask(idiom.counterSize);
+        flagOperation = OPERATION_SUB;
+        flagSize = idiom.counterSize;
+        flagSource = 1;
+        flagDestination = 1;
+        flagResult = 0;
+    }
+    else if (idiom.kind == IDIOM_STRING_LENGTH || idiom.kind == IDIOM_FIND) {
+        uint32_t address = A[idiom.source];
+        uint8_t value = idiom.kind == IDIOM_STRING_LENGTH ? 0 : (uint8_t)D[idiom.valueRegister];
+        uint32_t found;
+        if (address >= memorySize)
+            return 0;
+        uint64_t length = memorySize - address < maximumIterations ? memorySize - address : maximumIterations;
+        if (!memory->findByte(value, address, (uint32_t)length, found))
+            return 0;
+
+        iterations = found - address + 1;
+        A[idiom.source] = found + 1;
+        if (idiom.kind == IDIOM_STRING_LENGTH) {
+            writeByteToDataRegister(0, idiom.valueRegister);
+            setLogicalFlags<SIZE_BYTE>(0);
+        }
+        else {
+            arithmetic<OPERATION_CMP, SIZE_BYTE>(value, value);
+        }
+    }
+    else {
+        uint32_t first = A[idiom.source];
+        uint32_t second = A[idiom.destination];
+        uint32_t offset;
+        if (first >= memorySize || second >= memorySize)
+            return 0;
+        uint64_t length = memorySize - (first > second ? first : second);
+        if (!memory->findMismatch(first, second, (uint32_t)(length < maximumIterations ? length : maximumIterations), offset))
+            return 0;
+
+        iterations = offset + 1;
+        A[idiom.source] = first + offset + 1;
+        A[idiom.destination] = second + offset + 1;
+        uint8_t loaded = memory->readByteFromMemory(first + offset);
+        writeByteToDataRegister(loaded, idiom.valueRegister);
+        arithmetic<OPERATION_CMP, SIZE_BYTE>(memory->readByteFromMemory(second + offset), loaded);
+    }
+
+    PC = block.endAddress;
+    return iterations;
+}
+
+// Returns the extension word at PC, taken from the decoded instruction, and advances past it
+uint16_t CPUCore::fetchWord()
+{
+    PC += 2;
+    return *nextExtensionWord++;
+}
+
+// Returns the extension long at PC, taken from the decoded instruction, and advances past it
+uint32_t CPUCore::fetchLong()
+{
+    uint32_t data = (nextExtensionWord[0] << 16) | nextExtensionWord[1];
+    nextExtensionWord += 2;
+    PC += 4;
+    return data;
+}
+
+// Returns base + d8 + Xn for the indexed addressing modes, reading the brief extension word
+uint32_t CPUCore::indexedAddress(uint32_t base)
+{
+    uint16_t extension = fetchWord();
+    uint32_t index = registers[(extension >> 12) & 15];
+
+    if (((extension >> 8) & INDEX_SIZE_LONG) == INDEX_SIZE_WORD)
+        index = (int16_t)index;
+
+    return base + (int8_t)extension + (index << ((extension >> 9) & indexScaleMask));
+}
+
+// Returns the address of a memory operand, consuming its extension words and applying any
+// postincrement or predecrement to the address register
+template<int Size, int Mode>
+uint32_t CPUCore::effectiveAddress(int reg)
+{
+    // Byte accesses through the stack pointer still move it by a word to keep it aligned
+    const uint32_t increment = Size == SIZE_BYTE ? (reg == 7 ? 2 : 1) : sizeInBytes(Size);
+    uint32_t address;
+
+    switch (Mode) {
+    case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT:
+        return A[reg];
+    case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_POSTINCREMENT:
+        address = A[reg];
+        A[reg] += increment;
+        return address;
+    case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_PREDECREMENT:
+        A[reg] -= increment;
+        return A[reg];
+    case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_DISPLACEMENT:
+        return A[reg] + (int16_t)fetchWord();
+    case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_INDEX:
+        return indexedAddress(A[reg]);
+    case EA_ABSOLUTE_SHORT:
+        return (int16_t)fetchWord();
+    case EA_ABSOLUTE_LONG:
+        return fetchLong();
+    case EA_PROGRAM_COUNTER_WITH_DISPLACEMENT:
+        address = PC;
+        return address + (int16_t)fetchWord();
+    case EA_PROGRAM_COUNTER_WITH_INDEX:
+        return indexedAddress(PC);
+    default:
+        return 0;
+    }
+}
+
+template<int Size>
+uint32_t CPUCore::readMemory(uint32_t address)
+{
+    if (Size == SIZE_BYTE)
+        return memory->readByteFromMemory(address);
+    else if (Size == SIZE_WORD)
+        return memory->readWordFromMemory(address);
+    else
+        return memory->readLongFromMemory(address);
+}
+
+template<int Size>
+void CPUCore::writeMemory(uint32_t address, uint32_t data)
+{
+    if (Size == SIZE_BYTE)
+        memory->writeByteToMemory(data, address);
+    else if (Size == SIZE_WORD)
+        memory->writeWordToMemory(data, address);
+    else
+        memory->writeLongToMemory(data, address);
+}
+
+template<int Size>
+void CPUCore::writeDataRegister(uint32_t data, int reg)
+{
+    if (Size == SIZE_BYTE)
+        writeByteToDataRegister(data, reg);
+    else if (Size == SIZE_WORD)
+        writeWordToDataRegister(data, reg);
+    else
+        writeLongToDataRegister(data, reg);
+}
+
+// Resolves an operand once: register direct modes give the register, immediates give their
+// value and every other mode gives the guest address after its extension words are fetched and
+// any postincrement or predecrement is applied. Reads and writes of the operand go through the
+// result, so a read-modify-write instruction resolves its destination a single time.
+template<int Size, int Mode>
+CPUCore::Operand CPUCore::resolveOperand(int reg)
+{
+    Operand operand;
+
+    if (Mode == ADDRESS_MODE_DATA_REGISTER_DIRECT)
+        operand.reg = &D[reg];
+    else if (Mode == ADDRESS_MODE_ADDRESS_REGISTER_DIRECT)
+        operand.reg = &A[reg];
+    else if (Mode == EA_IMMEDIATE)
+        operand.address = Size == SIZE_LONG ? fetchLong() : fetchWord() & sizeMask(Size);
+    else
+        operand.address = effectiveAddress<Size, Mode>(reg);
+    return operand;
+}
+
+// Reads a resolved operand of the given size
+template<int Size, int Mode>
+uint32_t CPUCore::readOperand(const Operand &operand)
+{
+    if (Mode == ADDRESS_MODE_DATA_REGISTER_DIRECT || Mode == ADDRESS_MODE_ADDRESS_REGISTER_DIRECT)
+        return *operand.reg & sizeMask(Size);
+    else if (Mode == EA_IMMEDIATE)
+        return operand.address;
+    else
+        return readMemory<Size>(operand.address);
+}
+
+// Writes a resolved operand of the given size. Address registers are always written in full.
+template<int Size, int Mode>
+void CPUCore::writeOperand(const Operand &operand, uint32_t data)
+{
+    if (Mode == ADDRESS_MODE_DATA_REGISTER_DIRECT)
+        *operand.reg = (*operand.reg & ~sizeMask(Size)) | (data & sizeMask(Size));
+    else if (Mode == ADDRESS_MODE_ADDRESS_REGISTER_DIRECT)
+        *operand.reg = data;
+    else
+        writeMemory<Size>(operand.address, data);
+}
+
+// Reads a source operand of the given size
+template<int Size, int Mode>
+uint32_t CPUCore::readOperand(int reg)
+{
+    return readOperand<Size, Mode>(resolveOperand<Size, Mode>(reg));
+}
+
+// Writes a destination operand of the given size
+template<int Size, int Mode>
+void CPUCore::writeOperand(uint32_t data, int reg)
+{
+    writeOperand<Size, Mode>(resolveOperand<Size, Mode>(reg), data);
+}
+
+// Records a result for N and Z with V and C cleared, as MOVE, CLR and the logical operations do
+template<int Size>
+void CPUCore::setLogicalFlags(uint32_t result)
+{
+    // The extend flag is left alone, so one still pending from an ADD or SUB is evaluated first
+    if (flagOperation == OPERATION_ADD || flagOperation == OPERATION_SUB)
+        evaluateFlags();
+
+    flagOperation = FLAGS_LOGICAL;
+    flagSize = Size;
+    flagResult = result & sizeMask(Size);
+}
+
+// Computes destination + source or destination - source and records the operation for the
+// condition codes. CMP leaves the extend flag alone.
+template<int Operation, int Size>
+uint32_t CPUCore::arithmetic(uint32_t source, uint32_t destination)
+{
+    if (Operation == OPERATION_CMP && (flagOperation == OPERATION_ADD || flagOperation == OPERATION_SUB))
+        evaluateFlags();
+
+    source &= sizeMask(Size);
+    destination &= sizeMask(Size);
+
+    uint32_t result;
+    if (Operation == OPERATION_ADD)
+        result = (destination + source) & sizeMask(Size);
+    else
+        result = (destination - source) & sizeMask(Size);
+
+    flagOperation = Operation;
+    flagSize = Size;
+    flagSource = source;
+    flagDestination = destination;
+    flagResult = result;
+    return result;
+}
+
+// Returns the condition codes XNZVC worked out from the last operation that set them
+uint16_t CPUCore::conditionCodes()
+{
+    uint16_t extend = CCR & (1 << SR_CCR_EXTEND);
+
+    switch (flagOperation) {
+    case OPERATION_ADD:
+        return additionFlags(flagSize, flagSource, flagDestination, flagResult);
+    case OPERATION_SUB:
+        return subtractionFlags(flagSize, flagSource, flagDestination, flagResult);
+    case OPERATION_CMP:
+        return (subtractionFlags(flagSize, flagSource, flagDestination, flagResult) & 0x0F) | extend;
+    case FLAGS_LOGICAL:
+        return logicalFlags(flagSize, flagResult) | extend;
+    default:
+        return CCR;
+    }
+}
+
+// Brings the condition codes in SR up to date, for anything that reads or replaces SR as a whole
+void CPUCore::evaluateFlags()
+{
+    CCR = (uint8_t)conditionCodes();
+    flagOperation = FLAGS_EVALUATED;
+}
+
+// Sets the condition codes in changed to those in flags and leaves the others as they are, for
+// the instructions whose flags the lazy evaluation does not describe
+void CPUCore::setConditionCodes(uint16_t flags, uint16_t changed)
+{
+    evaluateFlags();
+    CCR = (uint8_t)((CCR & ~changed) | (flags & changed));
+}
+
+// Replaces the status register, swapping the stack pointers when the supervisor bit changes
+void CPUCore::writeStatusRegister(uint16_t data)
+{
+    data &= SR_MASK;
+    if ((((SR ^ data) >> SR_SUPERVISOR_MODE) & 1) == 1) {
+        uint32_t stackPointer = SP;
+        SP = inactiveStackPointer;
+        inactiveStackPointer = stackPointer;
+    }
+    SR = data;
+    flagOperation = FLAGS_EVALUATED;
+    if (interruptLevels != 0)
+        updateInterruptPending();
+}
+
+bool CPUCore::isSupervisor()
+{
+    return ((SR >> SR_SUPERVISOR_MODE) & 1) == 1;
+}
+
+// Takes an exception: enters supervisor mode, pushes the return address and the old status
+// register on the supervisor stack and jumps through the vector. A program that has not set the
+// vector up has nothing to handle the exception, so execution stops and false is returned.
+bool CPUCore::exception(int vector, uint32_t returnAddress)
+{
+    uint32_t handler = memory->readLongFromMemory(vector * 4);
+
+    if (handler == 0) {
+        cout << endl << "Unhandled exception " << dec << vector << " at address: " << uppercase << hex << returnAddress << endl;
+        return stopExecution(STOP_ILLEGAL_INSTRUCTION);
+    }
+
+    cycleCount += EXCEPTION_CYCLES;
+    evaluateFlags();
+    uint16_t status = SR;
+    writeStatusRegister((SR | (1 << SR_SUPERVISOR_MODE)) & ~(1 << SR_TRACE_MODE));
+    if (exceptionFormatWord) {
+        // Format 0, the four word frame, and the offset of the vector
+        SP -= 2;
+        memory->writeWordToMemory(vector * 4, SP);
+    }
+    SP -= 4;
+    memory->writeLongToMemory(returnAddress, SP);
+    SP -= 2;
+    memory->writeWordToMemory(status, SP);
+    PC = handler;
+    return true;
+}
+
+// Takes the privilege violation exception for a privileged instruction run in user mode. It has
+// to be called before the instruction fetches any extension words, while PC - 2 is its address.
+bool CPUCore::privilegeViolation()
+{
+    return exception(VECTOR_PRIVILEGE_VIOLATION, PC - 2);
+}
+
+// Records why execution stops, for run to return, and returns false for the handler to return
+bool CPUCore::stopExecution(stopReasons reason)
+{
+    stopReason = reason;
+    return false;
+}
 
-        default:
-            cout << "Unrecognised addressing mode" << endl;
-            return false;
-            break;
-        }
+// Stops a TRAP #15 task that reads the keyboard when there is no input for it and it is not to
+// wait. The TRAP is run again, reading the input, when execution carries on.
+bool CPUCore::awaitInput()
+{
+    PC -= 2;
+    return stopExecution(STOP_PENDING_IO);
+}
 
-        if (size == SIZE_BYTE || (size - 4) == SIZE_BYTE) {
-            (uint8_t)result == 0 ? SR |= 1 << SR_CCR_ZERO : SR &= ~(1 << SR_CCR_ZERO);
-        }
-        else if (size == SIZE_WORD || (size - 4) == SIZE_WORD) {
-            (uint16_t)result == 0 ? SR |= 1 << SR_CCR_ZERO : SR &= ~(1 << SR_CCR_ZERO);
-        }
-        else {
-            result == 0 ? SR |= 1 << SR_CCR_ZERO : SR &= ~(1 << SR_CCR_ZERO);
-        }
+// Computes destination + source + X or destination - source - X for ADDX, SUBX and NEGX. Z is
+// only ever cleared, so that a multiple precision result is zero only when every part of it is.
+template<int Operation, int Size>
+uint32_t CPUCore::extendedArithmetic(uint32_t source, uint32_t destination)
+{
+    evaluateFlags();
 
-        mostSignificantBitResult == 1 ? SR |= 1 << SR_CCR_NEGATIVE : SR &= ~(1 << SR_CCR_NEGATIVE);
+    uint32_t extend = (CCR >> SR_CCR_EXTEND) & 1;
+    uint16_t flags;
+    uint32_t result = Operation == OPERATION_ADD ? aluAdd<Size>(source, destination, extend, flags)
+        : aluSubtract<Size>(source, destination, extend, flags);
 
-        if (mostSignificantBitDestination == 1 && mostSignificantBitResult == 0)
-            SR |= 1 << SR_CCR_CARRY;
-        else
-            SR &= ~(1 << SR_CCR_CARRY);
+    CCR = (uint8_t)((flags & ~(1 << SR_CCR_ZERO)) | (CCR & flags & (1 << SR_CCR_ZERO)));
+    return result;
+}
+
+// Applies an AND, OR or EOR with a source value to a destination operand
+template<int Operation, int Size, int DestinationMode>
+void CPUCore::logicalToOperand(uint32_t source, int reg)
+{
+    Operand destination = resolveOperand<Size, DestinationMode>(reg);
+    uint32_t result = readOperand<Size, DestinationMode>(destination);
+
+    if (Operation == LOGICAL_AND)
+        result &= source;
+    else if (Operation == LOGICAL_OR)
+        result |= source;
+    else
+        result ^= source;
+
+    writeOperand<Size, DestinationMode>(destination, result);
+    setLogicalFlags<Size>(result);
+}
+
+// Adds or subtracts two packed decimal bytes and X for ABCD, SBCD and NBCD. Like ADDX, Z is only
+// ever cleared. V is undefined and left alone.
+template<int Operation>
+uint8_t CPUCore::decimalArithmetic(uint8_t source, uint8_t destination)
+{
+    evaluateFlags();
+
+    uint32_t extend = (CCR >> SR_CCR_EXTEND) & 1;
+    uint32_t result;
+    bool carry;
+
+    if (Operation == OPERATION_ADD) {
+        result = (source & 0x0F) + (destination & 0x0F) + extend;
+        if (result > 9)
+            result += 6;
+        result += (source & 0xF0) + (destination & 0xF0);
+        carry = result > 0x99;
+        if (carry)
+            result -= 0xA0;
+    }
+    else {
+        result = (destination & 0x0F) - (source & 0x0F) - extend;
+        if (result > 9)
+            result -= 6;
+        result += (destination & 0xF0) - (source & 0xF0);
+        carry = result > 0x99;
+        if (carry)
+            result += 0xA0;
+    }
+    result &= 0xFF;
+
+    uint16_t flags = (carry << SR_CCR_CARRY) | (carry << SR_CCR_EXTEND) | (((result & 0x80) != 0) << SR_CCR_NEGATIVE);
+    uint16_t changed = (1 << SR_CCR_CARRY) | (1 << SR_CCR_EXTEND) | (1 << SR_CCR_NEGATIVE);
+    if (result != 0)
+        changed |= 1 << SR_CCR_ZERO;
+    setConditionCodes(flags, changed);
+    return (uint8_t)result;
+}
 
-        if (mostSignificantBitSource == mostSignificantBitDestination)
-            mostSignificantBitDestination != mostSignificantBitResult ? SR |= 1 << SR_CCR_OVERFLOW : SR &= ~(1 << SR_CCR_OVERFLOW);
+// Shifts or rotates a value by a count of 0 to 63 and sets the condition codes. ROL and ROR
+// leave X alone.
+template<int Type, int Left, int Size>
+uint32_t CPUCore::shift(uint32_t value, int count)
+{
+    evaluateFlags();
 
-        ((SR >> SR_CCR_CARRY) & 1) == 1 ? SR |= 1 << SR_CCR_EXTEND : SR &= ~(1 << SR_CCR_EXTEND);
+    uint16_t flags;
+    uint32_t result = aluShift<Type, Left, Size>(value, count, (CCR >> SR_CCR_EXTEND) & 1, flags);
+    CCR = (uint8_t)flags;
+    return result;
+}
 
+// Returns true when the condition holds for the current condition codes
+template<int Condition>
+bool CPUCore::testCondition()
+{
+    if (Condition == CONDITIONAL_TRUE)
         return true;
-    }
-    
-    // ADDA (Add Address)
-    if ((instruction & 0xF000) == ADD) {
-        AddA:
-        int size = (instruction >> 6) & 7;
-
-        if (size == 3)
-            size = SIZE_WORD;
-        else if (size == SIZE_LONG)
-            size = SIZE_LONG;
-        else {
-            cout << "Invalid addressing mode." << endl;
-            return false;
-        }
+    if (Condition == CONDITIONAL_FALSE)
+        return false;
+    return ((conditionTable[Condition] >> (conditionCodes() & 0x0F)) & 1) == 1;
+}
 
-        int mode = (instruction >> 3) & 7;
-        int dataReg = (instruction >> 9) & 7;
-        int addressRegister = instruction & 7;
+// Returns the displacement of a branch: the low byte of the opcode, or the following
+// extension word when that byte is zero
+int32_t CPUCore::branchDisplacement(uint16_t instruction)
+{
+    int8_t shortDisplacement = instruction & 0xFF;
 
-        if (DEBUG_MODE) {
-            cout << "WE HAVE AN ADDA" << endl;
-            cout << "Mode is: " << mode << endl;
-            cout << "Destination address register is: " << dataReg << endl;
-            cout << "Address register is: " << addressRegister << endl;
-        }
+    if (shortDisplacement == 0)
+        return (int16_t)fetchWord();
+    return shortDisplacement;
+}
 
-        if (size == SIZE_WORD)
-            data = (uint16_t)A[dataReg];
-        else
-            data = A[dataReg];
-
-        switch (mode) {
-        case ADDRESS_MODE_DATA_REGISTER_DIRECT:
-            if (DEBUG_MODE)
-                cout << "Data: " << data << endl;
-            if (size == SIZE_WORD) {
-                data2 = (uint16_t)D[addressRegister];
-                result = data + data2;
-                writeWordToAddressRegister((uint16_t)result, dataReg);
-            }
-            else {
-                data2 = D[addressRegister];
-                result = data + data2;
-                writeLongToAddressRegister(result, dataReg);
-            }
-            break;
-        case ADDRESS_MODE_ADDRESS_REGISTER_DIRECT:
-            if (DEBUG_MODE)
-                cout << "Data: " << data << endl;
-            if (size == SIZE_WORD) {
-                data2 = (uint16_t)A[addressRegister];
-                result = data + data2;
-                writeWordToAddressRegister((uint16_t)result, dataReg);
-            }
-            else {
-                data2 = A[addressRegister];
-                result = data + data2;
-                writeLongToAddressRegister(result, dataReg);
-            }
-            break;
-        case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT:
-            if (size == SIZE_WORD) {
-                data2 = memory->readWordFromMemory(A[addressRegister]);
-                result = data + data2;
-                writeWordToAddressRegister(result, dataReg);
-            }
-            else {
-                data2 = memory->readLongFromMemory(A[addressRegister]);
-                result = data + data2;
-                writeLongToAddressRegister(result, dataReg);
-            }
-            break;
-        case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_POSTINCREMENT:
-            if (size == SIZE_WORD) {
-                data2 = memory->readWordFromMemory(A[addressRegister]);
-                result = data + data2;
-                writeWordToAddressRegister(result, dataReg);
-                A[addressRegister] += 2;
-            }
-            else {
-                data2 = memory->readLongFromMemory(A[addressRegister]);
-                result = data + data2;
-                writeLongToAddressRegister(result, dataReg);
-                A[addressRegister] += 4;
-            }
-            break;
-        case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_PREDECREMENT:
-            if (size == SIZE_WORD) {
-                A[addressRegister] -= 2;
-                data2 = memory->readWordFromMemory(A[addressRegister]);
-                result = data + data2;
-                writeWordToAddressRegister(result, dataReg);
-            }
-            else {
-                A[addressRegister] -= 4;
-                data2 = memory->readLongFromMemory(A[addressRegister]);
-                result = data + data2;
-                writeLongToAddressRegister(result, dataReg);
-            }
-            break;
-        case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_DISPLACEMENT:
-            PC += 2;
-            displacement = memory->readWordFromMemory(PC);
-            if (DEBUG_MODE)
-                cout << "Displacement: " << displacement << endl;
-            if (size == SIZE_WORD) {
-                data2 = memory->readWordFromMemory(A[addressRegister], displacement);
-                result = data + data2;
-                writeWordToAddressRegister(result, dataReg);
-            }
-            else {
-                data2 = memory->readLongFromMemory(A[addressRegister], displacement);
-                result = data + data2;
-                writeLongToAddressRegister(result, dataReg);
-            }
-            break;
-        case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_INDEX:
-            PC += 2;
-            indexRegister = (memory->readByteFromMemory(PC) >> 4) & 0x0F;
-            indexSize = memory->readByteFromMemory(PC) & 0x0F;
-            longDisplacement = memory->readByteFromMemory(PC + 1);
-            if (indexRegister <= 7) {
-                if (indexSize == INDEX_SIZE_WORD) {
-                    longDisplacement += (int16_t)D[indexRegister];
-                }
-                else
-                    longDisplacement += D[indexRegister];
-            }
-            else {
-                if (indexSize == INDEX_SIZE_WORD) {
-                    longDisplacement += (int16_t)A[indexRegister - 8];
-                }
-                else
-                    longDisplacement += D[indexRegister - 8];
-            }
-            if (size == SIZE_WORD) {
-                data2 = memory->readWordFromMemory(A[addressRegister], longDisplacement);
-                result = data + data2;
-                writeWordToAddressRegister(result, dataReg);
-            }
-            else {
-                data2 = memory->readLongFromMemory(A[addressRegister], longDisplacement);
-                result = data + data2;
-                writeLongToAddressRegister(result, dataReg);
-            }
-            break;
-        case ADDRESS_MODE_OTHERS:
-            switch (addressRegister) {
-            case ADDRESS_MODE_ABSOLUTE_SHORT:
-                PC += 2;
-                absoluteAddress = memory->readWordFromMemory(PC);
-                if (size == SIZE_WORD) {
-                    data2 = memory->readWordFromMemory(absoluteAddress);
-                    result = data + data2;
-                    writeWordToAddressRegister(result, dataReg);
-                }
-                else {
-                    data2 = memory->readLongFromMemory(absoluteAddress);
-                    result = data + data2;
-                    writeLongToAddressRegister(result, dataReg);
-                }
-                break;
-            case ADDRESS_MODE_ABSOLUTE_LONG:
-                PC += 2;
-                absoluteAddress = memory->readLongFromMemory(PC);
-                if (size == SIZE_WORD) {
-                    data2 = memory->readWordFromMemory(absoluteAddress);
-                    result = data + data2;
-                    writeWordToAddressRegister(result, dataReg);
-                }
-                else {
-                    data2 = memory->readLongFromMemory(absoluteAddress);
-                    result = data + data2;
-                    writeLongToAddressRegister(result, dataReg);
-                }
-                PC += 2;
-                break;
-            case ADDRESS_MODE_PROGRAM_COUNTER_WITH_DISPLACEMENT:
-                PC += 2;
-                displacement = memory->readWordFromMemory(PC);
-                if (DEBUG_MODE)
-                    cout << "Displacement: " << displacement << endl;
-                if (size == SIZE_WORD) {
-                    data2 = memory->readWordFromMemory(PC, displacement);
-                    result = data + data2;
-                    writeWordToAddressRegister(result, dataReg);
-                }
-                else if (size == SIZE_LONG) {
-                    data2 = memory->readLongFromMemory(PC, displacement);
-                    result = data + data2;
-                    writeLongToAddressRegister(result, dataReg);
-                    PC += 2;
-                }
-                break;
-            case ADDRESS_MODE_PROGRAM_COUNTER_WITH_INDEX:
-                PC += 2;
-                indexRegister = (memory->readByteFromMemory(PC) >> 4) & 0x0F;
-                indexSize = memory->readByteFromMemory(PC) & 0x0F;
-                longDisplacement = memory->readByteFromMemory(PC + 1);
-                if (indexRegister <= 7) {
-                    if (indexSize == INDEX_SIZE_WORD) {
-                        longDisplacement += (int16_t)D[indexRegister];
-                    }
-                    else
-                        longDisplacement += D[indexRegister];
-                }
-                else {
-                    if (indexSize == INDEX_SIZE_WORD) {
-                        longDisplacement += (int16_t)A[indexRegister - 8];
-                    }
-                    else
-                        longDisplacement += D[indexRegister - 8];
-                }
-                if (size == SIZE_WORD) {
-                    data2 = memory->readWordFromMemory(PC, longDisplacement);
-                    result = data + data2;
-                    writeWordToAddressRegister(result, dataReg);
-                }
-                else if (size == SIZE_LONG) {
-                    data2 = memory->readLongFromMemory(PC, longDisplacement);
-                    result = data + data2;
-                    writeLongToAddressRegister(result, dataReg);
-                    PC += 2;
-                }
-                break;
-            case ADDRESS_MODE_IMMEDIATE_OR_STATUS_REGISTER:
-                PC += 2;
-                if (size == SIZE_WORD) {
-                    data2 = memory->readWordFromMemory(PC);
-                    result = data + data2;
-                    writeWordToAddressRegister(result, dataReg);
-                }
-                else if (size == SIZE_LONG) {
-                    data2 = memory->readLongFromMemory(PC);
-                    result = data + data2;
-                    writeLongToAddressRegister(result, dataReg);
-                    PC += 2;
-                }
-                break;
-            default:
-                cout << "Invalid addressing mode" << endl;
-                return false;
-                break;
-            }
-            break;
+// CLR (Clear an Operand)
+template<int Size, int Mode>
+bool CPUCore::executeCLR(uint16_t instruction)
+{
+    writeOperand<Size, Mode>(0, instruction & 7);
+    setLogicalFlags<Size>(0);
+    return true;
+}
 
-        default:
-            cout << "Unrecognised addressing mode" << endl;
-            return false;
-            break;
-        }
+// JMP (Jump)
+template<int Mode>
+bool CPUCore::executeJMP(uint16_t instruction)
+{
+    PC = effectiveAddress<SIZE_LONG, Mode>(instruction & 7);
+    return true;
+}
+
+// MOVE/MOVEA (Move data from source to destination)
+template<int Size, int SourceMode, int DestinationMode>
+bool CPUCore::executeMOVE(uint16_t instruction)
+{
+    uint32_t data = readOperand<Size, SourceMode>(instruction & 7);
 
+    if (DestinationMode == ADDRESS_MODE_ADDRESS_REGISTER_DIRECT) {
+        // MOVEA sign extends words and leaves the condition codes alone
+        A[(instruction >> 9) & 7] = Size == SIZE_WORD ? (int16_t)data : data;
         return true;
     }
 
-    // ADDI (Add Immediate)
-    if ((instruction & 0xFF00) == ADDI) {
-        int size = (instruction >> 6) & 3;
+    writeOperand<Size, DestinationMode>(data, (instruction >> 9) & 7);
+    setLogicalFlags<Size>(data);
+    return true;
+}
 
-        int mode = ((instruction >> 3) & 7);
-        int destinationReg = (instruction & 7);
+// MOVEQ (Move quick)
+bool CPUCore::executeMOVEQ(uint16_t instruction)
+{
+    uint32_t data = (int8_t)(instruction & 0xFF);
+    writeLongToDataRegister(data, (instruction >> 9) & 7);
+    setLogicalFlags<SIZE_LONG>(data);
+    return true;
+}
 
-        if (DEBUG_MODE) {
-            cout << "WE HAVE AN ADD IMMEDIATE" << endl;
-            cout << "Mode is: " << mode << endl;
-            cout << "Destination address register is: " << destinationReg << endl << endl;
-        }
+// TRAP
+bool CPUCore::executeTRAP(uint16_t instruction)
+{
+    uint8_t vector = instruction & 15;
+    if (tracing)
+        cout << "TRAP" << endl;
+
+    // TRAP #15 provides the EASy68K I/O tasks, unless the host has bound a handler of its own to it
+    if (vector == 15)
+        return easy68kTask();
+    return exception(VECTOR_TRAP + vector, PC);
+}
 
-        PC += 2;
+// Runs the EASy68K I/O task numbered in D0.B for TRAP #15
+bool CPUCore::easy68kTask()
+{
+    /* IO (Compatible with Easy68k)
+    0	 Display string at (A1), D1.W bytes long (max 255) with carriage return and line feed (CR, LF). (see task 13)
+    1	 Display string at (A1), D1.W bytes long (max 255) without CR, LF. (see task 14)
+    2	 Read string from keyboard and store at (A1), NULL terminated, length retuned in D1.W (max 80)
+    3	 Display signed number in D1.L in decimal in smallest field. (see task 15 & 20)
+    4	 Read a number from the keyboard into D1.L.
+    5	 Read single character from the keyboard into D1.B.
+    6	 Display single character in D1.B.
+    7
+    Set D1.B to 1 if keyboard input is pending, otherwise set to 0.
+    Use code 5 to read pending key.
+
+    8	 Return time in hundredths of a second since midnight in D1.L.
+    9	 Terminate the program. (Halts the simulator)
+    10
+    Print the NULL terminated string at (A1) to the default printer. (Not Teesside compatible.)
+    Always send a Form Feed character to end printing. (See below.)
+    11
+    Position the cursor at ROW, COL.
+    The high byte of D1.W holds the COL number (0-79),
+    The low byte holds the ROW number (0-31).
+    0,0 is top left 79,31 is the bottom right.
+    Out of range coordinates are ignored.
+    Clear Screen : Set D1.W to $FF00.
+    12
+    Keyboard Echo.
+    D1.B = 0 to turn off keyboard echo.
+    D1.B = non zero to enable it (default).
+    Echo is restored on 'Reset' or when a new file is loaded.
+    13	 Display the NULL terminated string at (A1) with CR, LF.
+    14	 Display the NULL terminated string at (A1) without CR, LF.
+    15
+    Display the unsigned number in D1.L converted to number base (2 through 36) contained in D2.B.
+    For example, to display D1.L in base16 put 16 in D2.B
+    Values of D2.B outside the range 2 to 36 inclusive are ignored.
+    16	 Adjust display properties
+    D1.B = 0 to turn off the display of the input prompt.
+    D1.B = 1 to turn on the display of the input prompt. (default)
+    D1.B = 2 do not display a line feed when Enter pressed during Trap task #2 input
+    D1.B = 3 display a line feed when Enter key pressed during Trap task #2 input (default)
+    Other values of D1 reserved for future use.
+    Input prompt display is enabled by default and by 'Reset' or when a new file is loaded.
+    17
+    Combination of Trap codes 14 & 3.
+    Display the NULL terminated string at (A1) without CR, LF then
+    Display the decimal number in D1.L.
+    18	 Combination of Trap codes 14 & 4.
+    Display the NULL terminated string at (A1) without CR, LF then
+    Read a number from the keyboard into D1.L.
+    19	 Returns current state of up to 4 specified keys or returns key scan code.
+    Pre: D1.L = four 1-byte key codes
+    Post: D1.L contains four 1-byte Booleans.
+    $FF = corresponding key is pressed, $00 = corresponding key not pressed.
+    Pre: D1.L = $00000000
+    Post: D1.B contains key code of last key pressed
+    20	 Display signed number in D1.L in decimal in field D2.B columns wide.
+    21	 Set Font Color
+    D1.L = color as $00BBGGRR
+    BB is amount of blue from $00 to $FF
+    GG is amount of green from $00 to $FF
+    RR is amount of red from $00 to $FF
+    D2.B = style by bits,  0 = off, 1 = on
+    bit0 is Bold
+    bit1 is Italic
+    bit2 is Underline
+    bit3 is StrikeOut
+    22
+    Read char at Row,Col of text screen.
+    Pre: D1.L = High 16 bits = Row
+    Low 16 bits = Col
+    Post: D1.B contains ASCII code of character.
+    */
+    switch (D[0] & 0xFF) {
+    case 0:
+    {
+        int length = (uint16_t)D[1];
+        for (int i = 0; i < length; i++)
+            cout << memory->readByteFromMemory(A[1], i);
+        cout << endl;
+        break;
+    }
+    case 1:
+    {
+        int length = (uint16_t)D[1];
+        for (int i = 0; i < length; i++)
+            cout << memory->readByteFromMemory(A[1], i);
+        break;
+    }
+    case 2:
+    {
+        if (!waitForInput && input->rdbuf()->in_avail() <= 0)
+            return awaitInput();
+        string inputString;
+        *input >> inputString;
 
-        if (size == SIZE_BYTE) {
-            data = memory->readByteFromMemory(PC + 1);
-            mostSignificantBitSource = (data >> 7) & 1;
-        }
-        else if (size == SIZE_WORD) {
-            data = memory->readWordFromMemory(PC);
-            mostSignificantBitSource = (data >> 15) & 1;
-        }
-        else {
-            data = memory->readLongFromMemory(PC);
-            mostSignificantBitSource = (data >> 31) & 1;
-            PC += 2;
-        }
+        writeWordToDataRegister((uint16_t)inputString.length(), 1);
 
-        switch (mode) {
-        case ADDRESS_MODE_DATA_REGISTER_DIRECT:
-            if (DEBUG_MODE)
-                cout << "Data: " << data << endl;
-            if (size == SIZE_BYTE) {
-                data2 = (uint8_t)D[destinationReg];
-                mostSignificantBitDestination = (data2 >> 7) & 1;
-                result = data + data2;
-                mostSignificantBitResult = (result >> 7) & 1;
-                writeByteToDataRegister((uint8_t)result, destinationReg);
-            }
-            else if (size == SIZE_WORD) {
-                data2 = (uint16_t)D[destinationReg];
-                mostSignificantBitDestination = (data2 >> 15) & 1;
-                result = data + data2;
-                mostSignificantBitResult = (result >> 15) & 1;
-                writeWordToDataRegister((uint16_t)result, destinationReg);
-            }
-            else {
-                data2 = D[destinationReg];
-                mostSignificantBitDestination = (data2 >> 31) & 1;
-                result = data + data2;
-                mostSignificantBitResult = (result >> 31) & 1;
-                writeLongToDataRegister(result, destinationReg);
-            }
-            
-            break;
-        case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT:
-            if (size == SIZE_BYTE) {
-                data2 = memory->readByteFromMemory(A[destinationReg]);
-                mostSignificantBitDestination = (data2 >> 7) & 1;
-                result = data + data2;
-                mostSignificantBitResult = (result >> 7) & 1;
-                memory->writeByteToMemory(result, A[destinationReg]);
-            }
-            else if (size == SIZE_WORD) {
-                data2 = memory->readWordFromMemory(A[destinationReg]);
-                mostSignificantBitDestination = (data2 >> 15) & 1;
-                result = data + data2;
-                mostSignificantBitResult = (result >> 15) & 1;
-                memory->writeWordToMemory(result, A[destinationReg]);
-            }
-            else {
-                data2 = memory->readLongFromMemory(A[destinationReg]);
-                mostSignificantBitDestination = (data2 >> 31) & 1;
-                result = data + data2;
-                mostSignificantBitResult = (result >> 31) & 1;
-                memory->writeLongToMemory(result, A[destinationReg]);
-            }
-            break;
-        case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_POSTINCREMENT:
-            if (size == SIZE_BYTE) {
-                data2 = memory->readByteFromMemory(A[destinationReg]);
-                mostSignificantBitDestination = (data2 >> 7) & 1;
-                result = data + data2;
-                mostSignificantBitResult = (result >> 7) & 1;
-                memory->writeByteToMemory(result, A[destinationReg]);
-                A[destinationReg]++;
-            }
-            else if (size == SIZE_WORD) {
-                data2 = memory->readWordFromMemory(A[destinationReg]);
-                mostSignificantBitDestination = (data2 >> 15) & 1;
-                result = data + data2;
-                mostSignificantBitResult = (result >> 15) & 1;
-                memory->writeWordToMemory(result, A[destinationReg]);
-                A[destinationReg] += 2;
-            }
-            else {
-                data2 = memory->readLongFromMemory(A[destinationReg]);
-                mostSignificantBitDestination = (data2 >> 31) & 1;
-                result = data + data2;
-                mostSignificantBitResult = (result >> 31) & 1;
-                memory->writeLongToMemory(result, A[destinationReg]);
-                A[destinationReg] += 4;
-            }
-            break;
-        case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_PREDECREMENT:
-            if (size == SIZE_BYTE) {
-                A[destinationReg]--;
-                data2 = memory->readByteFromMemory(A[destinationReg]);
-                mostSignificantBitDestination = (data2 >> 7) & 1;
-                result = data + data2;
-                mostSignificantBitResult = (result >> 7) & 1;
-                memory->writeByteToMemory(result, A[destinationReg]);
-            }
-            else if (size == SIZE_WORD) {
-                A[destinationReg] -= 2;
-                data2 = memory->readWordFromMemory(A[destinationReg]);
-                mostSignificantBitDestination = (data2 >> 15) & 1;
-                result = data + data2;
-                mostSignificantBitResult = (result >> 15) & 1;
-                memory->writeWordToMemory(result, A[destinationReg]);
-            }
-            else {
-                A[destinationReg] -= 4;
-                data2 = memory->readLongFromMemory(A[destinationReg]);
-                mostSignificantBitDestination = (data2 >> 31) & 1;
-                result = data + data2;
-                mostSignificantBitResult = (result >> 31) & 1;
-                memory->writeLongToMemory(result, A[destinationReg]);
-            }
-            break;
-        case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_DISPLACEMENT:
-            PC += 2;
-            displacement = memory->readWordFromMemory(PC);
-            if (DEBUG_MODE)
-                cout << "Displacement: " << displacement << endl;
-            if (size == SIZE_BYTE) {
-                data2 = memory->readByteFromMemory(A[destinationReg], displacement);
-                mostSignificantBitDestination = (data2 >> 7) & 1;
-                result = data + data2;
-                mostSignificantBitResult = (result >> 7) & 1;
-                memory->writeByteToMemory(result, A[destinationReg], displacement);
-            } else if (size == SIZE_WORD) {
-                data2 = memory->readWordFromMemory(A[destinationReg], displacement);
-                mostSignificantBitDestination = (data2 >> 15) & 1;
-                result = data + data2;
-                mostSignificantBitResult = (result >> 15) & 1;
-                memory->writeWordToMemory(result, A[destinationReg], displacement);
-            } else {
-                data2 = memory->readLongFromMemory(A[destinationReg], displacement);
-                mostSignificantBitDestination = (data2 >> 31) & 1;
-                result = data + data2;
-                mostSignificantBitResult = (result >> 31) & 1;
-                memory->writeLongToMemory(result, A[destinationReg], displacement);
-            }
-            break;
-        case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_INDEX:
-            PC += 2;
-            indexRegister = (memory->readByteFromMemory(PC) >> 4) & 0x0F;
-            indexSize = memory->readByteFromMemory(PC) & 0x0F;
-            longDisplacement = memory->readByteFromMemory(PC + 1);
-            if (indexRegister <= 7) {
-                if (indexSize == INDEX_SIZE_WORD) {
-                    longDisplacement += (int16_t)D[indexRegister];
-                }
-                else
-                    longDisplacement += D[indexRegister];
-            }
-            else {
-                if (indexSize == INDEX_SIZE_WORD) {
-                    longDisplacement += (int16_t)A[indexRegister - 8];
-                }
-                else
-                    longDisplacement += D[indexRegister - 8];
-            }
-            if (size == SIZE_BYTE) {
-                data2 = memory->readByteFromMemory(A[destinationReg], longDisplacement);
-                mostSignificantBitDestination = (data2 >> 7) & 1;
-                result = data + data2;
-                mostSignificantBitResult = (result >> 7) & 1;
-                memory->writeByteToMemory(result, A[destinationReg], longDisplacement);
-            }
-            else if (size == SIZE_WORD) {
-                data2 = memory->readWordFromMemory(A[destinationReg], longDisplacement);
-                mostSignificantBitDestination = (data2 >> 15) & 1;
-                result = data + data2;
-                mostSignificantBitResult = (result >> 15) & 1;
-                memory->writeWordToMemory(result, A[destinationReg], longDisplacement);
-            }
-            else {
-                data2 = memory->readLongFromMemory(A[destinationReg], longDisplacement);
-                mostSignificantBitDestination = (data2 >> 31) & 1;
-                result = data + data2;
-                mostSignificantBitResult = (result >> 31) & 1;
-                memory->writeLongToMemory(result, A[destinationReg], longDisplacement);
-            }
-            break;
-        case ADDRESS_MODE_OTHERS:
-            switch (destinationReg) {
-            case ADDRESS_MODE_ABSOLUTE_SHORT:
-                PC += 2;
-                absoluteAddress = memory->readWordFromMemory(PC);
-                if (size == SIZE_BYTE) {
-                    data2 = memory->readByteFromMemory(absoluteAddress);
-                    mostSignificantBitDestination = (data2 >> 7) & 1;
-                    result = data + data2;
-                    mostSignificantBitResult = (result >> 7) & 1;
-                    memory->writeByteToMemory(result, absoluteAddress);
-                } else if (size == SIZE_WORD) {
-                    data2 = memory->readWordFromMemory(absoluteAddress);
-                    mostSignificantBitDestination = (data2 >> 15) & 1;
-                    result = data + data2;
-                    mostSignificantBitResult = (result >> 15) & 1;
-                    memory->writeWordToMemory(result, absoluteAddress);
-                }
-                else {
-                    data2 = memory->readLongFromMemory(absoluteAddress);
-                    mostSignificantBitDestination = (data2 >> 31) & 1;
-                    result = data + data2;
-                    mostSignificantBitResult = (result >> 31) & 1;
-                    memory->writeLongToMemory(result, absoluteAddress);
-                }
-                break;
-            case ADDRESS_MODE_ABSOLUTE_LONG:
-                PC += 2;
-                absoluteAddress = memory->readLongFromMemory(PC);
-                if (size == SIZE_BYTE) {
-                    data2 = memory->readByteFromMemory(absoluteAddress);
-                    mostSignificantBitDestination = (data2 >> 7) & 1;
-                    result = data + data2;
-                    mostSignificantBitResult = (result >> 7) & 1;
-                    memory->writeByteToMemory(result, absoluteAddress);
-                }
-                else if (size == SIZE_WORD) {
-                    data2 = memory->readWordFromMemory(absoluteAddress);
-                    mostSignificantBitDestination = (data2 >> 15) & 1;
-                    result = data + data2;
-                    mostSignificantBitResult = (result >> 15) & 1;
-                    memory->writeWordToMemory(result, absoluteAddress);
-                }
-                else {
-                    data2 = memory->readLongFromMemory(absoluteAddress);
-                    mostSignificantBitDestination = (data2 >> 31) & 1;
-                    result = data + data2;
-                    mostSignificantBitResult = (result >> 31) & 1;
-                    memory->writeLongToMemory(result, absoluteAddress);
-                }
-                PC += 2;
-                break;
-            default:
-                cout << "Invalid addressing mode" << endl;
-                return false;
-                break;
-            }
-            break;
+        int index = 0;
 
-        default:
-            cout << "Unrecognised addressing mode" << endl;
-            return false;
-            break;
+        for (char character : inputString) {
+            memory->writeByteToMemory(character, A[1], index);
+            index++;
         }
 
-        if (size == SIZE_BYTE) {
-            (uint8_t)result == 0 ? SR |= 1 << SR_CCR_ZERO : SR &= ~(1 << SR_CCR_ZERO);
-        }
-        else if (size == SIZE_WORD) {
-            (uint16_t)result == 0 ? SR |= 1 << SR_CCR_ZERO : SR &= ~(1 << SR_CCR_ZERO);
+        memory->writeByteToMemory(0, A[1], index);
+        break;
+    }
+    case 3:
+    {
+        int32_t number = D[1];
+        cout << number;
+        break;
+    }
+    case 4:
+        int number;
+        if (!waitForInput && input->rdbuf()->in_avail() <= 0)
+            return awaitInput();
+        *input >> number;
+        writeLongToDataRegister(number, 1);
+        break;
+    case 5:
+    {
+        char character;
+        if (!waitForInput && input->rdbuf()->in_avail() <= 0)
+            return awaitInput();
+        *input >> character;
+        writeByteToDataRegister(character, 1);
+        break;
+    }
+    case 6:
+        cout << (char)D[1];
+        break;
+    case 9:
+        return stopExecution(STOP_HALTED);
+        break;
+    case 11:
+    {
+        if ((uint16_t)D[1] == 0xFF00) {
+            // Clear screen
+#ifdef WIN32
+            system("cls");
+#endif
         }
         else {
-            result == 0 ? SR |= 1 << SR_CCR_ZERO : SR &= ~(1 << SR_CCR_ZERO);
+            uint16_t row = D[1] & 0xFF;
+            uint16_t column = (D[1] >> 8) & 0xFF;
+#ifdef WIN32
+            COORD coord;
+            coord.X = column;
+            coord.Y = row;
+            SetConsoleCursorPosition(
+                GetStdHandle(STD_OUTPUT_HANDLE),
+                coord
+                );
+#endif
         }
+        break;
+    }
+    case 12:
+#ifdef WIN32
+    {
+        HANDLE hStdin = GetStdHandle(STD_INPUT_HANDLE);
+        DWORD mode;
+        GetConsoleMode(hStdin, &mode);
 
-        mostSignificantBitResult == 1 ? SR |= 1 << SR_CCR_NEGATIVE : SR &= ~(1 << SR_CCR_NEGATIVE);
-        
-        if (mostSignificantBitDestination == 1 && mostSignificantBitResult == 0)
-            SR |= 1 << SR_CCR_CARRY;
+        if (D[1] == 0)
+            mode &= ~ENABLE_ECHO_INPUT;
         else
-            SR &= ~(1 << SR_CCR_CARRY);
+            mode |= ENABLE_ECHO_INPUT;
 
-        if (mostSignificantBitSource == mostSignificantBitDestination)
-            mostSignificantBitDestination != mostSignificantBitResult ? SR |= 1 << SR_CCR_OVERFLOW : SR &= ~(1 << SR_CCR_OVERFLOW);	
+        SetConsoleMode(hStdin, mode);
+    }
 
-        ((SR >> SR_CCR_CARRY) & 1) == 1 ? SR |= 1 << SR_CCR_EXTEND : SR &= ~(1 << SR_CCR_EXTEND);
+#else
+        struct termios tty;
+        tcgetattr(STDIN_FILENO, &tty);
+        if (D[1] == 0)
+            tty.c_lflag &= ~ECHO;
+        else
+            tty.c_lflag |= ECHO;
 
-        return true;
+        (void)tcsetattr(STDIN_FILENO, TCSANOW, &tty);
+#endif
+        break;
+    case 13:
+    {
+        char character = memory->readByteFromMemory(A[1]);
+        unsigned int characterIndex = 0;
+        while (character != 0) {
+            cout << character;
+            characterIndex++;
+            character = memory->readByteFromMemory(A[1] + characterIndex);
+        }
+        cout << endl;
+        break;
+    }
+    case 14:
+    {
+        char character = memory->readByteFromMemory(A[1]);
+        unsigned int characterIndex = 0;
+        while (character != 0) {
+            cout << character;
+            characterIndex++;
+            character = memory->readByteFromMemory(A[1] + characterIndex);
+        }
+        break;
     }
+    default:
+        cout << "Unknown IO task" << endl;
+        return stopExecution(STOP_ILLEGAL_INSTRUCTION);
+        break;
+    }
+    return true;
+}
 
-    // ADDQ (Add Quick)
-    if ((instruction & 0xF100) == ADDQ) {
-        int size = (instruction >> 6) & 3;
+// NOP (No Operation)
+bool CPUCore::executeNOP(uint16_t instruction)
+{
+    return true;
+}
 
-        int mode = (instruction >> 3) & 7;
-        int destinationReg = (instruction & 7);
+// LEA (Load Effective Address)
+template<int Mode>
+bool CPUCore::executeLEA(uint16_t instruction)
+{
+    A[(instruction >> 9) & 7] = effectiveAddress<SIZE_LONG, Mode>(instruction & 7);
+    return true;
+}
 
-        data = (instruction >> 9) & 7;
-        mostSignificantBitSource = (data >> 2) & 1;
+// PEA (Push Effective Address)
+template<int Mode>
+bool CPUCore::executePEA(uint16_t instruction)
+{
+    uint32_t address = effectiveAddress<SIZE_LONG, Mode>(instruction & 7);
 
-        if (DEBUG_MODE) {
-            cout << "WE HAVE AN ADD QUICK" << endl;
-            cout << "Mode is: " << mode << endl;
-            cout << "Destination address register is: " << destinationReg << endl << endl;
-        }
+    SP -= 4;
+    memory->writeLongToMemory(address, SP);
+    return true;
+}
 
-        switch (mode) {
-        case ADDRESS_MODE_DATA_REGISTER_DIRECT:
-            if (DEBUG_MODE)
-                cout << "Data: " << data << endl;
-            if (size == SIZE_BYTE) {
-                data2 = (uint8_t)D[destinationReg];
-                mostSignificantBitDestination = (data2 >> 7) & 1;
-                result = data + data2;
-                mostSignificantBitResult = (result >> 7) & 1;
-                writeByteToDataRegister((uint8_t)result, destinationReg);
-            }
-            else if (size == SIZE_WORD) {
-                data2 = (uint16_t)D[destinationReg];
-                mostSignificantBitDestination = (data2 >> 15) & 1;
-                result = data + data2;
-                mostSignificantBitResult = (result >> 15) & 1;
-                writeWordToDataRegister((uint16_t)result, destinationReg);
-            }
-            else {
-                data2 = D[destinationReg];
-                mostSignificantBitDestination = (data2 >> 31) & 1;
-                result = data + data2;
-                mostSignificantBitResult = (result >> 31) & 1;
-                writeLongToDataRegister(result, destinationReg);
-            }
-            break;
-        case ADDRESS_MODE_ADDRESS_REGISTER_DIRECT:
-            if (size == SIZE_BYTE) {
-                cout << "Invalid addressing mode." << endl;
-                return false;
-            }
-            else if (size == SIZE_WORD) {
-                data2 = (uint16_t)A[destinationReg];
-                result = data + data2;
-                writeWordToAddressRegister((uint16_t)result, destinationReg);
-            }
-            else {
-                data2 = A[destinationReg];
-                result = data + data2;
-                writeLongToAddressRegister(result, destinationReg);
-            }
-            return true;
-            break;
-        case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT:
-            if (size == SIZE_BYTE) {
-                data2 = memory->readByteFromMemory(A[destinationReg]);
-                mostSignificantBitDestination = (data2 >> 7) & 1;
-                result = data + data2;
-                mostSignificantBitResult = (result >> 7) & 1;
-                memory->writeByteToMemory(result, A[destinationReg]);
-            }
-            else if (size == SIZE_WORD) {
-                data2 = memory->readWordFromMemory(A[destinationReg]);
-                mostSignificantBitDestination = (data2 >> 15) & 1;
-                result = data + data2;
-                mostSignificantBitResult = (result >> 15) & 1;
-                memory->writeWordToMemory(result, A[destinationReg]);
-            }
-            else {
-                data2 = memory->readLongFromMemory(A[destinationReg]);
-                mostSignificantBitDestination = (data2 >> 31) & 1;
-                result = data + data2;
-                mostSignificantBitResult = (result >> 31) & 1;
-                memory->writeLongToMemory(result, A[destinationReg]);
-            }
-            break;
-        case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_POSTINCREMENT:
-            if (size == SIZE_BYTE) {
-                data2 = memory->readByteFromMemory(A[destinationReg]);
-                mostSignificantBitDestination = (data2 >> 7) & 1;
-                result = data + data2;
-                mostSignificantBitResult = (result >> 7) & 1;
-                memory->writeByteToMemory(result, A[destinationReg]);
-                A[destinationReg]++;
-            }
-            else if (size == SIZE_WORD) {
-                data2 = memory->readWordFromMemory(A[destinationReg]);
-                mostSignificantBitDestination = (data2 >> 15) & 1;
-                result = data + data2;
-                mostSignificantBitResult = (result >> 15) & 1;
-                memory->writeWordToMemory(result, A[destinationReg]);
-                A[destinationReg] += 2;
-            }
-            else {
-                data2 = memory->readLongFromMemory(A[destinationReg]);
-                mostSignificantBitDestination = (data2 >> 31) & 1;
-                result = data + data2;
-                mostSignificantBitResult = (result >> 31) & 1;
-                memory->writeLongToMemory(result, A[destinationReg]);
-                A[destinationReg] += 4;
-            }
-            break;
-        case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_PREDECREMENT:
-            if (size == SIZE_BYTE) {
-                A[destinationReg]--;
-                data2 = memory->readByteFromMemory(A[destinationReg]);
-                mostSignificantBitDestination = (data2 >> 7) & 1;
-                result = data + data2;
-                mostSignificantBitResult = (result >> 7) & 1;
-                memory->writeByteToMemory(result, A[destinationReg]);
-            }
-            else if (size == SIZE_WORD) {
-                A[destinationReg] -= 2;
-                data2 = memory->readWordFromMemory(A[destinationReg]);
-                mostSignificantBitDestination = (data2 >> 15) & 1;
-                result = data + data2;
-                mostSignificantBitResult = (result >> 15) & 1;
-                memory->writeWordToMemory(result, A[destinationReg]);
-            }
-            else {
-                A[destinationReg] -= 4;
-                data2 = memory->readLongFromMemory(A[destinationReg]);
-                mostSignificantBitDestination = (data2 >> 31) & 1;
-                result = data + data2;
-                mostSignificantBitResult = (result >> 31) & 1;
-                memory->writeLongToMemory(result, A[destinationReg]);
-            }
-            break;
-        case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_DISPLACEMENT:
-            PC += 2;
-            displacement = memory->readWordFromMemory(PC);
-            if (DEBUG_MODE)
-                cout << "Displacement: " << displacement << endl;
-            if (size == SIZE_BYTE) {
-                data2 = memory->readByteFromMemory(A[destinationReg], displacement);
-                mostSignificantBitDestination = (data2 >> 7) & 1;
-                result = data + data2;
-                mostSignificantBitResult = (result >> 7) & 1;
-                memory->writeByteToMemory(result, A[destinationReg], displacement);
-            }
-            else if (size == SIZE_WORD) {
-                data2 = memory->readWordFromMemory(A[destinationReg], displacement);
-                mostSignificantBitDestination = (data2 >> 15) & 1;
-                result = data + data2;
-                mostSignificantBitResult = (result >> 15) & 1;
-                memory->writeWordToMemory(result, A[destinationReg], displacement);
-            }
-            else {
-                data2 = memory->readLongFromMemory(A[destinationReg], displacement);
-                mostSignificantBitDestination = (data2 >> 31) & 1;
-                result = data + data2;
-                mostSignificantBitResult = (result >> 31) & 1;
-                memory->writeLongToMemory(result, A[destinationReg], displacement);
-            }
-            break;
-        case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_INDEX:
-            PC += 2;
-            indexRegister = (memory->readByteFromMemory(PC) >> 4) & 0x0F;
-            indexSize = memory->readByteFromMemory(PC) & 0x0F;
-            longDisplacement = memory->readByteFromMemory(PC + 1);
-            if (indexRegister <= 7) {
-                if (indexSize == INDEX_SIZE_WORD) {
-                    longDisplacement += (int16_t)D[indexRegister];
-                }
-                else
-                    longDisplacement += D[indexRegister];
-            }
-            else {
-                if (indexSize == INDEX_SIZE_WORD) {
-                    longDisplacement += (int16_t)A[indexRegister - 8];
-                }
-                else
-                    longDisplacement += D[indexRegister - 8];
-            }
-            if (size == SIZE_BYTE) {
-                data2 = memory->readByteFromMemory(A[destinationReg], longDisplacement);
-                mostSignificantBitDestination = (data2 >> 7) & 1;
-                result = data + data2;
-                mostSignificantBitResult = (result >> 7) & 1;
-                memory->writeByteToMemory(result, A[destinationReg], longDisplacement);
-            }
-            else if (size == SIZE_WORD) {
-                data2 = memory->readWordFromMemory(A[destinationReg], longDisplacement);
-                mostSignificantBitDestination = (data2 >> 15) & 1;
-                result = data + data2;
-                mostSignificantBitResult = (result >> 15) & 1;
-                memory->writeWordToMemory(result, A[destinationReg], longDisplacement);
-            }
-            else {
-                data2 = memory->readLongFromMemory(A[destinationReg], longDisplacement);
-                mostSignificantBitDestination = (data2 >> 31) & 1;
-                result = data + data2;
-                mostSignificantBitResult = (result >> 31) & 1;
-                memory->writeLongToMemory(result, A[destinationReg], longDisplacement);
-            }
-            break;
-        case ADDRESS_MODE_OTHERS:
-            switch (destinationReg) {
-            case ADDRESS_MODE_ABSOLUTE_SHORT:
-                PC += 2;
-                absoluteAddress = memory->readWordFromMemory(PC);
-                if (size == SIZE_BYTE) {
-                    data2 = memory->readByteFromMemory(absoluteAddress);
-                    mostSignificantBitDestination = (data2 >> 7) & 1;
-                    result = data + data2;
-                    mostSignificantBitResult = (result >> 7) & 1;
-                    memory->writeByteToMemory(result, absoluteAddress);
-                }
-                else if (size == SIZE_WORD) {
-                    data2 = memory->readWordFromMemory(absoluteAddress);
-                    mostSignificantBitDestination = (data2 >> 15) & 1;
-                    result = data + data2;
-                    mostSignificantBitResult = (result >> 15) & 1;
-                    memory->writeWordToMemory(result, absoluteAddress);
-                }
-                else {
-                    data2 = memory->readLongFromMemory(absoluteAddress);
-                    mostSignificantBitDestination = (data2 >> 31) & 1;
-                    result = data + data2;
-                    mostSignificantBitResult = (result >> 31) & 1;
-                    memory->writeLongToMemory(result, absoluteAddress);
-                }
-                break;
-            case ADDRESS_MODE_ABSOLUTE_LONG:
-                PC += 2;
-                absoluteAddress = memory->readLongFromMemory(PC);
-                if (size == SIZE_BYTE) {
-                    data2 = memory->readByteFromMemory(absoluteAddress);
-                    mostSignificantBitDestination = (data2 >> 7) & 1;
-                    result = data + data2;
-                    mostSignificantBitResult = (result >> 7) & 1;
-                    memory->writeByteToMemory(result, absoluteAddress);
-                }
-                else if (size == SIZE_WORD) {
-                    data2 = memory->readWordFromMemory(absoluteAddress);
-                    mostSignificantBitDestination = (data2 >> 15) & 1;
-                    result = data + data2;
-                    mostSignificantBitResult = (result >> 15) & 1;
-                    memory->writeWordToMemory(result, absoluteAddress);
-                }
-                else {
-                    data2 = memory->readLongFromMemory(absoluteAddress);
-                    mostSignificantBitDestination = (data2 >> 31) & 1;
-                    result = data + data2;
-                    mostSignificantBitResult = (result >> 31) & 1;
-                    memory->writeLongToMemory(result, absoluteAddress);
-                }
-                PC += 2;
-                break;
-            default:
-                cout << "Invalid addressing mode" << endl;
-                return false;
-                break;
-            }
-            break;
+// ADD/SUB/CMP <ea>,Dn
+template<int Operation, int Size, int SourceMode>
+bool CPUCore::executeArithmeticToRegister(uint16_t instruction)
+{
+    int reg = (instruction >> 9) & 7;
+    uint32_t result = arithmetic<Operation, Size>(readOperand<Size, SourceMode>(instruction & 7), D[reg]);
+
+    if (Operation != OPERATION_CMP)
+        writeDataRegister<Size>(result, reg);
+    return true;
+}
+
+// ADD/SUB Dn,<ea>
+template<int Operation, int Size, int DestinationMode>
+bool CPUCore::executeArithmeticToMemory(uint16_t instruction)
+{
+    Operand destination = resolveOperand<Size, DestinationMode>(instruction & 7);
+    uint32_t result = arithmetic<Operation, Size>(D[(instruction >> 9) & 7], readOperand<Size, DestinationMode>(destination));
+    writeOperand<Size, DestinationMode>(destination, result);
+    return true;
+}
+
+// ADDA/SUBA/CMPA (Word sources are sign extended and the whole address register is used)
+template<int Operation, int Size, int SourceMode>
+bool CPUCore::executeArithmeticToAddress(uint16_t instruction)
+{
+    int reg = (instruction >> 9) & 7;
+    uint32_t source = readOperand<Size, SourceMode>(instruction & 7);
+
+    if (Size == SIZE_WORD)
+        source = (int16_t)source;
+
+    if (Operation == OPERATION_ADD)
+        A[reg] += source;
+    else if (Operation == OPERATION_SUB)
+        A[reg] -= source;
+    else
+        arithmetic<OPERATION_CMP, SIZE_LONG>(source, A[reg]);
+    return true;
+}
+
+// Applies an ADD, SUB or CMP with a source value to a destination operand, updating the condition codes
+template<int Operation, int Size, int DestinationMode>
+void CPUCore::arithmeticToOperand(uint32_t source, int reg)
+{
+    Operand destination = resolveOperand<Size, DestinationMode>(reg);
+
+    if (DestinationMode == ADDRESS_MODE_ADDRESS_REGISTER_DIRECT) {
+        // Address registers are always changed in full and the condition codes are left alone
+        if (Operation == OPERATION_ADD)
+            *destination.reg += source;
+        else
+            *destination.reg -= source;
+    }
+    else {
+        uint32_t result = arithmetic<Operation, Size>(source, readOperand<Size, DestinationMode>(destination));
+        if (Operation != OPERATION_CMP)
+            writeOperand<Size, DestinationMode>(destination, result);
+    }
+}
+
+// ADDI/SUBI/CMPI (Add, subtract or compare immediate)
+template<int Operation, int Size, int DestinationMode>
+bool CPUCore::executeArithmeticImmediate(uint16_t instruction)
+{
+    uint32_t source = readOperand<Size, EA_IMMEDIATE>(0);
+    arithmeticToOperand<Operation, Size, DestinationMode>(source, instruction & 7);
+    return true;
+}
 
-        default:
-            cout << "Unrecognised addressing mode" << endl;
-            return false;
-            break;
-        }
+// ADDQ/SUBQ (Add or subtract quick, 1 to 8)
+template<int Operation, int Size, int DestinationMode>
+bool CPUCore::executeArithmeticQuick(uint16_t instruction)
+{
+    uint32_t source = (instruction >> 9) & 7;
 
-        if (size == SIZE_BYTE) {
-            (uint8_t)result == 0 ? SR |= 1 << SR_CCR_ZERO : SR &= ~(1 << SR_CCR_ZERO);
-        }
-        else if (size == SIZE_WORD) {
-            (uint16_t)result == 0 ? SR |= 1 << SR_CCR_ZERO : SR &= ~(1 << SR_CCR_ZERO);
-        }
-        else {
-            result == 0 ? SR |= 1 << SR_CCR_ZERO : SR &= ~(1 << SR_CCR_ZERO);
-        }
+    if (source == 0)
+        source = 8;
 
-        mostSignificantBitResult == 1 ? SR |= 1 << SR_CCR_NEGATIVE : SR &= ~(1 << SR_CCR_NEGATIVE);
+    arithmeticToOperand<Operation, Size, DestinationMode>(source, instruction & 7);
+    return true;
+}
 
-        if (mostSignificantBitDestination == 1 && mostSignificantBitResult == 0)
-            SR |= 1 << SR_CCR_CARRY;
-        else
-            SR &= ~(1 << SR_CCR_CARRY);
+// ADDX/SUBX Dy,Dx and -(Ay),-(Ax) (Add or subtract with extend)
+template<int Operation, int Size, int Mode>
+bool CPUCore::executeExtendedArithmetic(uint16_t instruction)
+{
+    uint32_t source = readOperand<Size, Mode>(instruction & 7);
+    Operand destination = resolveOperand<Size, Mode>((instruction >> 9) & 7);
+    uint32_t result = extendedArithmetic<Operation, Size>(source, readOperand<Size, Mode>(destination));
 
-        if (mostSignificantBitSource == mostSignificantBitDestination)
-            mostSignificantBitDestination != mostSignificantBitResult ? SR |= 1 << SR_CCR_OVERFLOW : SR &= ~(1 << SR_CCR_OVERFLOW);
+    writeOperand<Size, Mode>(destination, result);
+    return true;
+}
 
-        ((SR >> SR_CCR_CARRY) & 1) == 1 ? SR |= 1 << SR_CCR_EXTEND : SR &= ~(1 << SR_CCR_EXTEND);
+// CMPM (Ay)+,(Ax)+ (Compare memory)
+template<int Size>
+bool CPUCore::executeCMPM(uint16_t instruction)
+{
+    uint32_t source = readOperand<Size, ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_POSTINCREMENT>(instruction & 7);
+    uint32_t destination = readOperand<Size, ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_POSTINCREMENT>((instruction >> 9) & 7);
 
-        return true;
-    }
+    arithmetic<OPERATION_CMP, Size>(source, destination);
+    return true;
+}
 
-    // CMP (Compare)
-    if (((instruction & 0xF1C0) == CMP_B) || ((instruction & 0xF1C0) == CMP_W) || ((instruction & 0xF1C0) == CMP_L)) {
-        int size = (instruction >> 6) & 7;
-        int mode = (instruction >> 3) & 7;
-        int dataReg = (instruction >> 9) & 7;
-        int addressRegister = instruction & 7;
-
-        if (DEBUG_MODE) {
-            cout << "WE HAVE A COMPARE" << endl;
-            cout << "Mode is: " << mode << endl;
-            cout << "Data register is: " << dataReg << endl;
-            cout << "Address register is: " << addressRegister << endl;
-        }
+// AND/OR <ea>,Dn
+template<int Operation, int Size, int SourceMode>
+bool CPUCore::executeLogicalToRegister(uint16_t instruction)
+{
+    logicalToOperand<Operation, Size, ADDRESS_MODE_DATA_REGISTER_DIRECT>(readOperand<Size, SourceMode>(instruction & 7), (instruction >> 9) & 7);
+    return true;
+}
 
-        if (size == SIZE_BYTE) {
-            data = (uint8_t)D[dataReg];
-            mostSignificantBitDestination = (data >> 7) & 1;
-        }
-        else if (size == SIZE_WORD) {
-            data = (uint16_t)D[dataReg];
-            mostSignificantBitDestination = (data >> 15) & 1;
-        }
-        else {
-            data = D[dataReg];
-            mostSignificantBitDestination = (data >> 31) & 1;
-        }
+// AND/OR/EOR Dn,<ea>
+template<int Operation, int Size, int DestinationMode>
+bool CPUCore::executeLogicalFromRegister(uint16_t instruction)
+{
+    logicalToOperand<Operation, Size, DestinationMode>(D[(instruction >> 9) & 7], instruction & 7);
+    return true;
+}
 
-        switch (mode) {
-        case ADDRESS_MODE_DATA_REGISTER_DIRECT:
-            if (DEBUG_MODE)
-                cout << "Data: " << data << endl;
-            if (size == SIZE_BYTE) {
-                data2 = (uint8_t)D[addressRegister];
-                result = data - data2;
-                mostSignificantBitResult = (result >> 7) & 1;
-                mostSignificantBitSource = (data2 >> 7) & 1;
-            }
-            else if (size == SIZE_WORD) {
-                data2 = (uint16_t)D[addressRegister];
-                result = data - data2;
-                mostSignificantBitResult = (result >> 15) & 1;
-                mostSignificantBitSource = (data2 >> 15) & 1;
-            }
-            else {
-                data2 = D[addressRegister];
-                result = data - data2;
-                mostSignificantBitResult = (result >> 31) & 1;
-                mostSignificantBitSource = (data2 >> 31) & 1;
-            }
-            break;
-        case ADDRESS_MODE_ADDRESS_REGISTER_DIRECT:
-            if (DEBUG_MODE)
-                cout << "Data: " << data << endl;
-            if (size == SIZE_BYTE) {
-                cout << "Invalid addressing mode." << endl;
-                return false;
-            }
-            else if (size == SIZE_WORD) {
-                data2 = (uint16_t)A[addressRegister];
-                result = data - data2;
-                mostSignificantBitResult = (result >> 15) & 1;
-                mostSignificantBitSource = (data2 >> 15) & 1;
-            }
-            else {
-                data2 = A[addressRegister];
-                result = data - data2;
-                mostSignificantBitResult = (result >> 31) & 1;
-                mostSignificantBitSource = (data2 >> 31) & 1;
-            }
-            break;
-        case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT:
-            if (size == SIZE_BYTE) {
-                data2 = memory->readByteFromMemory(A[addressRegister]);
-                result = data - data2;
-                mostSignificantBitResult = (result >> 7) & 1;
-                mostSignificantBitSource = (data2 >> 7) & 1;
-            }
-            else if (size == SIZE_WORD) {
-                data2 = memory->readWordFromMemory(A[addressRegister]);
-                result = data - data2;
-                mostSignificantBitResult = (result >> 15) & 1;
-                mostSignificantBitSource = (data2 >> 15) & 1;
-            }
-            else {
-                data2 = memory->readLongFromMemory(A[addressRegister]);
-                result = data - data2;
-                mostSignificantBitResult = (result >> 31) & 1;
-                mostSignificantBitSource = (data2 >> 31) & 1;
-            }
-            break;
-        case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_POSTINCREMENT:
-            if (size == SIZE_BYTE) {
-                data2 = memory->readByteFromMemory(A[addressRegister]);
-                result = data - data2;
-                mostSignificantBitResult = (result >> 7) & 1;
-                mostSignificantBitSource = (data2 >> 7) & 1;
-                A[addressRegister]++;
-            }
-            else if (size == SIZE_WORD) {
-                data2 = memory->readWordFromMemory(A[addressRegister]);
-                result = data - data2;
-                mostSignificantBitResult = (result >> 15) & 1;
-                mostSignificantBitSource = (data2 >> 15) & 1;
-                A[addressRegister] += 2;
-            }
-            else {
-                data2 = memory->readLongFromMemory(A[addressRegister]);
-                result = data - data2;
-                mostSignificantBitResult = (result >> 31) & 1;
-                mostSignificantBitSource = (data2 >> 31) & 1;
-                A[addressRegister] += 4;
-            }
-            break;
-        case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_PREDECREMENT:
-            if (size == SIZE_BYTE) {
-                A[addressRegister]--;
-                data2 = memory->readByteFromMemory(A[addressRegister]);
-                result = data - data2;
-                mostSignificantBitResult = (result >> 7) & 1;
-                mostSignificantBitSource = (data2 >> 7) & 1;
-            }
-            else if (size == SIZE_WORD) {
-                A[addressRegister] -= 2;
-                data2 = memory->readWordFromMemory(A[addressRegister]);
-                result = data - data2;
-                mostSignificantBitResult = (result >> 15) & 1;
-                mostSignificantBitSource = (data2 >> 15) & 1;
-            }
-            else {
-                A[addressRegister] -= 4;
-                data2 = memory->readLongFromMemory(A[addressRegister]);
-                result = data - data2;
-                mostSignificantBitResult = (result >> 31) & 1;
-                mostSignificantBitSource = (data2 >> 31) & 1;
-            }
-            break;
-        case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_DISPLACEMENT:
-            PC += 2;
-            displacement = memory->readWordFromMemory(PC);
-            if (DEBUG_MODE)
-                cout << "Displacement: " << displacement << endl;
-            if (size == SIZE_BYTE) {
-                data2 = memory->readByteFromMemory(A[addressRegister], displacement);
-                result = data - data2;
-                mostSignificantBitResult = (result >> 7) & 1;
-                mostSignificantBitSource = (data2 >> 7) & 1;
-            }
-            else if (size == SIZE_WORD) {
-                data2 = memory->readWordFromMemory(A[addressRegister], displacement);
-                result = data - data2;
-                mostSignificantBitResult = (result >> 15) & 1;
-                mostSignificantBitSource = (data2 >> 15) & 1;
-            }
-            else {
-                data2 = memory->readLongFromMemory(A[addressRegister], displacement);
-                result = data - data2;
-                mostSignificantBitResult = (result >> 31) & 1;
-                mostSignificantBitSource = (data2 >> 31) & 1;
-            }
-            break;
-        case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_INDEX:
-            PC += 2;
-            indexRegister = (memory->readByteFromMemory(PC) >> 4) & 0x0F;
-            indexSize = memory->readByteFromMemory(PC) & 0x0F;
-            longDisplacement = memory->readByteFromMemory(PC + 1);
-            if (indexRegister <= 7) {
-                if (indexSize == INDEX_SIZE_WORD) {
-                    longDisplacement += (int16_t)D[indexRegister];
-                }
-                else
-                    longDisplacement += D[indexRegister];
-            }
-            else {
-                if (indexSize == INDEX_SIZE_WORD) {
-                    longDisplacement += (int16_t)A[indexRegister - 8];
-                }
-                else
-                    longDisplacement += D[indexRegister - 8];
-            }
-            if (size == SIZE_BYTE) {
-                data2 = memory->readByteFromMemory(A[addressRegister], longDisplacement);
-                result = data - data2;
-                mostSignificantBitResult = (result >> 7) & 1;
-                mostSignificantBitSource = (data2 >> 7) & 1;
-            }
-            else if (size == SIZE_WORD) {
-                data2 = memory->readWordFromMemory(A[addressRegister], longDisplacement);
-                result = data - data2;
-                mostSignificantBitResult = (result >> 15) & 1;
-                mostSignificantBitSource = (data2 >> 15) & 1;
-            }
-            else {
-                data2 = memory->readLongFromMemory(A[addressRegister], longDisplacement);
-                result = data - data2;
-                mostSignificantBitResult = (result >> 31) & 1;
-                mostSignificantBitSource = (data2 >> 31) & 1;
-            }
-            break;
-        case ADDRESS_MODE_OTHERS:
-            switch (addressRegister) {
-            case ADDRESS_MODE_ABSOLUTE_SHORT:
-                PC += 2;
-                absoluteAddress = memory->readWordFromMemory(PC);
-                if (size == SIZE_BYTE) {
-                    data2 = memory->readByteFromMemory(absoluteAddress);
-                    result = data - data2;
-                    mostSignificantBitResult = (result >> 7) & 1;
-                    mostSignificantBitSource = (data2 >> 7) & 1;
-                }
-                else if (size == SIZE_WORD) {
-                    data2 = memory->readWordFromMemory(absoluteAddress);
-                    result = data - data2;
-                    mostSignificantBitResult = (result >> 15) & 1;
-                    mostSignificantBitSource = (data2 >> 15) & 1;
-                }
-                else {
-                    data2 = memory->readLongFromMemory(absoluteAddress);
-                    result = data - data2;
-                    mostSignificantBitResult = (result >> 31) & 1;
-                    mostSignificantBitSource = (data2 >> 31) & 1;
-                }
-                break;
-            case ADDRESS_MODE_ABSOLUTE_LONG:
-                PC += 2;
-                absoluteAddress = memory->readLongFromMemory(PC);
-                if (size == SIZE_BYTE) {
-                    data2 = memory->readByteFromMemory(absoluteAddress);
-                    result = data - data2;
-                    mostSignificantBitResult = (result >> 7) & 1;
-                    mostSignificantBitSource = (data2 >> 7) & 1;
-                }
-                else if (size == SIZE_WORD) {
-                    data2 = memory->readWordFromMemory(absoluteAddress);
-                    result = data - data2;
-                    mostSignificantBitResult = (result >> 15) & 1;
-                    mostSignificantBitSource = (data2 >> 15) & 1;
-                }
-                else {
-                    data2 = memory->readLongFromMemory(absoluteAddress);
-                    result = data - data2;
-                    mostSignificantBitResult = (result >> 31) & 1;
-                    mostSignificantBitSource = (data2 >> 31) & 1;
-                }
-                PC += 2;
-                break;
-            case ADDRESS_MODE_PROGRAM_COUNTER_WITH_DISPLACEMENT:
-                PC += 2;
-                displacement = memory->readWordFromMemory(PC);
-                if (DEBUG_MODE)
-                    cout << "Displacement: " << displacement << endl;
-                if (size == SIZE_BYTE) {
-                    data2 = memory->readByteFromMemory(PC, displacement);
-                    result = data - data2;
-                    mostSignificantBitResult = (result >> 7) & 1;
-                    mostSignificantBitSource = (data2 >> 7) & 1;
-                }
-                else if (size == SIZE_WORD) {
-                    data2 = memory->readWordFromMemory(PC, displacement);
-                    result = data - data2;
-                    mostSignificantBitResult = (result >> 15) & 1;
-                    mostSignificantBitSource = (data2 >> 15) & 1;
-                }
-                else if (size == SIZE_LONG) {
-                    data2 = memory->readLongFromMemory(PC, displacement);
-                    result = data - data2;
-                    mostSignificantBitResult = (result >> 31) & 1;
-                    mostSignificantBitSource = (data2 >> 31) & 1;
-                    PC += 2;
-                }
-                else {
-                    cout << "Invalid addressing mode" << endl;
-                    return false;
-                }
-                break;
-            case ADDRESS_MODE_PROGRAM_COUNTER_WITH_INDEX:
-                PC += 2;
-                indexRegister = (memory->readByteFromMemory(PC) >> 4) & 0x0F;
-                indexSize = memory->readByteFromMemory(PC) & 0x0F;
-                longDisplacement = memory->readByteFromMemory(PC + 1);
-                if (indexRegister <= 7) {
-                    if (indexSize == INDEX_SIZE_WORD) {
-                        longDisplacement += (int16_t)D[indexRegister];
-                    }
-                    else
-                        longDisplacement += D[indexRegister];
-                }
-                else {
-                    if (indexSize == INDEX_SIZE_WORD) {
-                        longDisplacement += (int16_t)A[indexRegister - 8];
-                    }
-                    else
-                        longDisplacement += D[indexRegister - 8];
-                }
-                if (size == SIZE_BYTE) {
-                    data2 = memory->readByteFromMemory(PC, longDisplacement);
-                    result = data - data2;
-                    mostSignificantBitResult = (result >> 7) & 1;
-                    mostSignificantBitSource = (data2 >> 7) & 1;
-                }
-                else if (size == SIZE_WORD) {
-                    data2 = memory->readWordFromMemory(PC, longDisplacement);
-                    result = data - data2;
-                    mostSignificantBitResult = (result >> 15) & 1;
-                    mostSignificantBitSource = (data2 >> 15) & 1;
-                }
-                else if (size == SIZE_LONG) {
-                    data2 = memory->readLongFromMemory(PC, longDisplacement);
-                    result = data - data2;
-                    mostSignificantBitResult = (result >> 31) & 1;
-                    mostSignificantBitSource = (data2 >> 31) & 1;
-                    PC += 2;
-                }
-                else {
-                    cout << "Invalid addressing mode" << endl;
-                    return false;
-                }
-                break;
-            case ADDRESS_MODE_IMMEDIATE_OR_STATUS_REGISTER:
-                PC += 2;
-                if (size == SIZE_BYTE) {
-                    data2 = memory->readByteFromMemory(PC+1);
-                    result = data - data2;
-                    mostSignificantBitResult = (result >> 7) & 1;
-                    mostSignificantBitSource = (data2 >> 7) & 1;
-                }
-                else if (size == SIZE_WORD) {
-                    data2 = memory->readWordFromMemory(PC);
-                    result = data - data2;
-                    mostSignificantBitResult = (result >> 15) & 1;
-                    mostSignificantBitSource = (data2 >> 15) & 1;
-                }
-                else if (size == SIZE_LONG) {
-                    data2 = memory->readLongFromMemory(PC);
-                    result = data - data2;
-                    mostSignificantBitResult = (result >> 31) & 1;
-                    mostSignificantBitSource = (data2 >> 31) & 1;
-                    PC += 2;
-                }
-                else {
-                    cout << "Invalid addressing mode" << endl;
-                    return false;
-                }
-                break;
-            default:
-                cout << "Invalid addressing mode" << endl;
-                return false;
-                break;
-            }
-            break;
+// ANDI/ORI/EORI (And, or or exclusive or immediate)
+template<int Operation, int Size, int DestinationMode>
+bool CPUCore::executeLogicalImmediate(uint16_t instruction)
+{
+    uint32_t source = readOperand<Size, EA_IMMEDIATE>(0);
+    logicalToOperand<Operation, Size, DestinationMode>(source, instruction & 7);
+    return true;
+}
 
-        default:
-            cout << "Unrecognised addressing mode" << endl;
-            return false;
-            break;
-        }
+// ANDI/ORI/EORI to CCR, and to SR (Privileged Instruction)
+template<int Operation, int Size>
+bool CPUCore::executeLogicalToStatusRegister(uint16_t instruction)
+{
+    if (Size == SIZE_WORD && !isSupervisor())
+        return privilegeViolation();
+
+    evaluateFlags();
+    uint16_t source = fetchWord();
+    uint16_t result = SR;
+
+    if (Operation == LOGICAL_AND)
+        result &= source | (Size == SIZE_BYTE ? 0xFF00 : 0);
+    else if (Operation == LOGICAL_OR)
+        result |= source & sizeMask(Size);
+    else
+        result ^= source & sizeMask(Size);
+
+    writeStatusRegister(result);
+    return true;
+}
 
-        if (size == SIZE_BYTE || (size - 4) == SIZE_BYTE) {
-            (uint8_t)result == 0 ? SR |= 1 << SR_CCR_ZERO : SR &= ~(1 << SR_CCR_ZERO);
-        }
-        else if (size == SIZE_WORD || (size - 4) == SIZE_WORD) {
-            (uint16_t)result == 0 ? SR |= 1 << SR_CCR_ZERO : SR &= ~(1 << SR_CCR_ZERO);
-        }
-        else {
-            result == 0 ? SR |= 1 << SR_CCR_ZERO : SR &= ~(1 << SR_CCR_ZERO);
-        }
+// NEG (Negate)
+template<int Size, int Mode>
+bool CPUCore::executeNEG(uint16_t instruction)
+{
+    Operand operand = resolveOperand<Size, Mode>(instruction & 7);
+    writeOperand<Size, Mode>(operand, arithmetic<OPERATION_SUB, Size>(readOperand<Size, Mode>(operand), 0));
+    return true;
+}
 
-        mostSignificantBitResult == 1 ? SR |= 1 << SR_CCR_NEGATIVE : SR &= ~(1 << SR_CCR_NEGATIVE);
+// NEGX (Negate with extend)
+template<int Size, int Mode>
+bool CPUCore::executeNEGX(uint16_t instruction)
+{
+    Operand operand = resolveOperand<Size, Mode>(instruction & 7);
+    writeOperand<Size, Mode>(operand, extendedArithmetic<OPERATION_SUB, Size>(readOperand<Size, Mode>(operand), 0));
+    return true;
+}
 
-        if (mostSignificantBitDestination == 0 && mostSignificantBitResult == 1)
-            SR |= 1 << SR_CCR_CARRY;
-        else
-            SR &= ~(1 << SR_CCR_CARRY);
+// NOT (Logical complement)
+template<int Size, int Mode>
+bool CPUCore::executeNOT(uint16_t instruction)
+{
+    Operand operand = resolveOperand<Size, Mode>(instruction & 7);
+    uint32_t result = ~readOperand<Size, Mode>(operand) & sizeMask(Size);
 
-        if (mostSignificantBitSource != mostSignificantBitDestination)
-            mostSignificantBitDestination != mostSignificantBitResult ? SR |= 1 << SR_CCR_OVERFLOW : SR &= ~(1 << SR_CCR_OVERFLOW);
+    writeOperand<Size, Mode>(operand, result);
+    setLogicalFlags<Size>(result);
+    return true;
+}
 
-        return true;
-    }
+// TST (Test an operand)
+template<int Size, int Mode>
+bool CPUCore::executeTST(uint16_t instruction)
+{
+    setLogicalFlags<Size>(readOperand<Size, Mode>(instruction & 7));
+    return true;
+}
 
-    // CMPA (Compare Address)
-    if (((instruction & 0xF1C0) == CMPA_W) || ((instruction & 0xF1C0) == CMPA_L)) {
-        int size = (instruction >> 6) & 7;
-        int mode = (instruction >> 3) & 7;
-        int addressRegister = (instruction >> 9) & 7;
-        int reg = instruction & 7;
-
-        if (DEBUG_MODE) {
-            cout << "WE HAVE A COMPARE ADDRESS" << endl;
-            cout << "Mode is: " << mode << endl;
-            cout << "Dest register is: " << reg << endl;
-            cout << "Address register is: " << addressRegister << endl;
-        }
+// TAS (Test and set an operand)
+template<int Mode>
+bool CPUCore::executeTAS(uint16_t instruction)
+{
+    Operand operand = resolveOperand<SIZE_BYTE, Mode>(instruction & 7);
+    uint32_t data = readOperand<SIZE_BYTE, Mode>(operand);
 
-        if (size == 3)
-            size = SIZE_WORD;
-        else
-            size = SIZE_LONG;
+    setLogicalFlags<SIZE_BYTE>(data);
+    writeOperand<SIZE_BYTE, Mode>(operand, data | 0x80);
+    return true;
+}
 
-        if (size == SIZE_WORD) {
-            data = (uint16_t)A[addressRegister];
-            mostSignificantBitDestination = (data >> 15) & 1;
-        }
-        else {
-            data = A[addressRegister];
-            mostSignificantBitDestination = (data >> 31) & 1;
-        }
+// NBCD (Negate decimal with extend)
+template<int Mode>
+bool CPUCore::executeNBCD(uint16_t instruction)
+{
+    Operand operand = resolveOperand<SIZE_BYTE, Mode>(instruction & 7);
+    writeOperand<SIZE_BYTE, Mode>(operand, decimalArithmetic<OPERATION_SUB>((uint8_t)readOperand<SIZE_BYTE, Mode>(operand), 0));
+    return true;
+}
 
-        switch (mode) {
-        case ADDRESS_MODE_DATA_REGISTER_DIRECT:
-            if (DEBUG_MODE)
-                cout << "Data: " << data << endl;
-            if (size == SIZE_WORD) {
-                data2 = (uint16_t)D[reg];
-                result = data - data2;
-                mostSignificantBitResult = (result >> 15) & 1;
-                mostSignificantBitSource = (data2 >> 15) & 1;
-            }
-            else {
-                data2 = D[reg];
-                result = data - data2;
-                mostSignificantBitResult = (result >> 31) & 1;
-                mostSignificantBitSource = (data2 >> 31) & 1;
-            }
-            break;
-        case ADDRESS_MODE_ADDRESS_REGISTER_DIRECT:
-            if (DEBUG_MODE)
-                cout << "Data: " << data << endl;
-            if (size == SIZE_WORD) {
-                data2 = (uint16_t)A[reg];
-                result = data - data2;
-                mostSignificantBitResult = (result >> 15) & 1;
-                mostSignificantBitSource = (data2 >> 15) & 1;
-            }
-            else {
-                data2 = A[reg];
-                result = data - data2;
-                mostSignificantBitResult = (result >> 31) & 1;
-                mostSignificantBitSource = (data2 >> 31) & 1;
-            }
-            break;
-        case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT:
-            if (size == SIZE_WORD) {
-                data2 = memory->readWordFromMemory(A[reg]);
-                result = data - data2;
-                mostSignificantBitResult = (result >> 15) & 1;
-                mostSignificantBitSource = (data2 >> 15) & 1;
-            }
-            else {
-                data2 = memory->readLongFromMemory(A[reg]);
-                result = data - data2;
-                mostSignificantBitResult = (result >> 31) & 1;
-                mostSignificantBitSource = (data2 >> 31) & 1;
-            }
-            break;
-        case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_POSTINCREMENT:
-            if (size == SIZE_WORD) {
-                data2 = memory->readWordFromMemory(A[reg]);
-                result = data - data2;
-                mostSignificantBitResult = (result >> 15) & 1;
-                mostSignificantBitSource = (data2 >> 15) & 1;
-                A[reg] += 2;
-            }
-            else {
-                data2 = memory->readLongFromMemory(A[reg]);
-                result = data - data2;
-                mostSignificantBitResult = (result >> 31) & 1;
-                mostSignificantBitSource = (data2 >> 31) & 1;
-                A[reg] += 4;
-            }
-            break;
-        case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_PREDECREMENT:
-            if (size == SIZE_WORD) {
-                A[reg] -= 2;
-                data2 = memory->readWordFromMemory(A[reg]);
-                result = data - data2;
-                mostSignificantBitResult = (result >> 15) & 1;
-                mostSignificantBitSource = (data2 >> 15) & 1;
-            }
-            else {
-                A[reg] -= 4;
-                data2 = memory->readLongFromMemory(A[reg]);
-                result = data - data2;
-                mostSignificantBitResult = (result >> 31) & 1;
-                mostSignificantBitSource = (data2 >> 31) & 1;
-            }
-            break;
-        case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_DISPLACEMENT:
-            PC += 2;
-            displacement = memory->readWordFromMemory(PC);
-            if (DEBUG_MODE)
-                cout << "Displacement: " << displacement << endl;
-            if (size == SIZE_WORD) {
-                data2 = memory->readWordFromMemory(A[reg], displacement);
-                result = data - data2;
-                mostSignificantBitResult = (result >> 15) & 1;
-                mostSignificantBitSource = (data2 >> 15) & 1;
-            }
-            else {
-                data2 = memory->readLongFromMemory(A[reg], displacement);
-                result = data - data2;
-                mostSignificantBitResult = (result >> 31) & 1;
-                mostSignificantBitSource = (data2 >> 31) & 1;
-            }
-            break;
-        case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_INDEX:
-            PC += 2;
-            indexRegister = (memory->readByteFromMemory(PC) >> 4) & 0x0F;
-            indexSize = memory->readByteFromMemory(PC) & 0x0F;
-            longDisplacement = memory->readByteFromMemory(PC + 1);
-            if (indexRegister <= 7) {
-                if (indexSize == INDEX_SIZE_WORD) {
-                    longDisplacement += (int16_t)D[indexRegister];
-                }
-                else
-                    longDisplacement += D[indexRegister];
-            }
-            else {
-                if (indexSize == INDEX_SIZE_WORD) {
-                    longDisplacement += (int16_t)A[indexRegister - 8];
-                }
-                else
-                    longDisplacement += D[indexRegister - 8];
-            }
-            if (size == SIZE_WORD) {
-                data2 = memory->readWordFromMemory(A[reg], longDisplacement);
-                result = data - data2;
-                mostSignificantBitResult = (result >> 15) & 1;
-                mostSignificantBitSource = (data2 >> 15) & 1;
-            }
-            else {
-                data2 = memory->readLongFromMemory(A[reg], longDisplacement);
-                result = data - data2;
-                mostSignificantBitResult = (result >> 31) & 1;
-                mostSignificantBitSource = (data2 >> 31) & 1;
-            }
-            break;
-        case ADDRESS_MODE_OTHERS:
-            switch (reg) {
-            case ADDRESS_MODE_ABSOLUTE_SHORT:
-                PC += 2;
-                absoluteAddress = memory->readWordFromMemory(PC);
-                if (size == SIZE_WORD) {
-                    data2 = memory->readWordFromMemory(absoluteAddress);
-                    result = data - data2;
-                    mostSignificantBitResult = (result >> 15) & 1;
-                    mostSignificantBitSource = (data2 >> 15) & 1;
-                }
-                else {
-                    data2 = memory->readLongFromMemory(absoluteAddress);
-                    result = data - data2;
-                    mostSignificantBitResult = (result >> 31) & 1;
-                    mostSignificantBitSource = (data2 >> 31) & 1;
-                }
-                break;
-            case ADDRESS_MODE_ABSOLUTE_LONG:
-                PC += 2;
-                absoluteAddress = memory->readLongFromMemory(PC);
-                if (size == SIZE_WORD) {
-                    data2 = memory->readWordFromMemory(absoluteAddress);
-                    result = data - data2;
-                    mostSignificantBitResult = (result >> 15) & 1;
-                    mostSignificantBitSource = (data2 >> 15) & 1;
-                    PC += 2;
-                }
-                else {
-                    data2 = memory->readLongFromMemory(absoluteAddress);
-                    result = data - data2;
-                    mostSignificantBitResult = (result >> 31) & 1;
-                    mostSignificantBitSource = (data2 >> 31) & 1;
-                }
-                PC += 2;
-                break;
-            case ADDRESS_MODE_PROGRAM_COUNTER_WITH_DISPLACEMENT:
-                PC += 2;
-                displacement = memory->readWordFromMemory(PC);
-                if (DEBUG_MODE)
-                    cout << "Displacement: " << displacement << endl;
-                if (size == SIZE_WORD) {
-                    data2 = memory->readWordFromMemory(PC, displacement);
-                    result = data - data2;
-                    mostSignificantBitResult = (result >> 15) & 1;
-                    mostSignificantBitSource = (data2 >> 15) & 1;
-                }
-                else if (size == SIZE_LONG) {
-                    data2 = memory->readLongFromMemory(PC, displacement);
-                    result = data - data2;
-                    mostSignificantBitResult = (result >> 31) & 1;
-                    mostSignificantBitSource = (data2 >> 31) & 1;
-                    PC += 2;
-                }
-                break;
-            case ADDRESS_MODE_PROGRAM_COUNTER_WITH_INDEX:
-                PC += 2;
-                indexRegister = (memory->readByteFromMemory(PC) >> 4) & 0x0F;
-                indexSize = memory->readByteFromMemory(PC) & 0x0F;
-                longDisplacement = memory->readByteFromMemory(PC + 1);
-                if (indexRegister <= 7) {
-                    if (indexSize == INDEX_SIZE_WORD) {
-                        longDisplacement += (int16_t)D[indexRegister];
-                    }
-                    else
-                        longDisplacement += D[indexRegister];
-                }
-                else {
-                    if (indexSize == INDEX_SIZE_WORD) {
-                        longDisplacement += (int16_t)A[indexRegister - 8];
-                    }
-                    else
-                        longDisplacement += D[indexRegister - 8];
-                }
-                if (size == SIZE_WORD) {
-                    data2 = memory->readWordFromMemory(PC, longDisplacement);
-                    result = data - data2;
-                    mostSignificantBitResult = (result >> 15) & 1;
-                    mostSignificantBitSource = (data2 >> 15) & 1;
-                }
-                else if (size == SIZE_LONG) {
-                    data2 = memory->readLongFromMemory(PC, longDisplacement);
-                    result = data - data2;
-                    mostSignificantBitResult = (result >> 31) & 1;
-                    mostSignificantBitSource = (data2 >> 31) & 1;
-                    PC += 2;
-                }
-                break;
-            case ADDRESS_MODE_IMMEDIATE_OR_STATUS_REGISTER:
-                PC += 2;
-                if (size == SIZE_WORD) {
-                    data2 = memory->readWordFromMemory(PC);
-                    result = data - data2;
-                    mostSignificantBitResult = (result >> 15) & 1;
-                    mostSignificantBitSource = (data2 >> 15) & 1;
-                }
-                else if (size == SIZE_LONG) {
-                    data2 = memory->readLongFromMemory(PC);
-                    result = data - data2;
-                    mostSignificantBitResult = (result >> 31) & 1;
-                    mostSignificantBitSource = (data2 >> 31) & 1;
-                    PC += 2;
-                }
-                break;
-            default:
-                cout << "Invalid addressing mode" << endl;
-                return false;
-                break;
-            }
-            break;
+// ABCD/SBCD Dy,Dx and -(Ay),-(Ax) (Add or subtract decimal with extend)
+template<int Operation, int Mode>
+bool CPUCore::executeBCD(uint16_t instruction)
+{
+    uint8_t source = (uint8_t)readOperand<SIZE_BYTE, Mode>(instruction & 7);
+    Operand destination = resolveOperand<SIZE_BYTE, Mode>((instruction >> 9) & 7);
+    uint8_t result = decimalArithmetic<Operation>(source, (uint8_t)readOperand<SIZE_BYTE, Mode>(destination));
 
-        default:
-            cout << "Unrecognised addressing mode" << endl;
-            return false;
-            break;
-        }
+    writeOperand<SIZE_BYTE, Mode>(destination, result);
+    return true;
+}
+
+// MULU/MULS (Multiply two words into a long)
+template<int Signed, int SourceMode>
+bool CPUCore::executeMultiply(uint16_t instruction)
+{
+    int reg = (instruction >> 9) & 7;
+    uint32_t source = readOperand<SIZE_WORD, SourceMode>(instruction & 7);
+    uint32_t result;
+
+    if (Signed)
+        result = (uint32_t)((int32_t)(int16_t)source * (int16_t)D[reg]);
+    else
+        result = source * (uint16_t)D[reg];
+
+    // The multiplier takes two cycles for each one bit of the source, or for MULS each change
+    // between adjacent bits of the source with a zero below it
+    uint32_t steps = Signed ? (source ^ (source << 1)) & 0xFFFF : source;
+    cycleCount += 2 * bitset<16>(steps).count();
+
+    D[reg] = result;
+    setLogicalFlags<SIZE_LONG>(result);
+    return true;
+}
+
+// DIVU/DIVS (Divide a long by a word, leaving the remainder in the upper word and the quotient
+// in the lower). A quotient that does not fit in a word sets V and leaves the register alone.
+template<int Signed, int SourceMode>
+bool CPUCore::executeDivide(uint16_t instruction)
+{
+    int reg = (instruction >> 9) & 7;
+    uint32_t divisor = readOperand<SIZE_WORD, SourceMode>(instruction & 7);
+
+    if (divisor == 0) {
+        cycleCount -= (Signed ? DIVS_CYCLES : DIVU_CYCLES) - DIVIDE_BY_ZERO_CYCLES;
+        return exception(VECTOR_ZERO_DIVIDE, PC);
+    }
+
+    int64_t quotient;
+    int64_t remainder;
+    if (Signed) {
+        quotient = (int64_t)(int32_t)D[reg] / (int16_t)divisor;
+        remainder = (int64_t)(int32_t)D[reg] % (int16_t)divisor;
+    }
+    else {
+        quotient = D[reg] / divisor;
+        remainder = D[reg] % divisor;
+    }
 
+    if (Signed ? quotient != (int16_t)quotient : quotient > 0xFFFF) {
+        setConditionCodes(1 << SR_CCR_OVERFLOW, (1 << SR_CCR_OVERFLOW) | (1 << SR_CCR_CARRY));
         return true;
     }
 
-    // BSR (Branch to Subroutine)
-    if ((instruction & 0xFF00) == BSR) {
-        if (DEBUG_MODE)
-            cout << "Branch to subroutine" << endl;
-        SP -= 2;
-        memory->writeWordToMemory(PC,SP);
-        int8_t shortDisplacement = instruction & 0xFF;
+    D[reg] = ((uint32_t)remainder << 16) | ((uint32_t)quotient & 0xFFFF);
+    setLogicalFlags<SIZE_WORD>((uint32_t)quotient);
+    return true;
+}
 
-        if (((shortDisplacement >> 7) & 1) == 1) {
-            shortDisplacement = ~shortDisplacement - 1;
-            if (shortDisplacement == 0) {
-                PC += 2;
-                displacement = memory->readWordFromMemory(PC);
-                displacement += 2;
-                PC -= displacement;
-            }
-            else {
-                shortDisplacement += 2;
-                PC -= shortDisplacement;
-            }
-        }
-        else {
-            if (shortDisplacement == 0) {
-                PC += 2;
-                displacement = memory->readWordFromMemory(PC);
-                displacement -= 2;
-                PC += displacement;
-            }
-            else {
-                shortDisplacement -= 2;
-                PC += shortDisplacement;
-            }
-        }
+// CHK (Check a data register against bounds, taking the CHK exception when it is below zero or above <ea>)
+template<int SourceMode>
+bool CPUCore::executeCHK(uint16_t instruction)
+{
+    int16_t bound = (int16_t)readOperand<SIZE_WORD, SourceMode>(instruction & 7);
+    int16_t value = (int16_t)D[(instruction >> 9) & 7];
 
+    if (value >= 0 && value <= bound)
+        return true;
 
-        if (DEBUG_MODE) {
-            cout << "We have a branch" << endl;
-            cout << "Displacement: " << hex << displacement << endl;
-        }
+    setConditionCodes((value < 0) << SR_CCR_NEGATIVE, 1 << SR_CCR_NEGATIVE);
+    return exception(VECTOR_CHK, PC);
+}
+
+// EXT (Sign extend a byte to a word, or a word to a long)
+template<int Size>
+bool CPUCore::executeEXT(uint16_t instruction)
+{
+    int reg = instruction & 7;
+    uint32_t result = Size == SIZE_WORD ? (uint32_t)(int8_t)D[reg] : (uint32_t)(int16_t)D[reg];
+
+    writeDataRegister<Size>(result, reg);
+    setLogicalFlags<Size>(result);
+    return true;
+}
+
+// ASd/LSd/ROXd/ROd Dn (Shift or rotate a data register by 1-8, or by a count in a data register modulo 64)
+template<int Type, int Left, int Size>
+bool CPUCore::executeShiftRegister(uint16_t instruction)
+{
+    int reg = instruction & 7;
+    int count = (instruction >> 9) & 7;
+
+    if (((instruction >> 5) & 1) == 1)
+        count = D[count] & 63;
+    else if (count == 0)
+        count = 8;
 
+    cycleCount += 2 * count;
+    writeDataRegister<Size>(shift<Type, Left, Size>(D[reg], count), reg);
+    return true;
+}
+
+// ASd/LSd/ROXd/ROd <ea> (Shift or rotate a memory word by one)
+template<int Type, int Left, int Mode>
+bool CPUCore::executeShiftMemory(uint16_t instruction)
+{
+    Operand operand = resolveOperand<SIZE_WORD, Mode>(instruction & 7);
+    writeOperand<SIZE_WORD, Mode>(operand, shift<Type, Left, SIZE_WORD>(readOperand<SIZE_WORD, Mode>(operand), 1));
+    return true;
+}
+
+// BTST/BCHG/BCLR/BSET (Test a bit, then change, clear or set it). The bit number comes from a
+// data register or an extension word, and is taken modulo 32 for a data register and modulo 8
+// for the byte in memory.
+template<int Operation, int Mode, int Dynamic>
+bool CPUCore::executeBitOperation(uint16_t instruction)
+{
+    const int Size = Mode == ADDRESS_MODE_DATA_REGISTER_DIRECT ? SIZE_LONG : SIZE_BYTE;
+    uint32_t bit = Dynamic ? D[(instruction >> 9) & 7] : fetchWord();
+
+    bit &= Size == SIZE_LONG ? 31 : 7;
+    Operand operand = resolveOperand<Size, Mode>(instruction & 7);
+    uint32_t data = readOperand<Size, Mode>(operand);
+
+    setConditionCodes(((data >> bit) & 1) == 0 ? 1 << SR_CCR_ZERO : 0, 1 << SR_CCR_ZERO);
+    if (Operation == BIT_TEST)
+        return true;
+
+    if (Operation == BIT_CHANGE)
+        data ^= 1 << bit;
+    else if (Operation == BIT_CLEAR)
+        data &= ~(1 << bit);
+    else
+        data |= 1 << bit;
+    writeOperand<Size, Mode>(operand, data);
+    return true;
+}
+
+// MOVEP (Move peripheral data between a data register and every other byte from d16(An))
+template<int Size, int ToMemory>
+bool CPUCore::executeMOVEP(uint16_t instruction)
+{
+    int reg = (instruction >> 9) & 7;
+    uint32_t address = A[instruction & 7] + (int16_t)fetchWord();
+    const int bytes = sizeInBytes(Size);
+
+    if (ToMemory) {
+        for (int i = 0; i < bytes; i++)
+            memory->writeByteToMemory((uint8_t)(D[reg] >> (8 * (bytes - 1 - i))), address + 2 * i);
         return true;
     }
 
-    // BRA (Branch Always)
-    if ((instruction & 0xFF00) == BRA) {
-        int8_t shortDisplacement = instruction & 0xFF;
+    uint32_t data = 0;
+    for (int i = 0; i < bytes; i++)
+        data = (data << 8) | memory->readByteFromMemory(address + 2 * i);
+    writeDataRegister<Size>(data, reg);
+    return true;
+}
+
+// BSR (Branch to Subroutine)
+bool CPUCore::executeBSR(uint16_t instruction)
+{
+    uint32_t base = PC;
+    int32_t displacement = branchDisplacement(instruction);
 
-        if (((shortDisplacement >> 7) & 1) == 1) {
-            shortDisplacement = ~shortDisplacement - 1;
-            if (shortDisplacement == 0) {
-                PC += 2;
-                displacement = memory->readWordFromMemory(PC);
-                displacement += 2;
-                PC -= displacement;
-            }
-            else {
-                shortDisplacement += 2;
-                PC -= shortDisplacement;
-            }
-        }
-        else {
-            if (shortDisplacement == 0) {
-                PC += 2;
-                displacement = memory->readWordFromMemory(PC);
-                displacement -= 2;
-                PC += displacement;
-            }
-            else {
-                shortDisplacement -= 2;
-                PC += shortDisplacement;
-            }
-        }
-        
+    SP -= 4;
+    memory->writeLongToMemory(PC, SP);
+    PC = base + displacement;
+    return true;
+}
+
+// BRA (Branch Always)
+bool CPUCore::executeBRA(uint16_t instruction)
+{
+    uint32_t base = PC;
+    PC = base + branchDisplacement(instruction);
+    return true;
+}
+
+// Bcc (Branch Conditionally)
+template<int Condition>
+bool CPUCore::executeBcc(uint16_t instruction)
+{
+    uint32_t base = PC;
+    int32_t displacement = branchDisplacement(instruction);
+
+    if (testCondition<Condition>())
+        PC = base + displacement;
+    else if ((instruction & 0xFF) == 0)
+        cycleCount += 2; // A word branch not taken takes 12 cycles
+    else
+        cycleCount -= 2; // A byte branch not taken takes 8
+    return true;
+}
 
-        if (DEBUG_MODE) {
-            cout << "We have a branch" << endl;
-            cout << "Displacement: " << hex << displacement << endl;
-        }
+// DBcc (Test condition, decrement and branch: unless the condition holds, the low word of Dn
+// counts down and the branch is taken until it reaches -1)
+template<int Condition>
+bool CPUCore::executeDBcc(uint16_t instruction)
+{
+    uint32_t base = PC;
+    int32_t displacement = (int16_t)fetchWord();
 
+    if (testCondition<Condition>()) {
+        cycleCount += 2;
         return true;
     }
 
-    // Bcc (Branch Conditionally)
-    if ((instruction & 0xF000) == Bcc) {
-        int condition = (instruction >> 8) & 0xF;
-
-        displacement = instruction & 0xFF;
+    int reg = instruction & 7;
+    uint16_t count = (uint16_t)D[reg] - 1;
+    writeWordToDataRegister(count, reg);
+    if (count != 0xFFFF)
+        PC = base + displacement;
+    else
+        cycleCount += 4;
+    return true;
+}
 
-        if (displacement == 0) {
-            PC += 2;
-            displacement = memory->readWordFromMemory(PC);
-        }
+// Scc (Set a byte to all ones when the condition holds, otherwise to zero)
+template<int Condition, int Mode>
+bool CPUCore::executeScc(uint16_t instruction)
+{
+    bool holds = testCondition<Condition>();
 
-        if (DEBUG_MODE) {
-            cout << "We have a conditional branch" << endl;
-            cout << "Displacement: " << hex << displacement << endl;
-        }
+    // Setting a data register takes two cycles more than clearing one
+    if (Mode == ADDRESS_MODE_DATA_REGISTER_DIRECT && holds)
+        cycleCount += 2;
+    writeOperand<SIZE_BYTE, Mode>(holds ? 0xFF : 0, instruction & 7);
+    return true;
+}
 
-        displacement -= 2;
+// JSR (Jump to Subroutine)
+template<int Mode>
+bool CPUCore::executeJSR(uint16_t instruction)
+{
+    uint32_t target = effectiveAddress<SIZE_LONG, Mode>(instruction & 7);
 
-        switch (condition) {
-        case CONDITIONAL_CARRY_CLEAR:
-            if (((SR >> SR_CCR_CARRY) & 1) == 0)
-                PC += displacement;
-            break;
-        case CONDITIONAL_CARRY_SET:
-            if (((SR >> SR_CCR_CARRY) & 1) == 1)
-                PC += displacement;
-            break;
-        case CONDITIONAL_EQUAL:
-            if (((SR >> SR_CCR_ZERO) & 1) == 1)
-                PC += displacement;
-            break;
-        case CONDITIONAL_GREATER_OR_EQUAL:
-            if ((((SR >> SR_CCR_NEGATIVE) & 1) == 0) && (((SR >> SR_CCR_OVERFLOW) & 1) == 0))
-                PC += displacement;
-            else if ((((SR >> SR_CCR_NEGATIVE) & 1) == 1) && (((SR >> SR_CCR_OVERFLOW) & 1) == 1))
-                PC += displacement;
-            break;
-        case CONDITIONAL_GREATER_THAN:
-            if (((SR >> SR_CCR_ZERO) & 1) == 1)
-                break;
-            if ((((SR >> SR_CCR_NEGATIVE) & 1) == 1) && (((SR >> SR_CCR_OVERFLOW) & 1) == 1))
-                PC += displacement;
-            else if ((((SR >> SR_CCR_NEGATIVE) & 1) == 0) && (((SR >> SR_CCR_OVERFLOW) & 1) == 0))
-                PC += displacement;
-            break;
-        case CONDITIONAL_HIGH:
-            if ((((SR >> SR_CCR_CARRY) & 1) == 0) && (((SR >> SR_CCR_ZERO) & 1) == 0))
-                PC += displacement;
-            break;
-        case CONDITIONAL_LESS_OR_EQUAL:
-            if ((((SR >> SR_CCR_NEGATIVE) & 1) == 1) && (((SR >> SR_CCR_OVERFLOW) & 1) == 0))
-                PC += displacement;
-            else if ((((SR >> SR_CCR_NEGATIVE) & 1) == 0) && (((SR >> SR_CCR_OVERFLOW) & 1) == 1))
-                PC += displacement;
-            else if (((SR >> SR_CCR_ZERO) & 1) == 1)
-                PC += displacement;
-            break;
-        case CONDITIONAL_LOW_OR_SAME:
-            if ((((SR >> SR_CCR_CARRY) & 1) == 1) && (((SR >> SR_CCR_ZERO) & 1) == 1))
-                PC += displacement;
-            break;
-        case CONDITIONAL_LESS_THAN:
-            if ((((SR >> SR_CCR_NEGATIVE) & 1) == 1) && (((SR >> SR_CCR_OVERFLOW) & 1) == 0))
-                PC += displacement;
-            else if ((((SR >> SR_CCR_NEGATIVE) & 1) == 0) && (((SR >> SR_CCR_OVERFLOW) & 1) == 1))
-                PC += displacement;
-            break;
-        case CONDITIONAL_MINUS:
-            if (((SR >> SR_CCR_NEGATIVE) & 1) == 1)
-                PC += displacement;
-            break;
-        case CONDITIONAL_NOT_EQUAL:
-            if (((SR >> SR_CCR_ZERO) & 1) == 0)
-                PC += displacement;
-            break;
-        case CONDITIONAL_PLUS:
-            if (((SR >> SR_CCR_NEGATIVE) & 1) == 0)
-                PC += displacement;
-            break;
-        case CONDITIONAL_OVERFLOW_CLEAR:
-            if (((SR >> SR_CCR_OVERFLOW) & 1) == 0)
-                PC += displacement;
-            break;
-        case CONDITIONAL_OVERFLOW_SET:
-            if (((SR >> SR_CCR_OVERFLOW) & 1) == 1)
-                PC += displacement;
-            break;
-        default:
-            cout << "Illegal condition code" << endl;
-            return false;
-        }
+    SP -= 4;
+    memory->writeLongToMemory(PC, SP);
+    PC = target;
+    return true;
+}
 
-        return true;
-    }
+// RTS (Return from Subroutine)
+bool CPUCore::executeRTS(uint16_t instruction)
+{
+    PC = memory->readLongFromMemory(SP);
+    SP += 4;
+    return true;
+}
 
-    // RTS (Return from Subroutine)
-    if (instruction == RTS) {
-        uint16_t address = memory->readWordFromMemory(SP);
-        SP += 2;
-        PC = address + 2;
-        if (DEBUG_MODE)
-            cout << "Returning from subroutine" << endl;
-        return true;
-    }
+// RTR (Return and Restore Condition Codes)
+bool CPUCore::executeRTR(uint16_t instruction)
+{
+    setConditionCodes(memory->readWordFromMemory(SP), 0x1F);
+    PC = memory->readLongFromMemory(SP + 2);
+    SP += 6;
+    return true;
+}
 
-    // MOVEM (Move Multiple Registers)
-    if ((instruction & 0xFB80) == MOVEM) {
-        uint8_t direction = (instruction >> 10) & 1;
-        uint8_t size = (instruction >> 6) & 1;
-        size == 0 ? size = SIZE_WORD : size = SIZE_LONG;
-        int mode = (instruction >> 3) & 7;
-        int reg = instruction & 7;
-        PC += 2;
-        uint16_t registerListMask = memory->readWordFromMemory(PC);
-
-        if (DEBUG_MODE) {
-            cout << "We have a MOVEM" << endl;
-            cout << "Direction: " << direction << " Size: " << size << hex << uppercase << endl << "Register list mask: " << registerListMask << endl;
-        }
-        
-        int offset = 0;
-
-        switch (mode) {
-        case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT:
-            if (direction == 0) {
-                for (int i = 0; i < 8; i++) {
-                    if (((registerListMask >> i) & 1) == 1) {
-                        if (DEBUG_MODE)
-                            cout << "Uploading data register: " << i << endl;
-                        if (size == SIZE_WORD) {
-                            memory->writeWordToMemory((uint16_t)D[i], A[reg], offset);
-                            offset += 2;
-                        }
-                        else {
-                            memory->writeLongToMemory(D[i], A[reg], offset);
-                            offset += 4;
-                        }
-                    }
-                }
+// RTE (Return from Exception, Privileged Instruction)
+bool CPUCore::executeRTE(uint16_t instruction)
+{
+    if (!isSupervisor())
+        return privilegeViolation();
+
+    // Only the four word frame of format 0 is ever pushed, so any other format is an error
+    if (exceptionFormatWord && (memory->readWordFromMemory(SP + 6) >> 12) != 0)
+        return exception(VECTOR_FORMAT_ERROR, PC - 2);
+
+    uint16_t status = memory->readWordFromMemory(SP);
+    PC = memory->readLongFromMemory(SP + 2);
+    SP += exceptionFormatWord ? 8 : 6;
+    writeStatusRegister(status);
+    return true;
+}
 
-                for (int i = 0; i < 8; i++) {
-                    if (((registerListMask >> (i + 8)) & 1) == 1) {
-                        if (DEBUG_MODE)
-                            cout << "Uploading address register: " << i << endl;
-                        if (size == SIZE_WORD) {
-                            memory->writeWordToMemory((uint16_t)A[i], A[reg], offset);
-                            offset += 2;
-                        }
-                        else {
-                            memory->writeLongToMemory(A[i], A[reg], offset);
-                            offset += 4;
-                        }
-                    }
-                }
-            }
-            else {
-                for (int i = 0; i < 8; i++) {
-                    if (((registerListMask >> i) & 1) == 1) {
-                        if (DEBUG_MODE)
-                            cout << "Downloading data register: " << i << endl;
-                        if (size == SIZE_WORD) {
-                            D[i] = memory->readWordFromMemory(A[reg], offset);
-                            offset += 2;
-                        }
-                        else {
-                            D[i] = memory->readLongFromMemory(A[reg], offset);
-                            offset += 4;
-                        }
-                    }
-                }
+// LINK (Push An, point it at the new stack frame and move SP by the displacement)
+bool CPUCore::executeLINK(uint16_t instruction)
+{
+    int reg = instruction & 7;
+    int32_t displacement = (int16_t)fetchWord();
+
+    SP -= 4;
+    memory->writeLongToMemory(A[reg], SP);
+    A[reg] = SP;
+    SP += displacement;
+    return true;
+}
 
-                for (int i = 0; i < 8; i++) {
-                    if (((registerListMask >> i) & 1) == 1) {
-                        if (DEBUG_MODE)
-                            cout << "Downloading address register: " << i << endl;
-                        if (size == SIZE_WORD) {
-                            A[i] = memory->readWordFromMemory(A[reg], offset);
-                            offset += 2;
-                        }
-                        else {
-                            A[i] = memory->readLongFromMemory(A[reg], offset);
-                            offset += 4;
-                        }
-                    }
-                }
-            }
-            break;
-        case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_POSTINCREMENT:
-            if (direction == 0) {
-                cout << "Invalid addressing mode." << endl;
-                return false;
-            }
+// UNLK (Unlink: restore SP from An and pop An)
+bool CPUCore::executeUNLK(uint16_t instruction)
+{
+    int reg = instruction & 7;
 
-            for (int i = 0; i < 8; i++) {
-                if (((registerListMask >> i) & 1) == 1) {
-                    if (DEBUG_MODE)
-                        cout << "Uploading data register: " << i << endl;
-                    if (size == SIZE_WORD) {
-                        memory->writeWordToMemory((uint16_t)D[i], A[reg]);
-                        A[reg] += 2;
-                    }
-                    else {
-                        memory->writeLongToMemory(D[i], A[reg]);
-                        A[reg] += 4;
-                    }
-                }
-            }
+    SP = A[reg];
+    uint32_t data = memory->readLongFromMemory(SP);
+    SP += 4;
+    A[reg] = data;
+    return true;
+}
 
-            for (int i = 0; i < 8; i++) {
-                if (((registerListMask >> (i + 8)) & 1) == 1) {
-                    if (DEBUG_MODE)
-                        cout << "Uploading address register: " << i << endl;
-                    if (size == SIZE_WORD) {
-                        memory->writeWordToMemory((uint16_t)A[i], A[reg]);
-                        A[reg] += 2;
-                    }
-                    else {
-                        memory->writeLongToMemory(A[i], A[reg]);
-                        A[reg] += 4;
-                    }
-                }
-            }
-            break;
-        case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_PREDECREMENT:
-            if (direction == 1) {
-                cout << "Invalid addressing mode." << endl;
-                return false;
-            }
+// Returns a register by its number in a MOVEM register list: D0-D7 are 0-7 and A0-A7 are 8-15
+uint32_t &CPUCore::registerByNumber(int number)
+{
+    return registers[number];
+}
 
-            for (int i = 0; i < 8; i++) {
-                if (((registerListMask >> i) & 1) == 1) {
-                    if (DEBUG_MODE)
-                        cout << "Downloading address register: " << i << endl;
-                    if (size == SIZE_WORD) {
-                        A[reg] -= 2;
-                        A[7-i] = memory->readWordFromMemory(A[reg]);
-                    }
-                    else {
-                        A[reg] -= 4;
-                        A[7-i] = memory->readLongFromMemory(A[reg]);
-                    }
-                }
-            }
+// MOVEM <register list>,<ea> (Move Multiple Registers to memory)
+template<int Size, int Mode>
+bool CPUCore::executeMOVEMToMemory(uint16_t instruction)
+{
+    uint16_t registerListMask = fetchWord();
+    int reg = instruction & 7;
 
-            for (int i = 0; i < 8; i++) {
-                if (((registerListMask >> i) & 1) == 1) {
-                    if (DEBUG_MODE)
-                        cout << "Downloading data register: " << i << endl;
-                    if (size == SIZE_WORD) {
-                        A[reg] -= 2;
-                        D[7-i] = memory->readWordFromMemory(A[reg]);
-                    }
-                    else {
-                        A[reg] -= 4;
-                        D[7-i] = memory->readLongFromMemory(A[reg]);
-                    }
-                }
+    cycleCount += (Size == SIZE_LONG ? 8 : 4) * bitset<16>(registerListMask).count();
+    if (Mode == ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_PREDECREMENT) {
+        // The mask is reversed (bit 0 is A7) and registers are stored from A7 down to D0
+        uint32_t address = resolveOperand<Size, ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT>(reg).address;
+        for (int i = 0; i < 16; i++) {
+            if (((registerListMask >> i) & 1) == 1) {
+                address -= sizeInBytes(Size);
+                writeMemory<Size>(address, registerByNumber(15 - i));
             }
-            break;
-        case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_DISPLACEMENT:
-            PC += 2;
-            displacement = memory->readWordFromMemory(PC);
-            if (DEBUG_MODE)
-                cout << "Displacement: " << displacement << endl;
-
-            if (direction == 0) {
-                for (int i = 0; i < 8; i++) {
-                    if (((registerListMask >> i) & 1) == 1) {
-                        if (DEBUG_MODE)
-                            cout << "Uploading data register: " << i << endl;
-                        if (size == SIZE_WORD) {
-                            memory->writeWordToMemory((uint16_t)D[i], A[reg], offset + displacement);
-                            offset += 2;
-                        }
-                        else {
-                            memory->writeLongToMemory(D[i], A[reg], offset + displacement);
-                            offset += 4;
-                        }
-                    }
-                }
+        }
+        A[reg] = address;
+        return true;
+    }
 
-                for (int i = 0; i < 8; i++) {
-                    if (((registerListMask >> (i + 8)) & 1) == 1) {
-                        if (DEBUG_MODE)
-                            cout << "Uploading address register: " << i << endl;
-                        if (size == SIZE_WORD) {
-                            memory->writeWordToMemory((uint16_t)A[i], A[reg], offset + displacement);
-                            offset += 2;
-                        }
-                        else {
-                            memory->writeLongToMemory(A[i], A[reg], offset + displacement);
-                            offset += 4;
-                        }
-                    }
-                }
-            }
-            else {
-                for (int i = 0; i < 8; i++) {
-                    if (((registerListMask >> i) & 1) == 1) {
-                        if (DEBUG_MODE)
-                            cout << "Downloading data register: " << i << endl;
-                        if (size == SIZE_WORD) {
-                            D[i] = memory->readWordFromMemory(A[reg], offset + displacement);
-                            offset += 2;
-                        }
-                        else {
-                            D[i] = memory->readLongFromMemory(A[reg], offset + displacement);
-                            offset += 4;
-                        }
-                    }
-                }
+    uint32_t address = resolveOperand<Size, Mode>(reg).address;
+    for (int i = 0; i < 16; i++) {
+        if (((registerListMask >> i) & 1) == 1) {
+            writeMemory<Size>(address, registerByNumber(i));
+            address += sizeInBytes(Size);
+        }
+    }
+    return true;
+}
 
-                for (int i = 0; i < 8; i++) {
-                    if (((registerListMask >> i) & 1) == 1) {
-                        if (DEBUG_MODE)
-                            cout << "Downloading address register: " << i << endl;
-                        if (size == SIZE_WORD) {
-                            A[i] = memory->readWordFromMemory(A[reg], offset + displacement);
-                            offset += 2;
-                        }
-                        else {
-                            A[i] = memory->readLongFromMemory(A[reg], offset + displacement);
-                            offset += 4;
-                        }
-                    }
-                }
-            }
-            break;
-        case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_INDEX:
-            PC += 2;
-            indexRegister = (memory->readByteFromMemory(PC) >> 4) & 0x0F;
-            indexSize = memory->readByteFromMemory(PC) & 0x0F;
-            longDisplacement = memory->readByteFromMemory(PC + 1);
-            if (indexRegister <= 7) {
-                if (indexSize == INDEX_SIZE_WORD) {
-                    longDisplacement += (int16_t)D[indexRegister];
-                }
-                else
-                    longDisplacement += D[indexRegister];
-            }
-            else {
-                if (indexSize == INDEX_SIZE_WORD) {
-                    longDisplacement += (int16_t)A[indexRegister - 8];
-                }
-                else
-                    longDisplacement += D[indexRegister - 8];
-            }
+// MOVEM <ea>,<register list> (Move Multiple Registers from memory, words are sign extended)
+template<int Size, int Mode>
+bool CPUCore::executeMOVEMToRegisters(uint16_t instruction)
+{
+    uint16_t registerListMask = fetchWord();
+    int reg = instruction & 7;
+    cycleCount += (Size == SIZE_LONG ? 8 : 4) * bitset<16>(registerListMask).count();
+    // The postincrement form starts at (An) and leaves An after the last register loaded
+    const int StartMode = Mode == ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_POSTINCREMENT ? ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT : Mode;
+    uint32_t address = resolveOperand<Size, StartMode>(reg).address;
+
+    for (int i = 0; i < 16; i++) {
+        if (((registerListMask >> i) & 1) == 1) {
+            uint32_t data = readMemory<Size>(address);
+            registerByNumber(i) = Size == SIZE_WORD ? (int16_t)data : data;
+            address += sizeInBytes(Size);
+        }
+    }
 
-            if (direction == 0) {
-                for (int i = 0; i < 8; i++) {
-                    if (((registerListMask >> i) & 1) == 1) {
-                        if (DEBUG_MODE)
-                            cout << "Uploading data register: " << i << endl;
-                        if (size == SIZE_WORD) {
-                            memory->writeWordToMemory((uint16_t)D[i], A[reg], offset + longDisplacement);
-                            offset += 2;
-                        }
-                        else {
-                            memory->writeLongToMemory(D[i], A[reg], offset + longDisplacement);
-                            offset += 4;
-                        }
-                    }
-                }
+    if (Mode == ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_POSTINCREMENT)
+        A[reg] = address;
+    return true;
+}
 
-                for (int i = 0; i < 8; i++) {
-                    if (((registerListMask >> (i + 8)) & 1) == 1) {
-                        if (DEBUG_MODE)
-                            cout << "Uploading address register: " << i << endl;
-                        if (size == SIZE_WORD) {
-                            memory->writeWordToMemory((uint16_t)A[i], A[reg], offset + longDisplacement);
-                            offset += 2;
-                        }
-                        else {
-                            memory->writeLongToMemory(A[i], A[reg], offset + longDisplacement);
-                            offset += 4;
-                        }
-                    }
-                }
-            }
-            else {
-                for (int i = 0; i < 8; i++) {
-                    if (((registerListMask >> i) & 1) == 1) {
-                        if (DEBUG_MODE)
-                            cout << "Downloading data register: " << i << endl;
-                        if (size == SIZE_WORD) {
-                            D[i] = memory->readWordFromMemory(A[reg], offset + longDisplacement);
-                            offset += 2;
-                        }
-                        else {
-                            D[i] = memory->readLongFromMemory(A[reg], offset + longDisplacement);
-                            offset += 4;
-                        }
-                    }
-                }
+// MOVE from SR (Move from the Status Register, Privileged Instruction from the 68010 on)
+template<int Mode, int Privileged>
+bool CPUCore::executeMOVEFromSR(uint16_t instruction)
+{
+    if (Privileged && !isSupervisor())
+        return privilegeViolation();
 
-                for (int i = 0; i < 8; i++) {
-                    if (((registerListMask >> i) & 1) == 1) {
-                        if (DEBUG_MODE)
-                            cout << "Downloading address register: " << i << endl;
-                        if (size == SIZE_WORD) {
-                            A[i] = memory->readWordFromMemory(A[reg], offset + longDisplacement);
-                            offset += 2;
-                        }
-                        else {
-                            A[i] = memory->readLongFromMemory(A[reg], offset + longDisplacement);
-                            offset += 4;
-                        }
-                    }
-                }
-            }
-            break;
-        case ADDRESS_MODE_OTHERS:
-            switch (reg) {
-            case ADDRESS_MODE_ABSOLUTE_SHORT:
-                PC += 2;
-                absoluteAddress = memory->readWordFromMemory(PC);
-                if (direction == 0) {
-                    for (int i = 0; i < 8; i++) {
-                        if (((registerListMask >> i) & 1) == 1) {
-                            if (DEBUG_MODE)
-                                cout << "Uploading data register: " << i << endl;
-                            if (size == SIZE_WORD) {
-                                memory->writeWordToMemory((uint16_t)D[i], absoluteAddress, offset);
-                                offset += 2;
-                            }
-                            else {
-                                memory->writeLongToMemory(D[i], absoluteAddress, offset);
-                                offset += 4;
-                            }
-                        }
-                    }
-
-                    for (int i = 0; i < 8; i++) {
-                        if (((registerListMask >> (i + 8)) & 1) == 1) {
-                            if (DEBUG_MODE)
-                                cout << "Uploading address register: " << i << endl;
-                            if (size == SIZE_WORD) {
-                                memory->writeWordToMemory((uint16_t)A[i], absoluteAddress, offset);
-                                offset += 2;
-                            }
-                            else {
-                                memory->writeLongToMemory(A[i], absoluteAddress, offset);
-                                offset += 4;
-                            }
-                        }
-                    }
-                }
-                else {
-                    for (int i = 0; i < 8; i++) {
-                        if (((registerListMask >> i) & 1) == 1) {
-                            if (DEBUG_MODE)
-                                cout << "Downloading data register: " << i << endl;
-                            if (size == SIZE_WORD) {
-                                D[i] = memory->readWordFromMemory(absoluteAddress, offset);
-                                offset += 2;
-                            }
-                            else {
-                                D[i] = memory->readLongFromMemory(absoluteAddress, offset);
-                                offset += 4;
-                            }
-                        }
-                    }
-
-                    for (int i = 0; i < 8; i++) {
-                        if (((registerListMask >> i) & 1) == 1) {
-                            if (DEBUG_MODE)
-                                cout << "Downloading address register: " << i << endl;
-                            if (size == SIZE_WORD) {
-                                A[i] = memory->readWordFromMemory(absoluteAddress, offset);
-                                offset += 2;
-                            }
-                            else {
-                                A[i] = memory->readLongFromMemory(absoluteAddress, offset);
-                                offset += 4;
-                            }
-                        }
-                    }
-                }
-                break;
-            case ADDRESS_MODE_ABSOLUTE_LONG:
-                PC += 2;
-                absoluteAddress = memory->readLongFromMemory(PC);
-                if (direction == 0) {
-                    for (int i = 0; i < 8; i++) {
-                        if (((registerListMask >> i) & 1) == 1) {
-                            if (DEBUG_MODE)
-                                cout << "Uploading data register: " << i << endl;
-                            if (size == SIZE_WORD) {
-                                memory->writeWordToMemory((uint16_t)D[i], absoluteAddress, offset);
-                                offset += 2;
-                            }
-                            else {
-                                memory->writeLongToMemory(D[i], absoluteAddress, offset);
-                                offset += 4;
-                            }
-                        }
-                    }
-
-                    for (int i = 0; i < 8; i++) {
-                        if (((registerListMask >> (i + 8)) & 1) == 1) {
-                            if (DEBUG_MODE)
-                                cout << "Uploading address register: " << i << endl;
-                            if (size == SIZE_WORD) {
-                                memory->writeWordToMemory((uint16_t)A[i], absoluteAddress, offset);
-                                offset += 2;
-                            }
-                            else {
-                                memory->writeLongToMemory(A[i], absoluteAddress, offset);
-                                offset += 4;
-                            }
-                        }
-                    }
-                }
-                else {
-                    for (int i = 0; i < 8; i++) {
-                        if (((registerListMask >> i) & 1) == 1) {
-                            if (DEBUG_MODE)
-                                cout << "Downloading data register: " << i << endl;
-                            if (size == SIZE_WORD) {
-                                D[i] = memory->readWordFromMemory(absoluteAddress, offset);
-                                offset += 2;
-                            }
-                            else {
-                                D[i] = memory->readLongFromMemory(absoluteAddress, offset);
-                                offset += 4;
-                            }
-                        }
-                    }
-
-                    for (int i = 0; i < 8; i++) {
-                        if (((registerListMask >> i) & 1) == 1) {
-                            if (DEBUG_MODE)
-                                cout << "Downloading address register: " << i << endl;
-                            if (size == SIZE_WORD) {
-                                A[i] = memory->readWordFromMemory(absoluteAddress, offset);
-                                offset += 2;
-                            }
-                            else {
-                                A[i] = memory->readLongFromMemory(absoluteAddress, offset);
-                                offset += 4;
-                            }
-                        }
-                    }
-                }
-                PC += 2;
-                break;
-            case ADDRESS_MODE_PROGRAM_COUNTER_WITH_DISPLACEMENT:
-                if (direction == 0) {
-                    cout << "Invalid addressing mode." << endl;
-                    return false;
-                }
+    evaluateFlags();
+    writeOperand<SIZE_WORD, Mode>(SR, instruction & 7);
+    return true;
+}
 
-                PC += 2;
-                displacement = memory->readWordFromMemory(PC);
-                if (DEBUG_MODE)
-                    cout << "Displacement: " << displacement << endl;
-
-                for (int i = 0; i < 8; i++) {
-                    if (((registerListMask >> i) & 1) == 1) {
-                        if (DEBUG_MODE)
-                            cout << "Downloading data register: " << i << endl;
-                        if (size == SIZE_WORD) {
-                            D[i] = memory->readWordFromMemory(PC, offset + displacement);
-                            offset += 2;
-                        }
-                        else {
-                            D[i] = memory->readLongFromMemory(PC, offset + displacement);
-                            offset += 4;
-                        }
-                    }
-                }
+// MOVE from CCR (Move from the Condition Codes, zero extended to a word. 68010 and later.)
+template<int Mode>
+bool CPUCore::executeMOVEFromCCR(uint16_t instruction)
+{
+    writeOperand<SIZE_WORD, Mode>(conditionCodes(), instruction & 7);
+    return true;
+}
 
-                for (int i = 0; i < 8; i++) {
-                    if (((registerListMask >> i) & 1) == 1) {
-                        if (DEBUG_MODE)
-                            cout << "Downloading address register: " << i << endl;
-                        if (size == SIZE_WORD) {
-                            A[i] = memory->readWordFromMemory(PC, offset + displacement);
-                            offset += 2;
-                        }
-                        else {
-                            A[i] = memory->readLongFromMemory(PC, offset + displacement);
-                            offset += 4;
-                        }
-                    }
-                }
-                break;
-            case ADDRESS_MODE_PROGRAM_COUNTER_WITH_INDEX:
-                if (direction == 0) {
-                    cout << "Invalid addressing mode." << endl;
-                    return false;
-                }
+// MOVE to CCR (Move to the Condition Codes, from the low byte of a word)
+template<int Mode>
+bool CPUCore::executeMOVEToCCR(uint16_t instruction)
+{
+    setConditionCodes(readOperand<SIZE_WORD, Mode>(instruction & 7), 0x1F);
+    return true;
+}
 
-                PC += 2;
-                indexRegister = (memory->readByteFromMemory(PC) >> 4) & 0x0F;
-                indexSize = memory->readByteFromMemory(PC) & 0x0F;
-                longDisplacement = memory->readByteFromMemory(PC + 1);
-                if (indexRegister <= 7) {
-                    if (indexSize == INDEX_SIZE_WORD) {
-                        longDisplacement += (int16_t)D[indexRegister];
-                    }
-                    else
-                        longDisplacement += D[indexRegister];
-                }
-                else {
-                    if (indexSize == INDEX_SIZE_WORD) {
-                        longDisplacement += (int16_t)A[indexRegister - 8];
-                    }
-                    else
-                        longDisplacement += D[indexRegister - 8];
-                }
+// MOVE to SR (Move to the Status Register, Privileged Instruction)
+template<int Mode>
+bool CPUCore::executeMOVEToSR(uint16_t instruction)
+{
+    if (!isSupervisor())
+        return privilegeViolation();
 
-                for (int i = 0; i < 8; i++) {
-                    if (((registerListMask >> i) & 1) == 1) {
-                        if (DEBUG_MODE)
-                            cout << "Downloading data register: " << i << endl;
-                        if (size == SIZE_WORD) {
-                            D[i] = memory->readWordFromMemory(PC, offset + displacement);
-                            offset += 2;
-                        }
-                        else {
-                            D[i] = memory->readLongFromMemory(PC, offset + displacement);
-                            offset += 4;
-                        }
-                    }
-                }
+    writeStatusRegister(readOperand<SIZE_WORD, Mode>(instruction & 7));
+    return true;
+}
 
-                for (int i = 0; i < 8; i++) {
-                    if (((registerListMask >> i) & 1) == 1) {
-                        if (DEBUG_MODE)
-                            cout << "Downloading address register: " << i << endl;
-                        if (size == SIZE_WORD) {
-                            A[i] = memory->readWordFromMemory(PC, offset + displacement);
-                            offset += 2;
-                        }
-                        else {
-                            A[i] = memory->readLongFromMemory(PC, offset + displacement);
-                            offset += 4;
-                        }
-                    }
-                }
-                break;
-            default:
-                cout << "Invalid addressing mode." << endl;
-                return false;
-                break;
-            }
-            break;
-        default:
-            cout << "Invalid addressing mode." << endl;
-            return false;
-            break;
-        }
+// MOVE USP (Move to or from the User Stack Pointer, Privileged Instruction). Bit 3 is set for USP,An.
+bool CPUCore::executeMOVEUSP(uint16_t instruction)
+{
+    if (!isSupervisor())
+        return privilegeViolation();
+
+    if (((instruction >> 3) & 1) == 1)
+        A[instruction & 7] = inactiveStackPointer;
+    else
+        inactiveStackPointer = A[instruction & 7];
+    return true;
+}
 
-        return true;
+// EXG (Exchange Registers)
+bool CPUCore::executeEXG(uint16_t instruction)
+{
+    int register1 = (instruction >> 9) & 7;
+    int register2 = instruction & 7;
+    uint32_t temp;
+
+    switch (instruction & 0xF1F8) {
+    case EXG_DATA_REGISTERS:
+        temp = D[register1];
+        D[register1] = D[register2];
+        D[register2] = temp;
+        break;
+    case EXG_ADDRESS_REGISTERS:
+        temp = A[register1];
+        A[register1] = A[register2];
+        A[register2] = temp;
+        break;
+    default:
+        temp = D[register1];
+        D[register1] = A[register2];
+        A[register2] = temp;
+        break;
     }
+    return true;
+}
 
-    // MOVE_FROM_SR (Move from the Status Register)
-    if ((instruction & 0xFFC0) == MOVE_FROM_SR) {
-        int mode = ((instruction >> 3) & 7);
-        int reg = (instruction & 7);
+// SWAP (Swap Register Halves)
+bool CPUCore::executeSWAP(uint16_t instruction)
+{
+    int reg = instruction & 7;
 
-        if (DEBUG_MODE) {
-            cout << "WE HAVE A MOVE BYTE" << endl;
-            cout << "Mode is: " << mode << endl;
-            cout << "Address register is: " << reg << endl;
-        }
+    D[reg] = (D[reg] << 16) | (D[reg] >> 16);
+    setLogicalFlags<SIZE_LONG>(D[reg]);
+    return true;
+}
 
-        switch (mode) {
-        case ADDRESS_MODE_DATA_REGISTER_DIRECT:
-            D[reg] = SR;
-            break;
-        case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT:
-            memory->writeWordToMemory(SR, A[reg]);
-            break;
-        case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_POSTINCREMENT:
-            memory->writeWordToMemory(SR, A[reg]);
-            A[reg] += 2;
-            break;
-        case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_PREDECREMENT:
-            A[reg] -= 2;
-            memory->writeWordToMemory(SR, A[reg]);
-            break;
-        case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_DISPLACEMENT:
-            PC += 2;
-            displacement = memory->readWordFromMemory(PC);
-            if (DEBUG_MODE)
-                cout << "Displacement: " << displacement << endl;
-            memory->writeWordToMemory(SR, A[reg], displacement);
-            break;
-        case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_INDEX:
-            PC += 2;
-            indexRegister = (memory->readByteFromMemory(PC) >> 4) & 0x0F;
-            indexSize = memory->readByteFromMemory(PC) & 0x0F;
-            longDisplacement = memory->readByteFromMemory(PC + 1);
-            if (indexRegister <= 7) {
-                if (indexSize == INDEX_SIZE_WORD) {
-                    longDisplacement += (int16_t)D[indexRegister];
-                }
-                else
-                    longDisplacement += D[indexRegister];
-            }
-            else {
-                if (indexSize == INDEX_SIZE_WORD) {
-                    longDisplacement += (int16_t)A[indexRegister - 8];
-                }
-                else
-                    longDisplacement += D[indexRegister - 8];
-            }
-            memory->writeWordToMemory(SR, A[reg], longDisplacement);
-            break;
-        case ADDRESS_MODE_OTHERS:
-            switch (reg) {
-            case ADDRESS_MODE_ABSOLUTE_SHORT:
-                PC += 2;
-                absoluteAddress = memory->readWordFromMemory(PC);
-                memory->writeWordToMemory(SR, absoluteAddress);
-                break;
-            case ADDRESS_MODE_ABSOLUTE_LONG:
-                PC += 2;
-                absoluteAddress = memory->readLongFromMemory(PC);
-                memory->writeWordToMemory(SR, absoluteAddress);
-                PC += 2;
-                break;
-            default:
-                cout << "Invalid addressing mode" << endl;
-                return false;
-                break;
-            }
-            break;
+// RESET (Reset External Devices, Privileged Instruction). There are no devices to reset.
+bool CPUCore::executeRESET(uint16_t instruction)
+{
+    if (!isSupervisor())
+        return privilegeViolation();
+    return true;
+}
 
-        default:
-            cout << "Unrecognised addressing mode" << endl;
-            return false;
-            break;
-        }
+// STOP Load Status Register and Stop (Privileged Instruction)
+bool CPUCore::executeSTOP(uint16_t instruction)
+{
+    if (!isSupervisor())
+        return privilegeViolation();
+
+    if (tracing)
+        cout << "STOP" << endl;
+    writeStatusRegister(fetchWord());
 
+    // An interrupt the new mask lets through is taken straight away, returning after the STOP
+    if (interruptPending)
         return true;
-    }
+    stopped = true;
+    return stopExecution(STOP_STOPPED);
+}
 
-    // EXG (Exchange Registers)
-    if ((instruction & 0xF100) == EXG) {
-        int register1 = (instruction >> 9) & 7;
-        int register2 = instruction & 7;
-        int mode = (instruction >> 3) & 0x1F;
+// TRAPV (Trap on Overflow)
+bool CPUCore::executeTRAPV(uint16_t instruction)
+{
+    if (testCondition<CONDITIONAL_OVERFLOW_SET>())
+        return exception(VECTOR_TRAPV, PC);
+    return true;
+}
 
-        if (DEBUG_MODE) {
-            cout << "We have an exchange" << endl;
-            cout << "Register 1: " << register1 << " Register 2: " << register2 << " Mode: " << mode << endl;
-        }
+// Opcodes starting with $A, which take the line 1010 emulator exception
+bool CPUCore::executeLineA(uint16_t instruction)
+{
+    return exception(VECTOR_LINE_A, PC - 2);
+}
 
-        if (mode == 8) {
-            uint32_t temp = D[register1];
-            D[register1] = D[register2];
-            D[register2] = temp;
-        }
-        else if (mode == 9) {
-            uint32_t temp = A[register1];
-            A[register1] = A[register2];
-            A[register2] = temp;
-        }
-        else {
-            uint32_t temp = D[register1];
-            D[register1] = A[register2];
-            A[register2] = temp;
-        }
-        return true;
-    }
+// Opcodes starting with $F, which take the line 1111 emulator exception
+bool CPUCore::executeLineF(uint16_t instruction)
+{
+    return exception(VECTOR_LINE_F, PC - 2);
+}
+
+// Illegal instruction. Takes the illegal instruction exception when the program has set up its
+// vector, and otherwise stops.
+bool CPUCore::illegalInstruction(uint16_t instruction)
+{
+    if (memory->readLongFromMemory(VECTOR_ILLEGAL_INSTRUCTION * 4) != 0)
+        return exception(VECTOR_ILLEGAL_INSTRUCTION, PC - 2);
 
-    // SWAP (Swap Register Halves)
-    if ((instruction & 0xFFF8) == SWAP) {
-        int reg = instruction & 7;
+    cout << endl << "Illegal instruction " << uppercase << hex << instruction << " at address: " << PC - 2 << endl;
+    return stopExecution(STOP_ILLEGAL_INSTRUCTION);
+}
 
-        if (DEBUG_MODE) {
-            cout << "We have a swap" << endl;
-            cout << "Register: " << reg << endl;
-        }
+// Instructions the 68060 leaves to software, which take the unimplemented integer instruction
+// exception with PC at the instruction
+bool CPUCore::unimplementedInteger(uint16_t instruction)
+{
+    return exception(VECTOR_UNIMPLEMENTED_INTEGER, PC - 2);
+}
 
-        SR &= ~(1 << SR_CCR_OVERFLOW);
-        SR &= ~(1 << SR_CCR_CARRY);
+// Stands in for the handler of an instruction at a breakpoint. Stops with PC at the instruction,
+// unless run is resuming from it, when the instruction runs as normal.
+bool CPUCore::executeBreakpoint(uint16_t instruction)
+{
+    if (PC - 2 == resumeAddress) {
+        resumeAddress = INSTRUCTION_CACHE_EMPTY;
+        return (this->*handlerFor(instruction))(instruction);
+    }
 
-        uint16_t temp = D[reg] >> 16;
-        D[reg] = D[reg] << 16;
-        D[reg] += temp;
+    PC -= 2;
+    return stopExecution(STOP_BREAKPOINT);
+}
 
-        D[reg] == 0 ? SR |= 1 << SR_CCR_ZERO : SR &= ~(1 << SR_CCR_ZERO);
-        ((D[reg] >> 31) & 1) == 1 ? SR |= 1 << SR_CCR_NEGATIVE : SR &= ~(1 << SR_CCR_NEGATIVE);
+// Stands in for a branch that closes an idle loop, for the interpreters stepping instructions from
+// the instruction cache. The loop is walked again each time it is taken, as its body may have been
+// written over since the branch was decoded.
+bool CPUCore::executeIdleBranch(uint16_t instruction)
+{
+    uint32_t branch = PC - 2;
+    size_t instructions;
+    uint32_t cycles;
 
+    (this->*instructionTable[instruction].handler)(instruction);
+    if (PC > branch || !idleLoopEndingAt(branch, instruction, PC, instructions, cycles))
         return true;
-    }
+    return waitForEvent(instructions, cycles);
+}
 
-    // STOP Load Status Register and Stop (Privileged Instruction)
-    if (instruction == STOP) {
-        if (((SR >> SR_SUPERVISOR_MODE) & 1) == 1) {
-            if (DEBUG_MODE)
-                cout << "STOP" << endl;
-            PC += 2;
-            SR = memory->readWordFromMemory(PC);
-            PC += 2;
-            return false;
-        }
-        else {
-            // TRAP HERE
-            cout << "Permission denied." << endl;
-            return false;
-        }
-    }
+// Stands in for the handler of a TRAP, A-line or F-line opcode the host has bound a function to
+bool CPUCore::executeHostHandler(uint16_t instruction)
+{
+    auto handler = hostHandlers.find(instruction);
 
-    // Illegal instruction
-    cout << endl << "Illegal instruction " << uppercase << hex << instruction << " at address: " << PC << endl;
-    return false;
+    if (handler == hostHandlers.end())
+        return (this->*instructionTable[instruction].handler)(instruction);
+    if (!handler->second(*this, instruction))
+        return stopExecution(STOP_HALTED);
+    return true;
 }
 
 void CPUCore::writeByteToDataRegister(uint8_t data, int reg)
@@ -4341,6 +3539,12 @@ void CPUCore::writeLongToAddressRegister(uint32_t data, int reg)
 void CPUCore::setProgramCounter(unsigned int memoryLocation) 
 {
     PC = memoryLocation;
+    stopped = false;
+}
+
+uint32_t CPUCore::getProgramCounter()
+{
+    return PC;
 }
 
 void CPUCore::setAllRegisters(uint32_t value)
@@ -4371,8 +3575,85 @@ void CPUCore::setAddressRegister(int reg, uint32_t data)
     A[reg] = data;
 }
 
+uint64_t CPUCore::getInstructionCacheHits()
+{
+    return instructionCacheHits;
+}
+
+uint64_t CPUCore::getInstructionCacheMisses()
+{
+    return instructionCacheMisses;
+}
+
+uint64_t CPUCore::getTierExecutions(tiers tier)
+{
+    return tierExecutions[tier];
+}
+
+uint64_t CPUCore::getIdleWaitCount()
+{
+    return idleWaits;
+}
+
+uint64_t CPUCore::getCycleCount()
+{
+    return cycleCount;
+}
+
+size_t CPUCore::getTranslatedBlockCount()
+{
+    return translatedBlocks.size();
+}
+
+size_t CPUCore::getCompiledBlockCount()
+{
+    size_t count = 0;
+
+    for (const auto &block : translatedBlocks) {
+        if (block.second->native != nullptr)
+            count++;
+    }
+    return count;
+}
+
+size_t CPUCore::getEliminatedFlagUpdates()
+{
+    size_t count = 0;
+
+    for (const auto &block : translatedBlocks) {
+        if (block.second->native != nullptr)
+            count += block.second->nativeFlagUpdatesEliminated;
+    }
+    return count;
+}
+
+uint16_t CPUCore::getStatusRegister()
+{
+    evaluateFlags();
+    return SR;
+}
+
+void CPUCore::setStatusRegister(uint16_t data)
+{
+    SR = data;
+    flagOperation = FLAGS_EVALUATED;
+    updateInterruptPending();
+}
+
+CPUState CPUCore::getState()
+{
+    return *this;
+}
+
+void CPUCore::setState(const CPUState &state)
+{
+    static_cast<CPUState &>(*this) = state;
+    updateInterruptPending();
+}
+
 void CPUCore::displayInfo()
 {
+    evaluateFlags();
     cout << dec << "Model: Motorola MC" << model << std::uppercase << endl << endl;
     cout << setfill('-') << setw(83) << "-" << endl;
     cout << setfill(' ') << std::left << setw(17) << "Register" << setw(17) << "Decimal" << setw(17) << "Hex" << setw(17) << "Binary" << endl;
@@ -4396,4 +3677,5 @@ void CPUCore::displayInfo()
     cout << setfill(' ') << std::left << setw(17) << "PC" << setw(17) << dec << PC << setw(17) << hex << PC << setw(17) << bitset<32>(PC) << endl;
     cout << setfill(' ') << std::left << setw(17) << "SR" << setw(17) << dec << SR << setw(17) << hex << SR << setw(17) << bitset<32>(SR) << endl;
     cout << "                                                                   T S  III   XNZVC" << dec << endl << endl;
+    cout << "Instruction cache: " << instructionCacheHits << " hits, " << instructionCacheMisses << " misses" << endl << endl;
 }
@@ -1,17 +1,121 @@
 #pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
 #include <cstdint>
+#include <functional>
+#include <iosfwd>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
 #include "Memory.h"
+#include "EventScheduler.h"
 
 #define SP A[7]
+// Largest number of extension words following a 68000 opcode (MOVE.L with two absolute long operands)
+#define MAX_EXTENSION_WORDS 4
+// Instruction budget for run that never runs out
+#define RUN_UNLIMITED UINT64_MAX
 
-class CPUCore
+class JitCompiler;
+class Disassembler;
+class StaticRecompiler;
+
+// The architectural state of the CPU in one trivially copyable block, so that saving, restoring or
+// switching it is a single copy. The register file fills the first cache line on its own.
+struct alignas(64) CPUState
 {
-private:
-    uint32_t D[8]; // Data registers
-    uint32_t A[8]; // Address registers + SP
+    // D0-D7 followed by A0-A7, so a register is indexed by the 4-bit number made of the mode bit
+    // and register field of an opcode or extension word without a test on which kind it is
+    union {
+        uint32_t registers[16];
+        struct {
+            uint32_t D[8]; // Data registers
+            uint32_t A[8]; // Address registers + SP
+        };
+    };
     uint32_t PC; // Program Counter register
-    uint16_t SR; // Status register
+    // Status register. Its condition codes and system byte (trace, supervisor and interrupt mask)
+    // overlay it as bytes of their own, so the flags are stored without masking the rest of SR.
+    union {
+        uint16_t SR;
+        struct {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+            uint8_t systemByte;
+            uint8_t CCR;
+#else
+            uint8_t CCR;
+            uint8_t systemByte;
+#endif
+        };
+    };
+    // STOP has run and the CPU is waiting for an interrupt
+    bool stopped = false;
+    // The stack pointer not in use: the user stack pointer in supervisor mode and the supervisor
+    // stack pointer in user mode. The two are swapped whenever the supervisor bit changes.
+    uint32_t inactiveStackPointer;
+    // The condition codes are evaluated lazily: the last operation that set them is recorded with
+    // its operands and result, and the flags in SR are only brought up to date when they are read
+    int flagOperation;
+    int flagSize;
+    uint32_t flagSource;
+    uint32_t flagDestination;
+    uint32_t flagResult;
+};
 
+// The CPU is its architectural state plus the caches, tables and run loop state working on it.
+// Handlers reach the state's members directly, as members of their own.
+class CPUCore : private CPUState
+{
+    friend class JitCompiler;
+    friend class Disassembler;
+    friend class StaticRecompiler;
+public:
+    // The ways of running a program: an instruction at a time, in translated basic blocks, with
+    // the computed goto loop, which needs GCC or Clang and otherwise steps instructions, in basic
+    // blocks with hot ones compiled to x86-64 code, which runs as plain basic blocks on other hosts,
+    // or in tiers, moving code from stepping to blocks to compiled code as it gets hot
+    enum interpreters {
+        INTERPRETER_STEP,
+        INTERPRETER_BLOCKS,
+        INTERPRETER_THREADED,
+        INTERPRETER_JIT,
+        INTERPRETER_TIERED
+    };
+    // The tiers code runs in: stepped an instruction at a time, as a translated block, or compiled
+    enum tiers {
+        TIER_INTERPRETED,
+        TIER_TRANSLATED,
+        TIER_COMPILED,
+        TIER_COUNT
+    };
+    // Why run returned: the budget ran out, the program ran STOP or ended itself with TRAP #15 task 9,
+    // it reached something it cannot go on from, such as an illegal instruction or an exception with
+    // no vector set up, it reached a breakpoint, it is waiting for keyboard input, or another thread
+    // called wake while it waited in an idle loop
+    enum stopReasons {
+        STOP_BUDGET_EXHAUSTED,
+        STOP_STOPPED,
+        STOP_HALTED,
+        STOP_ILLEGAL_INSTRUCTION,
+        STOP_BREAKPOINT,
+        STOP_PENDING_IO,
+        STOP_WOKEN
+    };
+    // What a budget given to run counts
+    enum budgetUnits {
+        BUDGET_INSTRUCTIONS,
+        BUDGET_CYCLES
+    };
+    // A host function run in place of a TRAP, A-line or F-line opcode, with PC at the word after
+    // the opcode. It works on the CPU through its public interface, and returns false to stop run
+    // with STOP_HALTED.
+    typedef std::function<bool(CPUCore &cpu, uint16_t opcode)> HostHandler;
+
+private:
     enum models {
         MC68000 = 68000,
         MC68010 = 68010,
@@ -19,10 +123,322 @@ private:
         MC68040 = 68040,
         MC68060 = 68060
     } model;
+    // The 68010 and later push a format and vector offset word below PC in exception stack
+    // frames, and RTE reads it back
+    bool exceptionFormatWord;
+    // Mask of the scale field of the brief extension word, which the 68000 and 68010 ignore and
+    // the 68020 and later shift the index register by
+    uint16_t indexScaleMask;
+
+    interpreters interpreter = INTERPRETER_BLOCKS;
+    // Prints each instruction as it runs. Checked once per instruction, so it costs a single branch when off.
+    bool tracing;
 
     Memory *memory = nullptr;
 
-    bool decodeInstruction(uint16_t instruction);
+    // Instruction handlers execute one opcode and return false when execution should stop
+    typedef bool (CPUCore::*InstructionHandler)(uint16_t instruction);
+    // What the dispatch table knows about an opcode: its handler and how many extension words follow it
+    struct InstructionEntry {
+        InstructionHandler handler;
+        int extensionWords;
+        bool endsBlock; // Branches, jumps, returns, traps and anything that stops the CPU
+        bool canStop; // The handler can return false
+        uint8_t instruction; // One of the INSTRUCTION_ values
+        uint8_t cycles; // 68000 clock cycles, before any that depend on the data
+    };
+    // Dispatch table indexed directly by the 16-bit opcode, built for the CPU's model
+    const InstructionEntry *instructionTable = nullptr;
+
+    // An instruction decoded once and kept for later executions at the same address
+    struct DecodedInstruction {
+        InstructionHandler handler;
+        uint32_t address; // Address of the opcode, or an odd address when the entry is empty
+        uint16_t opcode;
+        uint8_t length; // Length in bytes including the extension words
+        uint8_t threadedLabel; // Where runThreaded jumps to for this instruction
+        uint8_t cycles; // Taken from the dispatch entry, and charged before the handler runs
+        uint16_t extensionWords[MAX_EXTENSION_WORDS];
+    };
+    // Direct mapped cache of decoded instructions indexed by the program counter
+    std::vector<DecodedInstruction> instructionCache;
+    // Extension words of the executing instruction not yet consumed by fetchWord and fetchLong
+    const uint16_t *nextExtensionWord = nullptr;
+    uint64_t instructionCacheHits = 0;
+    uint64_t instructionCacheMisses = 0;
+
+    // Compiled code for the start of a block, which runs on the register file starting at D0 and
+    // leaves PC at the first instruction it did not run
+    typedef void (*NativeBlock)(uint32_t *registers);
+
+    // A loop over memory recognised when its block is translated, and run in one go on the host
+    struct MemoryIdiom {
+        int kind; // One of the IDIOM_ values
+        int size; // Size of each element filled or copied
+        int counter; // Data register counted down to zero by fill and copy loops
+        int counterSize;
+        int source; // Address registers read from and written to
+        int destination;
+        int valueRegister; // Data register holding the value filled, found or loaded, or -1
+        uint32_t value; // Immediate value filled
+    };
+
+    // Straight-line instructions ending at a branch, jump, return or trap, executed as a unit
+    struct TranslatedBlock {
+        uint32_t address;
+        uint32_t endAddress;
+        std::vector<DecodedInstruction> instructions;
+        unsigned int executionCount = 0;
+        // Clock cycles of one pass through the block, and through the part of it that is compiled
+        uint32_t cycles = 0;
+        NativeBlock native = nullptr;
+        size_t nativeInstructionCount = 0;
+        uint32_t nativeCycles = 0;
+        // Condition code updates the compiled code leaves out, as later instructions set the flags first
+        size_t nativeFlagUpdatesEliminated = 0;
+        // The blocks last seen following this one. Their addresses are checked against PC before use.
+        TranslatedBlock *successors[2] = { nullptr, nullptr };
+        int nextSuccessor = 0;
+        // The block is a loop back to its own start that changes nothing, such as polling memory
+        bool idle = false;
+        MemoryIdiom idiom;
+    };
+    std::unordered_map<uint32_t, std::unique_ptr<TranslatedBlock>> translatedBlocks;
+    // Start addresses of the translated blocks overlapping each page, for checking writes against
+    std::unordered_map<uint32_t, std::vector<uint32_t>> blocksByPage;
+    // Set when a write hits a translated block. Blocks are only freed between instructions.
+    bool blockFlushPending = false;
+    // Compiles hot blocks when the JIT interpreter is selected
+    std::unique_ptr<JitCompiler> jit;
+    // Executions a block start needs in each tier before it moves up to the next
+    unsigned int translateThreshold;
+    unsigned int compileThreshold;
+    // Times each block start not yet translated has been reached by the tiered interpreter
+    std::unordered_map<uint32_t, unsigned int> blockHotness;
+    // Blocks run in each tier
+    uint64_t tierExecutions[TIER_COUNT] = {};
+    // Times the host thread slept in an idle loop, and what wakes it from another thread
+    uint64_t idleWaits = 0;
+    std::mutex wakeLock;
+    std::condition_variable wakeSignal;
+    std::atomic<bool> wakeRequested{ false };
+    // Passes compiled code may make through a block that loops on itself. Set before the code runs,
+    // which leaves it holding the passes it did not make.
+    uint32_t nativeLoopCounter = 0;
+
+    // 68000 clock cycles run since the CPU was made
+    uint64_t cycleCount = 0;
+    // Instructions left before run returns, the cycle count it returns at, and why the last
+    // handler to return false stopped
+    uint64_t instructionBudget = RUN_UNLIMITED;
+    uint64_t cycleLimit = RUN_UNLIMITED;
+    // Whether run was given an instruction budget. Without one, instructionBudget still counts
+    // down from RUN_UNLIMITED.
+    bool instructionBudgetGiven = false;
+    // Device events, and the cycle count the run loops next stop at: the earlier of the first
+    // event and cycleLimit
+    EventScheduler scheduler;
+    uint64_t nextDeadline = RUN_UNLIMITED;
+    // Interrupt levels devices are asserting, as bits 1 to 7, and whether level 7, which cannot be
+    // masked and is taken once each time it is asserted, has been asserted since it was last taken
+    uint8_t interruptLevels = 0;
+    bool nonMaskableInterrupt = false;
+    // An asserted level is above the interrupt mask in SR. Only worked out when either changes, and
+    // it sets nextDeadline to zero, so the run loops find it with the cycle count check they make anyway.
+    bool interruptPending = false;
+    stopReasons stopReason = STOP_BUDGET_EXHAUSTED;
+    // Addresses whose instructions are decoded to executeBreakpoint, and the one run resumed from,
+    // whose instruction runs once rather than stopping again
+    std::unordered_set<uint32_t> breakpoints;
+    uint32_t resumeAddress;
+    // Host functions bound to TRAP, A-line and F-line opcodes. Instructions are decoded to
+    // executeHostHandler when bound, so unbound ones cost nothing.
+    std::unordered_map<uint16_t, HostHandler> hostHandlers;
+    // Where TRAP #15 reads keyboard input, and whether it waits for it or returns STOP_PENDING_IO
+    std::istream *input;
+    bool waitForInput = true;
+
+    // An effective address resolved by resolveOperand: the register for the register direct
+    // modes, otherwise the guest address of the operand or the value of an immediate
+    struct Operand {
+        uint32_t *reg;
+        uint32_t address;
+    };
+
+    static const InstructionEntry *sharedInstructionTable(int model = MC68000);
+    static const InstructionEntry *buildInstructionTable(int model);
+    template<int FirstCount, int SecondCount, int ThirdCount, typename Factory>
+    static InstructionHandler instantiate(Factory factory, int first, int second, int third);
+    template<int SecondCount, int ThirdCount, typename Factory, int... Index>
+    static InstructionHandler instantiate(Factory factory, int index, std::integer_sequence<int, Index...>);
+    static InstructionHandler bindCLR(uint16_t opcode, int size, int mode);
+    static InstructionHandler bindJMP(uint16_t opcode, int size, int mode);
+    static InstructionHandler bindJSR(uint16_t opcode, int size, int mode);
+    static InstructionHandler bindLEA(uint16_t opcode, int size, int mode);
+    static InstructionHandler bindPEA(uint16_t opcode, int size, int mode);
+    static InstructionHandler bindMOVE(uint16_t opcode, int size, int mode);
+    static InstructionHandler bindArithmeticToRegister(uint16_t opcode, int size, int mode);
+    static InstructionHandler bindArithmeticToMemory(uint16_t opcode, int size, int mode);
+    static InstructionHandler bindArithmeticToAddress(uint16_t opcode, int size, int mode);
+    static InstructionHandler bindArithmeticImmediate(uint16_t opcode, int size, int mode);
+    static InstructionHandler bindArithmeticQuick(uint16_t opcode, int size, int mode);
+    static InstructionHandler bindExtendedArithmetic(uint16_t opcode, int size, int mode);
+    static InstructionHandler bindCMPM(uint16_t opcode, int size, int mode);
+    static InstructionHandler bindLogicalToRegister(uint16_t opcode, int size, int mode);
+    static InstructionHandler bindLogicalFromRegister(uint16_t opcode, int size, int mode);
+    static InstructionHandler bindLogicalImmediate(uint16_t opcode, int size, int mode);
+    static InstructionHandler bindLogicalToStatusRegister(uint16_t opcode, int size, int mode);
+    static InstructionHandler bindNEG(uint16_t opcode, int size, int mode);
+    static InstructionHandler bindNEGX(uint16_t opcode, int size, int mode);
+    static InstructionHandler bindNOT(uint16_t opcode, int size, int mode);
+    static InstructionHandler bindTST(uint16_t opcode, int size, int mode);
+    static InstructionHandler bindTAS(uint16_t opcode, int size, int mode);
+    static InstructionHandler bindNBCD(uint16_t opcode, int size, int mode);
+    static InstructionHandler bindBCD(uint16_t opcode, int size, int mode);
+    static InstructionHandler bindMultiply(uint16_t opcode, int size, int mode);
+    static InstructionHandler bindDivide(uint16_t opcode, int size, int mode);
+    static InstructionHandler bindCHK(uint16_t opcode, int size, int mode);
+    static InstructionHandler bindEXT(uint16_t opcode, int size, int mode);
+    static InstructionHandler bindShiftRegister(uint16_t opcode, int size, int mode);
+    static InstructionHandler bindShiftMemory(uint16_t opcode, int size, int mode);
+    static InstructionHandler bindBitOperation(uint16_t opcode, int size, int mode);
+    static InstructionHandler bindMOVEP(uint16_t opcode, int size, int mode);
+    static InstructionHandler bindScc(uint16_t opcode, int size, int mode);
+    static InstructionHandler bindDBcc(uint16_t opcode, int size, int mode);
+    static InstructionHandler bindBcc(uint16_t opcode, int size, int mode);
+    static InstructionHandler bindMOVEM(uint16_t opcode, int size, int mode);
+    static InstructionHandler bindMOVEFromSR(uint16_t opcode, int size, int mode);
+    static InstructionHandler bindMOVEFromSRPrivileged(uint16_t opcode, int size, int mode);
+    static InstructionHandler bindMOVEFromCCR(uint16_t opcode, int size, int mode);
+    static InstructionHandler bindMOVEToCCR(uint16_t opcode, int size, int mode);
+    static InstructionHandler bindMOVEToSR(uint16_t opcode, int size, int mode);
+    DecodedInstruction &decodedInstructionAt(uint32_t address);
+    void predecodeInstruction(uint32_t address, DecodedInstruction &decoded);
+    static bool branchTarget(Memory *memory, uint32_t address, uint16_t opcode, uint8_t instruction, uint32_t &target);
+    static bool endsControlFlow(uint8_t instruction);
+    InstructionHandler handlerFor(uint16_t opcode);
+    void bindHostHandler(uint16_t opcode, HostHandler handler);
+    void invalidateInstructions(uint32_t address);
+    TranslatedBlock *findBlock(uint32_t address);
+    TranslatedBlock *translateBlock(uint32_t address);
+    TranslatedBlock *successorBlock(TranslatedBlock *block);
+    bool isIdleLoop(const TranslatedBlock &block);
+    bool onlySetsFlags(uint16_t opcode);
+    bool idleLoopEndingAt(uint32_t branch, uint16_t opcode, uint32_t target, size_t &instructions, uint32_t &cycles);
+    int loopCondition(const TranslatedBlock &block);
+    int fallThroughCycles(const TranslatedBlock &block);
+    void recogniseIdiom(TranslatedBlock &block);
+    uint64_t executeIdiom(const TranslatedBlock &block, uint64_t maximumIterations);
+    bool waitForEvent(size_t instructions, uint32_t cycles);
+    void updateDeadline();
+    bool reachDeadline();
+    void updateInterruptPending();
+    bool takeInterrupt();
+    void waitForInterrupt();
+    void invalidateBlocks(uint32_t address);
+    void flushBlocks();
+    void runThreaded();
+    void runTiered();
+    void traceInstruction(const DecodedInstruction &decoded);
+    uint16_t fetchWord();
+    uint32_t fetchLong();
+    uint32_t indexedAddress(uint32_t base);
+    template<int Size, int Mode> uint32_t effectiveAddress(int reg);
+    template<int Size> uint32_t readMemory(uint32_t address);
+    template<int Size> void writeMemory(uint32_t address, uint32_t data);
+    template<int Size> void writeDataRegister(uint32_t data, int reg);
+    template<int Size, int Mode> Operand resolveOperand(int reg);
+    template<int Size, int Mode> uint32_t readOperand(const Operand &operand);
+    template<int Size, int Mode> void writeOperand(const Operand &operand, uint32_t data);
+    template<int Size, int Mode> uint32_t readOperand(int reg);
+    template<int Size, int Mode> void writeOperand(uint32_t data, int reg);
+    template<int Size> void setLogicalFlags(uint32_t result);
+    uint16_t conditionCodes();
+    void evaluateFlags();
+    template<int Operation, int Size> uint32_t arithmetic(uint32_t source, uint32_t destination);
+    template<int Operation, int Size, int DestinationMode> void arithmeticToOperand(uint32_t source, int reg);
+    template<int Operation, int Size> uint32_t extendedArithmetic(uint32_t source, uint32_t destination);
+    template<int Operation, int Size, int DestinationMode> void logicalToOperand(uint32_t source, int reg);
+    template<int Operation> uint8_t decimalArithmetic(uint8_t source, uint8_t destination);
+    template<int Type, int Left, int Size> uint32_t shift(uint32_t value, int count);
+    void setConditionCodes(uint16_t flags, uint16_t changed);
+    void writeStatusRegister(uint16_t data);
+    bool isSupervisor();
+    bool exception(int vector, uint32_t returnAddress);
+    bool privilegeViolation();
+    bool stopExecution(stopReasons reason);
+    bool awaitInput();
+    template<int Condition> bool testCondition();
+    int32_t branchDisplacement(uint16_t instruction);
+    uint32_t &registerByNumber(int number);
+
+    // Instruction handlers, specialised at compile time on operation, size and addressing modes
+    template<int Size, int Mode> bool executeCLR(uint16_t instruction);
+    template<int Mode> bool executeJMP(uint16_t instruction);
+    template<int Mode> bool executeJSR(uint16_t instruction);
+    template<int Size, int SourceMode, int DestinationMode> bool executeMOVE(uint16_t instruction);
+    bool executeMOVEQ(uint16_t instruction);
+    bool executeTRAP(uint16_t instruction);
+    bool executeTRAPV(uint16_t instruction);
+    bool executeNOP(uint16_t instruction);
+    template<int Mode> bool executeLEA(uint16_t instruction);
+    template<int Mode> bool executePEA(uint16_t instruction);
+    template<int Operation, int Size, int SourceMode> bool executeArithmeticToRegister(uint16_t instruction);
+    template<int Operation, int Size, int DestinationMode> bool executeArithmeticToMemory(uint16_t instruction);
+    template<int Operation, int Size, int SourceMode> bool executeArithmeticToAddress(uint16_t instruction);
+    template<int Operation, int Size, int DestinationMode> bool executeArithmeticImmediate(uint16_t instruction);
+    template<int Operation, int Size, int DestinationMode> bool executeArithmeticQuick(uint16_t instruction);
+    template<int Operation, int Size, int Mode> bool executeExtendedArithmetic(uint16_t instruction);
+    template<int Size> bool executeCMPM(uint16_t instruction);
+    template<int Operation, int Size, int SourceMode> bool executeLogicalToRegister(uint16_t instruction);
+    template<int Operation, int Size, int DestinationMode> bool executeLogicalFromRegister(uint16_t instruction);
+    template<int Operation, int Size, int DestinationMode> bool executeLogicalImmediate(uint16_t instruction);
+    template<int Operation, int Size> bool executeLogicalToStatusRegister(uint16_t instruction);
+    template<int Size, int Mode> bool executeNEG(uint16_t instruction);
+    template<int Size, int Mode> bool executeNEGX(uint16_t instruction);
+    template<int Size, int Mode> bool executeNOT(uint16_t instruction);
+    template<int Size, int Mode> bool executeTST(uint16_t instruction);
+    template<int Mode> bool executeTAS(uint16_t instruction);
+    template<int Mode> bool executeNBCD(uint16_t instruction);
+    template<int Operation, int Mode> bool executeBCD(uint16_t instruction);
+    template<int Signed, int SourceMode> bool executeMultiply(uint16_t instruction);
+    template<int Signed, int SourceMode> bool executeDivide(uint16_t instruction);
+    template<int SourceMode> bool executeCHK(uint16_t instruction);
+    template<int Size> bool executeEXT(uint16_t instruction);
+    template<int Type, int Left, int Size> bool executeShiftRegister(uint16_t instruction);
+    template<int Type, int Left, int Mode> bool executeShiftMemory(uint16_t instruction);
+    template<int Operation, int Mode, int Dynamic> bool executeBitOperation(uint16_t instruction);
+    template<int Size, int ToMemory> bool executeMOVEP(uint16_t instruction);
+    bool executeBSR(uint16_t instruction);
+    bool executeBRA(uint16_t instruction);
+    template<int Condition> bool executeBcc(uint16_t instruction);
+    template<int Condition> bool executeDBcc(uint16_t instruction);
+    template<int Condition, int Mode> bool executeScc(uint16_t instruction);
+    bool executeRTS(uint16_t instruction);
+    bool executeRTR(uint16_t instruction);
+    bool executeRTE(uint16_t instruction);
+    bool executeLINK(uint16_t instruction);
+    bool executeUNLK(uint16_t instruction);
+    template<int Size, int Mode> bool executeMOVEMToMemory(uint16_t instruction);
+    template<int Size, int Mode> bool executeMOVEMToRegisters(uint16_t instruction);
+    template<int Mode, int Privileged> bool executeMOVEFromSR(uint16_t instruction);
+    template<int Mode> bool executeMOVEFromCCR(uint16_t instruction);
+    template<int Mode> bool executeMOVEToCCR(uint16_t instruction);
+    template<int Mode> bool executeMOVEToSR(uint16_t instruction);
+    bool executeMOVEUSP(uint16_t instruction);
+    bool executeEXG(uint16_t instruction);
+    bool executeSWAP(uint16_t instruction);
+    bool executeRESET(uint16_t instruction);
+    bool executeSTOP(uint16_t instruction);
+    bool executeLineA(uint16_t instruction);
+    bool executeLineF(uint16_t instruction);
+    bool illegalInstruction(uint16_t instruction);
+    bool unimplementedInteger(uint16_t instruction);
+    bool executeBreakpoint(uint16_t instruction);
+    bool executeIdleBranch(uint16_t instruction);
+    bool executeHostHandler(uint16_t instruction);
+    bool easy68kTask();
+
     void writeByteToDataRegister(uint8_t data, int reg);
     void writeWordToDataRegister(uint16_t data, int reg);
     void writeLongToDataRegister(uint32_t data, int reg);
@@ -30,11 +446,72 @@ private:
     void writeWordToAddressRegister(uint16_t data, int reg);
     void writeLongToAddressRegister(uint32_t data, int reg);
 public:
+    // Makes a CPU of a model: 68000, 68010, 68020, 68040 or 68060. Anything else makes a 68000.
+    // The model picks the dispatch table, the address bus width and the form of exception stack
+    // frames once, here, rather than being tested as instructions run.
     CPUCore(Memory *memory, int model);
     ~CPUCore();
+    // Keeps the state on a cache line boundary, which plain new does not before C++17
+    static void *operator new(size_t size);
+    static void operator delete(void *pointer);
     bool startNextCycle();
+    // Executes the basic block at PC and the blocks chained after it. Returns false when execution
+    // stops or the instruction budget of run is used up.
+    bool executeBlock();
+    // Selects the interpreter used by run
+    void setInterpreter(interpreters interpreter);
+    // Runs the program until it stops or the budget of instructions or clock cycles has been used,
+    // and returns why it returned. A cycle budget is used up by the instruction that reaches it,
+    // so run may go over by part of an instruction. Calling it again carries on from where it left
+    // off, running the instruction at a breakpoint it stopped at rather than stopping there again.
+    // After STOP it waits for an interrupt, passing the time to each scheduled event in turn, and
+    // returns STOP_STOPPED again when none is taken.
+    stopReasons run(uint64_t budget = RUN_UNLIMITED, budgetUnits units = BUDGET_INSTRUCTIONS);
+    // Calls a function between instructions once the cycle count reaches a cycle, or straight
+    // away when it has already passed it. Returns an id for cancelEvent. Events only run inside run.
+    uint64_t scheduleEvent(uint64_t cycle, EventScheduler::Callback callback);
+    // Drops an event that has not run yet, returning false when there is no such event
+    bool cancelEvent(uint64_t id);
+    // Asserts an autovectored interrupt at a level from 1 to 7. It stays asserted, as a device holds
+    // its request line, until cleared, and is taken between instructions once it is above the
+    // interrupt mask in SR. Level 7 cannot be masked and is taken once each time it is asserted.
+    // Call from the thread running the CPU, such as from an event callback.
+    void assertInterrupt(int level);
+    void clearInterrupt(int level);
+    // Ends the wait of a program polling memory in an idle loop with nothing scheduled, making run
+    // return STOP_WOKEN so that the host can change memory or assert an interrupt on the CPU's
+    // thread before running on. It may be called from any thread. Called while the CPU is not
+    // waiting, it ends the next wait as soon as it starts.
+    void wake();
+    // Runs a host function in place of TRAP #vector, bypassing its exception vector. Binding
+    // TRAP #15 replaces the EASy68K I/O tasks. An empty function unbinds it again.
+    void bindTrap(int vector, HostHandler handler);
+    // Runs a host function in place of an A-line ($Axxx) or F-line ($Fxxx) opcode. Returns false
+    // for any other opcode. A handler must not unbind itself while it runs.
+    bool bindLineOpcode(uint16_t opcode, HostHandler handler);
+    // Follows the control flow from an entry point through branches, calls and jumps to fixed
+    // addresses, staying within ranges of loaded code given as start address and length, and
+    // predecodes every instruction it reaches into the instruction cache, so that the first run of
+    // each block decodes nothing. Instructions are decoded in the order they are found, up to as
+    // many as the cache holds, so code nearer the entry point keeps the entries it shares with
+    // code farther away. Returns the number of instructions found.
+    size_t predecodeReachable(uint32_t entryPoint, const std::vector<std::pair<uint32_t, uint32_t>> &ranges);
+    // Stops run before the instruction at an address executes
+    void addBreakpoint(uint32_t address);
+    void removeBreakpoint(uint32_t address);
+    // Reads TRAP #15 keyboard input from a stream rather than the console. When waitForInput is
+    // false and the stream has nothing buffered, run returns STOP_PENDING_IO with PC at the TRAP,
+    // which reads the input when run is called again.
+    void setInput(std::istream *stream, bool waitForInput);
+    // Sets how many times the tiered interpreter steps through a block before translating it, and
+    // how many times it runs a translated block before compiling it. The JIT interpreter uses the second.
+    void setTierThresholds(unsigned int translateThreshold, unsigned int compileThreshold);
+    // Turns instruction tracing on or off. It is on by default in debug builds.
+    void setTracing(bool enabled);
     void displayInfo();
     void setProgramCounter(unsigned int memoryLocation);
+    // Returns the address of the next instruction to run
+    uint32_t getProgramCounter();
     // Sets all data and address registers to a value. Used for testing.
     void setAllRegisters(uint32_t value);
     // Returns the contents of data register
@@ -45,5 +522,34 @@ public:
     void setDataRegister(int reg, uint32_t data);
     // Set the contents of data register
     void setAddressRegister(int reg, uint32_t data);
+    // Returns the number of instructions executed from the predecoded instruction cache
+    uint64_t getInstructionCacheHits();
+    // Returns the number of instructions that had to be decoded from memory
+    uint64_t getInstructionCacheMisses();
+    // Returns the number of blocks run in a tier, where a block compiled to loop on itself counts once
+    uint64_t getTierExecutions(tiers tier);
+    // Returns the 68000 clock cycles run so far. Loops run in one go as memory idioms or compiled
+    // code are charged each pass's table timing and the branch leaving the loop, without the
+    // costs that depend on the data.
+    uint64_t getCycleCount();
+    // Returns the number of times an idle loop put the host thread to sleep
+    uint64_t getIdleWaitCount();
+    // Returns the number of basic blocks currently translated
+    size_t getTranslatedBlockCount();
+    // Returns the number of translated blocks with compiled code
+    size_t getCompiledBlockCount();
+    // Returns the number of condition code updates left out of the compiled blocks because a later
+    // instruction in the same block sets the same flags before anything reads them
+    size_t getEliminatedFlagUpdates();
+    // Returns the contents of the status register
+    uint16_t getStatusRegister();
+    // Replaces the whole status register, condition codes included
+    void setStatusRegister(uint16_t data);
+    // Returns a copy of the registers, status register and STOP state, for snapshots and for
+    // switching between programs sharing the CPU
+    CPUState getState();
+    // Replaces the registers, status register and STOP state with a copy taken by getState. The
+    // caches are kept, since they depend on memory rather than on the state.
+    void setState(const CPUState &state);
 };
 
@@ -0,0 +1,554 @@
+#include "Disassembler.h"
+#include "M68kDefinitions.h"
+#include "ProgramLoader.h"
+
+#define WORD_COLUMN_WIDTH ((MAX_EXTENSION_WORDS + 1) * 5) // Room for the opcode and every extension word
+
+static const char *const mnemonics[] = {
+    "DC.W", "ABCD", "ADD", "ADDA", "ADDI", "ADDQ", "ADDX", "AND", "ANDI", "ANDI", "ANDI", "AS", "B", "BCHG", "BCLR",
+    "BRA", "BSET", "BSR", "BTST", "CHK", "CLR", "CMP", "CMPA", "CMPI", "CMPM", "DB", "DIVS", "DIVU", "EOR", "EORI",
+    "EORI", "EORI", "EXG", "EXT", "JMP", "JSR", "LEA", "DC.W", "DC.W", "LINK", "LS", "MOVE", "MOVE", "MOVE", "MOVE",
+    "MOVE", "MOVE", "MOVEM", "MOVEP", "MOVEQ", "MULS", "MULU", "NBCD", "NEG", "NEGX", "NOP", "NOT", "OR", "ORI", "ORI",
+    "ORI", "PEA", "RESET", "RO", "ROX", "RTE", "RTR", "RTS", "SBCD", "S", "STOP", "SUB", "SUBA", "SUBI", "SUBQ", "SUBX",
+    "SWAP", "TAS", "TRAP", "TRAPV", "TST", "UNLK"
+};
+static_assert(sizeof(mnemonics) / sizeof(mnemonics[0]) == INSTRUCTION_COUNT, "Every instruction needs a mnemonic");
+
+static const char *const conditionNames[] = {
+    "T", "F", "HI", "LS", "CC", "CS", "NE", "EQ", "VC", "VS", "PL", "MI", "GE", "LT", "GT", "LE"
+};
+
+static const char hexDigits[] = "0123456789ABCDEF";
+
+Disassembler::Disassembler(Memory *memory)
+{
+    this->memory = memory;
+    instructionTable = CPUCore::sharedInstructionTable();
+}
+
+uint16_t Disassembler::nextExtensionWord()
+{
+    uint16_t word = memory->readWordFromMemory(extensionAddress);
+    extensionAddress += 2;
+    return word;
+}
+
+uint32_t Disassembler::nextExtensionLong()
+{
+    uint32_t high = nextExtensionWord();
+    return (high << 16) | nextExtensionWord();
+}
+
+void Disassembler::appendText(const char *text)
+{
+    while (*text != 0)
+        *out++ = *text++;
+}
+
+void Disassembler::appendHex(uint32_t value, int digits)
+{
+    for (int shift = (digits - 1) * 4; shift >= 0; shift -= 4)
+        *out++ = hexDigits[(value >> shift) & 0xF];
+}
+
+// Appends a displacement as $n or -$n with as few digits as it needs
+void Disassembler::appendSignedHex(int32_t value)
+{
+    uint32_t magnitude = value < 0 ? 0 - (uint32_t)value : value;
+    int digits = 1;
+
+    if (value < 0)
+        *out++ = '-';
+    *out++ = '$';
+    while (digits < 8 && (magnitude >> (digits * 4)) != 0)
+        digits++;
+    appendHex(magnitude, digits);
+}
+
+// Appends a register by its number: D0-D7 are 0-7 and A0-A7 are 8-15
+void Disassembler::appendRegister(int reg)
+{
+    *out++ = reg < 8 ? 'D' : 'A';
+    *out++ = (char)('0' + (reg & 7));
+}
+
+void Disassembler::appendSize(int size)
+{
+    *out++ = '.';
+    *out++ = size == SIZE_BYTE ? 'B' : size == SIZE_WORD ? 'W' : 'L';
+}
+
+void Disassembler::appendEffectiveAddress(int mode, int reg, int size)
+{
+    uint32_t base;
+    uint16_t extension;
+    int16_t displacement;
+
+    switch (EA_MODE(mode, reg)) {
+    case ADDRESS_MODE_DATA_REGISTER_DIRECT:
+        appendRegister(reg);
+        break;
+    case ADDRESS_MODE_ADDRESS_REGISTER_DIRECT:
+        appendRegister(reg + 8);
+        break;
+    case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT:
+        *out++ = '(';
+        appendRegister(reg + 8);
+        *out++ = ')';
+        break;
+    case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_POSTINCREMENT:
+        *out++ = '(';
+        appendRegister(reg + 8);
+        appendText(")+");
+        break;
+    case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_PREDECREMENT:
+        appendText("-(");
+        appendRegister(reg + 8);
+        *out++ = ')';
+        break;
+    case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_DISPLACEMENT:
+        appendSignedHex((int16_t)nextExtensionWord());
+        *out++ = '(';
+        appendRegister(reg + 8);
+        *out++ = ')';
+        break;
+    case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_INDEX:
+    case EA_PROGRAM_COUNTER_WITH_INDEX:
+        extension = nextExtensionWord();
+        appendSignedHex((int8_t)(extension & 0xFF));
+        *out++ = '(';
+        if (mode == ADDRESS_MODE_OTHERS)
+            appendText("PC");
+        else
+            appendRegister(reg + 8);
+        *out++ = ',';
+        appendRegister(extension >> 12);
+        appendSize(((extension >> 8) & INDEX_SIZE_LONG) == INDEX_SIZE_WORD ? SIZE_WORD : SIZE_LONG);
+        *out++ = ')';
+        break;
+    case EA_ABSOLUTE_SHORT:
+        *out++ = '$';
+        appendHex(nextExtensionWord(), 4);
+        appendSize(SIZE_WORD);
+        break;
+    case EA_ABSOLUTE_LONG:
+        *out++ = '$';
+        appendHex(nextExtensionLong(), 8);
+        appendSize(SIZE_LONG);
+        break;
+    case EA_PROGRAM_COUNTER_WITH_DISPLACEMENT:
+        base = extensionAddress;
+        displacement = (int16_t)nextExtensionWord();
+        appendSignedHex(displacement);
+        appendText("(PC) ; $");
+        appendHex(base + displacement, 8);
+        break;
+    default:
+        appendText("#$");
+        if (size == SIZE_LONG)
+            appendHex(nextExtensionLong(), 8);
+        else
+            appendHex(nextExtensionWord() & sizeMask(size), size == SIZE_BYTE ? 2 : 4);
+        break;
+    }
+}
+
+// Appends a MOVEM register list such as D0-D3/A0/A6. The mask is reversed (bit 0 is A7) for predecrement.
+void Disassembler::appendRegisterList(uint16_t mask, bool reversed)
+{
+    bool first = true;
+
+    for (int reg = 0; reg < 16; reg++) {
+        if (((mask >> (reversed ? 15 - reg : reg)) & 1) == 0)
+            continue;
+
+        // Find the end of a run of registers within the same bank
+        int last = reg;
+        while (last < 15 && (last & 7) != 7 && ((mask >> (reversed ? 14 - last : last + 1)) & 1) == 1)
+            last++;
+
+        if (!first)
+            *out++ = '/';
+        appendRegister(reg);
+        if (last != reg) {
+            *out++ = '-';
+            appendRegister(last);
+        }
+        first = false;
+        reg = last;
+    }
+}
+
+// Appends the mnemonic and operands of an instruction the dispatch table has classified
+void Disassembler::appendOperands(uint16_t opcode, uint8_t instruction, uint32_t address)
+{
+    int mode = (opcode >> 3) & 7;
+    int reg = opcode & 7;
+    int otherReg = (opcode >> 9) & 7;
+    int size = (opcode >> 6) & 3;
+    int32_t displacement;
+
+    appendText(mnemonics[instruction]);
+    switch (instruction) {
+    case INSTRUCTION_ADD:
+    case INSTRUCTION_SUB:
+    case INSTRUCTION_CMP:
+    case INSTRUCTION_AND:
+    case INSTRUCTION_OR:
+    case INSTRUCTION_EOR:
+        appendSize(size);
+        *out++ = ' ';
+        if (((opcode >> 8) & 1) == 1) {
+            appendRegister(otherReg);
+            *out++ = ',';
+            appendEffectiveAddress(mode, reg, size);
+        }
+        else {
+            appendEffectiveAddress(mode, reg, size);
+            *out++ = ',';
+            appendRegister(otherReg);
+        }
+        break;
+    case INSTRUCTION_ADDA:
+    case INSTRUCTION_SUBA:
+    case INSTRUCTION_CMPA:
+        size = ((opcode >> 8) & 1) == 1 ? SIZE_LONG : SIZE_WORD;
+        appendSize(size);
+        *out++ = ' ';
+        appendEffectiveAddress(mode, reg, size);
+        *out++ = ',';
+        appendRegister(otherReg + 8);
+        break;
+    case INSTRUCTION_ADDI:
+    case INSTRUCTION_SUBI:
+    case INSTRUCTION_CMPI:
+    case INSTRUCTION_ANDI:
+    case INSTRUCTION_ORI:
+    case INSTRUCTION_EORI:
+        appendSize(size);
+        *out++ = ' ';
+        appendEffectiveAddress(ADDRESS_MODE_OTHERS, ADDRESS_MODE_IMMEDIATE_OR_STATUS_REGISTER, size);
+        *out++ = ',';
+        appendEffectiveAddress(mode, reg, size);
+        break;
+    case INSTRUCTION_ADDQ:
+    case INSTRUCTION_SUBQ:
+        appendSize(size);
+        appendText(" #");
+        *out++ = (char)('0' + (otherReg == 0 ? 8 : otherReg));
+        *out++ = ',';
+        appendEffectiveAddress(mode, reg, size);
+        break;
+    case INSTRUCTION_BCC:
+    case INSTRUCTION_BRA:
+    case INSTRUCTION_BSR:
+        if (instruction == INSTRUCTION_BCC)
+            appendText(conditionNames[(opcode >> 8) & 0xF]);
+        displacement = (int8_t)(opcode & 0xFF);
+        if (displacement == 0) {
+            displacement = (int16_t)nextExtensionWord();
+            appendText(".W $");
+        }
+        else {
+            appendText(".S $");
+        }
+        appendHex(address + 2 + displacement, 8);
+        break;
+    case INSTRUCTION_DBCC:
+        appendText(conditionNames[(opcode >> 8) & 0xF]);
+        *out++ = ' ';
+        appendRegister(reg);
+        appendText(",$");
+        appendHex(address + 2 + (int16_t)nextExtensionWord(), 8);
+        break;
+    case INSTRUCTION_SCC:
+        appendText(conditionNames[(opcode >> 8) & 0xF]);
+        *out++ = ' ';
+        appendEffectiveAddress(mode, reg, SIZE_BYTE);
+        break;
+    case INSTRUCTION_CLR:
+    case INSTRUCTION_NEG:
+    case INSTRUCTION_NEGX:
+    case INSTRUCTION_NOT:
+    case INSTRUCTION_TST:
+        appendSize(size);
+        *out++ = ' ';
+        appendEffectiveAddress(mode, reg, size);
+        break;
+    case INSTRUCTION_NBCD:
+    case INSTRUCTION_TAS:
+        *out++ = ' ';
+        appendEffectiveAddress(mode, reg, SIZE_BYTE);
+        break;
+    case INSTRUCTION_ADDX:
+    case INSTRUCTION_SUBX:
+    case INSTRUCTION_ABCD:
+    case INSTRUCTION_SBCD:
+        if (instruction == INSTRUCTION_ADDX || instruction == INSTRUCTION_SUBX)
+            appendSize(size);
+        *out++ = ' ';
+        // Bit 3 selects -(Ay),-(Ax) rather than Dy,Dx
+        mode = ((opcode >> 3) & 1) == 1 ? ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_PREDECREMENT : ADDRESS_MODE_DATA_REGISTER_DIRECT;
+        appendEffectiveAddress(mode, reg, size);
+        *out++ = ',';
+        appendEffectiveAddress(mode, otherReg, size);
+        break;
+    case INSTRUCTION_CMPM:
+        appendSize(size);
+        *out++ = ' ';
+        appendEffectiveAddress(ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_POSTINCREMENT, reg, size);
+        *out++ = ',';
+        appendEffectiveAddress(ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_POSTINCREMENT, otherReg, size);
+        break;
+    case INSTRUCTION_ANDI_TO_CCR:
+    case INSTRUCTION_ORI_TO_CCR:
+    case INSTRUCTION_EORI_TO_CCR:
+        appendText(" #$");
+        appendHex(nextExtensionWord() & 0xFF, 2);
+        appendText(",CCR");
+        break;
+    case INSTRUCTION_ANDI_TO_SR:
+    case INSTRUCTION_ORI_TO_SR:
+    case INSTRUCTION_EORI_TO_SR:
+        appendText(" #$");
+        appendHex(nextExtensionWord(), 4);
+        appendText(",SR");
+        break;
+    case INSTRUCTION_ASD:
+    case INSTRUCTION_LSD:
+    case INSTRUCTION_ROXD:
+    case INSTRUCTION_ROD:
+        *out++ = ((opcode >> 8) & 1) == 1 ? 'L' : 'R';
+        if (size == 3) {
+            // A memory word shifted by one
+            appendSize(SIZE_WORD);
+            *out++ = ' ';
+            appendEffectiveAddress(mode, reg, SIZE_WORD);
+            break;
+        }
+        appendSize(size);
+        *out++ = ' ';
+        if (((opcode >> 5) & 1) == 1) {
+            appendRegister(otherReg);
+        }
+        else {
+            *out++ = '#';
+            *out++ = (char)('0' + (otherReg == 0 ? 8 : otherReg));
+        }
+        *out++ = ',';
+        appendRegister(reg);
+        break;
+    case INSTRUCTION_BTST:
+    case INSTRUCTION_BCHG:
+    case INSTRUCTION_BCLR:
+    case INSTRUCTION_BSET:
+        *out++ = ' ';
+        if (((opcode >> 8) & 1) == 1) {
+            appendRegister(otherReg);
+        }
+        else {
+            appendText("#");
+            appendSignedHex(nextExtensionWord() & 0xFF);
+        }
+        *out++ = ',';
+        appendEffectiveAddress(mode, reg, SIZE_BYTE);
+        break;
+    case INSTRUCTION_CHK:
+    case INSTRUCTION_DIVS:
+    case INSTRUCTION_DIVU:
+    case INSTRUCTION_MULS:
+    case INSTRUCTION_MULU:
+        appendSize(SIZE_WORD);
+        *out++ = ' ';
+        appendEffectiveAddress(mode, reg, SIZE_WORD);
+        *out++ = ',';
+        appendRegister(otherReg);
+        break;
+    case INSTRUCTION_EXT:
+        appendSize(((opcode >> 6) & 1) == 1 ? SIZE_LONG : SIZE_WORD);
+        *out++ = ' ';
+        appendRegister(reg);
+        break;
+    case INSTRUCTION_LINK:
+        *out++ = ' ';
+        appendRegister(reg + 8);
+        appendText(",#");
+        appendSignedHex((int16_t)nextExtensionWord());
+        break;
+    case INSTRUCTION_UNLK:
+        *out++ = ' ';
+        appendRegister(reg + 8);
+        break;
+    case INSTRUCTION_MOVEP:
+        appendSize(((opcode >> 6) & 1) == 1 ? SIZE_LONG : SIZE_WORD);
+        *out++ = ' ';
+        if (((opcode >> 7) & 1) == 1) {
+            appendRegister(otherReg);
+            *out++ = ',';
+            appendEffectiveAddress(ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_DISPLACEMENT, reg, SIZE_WORD);
+        }
+        else {
+            appendEffectiveAddress(ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_DISPLACEMENT, reg, SIZE_WORD);
+            *out++ = ',';
+            appendRegister(otherReg);
+        }
+        break;
+    case INSTRUCTION_EXG:
+        *out++ = ' ';
+        appendRegister(otherReg + ((opcode & 0xF1F8) == EXG_ADDRESS_REGISTERS ? 8 : 0));
+        *out++ = ',';
+        appendRegister(reg + ((opcode & 0xF1F8) == EXG_DATA_REGISTERS ? 0 : 8));
+        break;
+    case INSTRUCTION_JMP:
+    case INSTRUCTION_JSR:
+    case INSTRUCTION_PEA:
+        *out++ = ' ';
+        appendEffectiveAddress(mode, reg, SIZE_LONG);
+        break;
+    case INSTRUCTION_LEA:
+        *out++ = ' ';
+        appendEffectiveAddress(mode, reg, SIZE_LONG);
+        *out++ = ',';
+        appendRegister(otherReg + 8);
+        break;
+    case INSTRUCTION_MOVE:
+        size = (opcode & 0xF000) == MOVE_B ? SIZE_BYTE : (opcode & 0xF000) == MOVE_W ? SIZE_WORD : SIZE_LONG;
+        if (((opcode >> 6) & 7) == ADDRESS_MODE_ADDRESS_REGISTER_DIRECT)
+            *out++ = 'A';
+        appendSize(size);
+        *out++ = ' ';
+        appendEffectiveAddress(mode, reg, size);
+        *out++ = ',';
+        appendEffectiveAddress((opcode >> 6) & 7, otherReg, size);
+        break;
+    case INSTRUCTION_MOVE_FROM_CCR:
+    case INSTRUCTION_MOVE_FROM_SR:
+        appendText(instruction == INSTRUCTION_MOVE_FROM_CCR ? " CCR," : " SR,");
+        appendEffectiveAddress(mode, reg, SIZE_WORD);
+        break;
+    case INSTRUCTION_MOVE_TO_CCR:
+    case INSTRUCTION_MOVE_TO_SR:
+        *out++ = ' ';
+        appendEffectiveAddress(mode, reg, SIZE_WORD);
+        appendText(instruction == INSTRUCTION_MOVE_TO_CCR ? ",CCR" : ",SR");
+        break;
+    case INSTRUCTION_MOVE_USP:
+        *out++ = ' ';
+        if (((opcode >> 3) & 1) == 1) {
+            appendText("USP,");
+            appendRegister(reg + 8);
+        }
+        else {
+            appendRegister(reg + 8);
+            appendText(",USP");
+        }
+        break;
+    case INSTRUCTION_MOVEM: {
+        uint16_t mask = nextExtensionWord();
+        size = ((opcode >> 6) & 1) == 1 ? SIZE_LONG : SIZE_WORD;
+        appendSize(size);
+        *out++ = ' ';
+        if (((opcode >> 10) & 1) == 1) {
+            appendEffectiveAddress(mode, reg, size);
+            *out++ = ',';
+            appendRegisterList(mask, false);
+        }
+        else {
+            appendRegisterList(mask, mode == ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_PREDECREMENT);
+            *out++ = ',';
+            appendEffectiveAddress(mode, reg, size);
+        }
+        break;
+    }
+    case INSTRUCTION_MOVEQ:
+        appendText(" #$");
+        appendHex(opcode & 0xFF, 2);
+        *out++ = ',';
+        appendRegister(otherReg);
+        break;
+    case INSTRUCTION_STOP:
+        appendText(" #$");
+        appendHex(nextExtensionWord(), 4);
+        break;
+    case INSTRUCTION_SWAP:
+        *out++ = ' ';
+        appendRegister(reg);
+        break;
+    case INSTRUCTION_TRAP:
+        appendText(" #");
+        if ((opcode & 0xF) >= 10)
+            *out++ = '1';
+        *out++ = (char)('0' + (opcode & 0xF) % 10);
+        break;
+    case INSTRUCTION_ILLEGAL:
+    case INSTRUCTION_LINE_A:
+    case INSTRUCTION_LINE_F:
+        appendText(" $");
+        appendHex(opcode, 4);
+        break;
+    default:
+        break;
+    }
+}
+
+unsigned int Disassembler::disassembleInstruction(uint32_t address, std::string &text)
+{
+    uint16_t opcode = memory->readWordFromMemory(address);
+    const CPUCore::InstructionEntry &entry = instructionTable[opcode];
+
+    out = line;
+    extensionAddress = address + 2;
+    appendOperands(opcode, entry.instruction, address);
+    text.assign(line, out - line);
+    return 2 + entry.extensionWords * 2;
+}
+
+size_t Disassembler::disassembleRange(uint32_t start, uint32_t end, std::string &buffer)
+{
+    buffer.clear();
+    return appendRange(start, end, buffer);
+}
+
+// Appends the lines for the instructions from start up to end to the buffer
+size_t Disassembler::appendRange(uint32_t start, uint32_t end, std::string &buffer)
+{
+    size_t count = 0;
+
+    for (uint32_t address = start; address < end; count++) {
+        uint16_t opcode = memory->readWordFromMemory(address);
+        const CPUCore::InstructionEntry &entry = instructionTable[opcode];
+        uint32_t length = 2 + entry.extensionWords * 2;
+
+        out = line;
+        appendHex(address, 8);
+        appendText("  ");
+        char *words = out;
+        for (uint32_t offset = 0; offset < length; offset += 2) {
+            appendHex(memory->readWordFromMemory(address + offset), 4);
+            *out++ = ' ';
+        }
+        while (out < words + WORD_COLUMN_WIDTH)
+            *out++ = ' ';
+
+        extensionAddress = address + 2;
+        appendOperands(opcode, entry.instruction, address);
+        *out++ = '\n';
+        buffer.append(line, out - line);
+        address += length;
+    }
+    return count;
+}
+
+size_t Disassembler::disassembleImage(std::string fileName, std::string &buffer)
+{
+    vector<ProgramLoader::Segment> segments;
+    size_t count = 0;
+
+    buffer.clear();
+    if (!ProgramLoader::loadImage(fileName, memory, segments))
+        return 0;
+
+    for (const ProgramLoader::Segment &segment : segments)
+        count += appendRange(segment.address, segment.address + segment.length, buffer);
+    return count;
+}
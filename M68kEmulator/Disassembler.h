@@ -0,0 +1,43 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include "CPUCore.h"
+#include "Memory.h"
+
+// Turns 68000 machine code in memory into assembly text. Opcodes are classified by the CPU's
+// dispatch table, so the disassembler always agrees with the executor on what is an instruction
+// and how long it is. Text is written without iostreams or allocations other than growing the
+// caller's buffer, which keeps its capacity from one call to the next.
+class Disassembler
+{
+private:
+    Memory *memory;
+    const CPUCore::InstructionEntry *instructionTable;
+
+    // The line being written and the position in it
+    char line[128];
+    char *out;
+    // Address of the next extension word of the instruction being disassembled
+    uint32_t extensionAddress;
+
+    uint16_t nextExtensionWord();
+    uint32_t nextExtensionLong();
+    void appendText(const char *text);
+    void appendHex(uint32_t value, int digits);
+    void appendSignedHex(int32_t value);
+    void appendRegister(int reg);
+    void appendSize(int size);
+    void appendEffectiveAddress(int mode, int reg, int size);
+    void appendRegisterList(uint16_t mask, bool reversed);
+    void appendOperands(uint16_t opcode, uint8_t instruction, uint32_t address);
+    size_t appendRange(uint32_t start, uint32_t end, std::string &buffer);
+public:
+    Disassembler(Memory *memory);
+    // Disassembles the instruction at an address into text, returning its length in bytes
+    unsigned int disassembleInstruction(uint32_t address, std::string &text);
+    // Disassembles the instructions from start up to end, one line each with the address and the
+    // words of the instruction, replacing the contents of the buffer. Returns the instruction count.
+    size_t disassembleRange(uint32_t start, uint32_t end, std::string &buffer);
+    // Loads an S-record image into memory and disassembles every segment it holds into the buffer
+    size_t disassembleImage(std::string fileName, std::string &buffer);
+};
@@ -0,0 +1,52 @@
+#include "EventScheduler.h"
+#include <algorithm>
+
+bool EventScheduler::later(const Event &first, const Event &second)
+{
+    return first.cycle != second.cycle ? first.cycle > second.cycle : first.id > second.id;
+}
+
+uint64_t EventScheduler::schedule(uint64_t cycle, Callback callback)
+{
+    uint64_t id = nextId++;
+    events.push_back(Event{ cycle, id, std::move(callback) });
+    std::push_heap(events.begin(), events.end(), later);
+    return id;
+}
+
+// Cancelling is rare next to running events, so the heap is searched and rebuilt rather than
+// keeping an index of where each event is
+bool EventScheduler::cancel(uint64_t id)
+{
+    for (size_t i = 0; i < events.size(); i++) {
+        if (events[i].id == id) {
+            events[i] = std::move(events.back());
+            events.pop_back();
+            std::make_heap(events.begin(), events.end(), later);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Each event is taken off the heap before its callback runs, so the callback is free to schedule
+// and cancel others
+void EventScheduler::runDue(uint64_t cycle)
+{
+    while (!events.empty() && events.front().cycle <= cycle) {
+        std::pop_heap(events.begin(), events.end(), later);
+        Event event = std::move(events.back());
+        events.pop_back();
+        event.callback(event.cycle);
+    }
+}
+
+uint64_t EventScheduler::nextDeadline() const
+{
+    return events.empty() ? UINT64_MAX : events.front().cycle;
+}
+
+size_t EventScheduler::size() const
+{
+    return events.size();
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+// Keeps the device events due at future points on the CPU's cycle counter in a min-heap, so the
+// CPU only ever compares its cycle count with the earliest of them rather than asking every device
+// after every instruction. Events due at the same cycle run in the order they were scheduled.
+class EventScheduler
+{
+public:
+    // Called with the cycle the event was scheduled for, which the CPU may have passed by part of
+    // an instruction. A device repeating at a fixed period schedules its next event from that cycle.
+    typedef std::function<void(uint64_t cycle)> Callback;
+
+private:
+    struct Event {
+        uint64_t cycle;
+        uint64_t id; // Counts up, so it also orders events due at the same cycle
+        Callback callback;
+    };
+    // Heap ordered with the earliest event at the front
+    std::vector<Event> events;
+    uint64_t nextId = 1;
+
+    static bool later(const Event &first, const Event &second);
+
+public:
+    // Adds an event and returns an id for cancelling it
+    uint64_t schedule(uint64_t cycle, Callback callback);
+    // Removes an event that has not run yet. Returns false when there is no such event.
+    bool cancel(uint64_t id);
+    // Runs every event due by a cycle, including any the callbacks schedule for it
+    void runDue(uint64_t cycle);
+    // Returns the cycle the earliest event is due at, or UINT64_MAX when none are scheduled
+    uint64_t nextDeadline() const;
+    // Returns the number of events scheduled
+    size_t size() const;
+};
@@ -0,0 +1,1059 @@
+#include "JitCompiler.h"
+#include "M68kDefinitions.h"
+#include <cstring>
+#if defined(__x86_64__) || defined(_M_X64)
+#define JIT_X86_64 1
+#else
+#define JIT_X86_64 0
+#endif
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+//Host registers
+#define HOST_RAX 0
+#define HOST_RCX 1
+#define HOST_RDX 2
+#define HOST_RBX 3
+#define HOST_RSP 4
+#define HOST_RBP 5
+#define HOST_RSI 6
+#define HOST_RDI 7
+#define HOST_R8 8
+#define HOST_R9 9
+#define HOST_R10 10
+#define HOST_R12 12
+#define HOST_R13 13
+#define HOST_R14 14 // Holds the status register
+#define HOST_R15 15 // Holds the address of the guest register file
+
+//Calling convention
+#ifdef _WIN32
+#define HOST_ARGUMENT1 HOST_RCX
+#define HOST_ARGUMENT2 HOST_RDX
+#define HOST_ARGUMENT3 HOST_R8
+#define FRAME_SIZE 56 // 32 bytes of shadow space for calls, three slots and alignment
+#define FRAME_SLOTS 32
+#else
+#define HOST_ARGUMENT1 HOST_RDI
+#define HOST_ARGUMENT2 HOST_RSI
+#define HOST_ARGUMENT3 HOST_RDX
+#define FRAME_SIZE 24 // Three slots, keeping the stack 16 byte aligned at calls
+#define FRAME_SLOTS 0
+#endif
+#define SLOT_LOOP_COUNTER (FRAME_SLOTS + 0)
+#define SLOT_SOURCE (FRAME_SLOTS + 8)
+#define SLOT_ADDRESS (FRAME_SLOTS + 16)
+
+//x86 opcodes
+#define X86_ADD 0x00
+#define X86_OR 0x08
+#define X86_AND 0x20
+#define X86_SUB 0x28
+#define X86_CMP 0x38
+#define X86_TEST 0x84
+#define X86_MOV_STORE 0x88
+#define X86_MOV_LOAD 0x8A
+#define X86_GROUP_IMMEDIATE 0x81
+#define X86_GROUP_IMMEDIATE_BYTE 0x80
+#define X86_GROUP_SHIFT 0xC1
+#define X86_MOV_IMMEDIATE 0xC7
+#define X86_JUMP 0xE9
+#define X86_CONDITION_ZERO 0x84
+#define X86_CONDITION_NOT_ZERO 0x85
+#define X86_CONDITION_NOT_CARRY 0x83
+#define X86_DIGIT_ADD 0
+#define X86_DIGIT_OR 1
+#define X86_DIGIT_AND 4
+#define X86_DIGIT_SUB 5
+#define X86_DIGIT_CMP 7
+#define X86_DIGIT_ROL 0
+#define X86_DIGIT_SHL 4
+#define X86_DIGIT_SHR 5
+
+//Compiler limits
+#define CODE_MEMORY_SIZE (4 * 1024 * 1024)
+
+// The operations ADD, SUB and CMP compile to, as the x86 opcode of their byte form
+static const uint8_t arithmeticOpcodes[] = { X86_ADD, X86_SUB, X86_CMP };
+#define JIT_ADD 0
+#define JIT_SUB 1
+#define JIT_CMP 2
+
+// Memory accesses made by compiled code
+static uint32_t readByte(Memory *memory, uint32_t address)
+{
+    return memory->readByteFromMemory(address);
+}
+
+static uint32_t readWord(Memory *memory, uint32_t address)
+{
+    return memory->readWordFromMemory(address);
+}
+
+static uint32_t readLong(Memory *memory, uint32_t address)
+{
+    return memory->readLongFromMemory(address);
+}
+
+static void writeByte(Memory *memory, uint32_t address, uint32_t data)
+{
+    memory->writeByteToMemory(data, address);
+}
+
+static void writeWord(Memory *memory, uint32_t address, uint32_t data)
+{
+    memory->writeWordToMemory(data, address);
+}
+
+static void writeLong(Memory *memory, uint32_t address, uint32_t data)
+{
+    memory->writeLongToMemory(data, address);
+}
+
+JitCompiler::JitCompiler(CPUCore *cpu, bool background)
+{
+    this->cpu = cpu;
+
+    // Offsets of the registers the compiled code reaches through the guest register file
+    uint8_t *registers = (uint8_t *)cpu->registers;
+    for (int reg = 0; reg < 16; reg++)
+        homes[reg] = { -1, (int32_t)(reg * sizeof(uint32_t)) };
+    programCounterOffset = (int32_t)((uint8_t *)&cpu->PC - registers);
+    statusRegisterOffset = (int32_t)((uint8_t *)&cpu->SR - registers);
+    blockFlushPendingOffset = (int32_t)((uint8_t *)&cpu->blockFlushPending - registers);
+    loopCounterOffset = (int32_t)((uint8_t *)&cpu->nativeLoopCounter - registers);
+
+#if JIT_X86_64
+#ifdef _WIN32
+    codeMemory = (uint8_t *)VirtualAlloc(nullptr, CODE_MEMORY_SIZE, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+#else
+    void *mapping = mmap(nullptr, CODE_MEMORY_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    codeMemory = mapping == MAP_FAILED ? nullptr : (uint8_t *)mapping;
+#endif
+#endif
+
+    if (background && codeMemory != nullptr)
+        worker = std::thread(&JitCompiler::compileJobs, this);
+}
+
+JitCompiler::~JitCompiler()
+{
+    if (worker.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(queueLock);
+            stopping = true;
+        }
+        queueReady.notify_one();
+        worker.join();
+    }
+
+#if JIT_X86_64
+#ifdef _WIN32
+    if (codeMemory != nullptr)
+        VirtualFree(codeMemory, 0, MEM_RELEASE);
+#else
+    if (codeMemory != nullptr)
+        munmap(codeMemory, CODE_MEMORY_SIZE);
+#endif
+#endif
+}
+
+bool JitCompiler::isSupported()
+{
+    return JIT_X86_64 == 1;
+}
+
+void JitCompiler::reset()
+{
+    std::lock_guard<std::mutex> lock(queueLock);
+    codeMemoryUsed = 0;
+    generation++;
+    jobs.clear();
+    results.clear();
+}
+
+void JitCompiler::compile(CPUCore::TranslatedBlock *block)
+{
+    if (codeMemory == nullptr)
+        return;
+
+    size_t count = assemble(block);
+    if (count > 0)
+        install(block, code, count, eliminatedFlagUpdates);
+}
+
+void JitCompiler::compileInBackground(const CPUCore::TranslatedBlock *block)
+{
+    if (!worker.joinable())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(queueLock);
+        jobs.push_back({ *block, generation });
+    }
+    queueReady.notify_one();
+}
+
+// Runs on the background thread, compiling queued blocks until the compiler is destroyed. Only
+// the code is generated here: the CPU thread copies it into executable memory.
+void JitCompiler::compileJobs()
+{
+    std::unique_lock<std::mutex> lock(queueLock);
+
+    for (;;) {
+        queueReady.wait(lock, [this]() { return stopping || !jobs.empty(); });
+        if (stopping)
+            return;
+
+        Job job = std::move(jobs.front());
+        jobs.pop_front();
+        lock.unlock();
+        size_t count = assemble(&job.block);
+        lock.lock();
+
+        if (count > 0 && job.generation == generation)
+            results.push_back({ job.block.address, code, count, eliminatedFlagUpdates, job.generation });
+    }
+}
+
+void JitCompiler::installCompiledBlocks()
+{
+    {
+        std::lock_guard<std::mutex> lock(queueLock);
+        if (results.empty())
+            return;
+        installing.swap(results);
+    }
+
+    for (const Result &result : installing) {
+        auto found = cpu->translatedBlocks.find(result.address);
+        if (result.generation == generation && found != cpu->translatedBlocks.end() && found->second->native == nullptr)
+            install(found->second.get(), result.code, result.instructionCount, result.eliminatedFlagUpdates);
+    }
+    installing.clear();
+}
+
+// Generates the code for a block into code, returning the number of instructions it covers and
+// setting eliminatedFlagUpdates to the number of condition code updates left out of it
+size_t JitCompiler::assemble(const CPUCore::TranslatedBlock *block)
+{
+    // The first pass keeps every guest register in memory and counts how often each is used.
+    // The most used ones then get the callee saved host registers for the second pass.
+    static const int allocatableRegisters[] = { HOST_RBX, HOST_RBP, HOST_R12, HOST_R13 };
+    Home memoryHomes[16];
+
+    for (int reg = 0; reg < 16; reg++) {
+        homes[reg].hostRegister = -1;
+        memoryHomes[reg] = homes[reg];
+        registerUses[reg] = 0;
+    }
+
+    analysingFlags = true;
+    flagEffects.assign(block->instructions.size() + 1, FlagEffects{ 0, false });
+    size_t count = compileInstructions(block, block->instructions.size());
+    if (count == 0)
+        return 0;
+
+    // Every flag is in SR when the compiled code leaves after its last instruction. Working back
+    // from there, an instruction's flags are live if a later one reads them before setting them.
+    uint8_t live = 0x1F;
+    liveFlags.resize(count);
+    for (size_t i = count; i-- > 0;) {
+        if (flagEffects[i].read)
+            live = 0x1F;
+        liveFlags[i] = live;
+        live &= ~flagEffects[i].set;
+    }
+    analysingFlags = false;
+    eliminatedFlagUpdates = 0;
+
+    for (int hostRegister : allocatableRegisters) {
+        int mostUsed = -1;
+        for (int reg = 0; reg < 16; reg++) {
+            if (homes[reg].hostRegister < 0 && registerUses[reg] > 0 && (mostUsed < 0 || registerUses[reg] > registerUses[mostUsed]))
+                mostUsed = reg;
+        }
+        if (mostUsed < 0)
+            break;
+        homes[mostUsed].hostRegister = hostRegister;
+    }
+    compileInstructions(block, count);
+
+    for (int reg = 0; reg < 16; reg++)
+        homes[reg] = memoryHomes[reg];
+    return count;
+}
+
+// Copies generated code into executable memory and gives it to a block. Pages are never writable
+// and executable at once, so this only happens on the CPU thread when no compiled code is running.
+void JitCompiler::install(CPUCore::TranslatedBlock *block, const std::vector<uint8_t> &code, size_t count, size_t eliminated)
+{
+    if (codeMemoryUsed + code.size() > CODE_MEMORY_SIZE)
+        return;
+
+    uint8_t *native = codeMemory + codeMemoryUsed;
+#if JIT_X86_64
+#ifdef _WIN32
+    DWORD oldProtection;
+    VirtualProtect(codeMemory, CODE_MEMORY_SIZE, PAGE_READWRITE, &oldProtection);
+    memcpy(native, code.data(), code.size());
+    VirtualProtect(codeMemory, CODE_MEMORY_SIZE, PAGE_EXECUTE_READ, &oldProtection);
+#else
+    mprotect(codeMemory, CODE_MEMORY_SIZE, PROT_READ | PROT_WRITE);
+    memcpy(native, code.data(), code.size());
+    mprotect(codeMemory, CODE_MEMORY_SIZE, PROT_READ | PROT_EXEC);
+#endif
+#endif
+    // Keep each block 16 byte aligned
+    codeMemoryUsed += (code.size() + 15) & ~(size_t)15;
+
+    block->native = (CPUCore::NativeBlock)native;
+    block->nativeInstructionCount = count;
+    block->nativeFlagUpdatesEliminated = eliminated;
+    block->nativeCycles = 0;
+    for (size_t i = 0; i < count; i++)
+        block->nativeCycles += block->instructions[i].cycles;
+}
+
+// Generates code for up to limit instructions from the start of a block, stopping early at the
+// first one that cannot be compiled. Returns the number of instructions compiled.
+size_t JitCompiler::compileInstructions(const CPUCore::TranslatedBlock *block, size_t limit)
+{
+    code.clear();
+    blockAddress = block->address;
+    emitPrologue();
+
+    size_t count = 0;
+    bool exited = false;
+    while (count < limit) {
+        const CPUCore::DecodedInstruction &decoded = block->instructions[count];
+        size_t start = code.size();
+        instructionIndex = count;
+
+        if (!compileInstruction(decoded)) {
+            code.resize(start);
+            break;
+        }
+        count++;
+
+        // Branches end the block and leave through their own exits
+        if (cpu->instructionTable[decoded.opcode].endsBlock) {
+            exited = true;
+            break;
+        }
+    }
+
+    instructionIndex = count;
+    if (!exited)
+        emitExit(count < block->instructions.size() ? block->instructions[count].address : block->endAddress);
+    return count;
+}
+
+// Generates the code for one instruction. Returns false, possibly after generating some code,
+// when the instruction or one of its addressing modes is not handled.
+bool JitCompiler::compileInstruction(const CPUCore::DecodedInstruction &decoded)
+{
+    uint16_t opcode = decoded.opcode;
+
+    extensionWord = decoded.extensionWords;
+    extensionAddress = decoded.address + 2;
+    nextAddress = decoded.address + decoded.length;
+
+    if (cpu->instructionTable[opcode].handler == &CPUCore::illegalInstruction || decoded.handler == &CPUCore::executeBreakpoint
+        || decoded.handler == &CPUCore::executeHostHandler)
+        return false;
+    // Code is generated for the 68000's encodings, so anything a later model does differently is interpreted
+    if (cpu->instructionTable[opcode].handler != CPUCore::sharedInstructionTable()[opcode].handler)
+        return false;
+
+    switch (opcode >> 12) {
+    case 0x0:
+        return compileArithmeticImmediate(opcode);
+    case 0x1:
+    case 0x2:
+    case 0x3:
+        return compileMOVE(opcode);
+    case 0x4:
+    case 0xC:
+        return compileMiscellaneous(opcode);
+    case 0x5:
+        return compileArithmeticQuick(opcode);
+    case 0x6:
+        return compileBranch(opcode);
+    case 0x7:
+        // MOVEQ
+        emitMoveImmediate(HOST_RAX, (int8_t)(opcode & 0xFF));
+        emitStore(home((opcode >> 9) & 7), HOST_RAX, SIZE_LONG);
+        emitOperation(X86_TEST, SIZE_LONG, HOST_RAX, HOST_RAX);
+        emitLogicalFlags();
+        return true;
+    case 0x9:
+    case 0xB:
+    case 0xD:
+        return compileArithmetic(opcode);
+    default:
+        return false;
+    }
+}
+
+bool JitCompiler::compileMOVE(uint16_t opcode)
+{
+    int size = SIZE_LONG;
+    if ((opcode & 0xF000) == MOVE_B)
+        size = SIZE_BYTE;
+    else if ((opcode & 0xF000) == MOVE_W)
+        size = SIZE_WORD;
+
+    int source = EA_MODE((opcode >> 3) & 7, opcode & 7);
+    int destination = EA_MODE((opcode >> 6) & 7, (opcode >> 9) & 7);
+    int destinationReg = (opcode >> 9) & 7;
+
+    if (destination == ADDRESS_MODE_ADDRESS_REGISTER_DIRECT) {
+        // MOVEA sign extends words and leaves the condition codes alone
+        if (!compileSource(source, opcode & 7, size, true))
+            return false;
+        emitStore(home(destinationReg + 8), HOST_RAX, SIZE_LONG);
+        return true;
+    }
+
+    if (!compileSource(source, opcode & 7, size, false))
+        return false;
+    emitOperation(X86_TEST, size, HOST_RAX, HOST_RAX);
+    emitLogicalFlags();
+    return compileDestination(destination, destinationReg, size);
+}
+
+// ADD, SUB and CMP in all their forms: <ea>,Dn, Dn,<ea> and <ea>,An
+bool JitCompiler::compileArithmetic(uint16_t opcode)
+{
+    int operation = (opcode & 0xF000) == ADD ? JIT_ADD : (opcode & 0xF000) == SUB ? JIT_SUB : JIT_CMP;
+    int reg = (opcode >> 9) & 7;
+    int mode = EA_MODE((opcode >> 3) & 7, opcode & 7);
+    int size = (opcode >> 6) & 3;
+
+    if (size == 3) {
+        // ADDA, SUBA and CMPA work on the whole address register with a sign extended source
+        size = ((opcode >> 8) & 1) == 1 ? SIZE_LONG : SIZE_WORD;
+        if (!compileSource(mode, opcode & 7, size, true))
+            return false;
+
+        emitLoad(HOST_RCX, home(reg + 8), SIZE_LONG, false);
+        emitOperation(arithmeticOpcodes[operation], SIZE_LONG, HOST_RCX, HOST_RAX);
+        if (operation == JIT_CMP)
+            emitArithmeticFlags(false);
+        else
+            emitStore(home(reg + 8), HOST_RCX, SIZE_LONG);
+        return true;
+    }
+
+    if (((opcode >> 8) & 1) == 1) {
+        // Dn,<ea>, where CMP is really EOR or CMPM and register modes are ADDX and SUBX
+        if (operation == JIT_CMP || mode < ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT)
+            return false;
+        emitLoad(HOST_RAX, home(reg), size, false);
+        return compileOperationToMemory(operation, size, mode, opcode & 7);
+    }
+
+    if (!compileSource(mode, opcode & 7, size, false))
+        return false;
+    compileOperation(operation, size, reg);
+    return true;
+}
+
+// ADDI and SUBI
+bool JitCompiler::compileArithmeticImmediate(uint16_t opcode)
+{
+    int operation;
+    if ((opcode & 0xFF00) == ADDI)
+        operation = JIT_ADD;
+    else if ((opcode & 0xFF00) == SUBI)
+        operation = JIT_SUB;
+    else
+        return false;
+
+    int size = (opcode >> 6) & 3;
+    int mode = EA_MODE((opcode >> 3) & 7, opcode & 7);
+
+    compileSource(EA_IMMEDIATE, 0, size, false);
+    if (mode == ADDRESS_MODE_DATA_REGISTER_DIRECT) {
+        compileOperation(operation, size, opcode & 7);
+        return true;
+    }
+    return compileOperationToMemory(operation, size, mode, opcode & 7);
+}
+
+// ADDQ and SUBQ
+bool JitCompiler::compileArithmeticQuick(uint16_t opcode)
+{
+    int operation = ((opcode >> 8) & 1) == 0 ? JIT_ADD : JIT_SUB;
+    int size = (opcode >> 6) & 3;
+    int mode = EA_MODE((opcode >> 3) & 7, opcode & 7);
+    int reg = opcode & 7;
+    uint32_t data = (opcode >> 9) & 7;
+
+    // Size 3 is Scc and DBcc
+    if (size == 3)
+        return false;
+    if (data == 0)
+        data = 8;
+
+    emitMoveImmediate(HOST_RAX, data);
+    if (mode == ADDRESS_MODE_DATA_REGISTER_DIRECT) {
+        compileOperation(operation, size, reg);
+        return true;
+    }
+    if (mode == ADDRESS_MODE_ADDRESS_REGISTER_DIRECT) {
+        // Address registers are always changed in full and the condition codes are left alone
+        emitLoad(HOST_RCX, home(reg + 8), SIZE_LONG, false);
+        emitOperation(arithmeticOpcodes[operation], SIZE_LONG, HOST_RCX, HOST_RAX);
+        emitStore(home(reg + 8), HOST_RCX, SIZE_LONG);
+        return true;
+    }
+    return compileOperationToMemory(operation, size, mode, reg);
+}
+
+// CLR, LEA, NOP, SWAP and EXG
+bool JitCompiler::compileMiscellaneous(uint16_t opcode)
+{
+    int reg = opcode & 7;
+    int otherReg = (opcode >> 9) & 7;
+
+    if ((opcode & 0xFF00) == CLR) {
+        int size = (opcode >> 6) & 3;
+        emitMoveImmediate(HOST_RAX, 0);
+        emitOperation(X86_TEST, SIZE_LONG, HOST_RAX, HOST_RAX);
+        emitLogicalFlags();
+        return compileDestination(EA_MODE((opcode >> 3) & 7, reg), reg, size);
+    }
+    if ((opcode & 0xF1C0) == LEA) {
+        if (!compileAddress(EA_MODE((opcode >> 3) & 7, reg), reg, SIZE_LONG))
+            return false;
+        emitStore(home(otherReg + 8), HOST_RCX, SIZE_LONG);
+        return true;
+    }
+    if (opcode == NOP)
+        return true;
+    if ((opcode & 0xFFF8) == SWAP) {
+        emitLoad(HOST_RAX, home(reg), SIZE_LONG, false);
+        emitGroup(X86_GROUP_SHIFT, X86_DIGIT_ROL, { HOST_RAX, 0 });
+        emit8(16);
+        emitStore(home(reg), HOST_RAX, SIZE_LONG);
+        emitOperation(X86_TEST, SIZE_LONG, HOST_RAX, HOST_RAX);
+        emitLogicalFlags();
+        return true;
+    }
+
+    int first;
+    int second;
+    switch (opcode & 0xF1F8) {
+    case EXG_DATA_REGISTERS:
+        first = otherReg;
+        second = reg;
+        break;
+    case EXG_ADDRESS_REGISTERS:
+        first = otherReg + 8;
+        second = reg + 8;
+        break;
+    case EXG_DATA_AND_ADDRESS_REGISTERS:
+        first = otherReg;
+        second = reg + 8;
+        break;
+    default:
+        return false;
+    }
+    emitLoad(HOST_RAX, home(first), SIZE_LONG, false);
+    emitLoad(HOST_RCX, home(second), SIZE_LONG, false);
+    emitStore(home(first), HOST_RCX, SIZE_LONG);
+    emitStore(home(second), HOST_RAX, SIZE_LONG);
+    return true;
+}
+
+// BRA and Bcc. The condition is looked up in its entry of the condition table.
+// A branch back to the start of the block loops inside the compiled code.
+bool JitCompiler::compileBranch(uint16_t opcode)
+{
+    if ((opcode & 0xFF00) == BSR)
+        return false;
+
+    int32_t displacement = (int8_t)(opcode & 0xFF);
+    uint32_t base = extensionAddress;
+    if (displacement == 0)
+        displacement = (int16_t)nextExtensionWord();
+
+    uint32_t target = base + displacement;
+    int condition = (opcode >> 8) & 0xF;
+
+    if (condition == CONDITIONAL_TRUE) {
+        if (target == blockAddress)
+            emitLoopBack(target);
+        else
+            emitExit(target);
+        return true;
+    }
+
+    noteFlagsRead();
+    emitLoad(HOST_RAX, { HOST_R14, 0 }, SIZE_LONG, false);
+    emitGroup(X86_GROUP_IMMEDIATE, X86_DIGIT_AND, { HOST_RAX, 0 });
+    emit32(0x0F);
+    emitMoveImmediate(HOST_RCX, conditionTable[condition]);
+    // bt ecx, eax
+    emitModRM(false, false, 0x0F, 0xA3, HOST_RAX, true, { HOST_RCX, 0 });
+
+    if (target == blockAddress) {
+        size_t notTaken = emitJump(X86_CONDITION_NOT_CARRY);
+        emitLoopBack(target);
+        patchJump(notTaken);
+        emitExit(nextAddress);
+    }
+    else {
+        emitMoveImmediate(HOST_RDX, nextAddress);
+        emitMoveImmediate(HOST_RAX, target);
+        // cmovc edx, eax
+        emitModRM(false, false, 0x0F, 0x42, HOST_RDX, true, { HOST_RAX, 0 });
+        emitExitToRegister(HOST_RDX);
+    }
+    return true;
+}
+
+// Loads a source operand into eax, zero extended or, when asked, sign extended
+bool JitCompiler::compileSource(int mode, int reg, int size, bool signExtend)
+{
+    switch (mode) {
+    case ADDRESS_MODE_DATA_REGISTER_DIRECT:
+        emitLoad(HOST_RAX, home(reg), size, signExtend);
+        return true;
+    case ADDRESS_MODE_ADDRESS_REGISTER_DIRECT:
+        emitLoad(HOST_RAX, home(reg + 8), size, signExtend);
+        return true;
+    case EA_IMMEDIATE: {
+        uint32_t data = size == SIZE_LONG ? nextExtensionLong() : nextExtensionWord() & sizeMask(size);
+        if (signExtend && size == SIZE_WORD)
+            data = (int16_t)data;
+        else if (signExtend && size == SIZE_BYTE)
+            data = (int8_t)data;
+        emitMoveImmediate(HOST_RAX, data);
+        return true;
+    }
+    default:
+        if (!compileAddress(mode, reg, size))
+            return false;
+        emitRead(size);
+        if (signExtend && size != SIZE_LONG)
+            emitLoad(HOST_RAX, { HOST_RAX, 0 }, size, true);
+        return true;
+    }
+}
+
+// Computes the address of a memory operand into ecx, applying any postincrement or predecrement
+bool JitCompiler::compileAddress(int mode, int reg, int size)
+{
+    // Byte accesses through the stack pointer still move it by a word to keep it aligned
+    const uint32_t increment = size == SIZE_BYTE ? (reg == 7 ? 2 : 1) : sizeInBytes(size);
+    uint32_t base;
+
+    switch (mode) {
+    case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT:
+        emitLoad(HOST_RCX, home(reg + 8), SIZE_LONG, false);
+        return true;
+    case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_POSTINCREMENT:
+        emitLoad(HOST_RCX, home(reg + 8), SIZE_LONG, false);
+        emitLoad(HOST_RDX, { HOST_RCX, 0 }, SIZE_LONG, false);
+        emitGroup(X86_GROUP_IMMEDIATE, X86_DIGIT_ADD, { HOST_RDX, 0 });
+        emit32(increment);
+        emitStore(home(reg + 8), HOST_RDX, SIZE_LONG);
+        return true;
+    case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_PREDECREMENT:
+        emitLoad(HOST_RCX, home(reg + 8), SIZE_LONG, false);
+        emitGroup(X86_GROUP_IMMEDIATE, X86_DIGIT_SUB, { HOST_RCX, 0 });
+        emit32(increment);
+        emitStore(home(reg + 8), HOST_RCX, SIZE_LONG);
+        return true;
+    case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_DISPLACEMENT:
+        emitLoad(HOST_RCX, home(reg + 8), SIZE_LONG, false);
+        emitGroup(X86_GROUP_IMMEDIATE, X86_DIGIT_ADD, { HOST_RCX, 0 });
+        emit32((int16_t)nextExtensionWord());
+        return true;
+    case EA_ABSOLUTE_SHORT:
+        emitMoveImmediate(HOST_RCX, (int16_t)nextExtensionWord());
+        return true;
+    case EA_ABSOLUTE_LONG:
+        emitMoveImmediate(HOST_RCX, nextExtensionLong());
+        return true;
+    case EA_PROGRAM_COUNTER_WITH_DISPLACEMENT:
+        base = extensionAddress;
+        emitMoveImmediate(HOST_RCX, base + (int16_t)nextExtensionWord());
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Writes eax to a destination operand
+bool JitCompiler::compileDestination(int mode, int reg, int size)
+{
+    if (mode == ADDRESS_MODE_DATA_REGISTER_DIRECT) {
+        emitStore(home(reg), HOST_RAX, size);
+        return true;
+    }
+    if (!compileAddress(mode, reg, size))
+        return false;
+    emitWrite(size);
+    return true;
+}
+
+// Applies an ADD, SUB or CMP with the source in eax to a data register
+void JitCompiler::compileOperation(int operation, int size, int destinationReg)
+{
+    emitLoad(HOST_RCX, { HOST_RAX, 0 }, SIZE_LONG, false);
+    emitLoad(HOST_RAX, home(destinationReg), SIZE_LONG, false);
+    emitOperation(arithmeticOpcodes[operation], size, HOST_RAX, HOST_RCX);
+    emitArithmeticFlags(operation != JIT_CMP);
+    if (operation != JIT_CMP)
+        emitStore(home(destinationReg), HOST_RAX, size);
+}
+
+// Applies an ADD or SUB with the source in eax to a memory operand. The source and the address
+// are kept in the stack frame across the calls that read and write memory.
+bool JitCompiler::compileOperationToMemory(int operation, int size, int mode, int reg)
+{
+    emitStackSlot(0x89, HOST_RAX, SLOT_SOURCE);
+    if (!compileAddress(mode, reg, size))
+        return false;
+    emitStackSlot(0x89, HOST_RCX, SLOT_ADDRESS);
+    emitRead(size);
+    emitStackSlot(0x8B, HOST_RCX, SLOT_SOURCE);
+    emitOperation(arithmeticOpcodes[operation], size, HOST_RAX, HOST_RCX);
+    emitArithmeticFlags(true);
+    emitStackSlot(0x8B, HOST_RCX, SLOT_ADDRESS);
+    emitWrite(size);
+    return true;
+}
+
+uint16_t JitCompiler::nextExtensionWord()
+{
+    extensionAddress += 2;
+    return *extensionWord++;
+}
+
+uint32_t JitCompiler::nextExtensionLong()
+{
+    uint32_t high = nextExtensionWord();
+    return (high << 16) | nextExtensionWord();
+}
+
+// Returns where a guest register lives (0-7 are D0-D7 and 8-15 are A0-A7), counting the use
+JitCompiler::Home JitCompiler::home(int guestRegister)
+{
+    registerUses[guestRegister]++;
+    return homes[guestRegister];
+}
+
+void JitCompiler::emit8(uint8_t data)
+{
+    code.push_back(data);
+}
+
+void JitCompiler::emit32(uint32_t data)
+{
+    for (int i = 0; i < 4; i++)
+        emit8((uint8_t)(data >> (8 * i)));
+}
+
+void JitCompiler::emit64(uint64_t data)
+{
+    emit32((uint32_t)data);
+    emit32((uint32_t)(data >> 32));
+}
+
+// Emits an instruction with a ModRM operand: the operand size prefix for word operands, a REX
+// prefix when an extended register or a byte register beyond bl is involved, the opcode (with an
+// optional second byte), then ModRM naming either a host register or memory at r15 + offset
+void JitCompiler::emitModRM(bool wordOperands, bool byteOperands, uint8_t opcode, uint8_t secondOpcode, int regField, bool regIsRegister, Home rm)
+{
+    int rmRegister = rm.hostRegister >= 0 ? rm.hostRegister : HOST_R15;
+    uint8_t rex = 0x40 | ((regField & 8) != 0 ? 4 : 0) | ((rmRegister & 8) != 0 ? 1 : 0);
+    bool byteRegisterNeedsRex = byteOperands && ((regIsRegister && regField >= 4 && regField < 8)
+        || (rm.hostRegister >= 4 && rm.hostRegister < 8));
+
+    if (wordOperands)
+        emit8(0x66);
+    if (rex != 0x40 || byteRegisterNeedsRex)
+        emit8(rex);
+    emit8(opcode);
+    if (opcode == 0x0F)
+        emit8(secondOpcode);
+
+    if (rm.hostRegister >= 0) {
+        emit8(0xC0 | ((regField & 7) << 3) | (rmRegister & 7));
+    }
+    else {
+        emit8(0x80 | ((regField & 7) << 3) | (rmRegister & 7));
+        emit32(rm.offset);
+    }
+}
+
+// Loads an operand of the given size into a 32 bit host register, zero or sign extended
+void JitCompiler::emitLoad(int reg, Home source, int size, bool signExtend)
+{
+    if (size == SIZE_LONG)
+        emitModRM(false, false, 0x8B, 0, reg, true, source);
+    else if (size == SIZE_WORD)
+        emitModRM(false, false, 0x0F, signExtend ? 0xBF : 0xB7, reg, true, source);
+    else
+        emitModRM(false, true, 0x0F, signExtend ? 0xBE : 0xB6, reg, true, source);
+}
+
+// Stores the low bytes of a host register, leaving the rest of the destination alone
+void JitCompiler::emitStore(Home destination, int reg, int size)
+{
+    emitModRM(size == SIZE_WORD, size == SIZE_BYTE, size == SIZE_BYTE ? X86_MOV_STORE : X86_MOV_STORE + 1, 0, reg, true, destination);
+}
+
+// Emits destination = destination <operation> source on host registers, given the byte form opcode
+void JitCompiler::emitOperation(uint8_t opcode, int size, int destinationReg, int sourceReg)
+{
+    emitModRM(size == SIZE_WORD, size == SIZE_BYTE, size == SIZE_BYTE ? opcode : opcode + 1, 0, sourceReg, true, { destinationReg, 0 });
+}
+
+// Emits a 32 bit group instruction, whose ModRM reg field selects the operation
+void JitCompiler::emitGroup(uint8_t opcode, int digit, Home rm)
+{
+    emitModRM(false, false, opcode, 0, digit, false, rm);
+}
+
+void JitCompiler::emitMoveImmediate(int reg, uint32_t value)
+{
+    if (reg >= 8)
+        emit8(0x41);
+    emit8(0xB8 + (reg & 7));
+    emit32(value);
+}
+
+// Moves eax or ecx to (0x89) or from (0x8B) a slot in the stack frame
+void JitCompiler::emitStackSlot(uint8_t opcode, int reg, int slot)
+{
+    emit8(opcode);
+    emit8(0x44 | (reg << 3));
+    emit8(0x24);
+    emit8(slot);
+}
+
+void JitCompiler::emitCall(const void *function)
+{
+    // mov rax, function; call rax
+    emit8(0x48);
+    emit8(0xB8);
+    emit64((uint64_t)function);
+    emit8(0xFF);
+    emit8(0xD0);
+}
+
+// Reads memory at the address in ecx into eax
+void JitCompiler::emitRead(int size)
+{
+    static const void *const functions[] = { (const void *)&readByte, (const void *)&readWord, (const void *)&readLong };
+
+    emitLoad(HOST_ARGUMENT2, { HOST_RCX, 0 }, SIZE_LONG, false);
+    emit8(0x48 | ((HOST_ARGUMENT1 & 8) != 0 ? 1 : 0));
+    emit8(0xB8 + (HOST_ARGUMENT1 & 7));
+    emit64((uint64_t)cpu->memory);
+    emitCall(functions[size]);
+}
+
+// Writes eax to memory at the address in ecx. A write over translated code makes the block stop
+// after this instruction, as the interpreter does.
+void JitCompiler::emitWrite(int size)
+{
+    static const void *const functions[] = { (const void *)&writeByte, (const void *)&writeWord, (const void *)&writeLong };
+
+    emitLoad(HOST_ARGUMENT2, { HOST_RCX, 0 }, SIZE_LONG, false);
+    emitLoad(HOST_ARGUMENT3, { HOST_RAX, 0 }, SIZE_LONG, false);
+    emit8(0x48 | ((HOST_ARGUMENT1 & 8) != 0 ? 1 : 0));
+    emit8(0xB8 + (HOST_ARGUMENT1 & 7));
+    emit64((uint64_t)cpu->memory);
+    emitCall(functions[size]);
+
+    // cmp byte [r15 + blockFlushPending], 0
+    emitModRM(false, true, X86_GROUP_IMMEDIATE_BYTE, 0, X86_DIGIT_CMP, false, { -1, blockFlushPendingOffset });
+    emit8(0);
+    size_t notPending = emitJump(X86_CONDITION_ZERO);
+    emitExit(nextAddress);
+    patchJump(notPending);
+}
+
+// In the first pass, notes that the instruction being compiled sets some flags and returns true.
+// In the second, returns false and counts the update as eliminated when none of those flags are
+// live after the instruction, so its code can be left out.
+bool JitCompiler::keepFlagUpdate(uint8_t flags)
+{
+    if (analysingFlags) {
+        flagEffects[instructionIndex].set |= flags;
+        return true;
+    }
+    if ((liveFlags[instructionIndex] & flags) != 0)
+        return true;
+    eliminatedFlagUpdates++;
+    return false;
+}
+
+// Notes in the first pass that the instruction being compiled reads the flags in r14
+void JitCompiler::noteFlagsRead()
+{
+    if (analysingFlags)
+        flagEffects[instructionIndex].read = true;
+}
+
+// Sets N and Z from the host flags of a test and clears V and C, using r8 and r9
+void JitCompiler::emitLogicalFlags()
+{
+    if (!keepFlagUpdate(0x0F))
+        return;
+    // pushfq; pop r8
+    emit8(0x9C);
+    emit8(0x41);
+    emit8(0x58);
+    // r9d = (flags >> 4) & 0x0C moves SF (bit 7) and ZF (bit 6) to N and Z
+    emitLoad(HOST_R9, { HOST_R8, 0 }, SIZE_LONG, false);
+    emitGroup(X86_GROUP_SHIFT, X86_DIGIT_SHR, { HOST_R9, 0 });
+    emit8(4);
+    emitGroup(X86_GROUP_IMMEDIATE, X86_DIGIT_AND, { HOST_R9, 0 });
+    emit32(0x0C);
+
+    emitGroup(X86_GROUP_IMMEDIATE, X86_DIGIT_AND, { HOST_R14, 0 });
+    emit32(~(uint32_t)0x0F);
+    emitOperation(X86_OR, SIZE_LONG, HOST_R14, HOST_R9);
+}
+
+// Sets N, Z, V and C, and X when asked, from the host flags of an add, subtract or compare,
+// using r8-r10. The x86 carry after a subtraction is a borrow, as on the 68000.
+void JitCompiler::emitArithmeticFlags(bool setExtend)
+{
+    if (!keepFlagUpdate(setExtend ? 0x1F : 0x0F))
+        return;
+    emit8(0x9C);
+    emit8(0x41);
+    emit8(0x58);
+    emitLoad(HOST_R9, { HOST_R8, 0 }, SIZE_LONG, false);
+    emitGroup(X86_GROUP_SHIFT, X86_DIGIT_SHR, { HOST_R9, 0 });
+    emit8(4);
+    emitGroup(X86_GROUP_IMMEDIATE, X86_DIGIT_AND, { HOST_R9, 0 });
+    emit32(0x0C);
+    // OF (bit 11) to V
+    emitLoad(HOST_R10, { HOST_R8, 0 }, SIZE_LONG, false);
+    emitGroup(X86_GROUP_SHIFT, X86_DIGIT_SHR, { HOST_R10, 0 });
+    emit8(10);
+    emitGroup(X86_GROUP_IMMEDIATE, X86_DIGIT_AND, { HOST_R10, 0 });
+    emit32(0x02);
+    emitOperation(X86_OR, SIZE_LONG, HOST_R9, HOST_R10);
+    // CF (bit 0) to C, and to X
+    emitGroup(X86_GROUP_IMMEDIATE, X86_DIGIT_AND, { HOST_R8, 0 });
+    emit32(0x01);
+    emitOperation(X86_OR, SIZE_LONG, HOST_R9, HOST_R8);
+    if (setExtend) {
+        emitGroup(X86_GROUP_SHIFT, X86_DIGIT_SHL, { HOST_R8, 0 });
+        emit8(SR_CCR_EXTEND);
+        emitOperation(X86_OR, SIZE_LONG, HOST_R9, HOST_R8);
+    }
+
+    emitGroup(X86_GROUP_IMMEDIATE, X86_DIGIT_AND, { HOST_R14, 0 });
+    emit32(~(uint32_t)(setExtend ? 0x1F : 0x0F));
+    emitOperation(X86_OR, SIZE_LONG, HOST_R14, HOST_R9);
+}
+
+// Saves the callee saved registers, points r15 at the guest registers and loads the ones kept in
+// host registers along with the status register and the loop counter. A loop back to the start of
+// the block jumps to just after this.
+void JitCompiler::emitPrologue()
+{
+    static const uint8_t pushes[] = { 0x53, 0x55, 0x41, 0x54, 0x41, 0x55, 0x41, 0x56, 0x41, 0x57 };
+    for (uint8_t byte : pushes)
+        emit8(byte);
+    // sub rsp, FRAME_SIZE
+    emit8(0x48);
+    emit8(0x83);
+    emit8(0xEC);
+    emit8(FRAME_SIZE);
+    // mov r15, first argument
+    emit8(0x49 | ((HOST_ARGUMENT1 & 8) != 0 ? 4 : 0));
+    emit8(0x89);
+    emit8(0xC0 | ((HOST_ARGUMENT1 & 7) << 3) | (HOST_R15 & 7));
+
+    for (int reg = 0; reg < 16; reg++) {
+        if (homes[reg].hostRegister >= 0)
+            emitLoad(homes[reg].hostRegister, { -1, homes[reg].offset }, SIZE_LONG, false);
+    }
+    emitLoad(HOST_R14, { -1, statusRegisterOffset }, SIZE_WORD, false);
+
+    // The CPU sets how many passes a loop may make, which fit in the instruction budget
+    emitLoad(HOST_RAX, { -1, loopCounterOffset }, SIZE_LONG, false);
+    emitStackSlot(0x89, HOST_RAX, SLOT_LOOP_COUNTER);
+    loopStart = code.size();
+}
+
+// Writes the host registers back to the guest registers and the status register, sets PC, hands
+// the loop counter back to the CPU and returns
+void JitCompiler::emitExit(uint32_t programCounter)
+{
+    emitMoveImmediate(HOST_RDX, programCounter);
+    emitExitToRegister(HOST_RDX);
+}
+
+void JitCompiler::emitExitToRegister(int reg)
+{
+    static const uint8_t pops[] = { 0x41, 0x5F, 0x41, 0x5E, 0x41, 0x5D, 0x41, 0x5C, 0x5D, 0x5B, 0xC3 };
+
+    // Leaving stores r14 to SR, so every flag has to be up to date
+    noteFlagsRead();
+    for (int guestRegister = 0; guestRegister < 16; guestRegister++) {
+        if (homes[guestRegister].hostRegister >= 0)
+            emitStore({ -1, homes[guestRegister].offset }, homes[guestRegister].hostRegister, SIZE_LONG);
+    }
+    emitStore({ -1, statusRegisterOffset }, HOST_R14, SIZE_WORD);
+    emitStore({ -1, programCounterOffset }, reg, SIZE_LONG);
+    emitStackSlot(0x8B, HOST_RAX, SLOT_LOOP_COUNTER);
+    emitStore({ -1, loopCounterOffset }, HOST_RAX, SIZE_LONG);
+    // add rsp, FRAME_SIZE
+    emit8(0x48);
+    emit8(0x83);
+    emit8(0xC4);
+    emit8(FRAME_SIZE);
+    for (uint8_t byte : pops)
+        emit8(byte);
+}
+
+// Jumps back to the start of the block, or leaves with PC at it once the loop limit is reached
+void JitCompiler::emitLoopBack(uint32_t target)
+{
+    // sub dword [rsp + SLOT_LOOP_COUNTER], 1
+    emit8(0x83);
+    emit8(0x6C);
+    emit8(0x24);
+    emit8(SLOT_LOOP_COUNTER);
+    emit8(1);
+    size_t limitReached = emitJump(X86_CONDITION_ZERO);
+
+    emit8(X86_JUMP);
+    emit32((uint32_t)(loopStart - (code.size() + 4)));
+
+    patchJump(limitReached);
+    emitExit(target);
+}
+
+// Emits a conditional jump with its target left to patchJump, returning where to patch
+size_t JitCompiler::emitJump(uint8_t condition)
+{
+    emit8(0x0F);
+    emit8(condition);
+    emit32(0);
+    return code.size();
+}
+
+// Makes a jump from emitJump land at the current position
+void JitCompiler::patchJump(size_t jump)
+{
+    uint32_t displacement = (uint32_t)(code.size() - jump);
+    memcpy(&code[jump - 4], &displacement, 4);
+}
@@ -0,0 +1,138 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "CPUCore.h"
+
+// Translates hot basic blocks into x86-64 machine code. The guest registers a block uses most are
+// kept in host registers while it runs, and translation stops at the first instruction the compiler
+// does not handle, leaving the rest of the block to the interpreter. On other hosts nothing is compiled.
+// Blocks can also be compiled on a background thread, in which case the code is only copied into
+// executable memory when the CPU thread installs it between blocks.
+class JitCompiler
+{
+private:
+    CPUCore *cpu;
+    // Executable memory the compiled blocks are copied into
+    uint8_t *codeMemory = nullptr;
+    size_t codeMemoryUsed = 0;
+
+    // A copy of a block waiting to be compiled on the background thread, and the code made from one
+    struct Job {
+        CPUCore::TranslatedBlock block;
+        uint64_t generation;
+    };
+    struct Result {
+        uint32_t address;
+        std::vector<uint8_t> code;
+        size_t instructionCount;
+        size_t eliminatedFlagUpdates;
+        uint64_t generation;
+    };
+    std::thread worker;
+    std::mutex queueLock;
+    std::condition_variable queueReady;
+    std::deque<Job> jobs;
+    std::vector<Result> results;
+    std::vector<Result> installing;
+    // Counts resets, so that code compiled for blocks that have since been dropped is thrown away
+    uint64_t generation = 0;
+    bool stopping = false;
+
+    // Where a guest register lives while a block runs: a host register, or memory at an offset
+    // from the guest register file when hostRegister is negative
+    struct Home {
+        int hostRegister;
+        int32_t offset;
+    };
+    Home homes[16]; // D0-D7 then A0-A7
+    unsigned int registerUses[16];
+    int32_t programCounterOffset;
+    int32_t statusRegisterOffset;
+    int32_t blockFlushPendingOffset;
+    int32_t loopCounterOffset;
+
+    // State of the block being compiled
+    std::vector<uint8_t> code;
+    uint32_t blockAddress;
+    size_t loopStart;
+    // Extension words of the instruction being compiled and the address of the next one
+    const uint16_t *extensionWord;
+    uint32_t extensionAddress;
+    uint32_t nextAddress;
+    // Condition code liveness. The first pass notes the flags each instruction sets and whether it
+    // reads them or can leave the block, after which they all have to be in SR. The second pass
+    // then leaves out any update whose flags are all set again before anything reads them.
+    struct FlagEffects {
+        uint8_t set;
+        bool read;
+    };
+    bool analysingFlags;
+    size_t instructionIndex;
+    std::vector<FlagEffects> flagEffects;
+    std::vector<uint8_t> liveFlags; // The flags read after each instruction before being set again
+    size_t eliminatedFlagUpdates;
+
+    size_t assemble(const CPUCore::TranslatedBlock *block);
+    void install(CPUCore::TranslatedBlock *block, const std::vector<uint8_t> &code, size_t count, size_t eliminated);
+    void compileJobs();
+    size_t compileInstructions(const CPUCore::TranslatedBlock *block, size_t limit);
+    bool compileInstruction(const CPUCore::DecodedInstruction &decoded);
+    bool compileMOVE(uint16_t opcode);
+    bool compileArithmetic(uint16_t opcode);
+    bool compileArithmeticImmediate(uint16_t opcode);
+    bool compileArithmeticQuick(uint16_t opcode);
+    bool compileMiscellaneous(uint16_t opcode);
+    bool compileBranch(uint16_t opcode);
+    bool compileSource(int mode, int reg, int size, bool signExtend);
+    bool compileAddress(int mode, int reg, int size);
+    bool compileDestination(int mode, int reg, int size);
+    void compileOperation(int operation, int size, int destinationReg);
+    bool compileOperationToMemory(int operation, int size, int mode, int reg);
+    uint16_t nextExtensionWord();
+    uint32_t nextExtensionLong();
+    Home home(int guestRegister);
+
+    void emit8(uint8_t data);
+    void emit32(uint32_t data);
+    void emit64(uint64_t data);
+    void emitModRM(bool wordOperands, bool byteOperands, uint8_t opcode, uint8_t secondOpcode, int regField, bool regIsRegister, Home rm);
+    void emitLoad(int reg, Home source, int size, bool signExtend);
+    void emitStore(Home destination, int reg, int size);
+    void emitOperation(uint8_t opcode, int size, int destinationReg, int sourceReg);
+    void emitGroup(uint8_t opcode, int digit, Home rm);
+    void emitMoveImmediate(int reg, uint32_t value);
+    void emitStackSlot(uint8_t opcode, int reg, int slot);
+    void emitCall(const void *function);
+    void emitRead(int size);
+    void emitWrite(int size);
+    bool keepFlagUpdate(uint8_t flags);
+    void noteFlagsRead();
+    void emitLogicalFlags();
+    void emitArithmeticFlags(bool setExtend);
+    void emitPrologue();
+    void emitExit(uint32_t programCounter);
+    void emitExitToRegister(int reg);
+    void emitLoopBack(uint32_t target);
+    size_t emitJump(uint8_t condition);
+    void patchJump(size_t jump);
+public:
+    // Starts a background compile thread when background is true
+    JitCompiler(CPUCore *cpu, bool background = false);
+    ~JitCompiler();
+    // Returns true when the host can run compiled code
+    static bool isSupported();
+    // Compiles the longest run of instructions from the start of a block the compiler handles,
+    // setting the block's native code and the number of instructions it covers
+    void compile(CPUCore::TranslatedBlock *block);
+    // Queues a copy of a block for the background thread and returns straight away
+    void compileInBackground(const CPUCore::TranslatedBlock *block);
+    // Gives the blocks compiled in the background their code. Called by the CPU between blocks.
+    void installCompiledBlocks();
+    // Frees all compiled code, discarding anything still being compiled
+    void reset();
+};
@@ -0,0 +1,379 @@
+#pragma once
+#include <cstdint>
+
+// Definitions of the 68000 instruction set shared by the CPU core and the code that translates its instructions
+
+//Status Register flags
+#define SR_CCR_CARRY 0
+#define SR_CCR_OVERFLOW 1
+#define SR_CCR_ZERO 2
+#define SR_CCR_NEGATIVE 3
+#define SR_CCR_EXTEND 4
+#define SR_INT0 8
+#define SR_INT1 9
+#define SR_INT2 10
+#define SR_INTERRUPT_MASK (7 << SR_INT0)
+#define SR_SUPERVISOR_MODE 13
+#define SR_TRACE_MODE 15
+
+//Status register bits the 68000 implements
+#define SR_MASK 0xA71F
+
+//Instructions
+#define ABCD 0xC100
+#define ADD 0xD000
+#define ADDA 0xD0C0
+#define ADDI 0x0600
+#define ADDQ 0x5000
+#define ADDX 0xD100
+#define AND 0xC000
+#define ANDI 0x0200
+#define ANDI_TO_CCR 0x023C
+#define ANDI_TO_SR 0x027C
+#define Bcc 0x6000
+#define BIT_DYNAMIC 0x0100
+#define BIT_STATIC 0x0800
+#define BRA 0x6000
+#define BSR 0x6100
+#define CHK 0x4180
+#define CLR 0x4200
+#define CMP 0xB000
+#define CMPA 0xB0C0
+#define CMPI 0x0C00
+#define CMPM 0xB108
+#define DBcc 0x50C8
+#define DIVS 0x81C0
+#define DIVU 0x80C0
+#define EOR 0xB100
+#define EORI 0x0A00
+#define EORI_TO_CCR 0x0A3C
+#define EORI_TO_SR 0x0A7C
+#define EXG_DATA_REGISTERS 0xC140
+#define EXG_ADDRESS_REGISTERS 0xC148
+#define EXG_DATA_AND_ADDRESS_REGISTERS 0xC188
+#define EXT_W 0x4880
+#define EXT_L 0x48C0
+#define JMP 0x4EC0
+#define JSR 0x4E80
+#define LEA 0x41C0
+#define LINE_A 0xA000
+#define LINE_F 0xF000
+#define LINK 0x4E50
+#define MOVE_B 0x1000
+#define MOVE_W 0x3000
+#define MOVE_L 0x2000
+#define MOVE_FROM_CCR 0x42C0
+#define MOVE_FROM_SR 0x40C0
+#define MOVE_TO_CCR 0x44C0
+#define MOVE_TO_SR 0x46C0
+#define MOVE_USP 0x4E60
+#define MOVEM 0x4880
+#define MOVEP 0x0108
+#define MOVEQ 0x7000
+#define MULS 0xC1C0
+#define MULU 0xC0C0
+#define NBCD 0x4800
+#define NEG 0x4400
+#define NEGX 0x4000
+#define NOP 0x4E71
+#define NOT 0x4600
+#define OR 0x8000
+#define ORI 0x0000
+#define ORI_TO_CCR 0x003C
+#define ORI_TO_SR 0x007C
+#define PEA 0x4840
+#define RESET 0x4E70
+#define RTE 0x4E73
+#define RTR 0x4E77
+#define RTS 0x4E75
+#define SBCD 0x8100
+#define Scc 0x50C0
+#define SHIFT_MEMORY 0xE0C0
+#define SHIFT_REGISTER 0xE000
+#define STOP 0x4E72
+#define SUB 0x9000
+#define SUBA 0x90C0
+#define SUBI 0x0400
+#define SUBQ 0x5100
+#define SUBX 0x9100
+#define SWAP 0x4840
+#define TAS 0x4AC0
+#define TRAP 0x4E40
+#define TRAPV 0x4E76
+#define TST 0x4A00
+#define UNLK 0x4E58
+
+//Instructions as recorded in the dispatch table
+#define INSTRUCTION_ILLEGAL 0
+#define INSTRUCTION_ABCD 1
+#define INSTRUCTION_ADD 2
+#define INSTRUCTION_ADDA 3
+#define INSTRUCTION_ADDI 4
+#define INSTRUCTION_ADDQ 5
+#define INSTRUCTION_ADDX 6
+#define INSTRUCTION_AND 7
+#define INSTRUCTION_ANDI 8
+#define INSTRUCTION_ANDI_TO_CCR 9
+#define INSTRUCTION_ANDI_TO_SR 10
+#define INSTRUCTION_ASD 11
+#define INSTRUCTION_BCC 12
+#define INSTRUCTION_BCHG 13
+#define INSTRUCTION_BCLR 14
+#define INSTRUCTION_BRA 15
+#define INSTRUCTION_BSET 16
+#define INSTRUCTION_BSR 17
+#define INSTRUCTION_BTST 18
+#define INSTRUCTION_CHK 19
+#define INSTRUCTION_CLR 20
+#define INSTRUCTION_CMP 21
+#define INSTRUCTION_CMPA 22
+#define INSTRUCTION_CMPI 23
+#define INSTRUCTION_CMPM 24
+#define INSTRUCTION_DBCC 25
+#define INSTRUCTION_DIVS 26
+#define INSTRUCTION_DIVU 27
+#define INSTRUCTION_EOR 28
+#define INSTRUCTION_EORI 29
+#define INSTRUCTION_EORI_TO_CCR 30
+#define INSTRUCTION_EORI_TO_SR 31
+#define INSTRUCTION_EXG 32
+#define INSTRUCTION_EXT 33
+#define INSTRUCTION_JMP 34
+#define INSTRUCTION_JSR 35
+#define INSTRUCTION_LEA 36
+#define INSTRUCTION_LINE_A 37
+#define INSTRUCTION_LINE_F 38
+#define INSTRUCTION_LINK 39
+#define INSTRUCTION_LSD 40
+#define INSTRUCTION_MOVE 41
+#define INSTRUCTION_MOVE_FROM_CCR 42
+#define INSTRUCTION_MOVE_FROM_SR 43
+#define INSTRUCTION_MOVE_TO_CCR 44
+#define INSTRUCTION_MOVE_TO_SR 45
+#define INSTRUCTION_MOVE_USP 46
+#define INSTRUCTION_MOVEM 47
+#define INSTRUCTION_MOVEP 48
+#define INSTRUCTION_MOVEQ 49
+#define INSTRUCTION_MULS 50
+#define INSTRUCTION_MULU 51
+#define INSTRUCTION_NBCD 52
+#define INSTRUCTION_NEG 53
+#define INSTRUCTION_NEGX 54
+#define INSTRUCTION_NOP 55
+#define INSTRUCTION_NOT 56
+#define INSTRUCTION_OR 57
+#define INSTRUCTION_ORI 58
+#define INSTRUCTION_ORI_TO_CCR 59
+#define INSTRUCTION_ORI_TO_SR 60
+#define INSTRUCTION_PEA 61
+#define INSTRUCTION_RESET 62
+#define INSTRUCTION_ROD 63
+#define INSTRUCTION_ROXD 64
+#define INSTRUCTION_RTE 65
+#define INSTRUCTION_RTR 66
+#define INSTRUCTION_RTS 67
+#define INSTRUCTION_SBCD 68
+#define INSTRUCTION_SCC 69
+#define INSTRUCTION_STOP 70
+#define INSTRUCTION_SUB 71
+#define INSTRUCTION_SUBA 72
+#define INSTRUCTION_SUBI 73
+#define INSTRUCTION_SUBQ 74
+#define INSTRUCTION_SUBX 75
+#define INSTRUCTION_SWAP 76
+#define INSTRUCTION_TAS 77
+#define INSTRUCTION_TRAP 78
+#define INSTRUCTION_TRAPV 79
+#define INSTRUCTION_TST 80
+#define INSTRUCTION_UNLK 81
+#define INSTRUCTION_COUNT 82
+
+//Exception vectors
+#define VECTOR_ILLEGAL_INSTRUCTION 4
+#define VECTOR_ZERO_DIVIDE 5
+#define VECTOR_CHK 6
+#define VECTOR_TRAPV 7
+#define VECTOR_PRIVILEGE_VIOLATION 8
+#define VECTOR_LINE_A 10
+#define VECTOR_LINE_F 11
+#define VECTOR_FORMAT_ERROR 14
+#define VECTOR_SPURIOUS_INTERRUPT 24 // Followed by the autovectors of interrupt levels 1 to 7
+#define VECTOR_TRAP 32 // TRAP #0, followed by the vectors of TRAP #1 to #15
+#define VECTOR_UNIMPLEMENTED_INTEGER 61 // 68060 only
+
+//Addressing modes
+#define ADDRESS_MODE_DATA_REGISTER_DIRECT 0
+#define ADDRESS_MODE_ADDRESS_REGISTER_DIRECT 1
+#define ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT 2
+#define ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_POSTINCREMENT 3
+#define ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_PREDECREMENT 4
+#define ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_DISPLACEMENT 5
+#define ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_INDEX 6
+//Mode = 7 and address register = :
+#define ADDRESS_MODE_OTHERS 7
+#define ADDRESS_MODE_ABSOLUTE_SHORT 0
+#define ADDRESS_MODE_ABSOLUTE_LONG 1
+#define ADDRESS_MODE_PROGRAM_COUNTER_WITH_DISPLACEMENT 2
+#define ADDRESS_MODE_PROGRAM_COUNTER_WITH_INDEX 3
+#define ADDRESS_MODE_IMMEDIATE_OR_STATUS_REGISTER 4
+
+//Effective address modes used to specialise handlers: modes 0-6 as above, then mode 7 expanded by register
+#define EA_MODE(mode, reg) ((mode) == ADDRESS_MODE_OTHERS ? ADDRESS_MODE_OTHERS + (reg) : (mode))
+#define EA_ABSOLUTE_SHORT (ADDRESS_MODE_OTHERS + ADDRESS_MODE_ABSOLUTE_SHORT)
+#define EA_ABSOLUTE_LONG (ADDRESS_MODE_OTHERS + ADDRESS_MODE_ABSOLUTE_LONG)
+#define EA_PROGRAM_COUNTER_WITH_DISPLACEMENT (ADDRESS_MODE_OTHERS + ADDRESS_MODE_PROGRAM_COUNTER_WITH_DISPLACEMENT)
+#define EA_PROGRAM_COUNTER_WITH_INDEX (ADDRESS_MODE_OTHERS + ADDRESS_MODE_PROGRAM_COUNTER_WITH_INDEX)
+#define EA_IMMEDIATE (ADDRESS_MODE_OTHERS + ADDRESS_MODE_IMMEDIATE_OR_STATUS_REGISTER)
+#define EA_MODE_COUNT 12
+#define EA_ALTERABLE_MODE_COUNT 9
+
+//Effective address categories, as bit masks over the effective address modes
+#define EA_CATEGORY_ALL 0x0FFF
+#define EA_CATEGORY_DATA 0x0FFD
+#define EA_CATEGORY_ALTERABLE 0x01FF
+#define EA_CATEGORY_DATA_ALTERABLE 0x01FD
+#define EA_CATEGORY_MEMORY_ALTERABLE 0x01FC
+#define EA_CATEGORY_CONTROL 0x07E4
+
+//Size codes
+#define SIZE_BYTE 0
+#define SIZE_WORD 1
+#define SIZE_LONG 2
+
+//Arithmetic operations shared by the ADD, SUB and CMP handlers
+#define OPERATION_ADD 0
+#define OPERATION_SUB 1
+#define OPERATION_CMP 2
+
+//Logical operations shared by the AND, OR and EOR handlers
+#define LOGICAL_AND 0
+#define LOGICAL_OR 1
+#define LOGICAL_EOR 2
+
+//Shift and rotate types, as encoded in the instructions
+#define SHIFT_ARITHMETIC 0
+#define SHIFT_LOGICAL 1
+#define ROTATE_EXTEND 2
+#define ROTATE 3
+
+//Index size codes
+#define INDEX_SIZE_WORD 0
+#define INDEX_SIZE_LONG 0x8
+
+//Conditional tests
+#define CONDITIONAL_TRUE 0
+#define CONDITIONAL_FALSE 1
+#define CONDITIONAL_HIGH 2
+#define CONDITIONAL_LOW_OR_SAME 3
+#define CONDITIONAL_CARRY_CLEAR 4
+#define CONDITIONAL_CARRY_SET 5
+#define CONDITIONAL_NOT_EQUAL 6
+#define CONDITIONAL_EQUAL 7
+#define CONDITIONAL_OVERFLOW_CLEAR 8
+#define CONDITIONAL_OVERFLOW_SET 9
+#define CONDITIONAL_PLUS 10
+#define CONDITIONAL_MINUS 11
+#define CONDITIONAL_GREATER_OR_EQUAL 12
+#define CONDITIONAL_LESS_THAN 13
+#define CONDITIONAL_GREATER_THAN 14
+#define CONDITIONAL_LESS_OR_EQUAL 15
+
+// Returns the mask of the bits used by an operand of the given size
+static constexpr uint32_t sizeMask(int size)
+{
+    return size == SIZE_BYTE ? 0xFF : size == SIZE_WORD ? 0xFFFF : 0xFFFFFFFF;
+}
+
+// Returns the most significant bit of an operand of the given size
+static constexpr uint32_t signBit(int size)
+{
+    return size == SIZE_BYTE ? 0x80 : size == SIZE_WORD ? 0x8000 : 0x80000000;
+}
+
+static constexpr uint32_t sizeInBytes(int size)
+{
+    return 1 << size;
+}
+
+// Returns true when a condition holds for the condition codes NZVC given as a 4 bit value
+static constexpr bool conditionHolds(int condition, int ccr)
+{
+    bool carry = ((ccr >> SR_CCR_CARRY) & 1) == 1;
+    bool overflow = ((ccr >> SR_CCR_OVERFLOW) & 1) == 1;
+    bool zero = ((ccr >> SR_CCR_ZERO) & 1) == 1;
+    bool negative = ((ccr >> SR_CCR_NEGATIVE) & 1) == 1;
+
+    switch (condition) {
+    case CONDITIONAL_TRUE:
+        return true;
+    case CONDITIONAL_FALSE:
+        return false;
+    case CONDITIONAL_HIGH:
+        return !carry && !zero;
+    case CONDITIONAL_LOW_OR_SAME:
+        return carry || zero;
+    case CONDITIONAL_CARRY_CLEAR:
+        return !carry;
+    case CONDITIONAL_CARRY_SET:
+        return carry;
+    case CONDITIONAL_NOT_EQUAL:
+        return !zero;
+    case CONDITIONAL_EQUAL:
+        return zero;
+    case CONDITIONAL_OVERFLOW_CLEAR:
+        return !overflow;
+    case CONDITIONAL_OVERFLOW_SET:
+        return overflow;
+    case CONDITIONAL_PLUS:
+        return !negative;
+    case CONDITIONAL_MINUS:
+        return negative;
+    case CONDITIONAL_GREATER_OR_EQUAL:
+        return negative == overflow;
+    case CONDITIONAL_LESS_THAN:
+        return negative != overflow;
+    case CONDITIONAL_GREATER_THAN:
+        return negative == overflow && !zero;
+    default:
+        return negative != overflow || zero;
+    }
+}
+
+// Returns a mask with bit n set when a condition holds for the condition codes NZVC = n
+static constexpr uint16_t conditionMask(int condition)
+{
+    uint16_t mask = 0;
+
+    for (int ccr = 0; ccr < 16; ccr++) {
+        if (conditionHolds(condition, ccr))
+            mask |= 1 << ccr;
+    }
+    return mask;
+}
+
+// The 16 conditions against every value of NZVC, so testing a condition is a shift and a mask
+static constexpr uint16_t conditionTable[16] = {
+    conditionMask(0), conditionMask(1), conditionMask(2), conditionMask(3),
+    conditionMask(4), conditionMask(5), conditionMask(6), conditionMask(7),
+    conditionMask(8), conditionMask(9), conditionMask(10), conditionMask(11),
+    conditionMask(12), conditionMask(13), conditionMask(14), conditionMask(15)
+};
+
+// 68000 clock cycles to calculate each effective address mode, for a byte or word operand then a
+// long one, as given in the M68000 user's manual. Register direct modes take none.
+static constexpr uint8_t effectiveAddressCycles[2][EA_MODE_COUNT] = {
+    { 0, 0, 4, 4, 6, 8, 10, 8, 12, 8, 10, 4 },
+    { 0, 0, 8, 8, 10, 12, 14, 12, 16, 12, 14, 8 }
+};
+
+// Cycles MOVE adds for writing its destination, for which predecrement costs no more than (An)
+static constexpr uint8_t moveDestinationCycles[2][EA_MODE_COUNT] = {
+    { 0, 0, 4, 4, 4, 8, 10, 8, 12, 0, 0, 0 },
+    { 0, 0, 8, 8, 8, 12, 14, 12, 16, 0, 0, 0 }
+};
+
+// Whole instruction times of JMP, JSR, LEA and PEA for each control addressing mode
+static constexpr uint8_t jumpCycles[EA_MODE_COUNT] = { 0, 0, 8, 0, 0, 10, 14, 10, 12, 10, 14, 0 };
+static constexpr uint8_t jumpToSubroutineCycles[EA_MODE_COUNT] = { 0, 0, 16, 0, 0, 18, 22, 18, 20, 18, 22, 0 };
+static constexpr uint8_t loadEffectiveAddressCycles[EA_MODE_COUNT] = { 0, 0, 4, 0, 0, 8, 12, 8, 12, 8, 12, 0 };
+static constexpr uint8_t pushEffectiveAddressCycles[EA_MODE_COUNT] = { 0, 0, 12, 0, 0, 16, 20, 16, 20, 16, 20, 0 };
@@ -2,9 +2,14 @@
 //
 
 #include "CPUCore.h"
+#include "Disassembler.h"
 #include "Memory.h"
 #include "ProgramLoader.h"
+#include "StaticRecompiler.h"
+#include <chrono>
+#include <fstream>
 #include <iostream>
+#include <string>
 #ifdef _DEBUG
 #define DEBUG_MODE 1
 #else
@@ -17,7 +22,7 @@ using namespace conmanip;
 
 using namespace std;
 
-int main()
+int main(int argc, char *argv[])
 {
 
 #ifdef WIN32
@@ -45,14 +50,55 @@ int main()
 
     Memory *memory = new Memory(256);
     CPUCore *cpu = new CPUCore(memory, 68000);
-    if (!ProgramLoader::loadProgram("program.S68", cpu, memory)) {
+    // An argument of disassemble lists the program instead of running it
+    if (argc > 1 && string(argv[1]) == "disassemble") {
+        Disassembler disassembler(memory);
+        string listing;
+        disassembler.disassembleImage("program.S68", listing);
+        cout << listing;
+        return 0;
+    }
+    // An argument of recompile writes the program out as C++, to program.cpp or the file named after it
+    if (argc > 1 && string(argv[1]) == "recompile") {
+        StaticRecompiler recompiler(memory);
+        string source;
+        string fileName = argc > 2 ? argv[2] : "program.cpp";
+        size_t count = recompiler.recompileImage("program.S68", source);
+        ofstream sourceFile(fileName);
+        if (count == 0 || !(sourceFile << source)) {
+            cout << "Unable to recompile program.S68 to " << fileName << endl;
+            return 1;
+        }
+        cout << "Recompiled " << count << " instructions to " << fileName << endl;
+        return 0;
+    }
+    if (!ProgramLoader::loadProgram("program.S68", cpu, memory, true)) {
         cout << "Program loader failed. Exiting." << endl;
         return 1;
     }
-    bool cpuRunning = true;
-    while (cpuRunning)
-        cpuRunning = cpu->startNextCycle();
-    cout << endl << "Execution completed." << endl << endl;
+    // The interpreter can be chosen on the command line: step, blocks (the default), threaded, jit or tiered
+    string interpreter = argc > 1 ? argv[1] : "blocks";
+    if (interpreter == "step")
+        cpu->setInterpreter(CPUCore::INTERPRETER_STEP);
+    else if (interpreter == "threaded")
+        cpu->setInterpreter(CPUCore::INTERPRETER_THREADED);
+    else if (interpreter == "jit")
+        cpu->setInterpreter(CPUCore::INTERPRETER_JIT);
+    else if (interpreter == "tiered")
+        cpu->setInterpreter(CPUCore::INTERPRETER_TIERED);
+    else
+        cpu->setInterpreter(CPUCore::INTERPRETER_BLOCKS);
+    // A second argument of trace prints each instruction as it runs
+    if (argc > 2 && string(argv[2]) == "trace")
+        cpu->setTracing(true);
+    chrono::steady_clock::time_point started = chrono::steady_clock::now();
+    cpu->run();
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+    cout << endl << "Execution completed." << endl;
+    // The cycle count is compared against an 8 MHz 68000
+    uint64_t cycles = cpu->getCycleCount();
+    cout << cycles << " cycles in " << seconds << " seconds, " << (seconds > 0 ? cycles / seconds / 1e6 : 0) << " MHz emulated, "
+        << cycles / 8e6 << " seconds on an 8 MHz 68000" << endl << endl;
     if (DEBUG_MODE) {
         cpu->displayInfo();
         memory->dumpMemoryToConsole();
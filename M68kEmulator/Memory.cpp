@@ -3,53 +3,68 @@
 #include <fstream>
 #include <iomanip>
 #include <cstdint>
+#include <cstring>
+
+// Code pages are tracked in 256 byte units so that data kept next to code rarely shares a page with it
+#define CODE_PAGE_SHIFT 8
+// Bytes compared at a time by findMismatch before it looks for the byte that differs
+#define MISMATCH_CHUNK 64
 
 Memory::Memory(unsigned int sizeinKB)
 {
     this->sizeInKB = sizeinKB;
     unsigned int sizeInBytes = sizeinKB * 1024;
     memoryBlock = new uint8_t[sizeInBytes];
+    codePages = new uint8_t[(sizeInBytes >> CODE_PAGE_SHIFT) + 1]();
     clearMemory(0);
 }
 
 
 Memory::~Memory()
 {
-    delete memoryBlock;
+    delete[] memoryBlock;
+    delete[] codePages;
 }
 
 uint8_t Memory::readByteFromMemory(uint32_t address, int offset)
 {
-    return memoryBlock[address + offset];
+    address = (address + offset) & addressMask;
+    return memoryBlock[address];
 }
 
 uint16_t Memory::readWordFromMemory(uint32_t address, int offset)
 {
-    uint16_t data = memoryBlock[address + offset] << 8;
-    data += memoryBlock[address + offset + 1];
+    address = (address + offset) & addressMask;
+    uint16_t data = memoryBlock[address] << 8;
+    data += memoryBlock[address + 1];
     return data;
 }
 
 uint32_t Memory::readLongFromMemory(uint32_t address, int offset)
 {
-    uint32_t data = memoryBlock[address + offset] << 24;
-    data += memoryBlock[address + offset + 1] << 16;
-    data += memoryBlock[address + offset + 2] << 8;
-    data += memoryBlock[address + offset + 3];
+    address = (address + offset) & addressMask;
+    uint32_t data = memoryBlock[address] << 24;
+    data += memoryBlock[address + 1] << 16;
+    data += memoryBlock[address + 2] << 8;
+    data += memoryBlock[address + 3];
     return data;
 }
 
 void Memory::writeByteToMemory(uint8_t data, uint32_t address, int offset)
 {
-    memoryBlock[address + offset] = data;
+    address = (address + offset) & addressMask;
+    memoryBlock[address] = data;
+    checkCodeWrite(address, 1);
 }
 
 void Memory::writeWordToMemory(uint16_t data, uint32_t address, int offset)
 {
     uint8_t firstByte = (uint8_t)(data >> 8);
     uint8_t secondByte = (uint8_t)data;
-    memoryBlock[address + offset] = firstByte;
-    memoryBlock[address + 1 + offset] = secondByte;
+    address = (address + offset) & addressMask;
+    memoryBlock[address] = firstByte;
+    memoryBlock[address + 1] = secondByte;
+    checkCodeWrite(address, 2);
 }
 
 void Memory::writeLongToMemory(uint32_t data, uint32_t address, int offset)
@@ -58,10 +73,119 @@ void Memory::writeLongToMemory(uint32_t data, uint32_t address, int offset)
     uint8_t secondByte = (uint8_t)(data >> 16);
     uint8_t thirdByte = (uint8_t)(data >> 8);
     uint8_t fourthByte = (uint8_t)data;
-    memoryBlock[address + offset] = firstByte;
-    memoryBlock[address + 1 + offset] = secondByte;
-    memoryBlock[address + 2 + offset] = thirdByte;
-    memoryBlock[address + 3 + offset] = fourthByte;
+    address = (address + offset) & addressMask;
+    memoryBlock[address] = firstByte;
+    memoryBlock[address + 1] = secondByte;
+    memoryBlock[address + 2] = thirdByte;
+    memoryBlock[address + 3] = fourthByte;
+    checkCodeWrite(address, 4);
+}
+
+// Reports a write to the code write handler when either end of it lies in a code page
+void Memory::checkCodeWrite(uint32_t address, unsigned int length)
+{
+    if ((codePages[address >> CODE_PAGE_SHIFT] | codePages[(address + length - 1) >> CODE_PAGE_SHIFT]) != 0) {
+        codeWrites++;
+        if (codeWriteHandler)
+            codeWriteHandler(address);
+    }
+}
+
+// Reports a bulk write to the code write handler once for each code page it covers
+void Memory::checkCodeRange(uint32_t address, uint32_t length)
+{
+    for (uint32_t page = address >> CODE_PAGE_SHIFT; page <= (address + length - 1) >> CODE_PAGE_SHIFT; page++) {
+        if (codePages[page] == 0)
+            continue;
+        codeWrites++;
+        if (codeWriteHandler)
+            codeWriteHandler(page << CODE_PAGE_SHIFT > address ? page << CODE_PAGE_SHIFT : address);
+    }
+}
+
+uint32_t Memory::getSizeInBytes()
+{
+    return sizeInKB * 1024;
+}
+
+void Memory::fillMemory(uint32_t data, unsigned int width, uint32_t address, uint32_t count)
+{
+    uint32_t length = count * width;
+    uint8_t *destination = memoryBlock + address;
+
+    for (unsigned int i = 0; i < width; i++)
+        destination[i] = (uint8_t)(data >> ((width - 1 - i) * 8));
+
+    if (width == 1 || (data & 0xFF) * (width == 2 ? 0x0101 : 0x01010101) == data) {
+        memset(destination, destination[0], length);
+    }
+    else {
+        // Each pass copies everything written so far, doubling it
+        for (uint32_t filled = width; filled < length; filled *= 2)
+            memcpy(destination + filled, destination, filled < length - filled ? filled : length - filled);
+    }
+    checkCodeRange(address, length);
+}
+
+void Memory::copyMemory(uint32_t destination, uint32_t source, uint32_t length)
+{
+    memcpy(memoryBlock + destination, memoryBlock + source, length);
+    checkCodeRange(destination, length);
+}
+
+bool Memory::findByte(uint8_t data, uint32_t address, uint32_t length, uint32_t &found)
+{
+    const uint8_t *match = (const uint8_t *)memchr(memoryBlock + address, data, length);
+
+    if (match == nullptr)
+        return false;
+    found = (uint32_t)(match - memoryBlock);
+    return true;
+}
+
+bool Memory::findMismatch(uint32_t first, uint32_t second, uint32_t length, uint32_t &offset)
+{
+    for (uint32_t chunk = 0; chunk < length; chunk += MISMATCH_CHUNK) {
+        uint32_t chunkLength = length - chunk < MISMATCH_CHUNK ? length - chunk : MISMATCH_CHUNK;
+        if (memcmp(memoryBlock + first + chunk, memoryBlock + second + chunk, chunkLength) == 0)
+            continue;
+
+        for (offset = chunk; memoryBlock[first + offset] == memoryBlock[second + offset]; offset++);
+        return true;
+    }
+    return false;
+}
+
+void Memory::markCode(uint32_t address, unsigned int length)
+{
+    address &= addressMask;
+    for (uint32_t page = address >> CODE_PAGE_SHIFT; page <= (address + length - 1) >> CODE_PAGE_SHIFT; page++)
+        codePages[page] = 1;
+}
+
+bool Memory::isCode(uint32_t address, uint32_t length)
+{
+    address &= addressMask;
+    for (uint32_t page = address >> CODE_PAGE_SHIFT; page <= (address + length - 1) >> CODE_PAGE_SHIFT; page++) {
+        if (codePages[page] != 0)
+            return true;
+    }
+    return false;
+}
+
+uint64_t Memory::getCodeWriteCount()
+{
+    return codeWrites;
+}
+
+void Memory::setCodeWriteHandler(std::function<void(uint32_t address)> handler)
+{
+    codeWriteHandler = handler;
+}
+
+void Memory::setAddressMask(uint32_t mask)
+{
+    addressMask = mask;
 }
 
 void Memory::clearMemory(uint8_t value)
@@ -1,6 +1,7 @@
 #pragma once
 #include <cstdint>
 #include <string>
+#include <functional>
 
 using namespace std;
 
@@ -9,6 +10,15 @@ class Memory
 private:
     uint8_t *memoryBlock;
     unsigned int sizeInKB;
+    // One flag per code page, set for pages the CPU has predecoded instructions from
+    uint8_t *codePages;
+    std::function<void(uint32_t address)> codeWriteHandler;
+    uint64_t codeWrites = 0;
+    // The address lines the CPU drives. Bits above them are dropped from every address, so a 24-bit
+    // 68000 reads the same byte at $01000100 as at $000100.
+    uint32_t addressMask = 0xFFFFFFFF;
+    void checkCodeWrite(uint32_t address, unsigned int length);
+    void checkCodeRange(uint32_t address, uint32_t length);
     void clearMemory(uint8_t value);
     void insertString(string s, unsigned int address);
 public:
@@ -21,8 +31,27 @@ public:
     void writeByteToMemory(uint8_t data, uint32_t address, int offset = 0);
     void writeWordToMemory(uint16_t data, uint32_t address, int offset = 0);
     void writeLongToMemory(uint32_t data, uint32_t address, int offset = 0);
+    uint32_t getSizeInBytes();
+    // Writes count copies of a 1, 2 or 4 byte value from an address
+    void fillMemory(uint32_t data, unsigned int width, uint32_t address, uint32_t count);
+    // Copies a range of memory that does not overlap the range it is copied to
+    void copyMemory(uint32_t destination, uint32_t source, uint32_t length);
+    // Finds the first byte equal to data in a range, returning false when there is none
+    bool findByte(uint8_t data, uint32_t address, uint32_t length, uint32_t &found);
+    // Finds the offset of the first byte that differs between two ranges, returning false when they match
+    bool findMismatch(uint32_t first, uint32_t second, uint32_t length, uint32_t &offset);
     void dumpMemoryToFile(std::string fileName);
     void dumpMemoryToConsole(unsigned int rowsToShow = 20);
     void loadMemoryFromFile(std::string fileName);
+    // Marks the pages covering a range as holding code, so that writes to them are reported
+    void markCode(uint32_t address, unsigned int length);
+    // Returns true when any page of a range holds code
+    bool isCode(uint32_t address, uint32_t length);
+    // Returns the number of writes that have landed in code pages
+    uint64_t getCodeWriteCount();
+    // Sets the function called with the address of every write that lands in a code page
+    void setCodeWriteHandler(std::function<void(uint32_t address)> handler);
+    // Sets the address lines the CPU drives, as a mask of the address bits that reach memory
+    void setAddressMask(uint32_t mask);
 };
 
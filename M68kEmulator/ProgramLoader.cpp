@@ -4,74 +4,75 @@
 #include <string>
 #include <cstdlib>
 
-bool ProgramLoader::loadProgram(string fileName, CPUCore *cpu, Memory *memory)
+bool ProgramLoader::loadProgram(string fileName, CPUCore *cpu, Memory *memory, bool predecode)
+{
+    vector<Segment> segments;
+
+    if (loadImage(fileName, memory, segments))
+    {
+        cout << "Loading..." << endl;
+        cpu->setProgramCounter(memory->startingLocation);
+        if (predecode) {
+            vector<pair<uint32_t, uint32_t>> ranges;
+            for (const Segment &segment : segments)
+                ranges.push_back({ segment.address, segment.length });
+            cpu->predecodeReachable(memory->startingLocation, ranges);
+        }
+        cout << "Program loaded!" << endl << endl;
+        return true;
+    }
+
+    else cout << "Unable to open file" << endl;
+    return false;
+
+}
+
+bool ProgramLoader::loadImage(string fileName, Memory *memory, vector<Segment> &segments)
 {
     string line;
     ifstream programFile;
     programFile.open(fileName);
     if (programFile.is_open())
     {
-        cout << "Loading..." << endl;
         while (getline(programFile, line))
         {
             string recordType = line.substr(0, 2);
             unsigned int recordSize = extractHex(line.substr(2, 2));
             string record = line.substr(4, recordSize * 2);
-            if (recordType == "S1") {
-                string memoryString = record.substr(0, 4);
-                uint32_t memoryAddress = extractHex(memoryString);
-                for (unsigned int i = 4; i < ((recordSize * 2) - 2); i += 2) {
-                    unsigned int data = extractHex(record.substr(i, 2));
-                    memory->writeByteToMemory(data, memoryAddress);
-                    memoryAddress++;
-                }
-            }
-            else if (recordType == "S2") {
-                string memoryString = record.substr(0, 6);
-                uint32_t memoryAddress = extractHex(memoryString);
-                for (unsigned int i = 6; i < ((recordSize * 2) - 2); i += 2) {
-                    unsigned int data = extractHex(record.substr(i, 2));
-                    memory->writeByteToMemory(data, memoryAddress);
-                    memoryAddress++;
-                }
-            }
-            else if (recordType == "S3") {
-                string memoryString = record.substr(0, 8);
-                uint32_t memoryAddress = extractHex(memoryString);
-                for (unsigned int i = 8; i < ((recordSize * 2) - 2); i += 2) {
-                    unsigned int data = extractHex(record.substr(i, 2));
-                    memory->writeByteToMemory(data, memoryAddress);
-                    memoryAddress++;
-                }
-            }
-            else if (recordType == "S7") {
-                string memoryString = record.substr(0, 8);
-                uint32_t memoryAddress = extractHex(memoryString);
-                cpu->setProgramCounter(memoryAddress);
-                memory->startingLocation = memoryAddress;
-            }
-            else if (recordType == "S8") {
-                string memoryString = record.substr(0, 6);
-                uint32_t memoryAddress = extractHex(memoryString);
-                cpu->setProgramCounter(memoryAddress);
+            // S1, S2 and S3 records hold data at 16, 24 and 32 bit addresses. S9, S8 and S7 end the file with the start address.
+            unsigned int addressLength = 0;
+            if (recordType == "S1" || recordType == "S9")
+                addressLength = 4;
+            else if (recordType == "S2" || recordType == "S8")
+                addressLength = 6;
+            else if (recordType == "S3" || recordType == "S7")
+                addressLength = 8;
+            else
+                continue;
+
+            uint32_t memoryAddress = extractHex(record.substr(0, addressLength));
+            if (recordType == "S7" || recordType == "S8" || recordType == "S9") {
                 memory->startingLocation = memoryAddress;
+                continue;
             }
-            else if (recordType == "S9") {
-                string memoryString = record.substr(0, 4);
-                uint32_t memoryAddress = extractHex(memoryString);
-                cpu->setProgramCounter(memoryAddress);
-                memory->startingLocation = memoryAddress;
+
+            uint32_t start = memoryAddress;
+            for (unsigned int i = addressLength; i < ((recordSize * 2) - 2); i += 2) {
+                unsigned int data = extractHex(record.substr(i, 2));
+                memory->writeByteToMemory(data, memoryAddress);
+                memoryAddress++;
             }
-            
+
+            // Records usually follow on from each other, so they are merged into one segment
+            if (!segments.empty() && segments.back().address + segments.back().length == start)
+                segments.back().length += memoryAddress - start;
+            else if (memoryAddress != start)
+                segments.push_back({ start, memoryAddress - start });
         }
-        cout << "Program loaded!" << endl << endl;
         programFile.close();
         return true;
     }
-
-    else cout << "Unable to open file" << endl;
     return false;
-    
 }
 
 inline uint32_t ProgramLoader::extractHex(string record)
@@ -1,11 +1,22 @@
 #pragma once
+#include <vector>
 #include "Memory.h"
 #include "CPUCore.h"
 
 class ProgramLoader
 {
 public:
-    static bool loadProgram(string fileName, CPUCore *cpu, Memory *memory);
+    // A run of consecutive bytes loaded from the data records of an S-record file
+    struct Segment {
+        uint32_t address;
+        uint32_t length;
+    };
+    // Loads an S-record file and sets PC to its start address. With predecode, the code reachable
+    // from the start address is also decoded into the CPU's instruction cache.
+    static bool loadProgram(string fileName, CPUCore *cpu, Memory *memory, bool predecode = false);
+    // Loads the data records of an S-record file into memory without a CPU, adding the segments
+    // they cover. The start address, when the file has one, goes to memory->startingLocation.
+    static bool loadImage(string fileName, Memory *memory, vector<Segment> &segments);
 private:
     static inline uint32_t extractHex(string record);
 };
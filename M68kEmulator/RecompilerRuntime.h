@@ -0,0 +1,144 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include "CPUCore.h"
+#include "Memory.h"
+#include "M68kDefinitions.h"
+#include "AluKernels.h"
+
+// Support for the C++ written by StaticRecompiler. The recompiled code keeps the guest registers in
+// locals and works the condition codes out as each instruction runs, so everything here is inline.
+
+// Bytes of the image the recompiled program was made from, copied into memory before it starts
+struct RecompiledSegment {
+    uint32_t address;
+    uint32_t length;
+    const uint8_t *data;
+};
+
+// Bytes holding recompiled instructions, from start up to end
+struct RecompiledRange {
+    uint32_t start;
+    uint32_t end;
+};
+
+inline void loadRecompiledSegments(Memory &memory, const RecompiledSegment *segments, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+        for (uint32_t offset = 0; offset < segments[i].length; offset++)
+            memory.writeByteToMemory(segments[i].data[offset], segments[i].address + offset);
+}
+
+// Marks the recompiled instructions as code, so that writes to them can be caught
+inline void markRecompiledCode(Memory &memory, const RecompiledRange *ranges, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+        memory.markCode(ranges[i].start, ranges[i].end - ranges[i].start);
+}
+
+// Returns true when a write overlaps a recompiled instruction. The page check keeps writes to data
+// away from the code cheap, and the ranges tell writes to data sharing a page with code apart.
+inline bool writesRecompiledCode(Memory &memory, const RecompiledRange *ranges, size_t count, uint32_t address, uint32_t length)
+{
+    if (!memory.isCode(address, length))
+        return false;
+
+    for (size_t i = 0; i < count; i++)
+        if (address < ranges[i].end && address + length > ranges[i].start)
+            return true;
+    return false;
+}
+
+inline void loadRecompiledRegisters(CPUCore &cpu, uint32_t *D, uint32_t *A, uint16_t &SR)
+{
+    for (int reg = 0; reg < 8; reg++) {
+        D[reg] = cpu.getDataRegister(reg);
+        A[reg] = cpu.getAddressRegister(reg);
+    }
+    SR = cpu.getStatusRegister();
+}
+
+inline void saveRecompiledRegisters(CPUCore &cpu, const uint32_t *D, const uint32_t *A, uint16_t SR, uint32_t pc)
+{
+    for (int reg = 0; reg < 8; reg++) {
+        cpu.setDataRegister(reg, D[reg]);
+        cpu.setAddressRegister(reg, A[reg]);
+    }
+    cpu.setStatusRegister(SR);
+    cpu.setProgramCounter(pc);
+}
+
+// Runs the instruction at pc on the interpreter, for instructions the recompiled code leaves to it
+// and for code it never found. Returns false when execution stops, otherwise pc is where to go next.
+inline bool stepRecompiledInstruction(CPUCore &cpu, uint32_t *D, uint32_t *A, uint16_t &SR, uint32_t &pc)
+{
+    saveRecompiledRegisters(cpu, D, A, SR, pc);
+    if (!cpu.startNextCycle())
+        return false;
+    loadRecompiledRegisters(cpu, D, A, SR);
+    pc = cpu.getProgramCounter();
+    return true;
+}
+
+template<int Size>
+inline uint32_t recompiledRead(Memory &memory, uint32_t address)
+{
+    if (Size == SIZE_BYTE)
+        return memory.readByteFromMemory(address);
+    else if (Size == SIZE_WORD)
+        return memory.readWordFromMemory(address);
+    else
+        return memory.readLongFromMemory(address);
+}
+
+template<int Size>
+inline void recompiledWrite(Memory &memory, uint32_t address, uint32_t data)
+{
+    if (Size == SIZE_BYTE)
+        memory.writeByteToMemory(data, address);
+    else if (Size == SIZE_WORD)
+        memory.writeWordToMemory(data, address);
+    else
+        memory.writeLongToMemory(data, address);
+}
+
+// Writes the low bytes of a data register, leaving the rest alone
+template<int Size>
+inline void recompiledWriteRegister(uint32_t &reg, uint32_t data)
+{
+    reg = (reg & ~sizeMask(Size)) | (data & sizeMask(Size));
+}
+
+// N and Z from the result with V and C cleared, as MOVE, CLR and the logical operations set them
+template<int Size>
+inline void recompiledLogicalFlags(uint16_t &SR, uint32_t result)
+{
+    SR = (SR & ~0x0F) | logicalFlags(Size, result);
+}
+
+template<int Size>
+inline uint32_t recompiledAdd(uint16_t &SR, uint32_t source, uint32_t destination)
+{
+    uint16_t flags;
+    uint32_t result = aluAdd<Size>(source, destination, 0, flags);
+
+    SR = (SR & ~0x1F) | flags;
+    return result;
+}
+
+// Subtracts source from destination. CMP passes false for extend and leaves X alone.
+template<int Size>
+inline uint32_t recompiledSubtract(uint16_t &SR, uint32_t source, uint32_t destination, bool extend = true)
+{
+    uint16_t flags;
+    uint32_t result = aluSubtract<Size>(source, destination, 0, flags);
+    uint16_t changed = extend ? 0x1F : 0x0F;
+
+    SR = (SR & ~changed) | (flags & changed);
+    return result;
+}
+
+inline bool recompiledCondition(uint16_t SR, int condition)
+{
+    return ((conditionTable[condition] >> (SR & 0x0F)) & 1) == 1;
+}
@@ -0,0 +1,587 @@
+#include "StaticRecompiler.h"
+#include "M68kDefinitions.h"
+#include <cstdarg>
+#include <cstdio>
+#include <iterator>
+
+#define SEGMENT_BYTES_PER_LINE 16
+
+static const char *const sizeNames[] = { "SIZE_BYTE", "SIZE_WORD", "SIZE_LONG" };
+
+// Returns printf style text as a string, for the pieces of generated expressions
+static std::string format(const char *text, ...)
+{
+    char buffer[128];
+    va_list arguments;
+
+    va_start(arguments, text);
+    vsnprintf(buffer, sizeof(buffer), text, arguments);
+    va_end(arguments);
+    return buffer;
+}
+
+// Returns a displacement as text to add to an address: nothing, " + n" or " - n"
+static std::string offset(int32_t displacement)
+{
+    if (displacement == 0)
+        return std::string();
+    if (displacement < 0)
+        return format(" - %u", 0 - (uint32_t)displacement);
+    return format(" + %d", displacement);
+}
+
+// Returns true for instructions after which the recompiled code carries on at the next
+// instruction. Branches leave through their own jumps, and every instruction left to the
+// interpreter comes back to the next one through the dispatch switch.
+static bool fallsThrough(uint8_t instruction)
+{
+    switch (instruction) {
+    case INSTRUCTION_ADD:
+    case INSTRUCTION_ADDA:
+    case INSTRUCTION_ADDI:
+    case INSTRUCTION_ADDQ:
+    case INSTRUCTION_BCC:
+    case INSTRUCTION_CLR:
+    case INSTRUCTION_CMP:
+    case INSTRUCTION_CMPA:
+    case INSTRUCTION_EXG:
+    case INSTRUCTION_LEA:
+    case INSTRUCTION_MOVE:
+    case INSTRUCTION_MOVE_FROM_SR:
+    case INSTRUCTION_MOVEM:
+    case INSTRUCTION_MOVEQ:
+    case INSTRUCTION_NOP:
+    case INSTRUCTION_SUB:
+    case INSTRUCTION_SUBA:
+    case INSTRUCTION_SUBI:
+    case INSTRUCTION_SUBQ:
+    case INSTRUCTION_SWAP:
+        return true;
+    default:
+        return false;
+    }
+}
+
+StaticRecompiler::StaticRecompiler(Memory *memory) : disassembler(memory)
+{
+    this->memory = memory;
+    instructionTable = CPUCore::sharedInstructionTable();
+}
+
+// Returns true when a range lies wholly within one of the loaded segments
+bool StaticRecompiler::isLoaded(uint32_t address, uint32_t length)
+{
+    for (const ProgramLoader::Segment &segment : segments) {
+        if (address >= segment.address && address + length <= segment.address + segment.length)
+            return true;
+    }
+    return false;
+}
+
+// Follows the control flow from the entry point, recording every instruction reached and the
+// addresses that are reached other than by falling through
+void StaticRecompiler::recoverControlFlow(uint32_t entry)
+{
+    std::vector<uint32_t> pending(1, entry);
+    blockStarts.insert(entry);
+
+    while (!pending.empty()) {
+        uint32_t address = pending.back();
+        pending.pop_back();
+
+        // Decode straight-line code until it ends, leaves the image or joins code already found
+        while ((address & 1) == 0 && instructions.count(address) == 0 && isLoaded(address, 2)) {
+            uint16_t opcode = memory->readWordFromMemory(address);
+            const CPUCore::InstructionEntry &decoded = instructionTable[opcode];
+            RecoveredInstruction recovered = { opcode, decoded.instruction, (uint8_t)(2 + decoded.extensionWords * 2) };
+            uint32_t target;
+
+            if (!isLoaded(address, recovered.length))
+                break;
+            instructions[address] = recovered;
+
+            if (CPUCore::branchTarget(memory, address, opcode, recovered.instruction, target)) {
+                blockStarts.insert(target);
+                pending.push_back(target);
+            }
+
+            uint8_t instruction = recovered.instruction;
+            address += recovered.length;
+            if (CPUCore::endsControlFlow(instruction))
+                break;
+            // Calls return, and the instructions run on the interpreter come back, to the next
+            // instruction through the dispatch switch
+            if (!fallsThrough(instruction))
+                blockStarts.insert(address);
+        }
+    }
+
+    // Code that runs on into an address the instructions do not continue to, such as the end of
+    // the image or the middle of another instruction, goes there through the dispatch switch
+    for (auto recovered = instructions.begin(); recovered != instructions.end(); ++recovered) {
+        uint32_t next = recovered->first + recovered->second.length;
+        auto following = std::next(recovered);
+
+        if (fallsThrough(recovered->second.instruction) && (following == instructions.end() || following->first != next))
+            blockStarts.insert(next);
+    }
+}
+
+void StaticRecompiler::emit(const char *text, ...)
+{
+    char line[256];
+    va_list arguments;
+
+    va_start(arguments, text);
+    int length = vsnprintf(line, sizeof(line), text, arguments);
+    va_end(arguments);
+    out->append(line, length < (int)sizeof(line) ? length : sizeof(line) - 1);
+}
+
+// Jumps to recompiled code when the target was found, otherwise to the interpreter
+void StaticRecompiler::emitJump(uint32_t target, const char *indent)
+{
+    if (instructions.count(target) != 0)
+        emit("%sgoto address_%08X;\n", indent, target);
+    else
+        emit("%spc = 0x%08X;\n%sgoto interpret;\n", indent, target, indent);
+}
+
+uint16_t StaticRecompiler::nextExtensionWord()
+{
+    uint16_t word = memory->readWordFromMemory(extensionAddress);
+    extensionAddress += 2;
+    return word;
+}
+
+uint32_t StaticRecompiler::nextExtensionLong()
+{
+    uint32_t high = nextExtensionWord();
+    return (high << 16) | nextExtensionWord();
+}
+
+// Works out an effective address in the same order as the interpreter, consuming its extension
+// words. Modes that depend on registers declare a local with the given name holding the address,
+// applying any postincrement or predecrement, and the rest give a constant.
+StaticRecompiler::Operand StaticRecompiler::resolveOperand(int size, int mode, int reg, const char *name)
+{
+    Operand operand = { EA_MODE(mode, reg), reg, std::string(), 0 };
+    // Byte accesses through the stack pointer still move it by a word to keep it aligned
+    uint32_t increment = size == SIZE_BYTE ? (reg == 7 ? 2 : 1) : sizeInBytes(size);
+    uint32_t base = extensionAddress;
+    uint16_t extension;
+    std::string index;
+
+    switch (operand.mode) {
+    case ADDRESS_MODE_DATA_REGISTER_DIRECT:
+    case ADDRESS_MODE_ADDRESS_REGISTER_DIRECT:
+        break;
+    case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT:
+        operand.address = format("A[%d]", reg);
+        break;
+    case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_POSTINCREMENT:
+        emit("        uint32_t %s = A[%d];\n        A[%d] += %u;\n", name, reg, reg, increment);
+        operand.address = name;
+        break;
+    case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_PREDECREMENT:
+        emit("        A[%d] -= %u;\n        uint32_t %s = A[%d];\n", reg, increment, name, reg);
+        operand.address = name;
+        break;
+    case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_DISPLACEMENT:
+        emit("        uint32_t %s = A[%d]%s;\n", name, reg, offset((int16_t)nextExtensionWord()).c_str());
+        operand.address = name;
+        break;
+    case ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_INDEX:
+    case EA_PROGRAM_COUNTER_WITH_INDEX:
+        extension = nextExtensionWord();
+        index = format(((extension >> 8) & INDEX_SIZE_LONG) == INDEX_SIZE_WORD ? "(int16_t)%c[%d]" : "%c[%d]",
+            ((extension >> 15) & 1) == 1 ? 'A' : 'D', (extension >> 12) & 7);
+        if (operand.mode == EA_PROGRAM_COUNTER_WITH_INDEX)
+            emit("        uint32_t %s = 0x%08Xu + %s;\n", name, base + (int8_t)(extension & 0xFF), index.c_str());
+        else
+            emit("        uint32_t %s = A[%d]%s + %s;\n", name, reg, offset((int8_t)(extension & 0xFF)).c_str(), index.c_str());
+        operand.address = name;
+        break;
+    case EA_ABSOLUTE_SHORT:
+        operand.address = format("0x%08Xu", (uint32_t)(int16_t)nextExtensionWord());
+        break;
+    case EA_ABSOLUTE_LONG:
+        operand.address = format("0x%08Xu", nextExtensionLong());
+        break;
+    case EA_PROGRAM_COUNTER_WITH_DISPLACEMENT:
+        operand.address = format("0x%08Xu", base + (int16_t)nextExtensionWord());
+        break;
+    default:
+        operand.value = size == SIZE_LONG ? nextExtensionLong() : nextExtensionWord() & sizeMask(size);
+        break;
+    }
+    return operand;
+}
+
+// Returns an expression reading an operand of the given size
+std::string StaticRecompiler::readOperand(const Operand &operand, int size)
+{
+    switch (operand.mode) {
+    case ADDRESS_MODE_DATA_REGISTER_DIRECT:
+    case ADDRESS_MODE_ADDRESS_REGISTER_DIRECT:
+        if (size == SIZE_LONG)
+            return format("%c[%d]", operand.mode == ADDRESS_MODE_DATA_REGISTER_DIRECT ? 'D' : 'A', operand.reg);
+        return format("(%c[%d] & 0x%X)", operand.mode == ADDRESS_MODE_DATA_REGISTER_DIRECT ? 'D' : 'A', operand.reg, sizeMask(size));
+    case EA_IMMEDIATE:
+        return format("0x%Xu", operand.value);
+    default:
+        return format("recompiledRead<%s>(memory, %s)", sizeNames[size], operand.address.c_str());
+    }
+}
+
+// Writes an operand of the given size. Writes to memory are checked for landing on recompiled code.
+void StaticRecompiler::writeOperand(const Operand &operand, int size, const std::string &data)
+{
+    if (operand.mode == ADDRESS_MODE_ADDRESS_REGISTER_DIRECT)
+        emit("        A[%d] = %s;\n", operand.reg, data.c_str());
+    else if (operand.mode == ADDRESS_MODE_DATA_REGISTER_DIRECT && size == SIZE_LONG)
+        emit("        D[%d] = %s;\n", operand.reg, data.c_str());
+    else if (operand.mode == ADDRESS_MODE_DATA_REGISTER_DIRECT)
+        emit("        recompiledWriteRegister<%s>(D[%d], %s);\n", sizeNames[size], operand.reg, data.c_str());
+    else {
+        emit("        recompiledWrite<%s>(memory, %s, %s);\n", sizeNames[size], operand.address.c_str(), data.c_str());
+        emit("        codeWritten |= writesCode(memory, %s, %u);\n", operand.address.c_str(), sizeInBytes(size));
+        writesMemory = true;
+    }
+}
+
+// ADD, SUB or CMP of a source value and a destination operand, setting the condition codes
+void StaticRecompiler::emitArithmetic(uint8_t instruction, int size, const std::string &source, const Operand &destination)
+{
+    std::string data = readOperand(destination, size);
+
+    switch (instruction) {
+    case INSTRUCTION_CMP:
+        emit("        recompiledSubtract<%s>(SR, %s, %s, false);\n", sizeNames[size], source.c_str(), data.c_str());
+        return;
+    case INSTRUCTION_ADD:
+    case INSTRUCTION_ADDI:
+    case INSTRUCTION_ADDQ:
+        emit("        uint32_t result = recompiledAdd<%s>(SR, %s, %s);\n", sizeNames[size], source.c_str(), data.c_str());
+        break;
+    default:
+        emit("        uint32_t result = recompiledSubtract<%s>(SR, %s, %s);\n", sizeNames[size], source.c_str(), data.c_str());
+        break;
+    }
+    writeOperand(destination, size, "result");
+}
+
+// MOVEM with its register list unrolled. The address is taken once, so loading the address
+// register itself does not move the later transfers.
+void StaticRecompiler::emitMOVEM(uint16_t opcode)
+{
+    uint16_t mask = nextExtensionWord();
+    int size = ((opcode >> 6) & 1) == 1 ? SIZE_LONG : SIZE_WORD;
+    int mode = (opcode >> 3) & 7;
+    int reg = opcode & 7;
+    uint32_t step = sizeInBytes(size);
+    uint32_t transferred = 0;
+
+    // The predecrement and postincrement forms start at (An) and leave An after the last register
+    bool adjustsRegister = mode == ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_PREDECREMENT
+        || mode == ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_POSTINCREMENT;
+    Operand start = resolveOperand(size, adjustsRegister ? ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT : mode, reg, "start");
+    emit("        uint32_t address = %s;\n", start.address.c_str());
+
+    if (((opcode >> 10) & 1) == 1) {
+        for (int i = 0; i < 16; i++) {
+            if (((mask >> i) & 1) == 0)
+                continue;
+            std::string data = format("recompiledRead<%s>(memory, address + %u)", sizeNames[size], transferred);
+            emit("        %c[%d] = %s%s;\n", i < 8 ? 'D' : 'A', i & 7, size == SIZE_WORD ? "(int16_t)" : "", data.c_str());
+            transferred += step;
+        }
+        if (adjustsRegister)
+            emit("        A[%d] = address + %u;\n", reg, transferred);
+        return;
+    }
+
+    for (int i = 0; i < 16; i++) {
+        if (((mask >> i) & 1) == 0)
+            continue;
+        if (mode == ADDRESS_MODE_ADDRESS_REGISTER_INDIRECT_WITH_PREDECREMENT) {
+            // The mask is reversed (bit 0 is A7) and registers are stored from A7 down to D0
+            transferred += step;
+            emit("        recompiledWrite<%s>(memory, address - %u, %c[%d]);\n", sizeNames[size], transferred, i < 8 ? 'A' : 'D', 7 - (i & 7));
+            emit("        codeWritten |= writesCode(memory, address - %u, %u);\n", transferred, step);
+        }
+        else {
+            emit("        recompiledWrite<%s>(memory, address + %u, %c[%d]);\n", sizeNames[size], transferred, i < 8 ? 'D' : 'A', i & 7);
+            emit("        codeWritten |= writesCode(memory, address + %u, %u);\n", transferred, step);
+            transferred += step;
+        }
+        writesMemory = true;
+    }
+    if (adjustsRegister)
+        emit("        A[%d] = address - %u;\n", reg, transferred);
+}
+
+// Writes the C++ for one instruction: a comment with its disassembly, a label when it is reached
+// other than by falling through, and its statements in a block of their own
+void StaticRecompiler::emitInstruction(uint32_t address, const RecoveredInstruction &recovered)
+{
+    uint16_t opcode = recovered.opcode;
+    int mode = (opcode >> 3) & 7;
+    int reg = opcode & 7;
+    int otherReg = (opcode >> 9) & 7;
+    int size = (opcode >> 6) & 3;
+    uint32_t target;
+    std::string text;
+    Operand source;
+    Operand destination;
+    Operand dataRegister = { ADDRESS_MODE_DATA_REGISTER_DIRECT, otherReg, std::string(), 0 };
+
+    disassembler.disassembleInstruction(address, text);
+    emit("    // %08X  %s\n", address, text.c_str());
+    if (blockStarts.count(address) != 0)
+        emit("address_%08X:\n", address);
+    emit("    {\n");
+
+    extensionAddress = address + 2;
+    nextAddress = address + recovered.length;
+    writesMemory = false;
+
+    switch (recovered.instruction) {
+    case INSTRUCTION_ADD:
+    case INSTRUCTION_SUB:
+    case INSTRUCTION_CMP:
+        if (((opcode >> 8) & 1) == 1) {
+            destination = resolveOperand(size, mode, reg, "destination");
+            emitArithmetic(recovered.instruction, size, format("D[%d]", otherReg), destination);
+        }
+        else {
+            source = resolveOperand(size, mode, reg, "source");
+            emitArithmetic(recovered.instruction, size, readOperand(source, size), dataRegister);
+        }
+        break;
+    case INSTRUCTION_ADDA:
+    case INSTRUCTION_SUBA:
+    case INSTRUCTION_CMPA:
+        // Word sources are sign extended and the whole address register is used
+        size = ((opcode >> 8) & 1) == 1 ? SIZE_LONG : SIZE_WORD;
+        source = resolveOperand(size, mode, reg, "source");
+        text = (size == SIZE_WORD ? "(uint32_t)(int16_t)" : "") + readOperand(source, size);
+        if (recovered.instruction == INSTRUCTION_CMPA)
+            emit("        recompiledSubtract<SIZE_LONG>(SR, %s, A[%d], false);\n", text.c_str(), otherReg);
+        else
+            emit("        A[%d] %s= %s;\n", otherReg, recovered.instruction == INSTRUCTION_ADDA ? "+" : "-", text.c_str());
+        break;
+    case INSTRUCTION_ADDI:
+    case INSTRUCTION_SUBI:
+        text = format("0x%Xu", size == SIZE_LONG ? nextExtensionLong() : nextExtensionWord() & sizeMask(size));
+        destination = resolveOperand(size, mode, reg, "destination");
+        emitArithmetic(recovered.instruction, size, text, destination);
+        break;
+    case INSTRUCTION_ADDQ:
+    case INSTRUCTION_SUBQ:
+        text = format("%d", otherReg == 0 ? 8 : otherReg);
+        if (mode == ADDRESS_MODE_ADDRESS_REGISTER_DIRECT) {
+            // Address registers are always changed in full and the condition codes are left alone
+            emit("        A[%d] %s= %s;\n", reg, recovered.instruction == INSTRUCTION_ADDQ ? "+" : "-", text.c_str());
+            break;
+        }
+        destination = resolveOperand(size, mode, reg, "destination");
+        emitArithmetic(recovered.instruction, size, text, destination);
+        break;
+    case INSTRUCTION_BCC:
+        CPUCore::branchTarget(memory, address, opcode, recovered.instruction, target);
+        emit("        if (recompiledCondition(SR, %d)) {\n", (opcode >> 8) & 0xF);
+        emitJump(target, "            ");
+        emit("        }\n");
+        break;
+    case INSTRUCTION_BRA:
+        CPUCore::branchTarget(memory, address, opcode, recovered.instruction, target);
+        emitJump(target, "        ");
+        break;
+    case INSTRUCTION_BSR:
+        CPUCore::branchTarget(memory, address, opcode, recovered.instruction, target);
+        emit("        A[7] -= 4;\n");
+        emit("        recompiledWrite<SIZE_LONG>(memory, A[7], 0x%08Xu);\n", nextAddress);
+        emit("        codeWritten |= writesCode(memory, A[7], 4);\n");
+        emit("        if (codeWritten) {\n            pc = 0x%08X;\n            goto modified;\n        }\n", target);
+        emitJump(target, "        ");
+        checksCodeWrites = true;
+        break;
+    case INSTRUCTION_CLR:
+        destination = resolveOperand(size, mode, reg, "destination");
+        writeOperand(destination, size, "0");
+        emit("        recompiledLogicalFlags<%s>(SR, 0);\n", sizeNames[size]);
+        break;
+    case INSTRUCTION_EXG:
+        if ((opcode & 0xF1F8) == EXG_DATA_REGISTERS)
+            emit("        std::swap(D[%d], D[%d]);\n", otherReg, reg);
+        else if ((opcode & 0xF1F8) == EXG_ADDRESS_REGISTERS)
+            emit("        std::swap(A[%d], A[%d]);\n", otherReg, reg);
+        else
+            emit("        std::swap(D[%d], A[%d]);\n", otherReg, reg);
+        break;
+    case INSTRUCTION_JMP:
+        if (CPUCore::branchTarget(memory, address, opcode, recovered.instruction, target)) {
+            emitJump(target, "        ");
+            break;
+        }
+        destination = resolveOperand(SIZE_LONG, mode, reg, "target");
+        emit("        pc = %s;\n        goto dispatch;\n", destination.address.c_str());
+        break;
+    case INSTRUCTION_LEA:
+        source = resolveOperand(SIZE_LONG, mode, reg, "source");
+        emit("        A[%d] = %s;\n", otherReg, source.address.c_str());
+        break;
+    case INSTRUCTION_MOVE:
+        size = (opcode & 0xF000) == MOVE_B ? SIZE_BYTE : (opcode & 0xF000) == MOVE_W ? SIZE_WORD : SIZE_LONG;
+        source = resolveOperand(size, mode, reg, "source");
+        emit("        uint32_t data = %s;\n", readOperand(source, size).c_str());
+        if (((opcode >> 6) & 7) == ADDRESS_MODE_ADDRESS_REGISTER_DIRECT) {
+            // MOVEA sign extends words and leaves the condition codes alone
+            emit("        A[%d] = %sdata;\n", otherReg, size == SIZE_WORD ? "(int16_t)" : "");
+            break;
+        }
+        destination = resolveOperand(size, (opcode >> 6) & 7, otherReg, "destination");
+        writeOperand(destination, size, "data");
+        emit("        recompiledLogicalFlags<%s>(SR, data);\n", sizeNames[size]);
+        break;
+    case INSTRUCTION_MOVE_FROM_SR:
+        destination = resolveOperand(SIZE_WORD, mode, reg, "destination");
+        writeOperand(destination, SIZE_WORD, "SR");
+        break;
+    case INSTRUCTION_MOVEM:
+        emitMOVEM(opcode);
+        break;
+    case INSTRUCTION_MOVEQ:
+        emit("        D[%d] = 0x%08Xu;\n", otherReg, (uint32_t)(int8_t)(opcode & 0xFF));
+        emit("        recompiledLogicalFlags<SIZE_LONG>(SR, D[%d]);\n", otherReg);
+        break;
+    case INSTRUCTION_NOP:
+        break;
+    case INSTRUCTION_RTS:
+        emit("        pc = recompiledRead<SIZE_LONG>(memory, A[7]);\n        A[7] += 4;\n        goto dispatch;\n");
+        break;
+    case INSTRUCTION_SWAP:
+        emit("        D[%d] = (D[%d] << 16) | (D[%d] >> 16);\n", reg, reg, reg);
+        emit("        recompiledLogicalFlags<SIZE_LONG>(SR, D[%d]);\n", reg);
+        break;
+    default:
+        // Everything else, TRAP, STOP and illegal instructions included, is left to the interpreter
+        emit("        pc = 0x%08X;\n        goto interpret;\n", address);
+        break;
+    }
+
+    // A write over recompiled code hands the rest of the program to the interpreter
+    if (writesMemory) {
+        emit("        if (codeWritten) {\n            pc = 0x%08X;\n            goto modified;\n        }\n", nextAddress);
+        checksCodeWrites = true;
+    }
+    auto following = instructions.upper_bound(address);
+    if (fallsThrough(recovered.instruction) && (following == instructions.end() || following->first != nextAddress))
+        emitJump(nextAddress, "        ");
+    emit("    }\n");
+}
+
+// Writes the start of the translation unit: the image, the recompiled code ranges and the check
+// for writes to them
+void StaticRecompiler::emitData(uint32_t entry)
+{
+    emit("// Recompiled from an S-record image by StaticRecompiler, starting at $%08X. Build it with\n", entry);
+    emit("// the emulator's sources other than M68kEmulator.cpp.\n\n");
+    emit("#include \"RecompilerRuntime.h\"\n#include <iostream>\n#include <utility>\n\n");
+
+    for (size_t i = 0; i < segments.size(); i++) {
+        emit("static const uint8_t segment%u[] = {", (unsigned int)i);
+        for (uint32_t position = 0; position < segments[i].length; position++) {
+            if (position % SEGMENT_BYTES_PER_LINE == 0)
+                emit("\n   ");
+            emit(" 0x%02X,", memory->readByteFromMemory(segments[i].address + position));
+        }
+        emit("\n};\n");
+    }
+    emit("\nstatic const RecompiledSegment segments[] = {\n");
+    for (size_t i = 0; i < segments.size(); i++)
+        emit("    { 0x%08X, %u, segment%u },\n", segments[i].address, segments[i].length, (unsigned int)i);
+    if (segments.empty())
+        emit("    { 0, 0, nullptr },\n");
+    emit("};\n\n");
+
+    // Instructions that follow on from each other share a range
+    emit("static const RecompiledRange codeRanges[] = {\n");
+    for (auto recovered = instructions.begin(); recovered != instructions.end();) {
+        uint32_t start = recovered->first;
+        uint32_t end = start;
+        while (recovered != instructions.end() && recovered->first <= end) {
+            if (recovered->first + recovered->second.length > end)
+                end = recovered->first + recovered->second.length;
+            ++recovered;
+        }
+        emit("    { 0x%08X, 0x%08X },\n", start, end);
+    }
+    if (instructions.empty())
+        emit("    { 0, 0 },\n");
+    emit("};\n\n");
+
+    if (checksCodeWrites) {
+        emit("static inline bool writesCode(Memory &memory, uint32_t address, uint32_t length)\n{\n");
+        emit("    return writesRecompiledCode(memory, codeRanges, sizeof(codeRanges) / sizeof(codeRanges[0]), address, length);\n}\n\n");
+    }
+}
+
+size_t StaticRecompiler::recompile(const std::vector<ProgramLoader::Segment> &segments, uint32_t entry, std::string &output)
+{
+    std::string code;
+
+    this->segments = segments;
+    instructions.clear();
+    blockStarts.clear();
+    checksCodeWrites = false;
+    recoverControlFlow(entry);
+
+    out = &code;
+    for (const auto &recovered : instructions)
+        emitInstruction(recovered.first, recovered.second);
+
+    output.clear();
+    out = &output;
+    emitData(entry);
+
+    emit("static void runRecompiled(CPUCore &cpu, Memory &memory)\n{\n");
+    emit("    uint32_t D[8];\n    uint32_t A[8];\n    uint16_t SR;\n");
+    emit("    uint32_t pc = cpu.getProgramCounter();\n    uint64_t codeWrites;\n");
+    if (checksCodeWrites)
+        emit("    bool codeWritten = false;\n");
+    emit("\n    loadRecompiledRegisters(cpu, D, A, SR);\n");
+    emit("dispatch:\n    switch (pc) {\n");
+    for (uint32_t address : blockStarts) {
+        if (instructions.count(address) != 0)
+            emit("    case 0x%08X: goto address_%08X;\n", address, address);
+    }
+    emit("    default: goto interpret;\n    }\n");
+    // Code that was not found, and instructions the recompiled code leaves alone, are stepped
+    emit("interpret:\n    codeWrites = memory.getCodeWriteCount();\n");
+    emit("    if (!stepRecompiledInstruction(cpu, D, A, SR, pc))\n        return;\n");
+    emit("    if (memory.getCodeWriteCount() == codeWrites)\n        goto dispatch;\n");
+    if (checksCodeWrites)
+        emit("modified:\n");
+    emit("    saveRecompiledRegisters(cpu, D, A, SR, pc);\n    cpu.run();\n    return;\n\n");
+    output.append(code);
+    emit("}\n\n");
+
+    emit("int main()\n{\n    Memory memory(256);\n    CPUCore cpu(&memory, 68000);\n\n");
+    emit("    loadRecompiledSegments(memory, segments, sizeof(segments) / sizeof(segments[0]));\n");
+    emit("    markRecompiledCode(memory, codeRanges, sizeof(codeRanges) / sizeof(codeRanges[0]));\n");
+    emit("    cpu.setProgramCounter(0x%08X);\n    runRecompiled(cpu, memory);\n", entry);
+    emit("    std::cout << std::endl << \"Execution completed.\" << std::endl << std::endl;\n    return 0;\n}\n");
+    return instructions.size();
+}
+
+size_t StaticRecompiler::recompileImage(std::string fileName, std::string &output)
+{
+    std::vector<ProgramLoader::Segment> segments;
+
+    output.clear();
+    if (!ProgramLoader::loadImage(fileName, memory, segments))
+        return 0;
+    return recompile(segments, memory->startingLocation, output);
+}
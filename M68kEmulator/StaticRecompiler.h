@@ -0,0 +1,78 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include "CPUCore.h"
+#include "Disassembler.h"
+#include "Memory.h"
+#include "ProgramLoader.h"
+
+// Translates an S-record program into a C++ translation unit ahead of time. The control flow is
+// followed from the entry point through branches, calls and jumps to known addresses, and each
+// instruction found becomes a few lines of C++ working on the registers as locals, with labels at
+// the places code is reached by a jump. Returns, computed jumps and anything not found go through
+// a switch on the program counter, and addresses missing from it are run on the interpreter, as
+// is every instruction outside the common integer subset it translates. The generated unit includes RecompilerRuntime.h and
+// builds with the emulator's sources other than M68kEmulator.cpp into a program of its own.
+class StaticRecompiler
+{
+private:
+    Memory *memory;
+    const CPUCore::InstructionEntry *instructionTable;
+    Disassembler disassembler;
+
+    // An instruction reached by following the control flow from the entry point
+    struct RecoveredInstruction {
+        uint16_t opcode;
+        uint8_t instruction; // One of the INSTRUCTION_ values
+        uint8_t length; // Length in bytes including the extension words
+    };
+    // An effective address as the generated code sees it: the text of its address, which is a
+    // constant when the mode allows, or the value of an immediate
+    struct Operand {
+        int mode; // EA_MODE of the mode and register fields
+        int reg;
+        std::string address;
+        uint32_t value;
+    };
+
+    std::vector<ProgramLoader::Segment> segments;
+    std::map<uint32_t, RecoveredInstruction> instructions;
+    // Addresses reached other than by falling through: the entry point, branch and jump targets,
+    // return addresses and the instructions after ones the interpreter runs
+    std::set<uint32_t> blockStarts;
+
+    std::string *out;
+    // Address of the next extension word of the instruction being recompiled
+    uint32_t extensionAddress;
+    // Address of the instruction after the one being recompiled
+    uint32_t nextAddress;
+    // The instruction being recompiled writes memory, so the code it leaves behind must be checked
+    bool writesMemory;
+    // Some instruction checks its writes, so the generated unit needs the check and the label it goes to
+    bool checksCodeWrites;
+
+    bool isLoaded(uint32_t address, uint32_t length);
+    void recoverControlFlow(uint32_t entry);
+    void emit(const char *format, ...);
+    void emitJump(uint32_t target, const char *indent);
+    uint16_t nextExtensionWord();
+    uint32_t nextExtensionLong();
+    Operand resolveOperand(int size, int mode, int reg, const char *name);
+    std::string readOperand(const Operand &operand, int size);
+    void writeOperand(const Operand &operand, int size, const std::string &data);
+    void emitArithmetic(uint8_t instruction, int size, const std::string &source, const Operand &destination);
+    void emitMOVEM(uint16_t opcode);
+    void emitInstruction(uint32_t address, const RecoveredInstruction &recovered);
+    void emitData(uint32_t entry);
+public:
+    StaticRecompiler(Memory *memory);
+    // Recompiles the code reachable from an entry point in segments already loaded into memory,
+    // replacing the contents of output with the C++ source. Returns the number of instructions found.
+    size_t recompile(const std::vector<ProgramLoader::Segment> &segments, uint32_t entry, std::string &output);
+    // Loads an S-record image into memory and recompiles it from the start address in its
+    // S7, S8 or S9 record. Returns the number of instructions found, or 0 when the file cannot be read.
+    size_t recompileImage(std::string fileName, std::string &output);
+};
@@ -1,6 +1,73 @@
 #include "pch.h"
 #include "../M68kEmulator/Memory.cpp"
 #include "../M68kEmulator/CPUCore.cpp"
+#include "../M68kEmulator/EventScheduler.cpp"
+#include "../M68kEmulator/JitCompiler.cpp"
+#include "../M68kEmulator/ProgramLoader.cpp"
+#include "../M68kEmulator/Disassembler.cpp"
+#include "../M68kEmulator/StaticRecompiler.cpp"
+#include "../M68kEmulator/RecompilerRuntime.h"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <new>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+// Counts heap allocations, so tests can check that running a program makes none. Atomic, as the
+// tiered interpreter's background compiler allocates too.
+static std::atomic<size_t> allocationCount(0);
+
+// Every form of operator new and delete goes through these. Freeing is kept out of line so that
+// GCC does not see free called on memory it believes came from the library's operator new.
+static void *countedAllocation(size_t size)
+{
+    allocationCount++;
+    void *allocation = malloc(size == 0 ? 1 : size);
+    if (allocation == nullptr)
+        throw std::bad_alloc();
+    return allocation;
+}
+
+#if defined(__GNUC__)
+__attribute__((noinline))
+#endif
+static void countedFree(void *allocation) noexcept
+{
+    free(allocation);
+}
+
+void *operator new(size_t size)
+{
+    return countedAllocation(size);
+}
+
+void *operator new[](size_t size)
+{
+    return countedAllocation(size);
+}
+
+void operator delete(void *allocation) noexcept
+{
+    countedFree(allocation);
+}
+
+void operator delete[](void *allocation) noexcept
+{
+    countedFree(allocation);
+}
+
+void operator delete(void *allocation, size_t) noexcept
+{
+    countedFree(allocation);
+}
+
+void operator delete[](void *allocation, size_t) noexcept
+{
+    countedFree(allocation);
+}
 
 class CPUInitTest : public ::testing::Test {
 protected:
@@ -40,6 +107,81 @@ protected:
     CPUCore *cpu = new CPUCore(memory, 68000);
 };
 
+// Writes a program's words to memory from an address
+static void loadProgram(Memory &memory, const uint16_t *program, size_t words, uint32_t address)
+{
+    for (size_t i = 0; i < words; i++)
+        memory.writeWordToMemory(program[i], address + (uint32_t)i * 2);
+}
+
+template<size_t Words>
+static void loadProgram(Memory &memory, const uint16_t (&program)[Words], uint32_t address = 0x100)
+{
+    loadProgram(memory, program, Words, address);
+}
+
+// What a program leaves behind when it has run to the end
+struct RunResult {
+    uint32_t registers[16]; // D0-D7 then A0-A7
+    uint16_t statusRegister;
+    uint32_t programCounter;
+    std::vector<uint8_t> memory;
+};
+
+typedef std::function<void(CPUCore &cpu, Memory &memory, CPUCore::interpreters interpreter)> RunHook;
+
+// Runs a program loaded at $100 on a fresh CPU with 8 KB of memory. prepare sets up the CPU and
+// memory before the run, and inspect can check them afterwards. Both are told the interpreter.
+static RunResult runProgram(const uint16_t *program, size_t words, CPUCore::interpreters interpreter,
+    const RunHook &prepare, const RunHook &inspect)
+{
+    Memory memory(8);
+    CPUCore cpu(&memory, 68000);
+    RunResult result;
+
+    loadProgram(memory, program, words, 0x100);
+    cpu.setProgramCounter(0x100);
+    cpu.setInterpreter(interpreter);
+    if (prepare)
+        prepare(cpu, memory, interpreter);
+    cpu.run();
+    if (inspect)
+        inspect(cpu, memory, interpreter);
+
+    for (int reg = 0; reg < 8; reg++) {
+        result.registers[reg] = cpu.getDataRegister(reg);
+        result.registers[reg + 8] = cpu.getAddressRegister(reg);
+    }
+    result.statusRegister = cpu.getStatusRegister();
+    result.programCounter = cpu.getProgramCounter();
+    for (uint32_t address = 0; address < 8 * 1024; address++)
+        result.memory.push_back(memory.readByteFromMemory(address));
+    return result;
+}
+
+// Runs a program with each interpreter in turn, expecting every run to leave the registers, status
+// register, PC and memory as the first did. Returns what the first run left.
+template<size_t Words>
+static RunResult expectInterpretersAgree(const uint16_t (&program)[Words], const std::vector<CPUCore::interpreters> &interpreters,
+    const RunHook &prepare = nullptr, const RunHook &inspect = nullptr)
+{
+    RunResult first = runProgram(program, Words, interpreters[0], prepare, inspect);
+
+    for (size_t i = 1; i < interpreters.size(); i++) {
+        CPUCore::interpreters interpreter = interpreters[i];
+        RunResult result = runProgram(program, Words, interpreter, prepare, inspect);
+        for (int reg = 0; reg < 16; reg++)
+            EXPECT_EQ(result.registers[reg], first.registers[reg]) << "Interpreter " << interpreter << " register " << reg;
+        EXPECT_EQ(result.statusRegister, first.statusRegister) << "Interpreter " << interpreter;
+        EXPECT_EQ(result.programCounter, first.programCounter) << "Interpreter " << interpreter;
+        EXPECT_TRUE(result.memory == first.memory) << "Interpreter " << interpreter;
+    }
+    return first;
+}
+
+static const std::vector<CPUCore::interpreters> allInterpreters = { CPUCore::INTERPRETER_STEP, CPUCore::INTERPRETER_BLOCKS,
+    CPUCore::INTERPRETER_THREADED, CPUCore::INTERPRETER_JIT, CPUCore::INTERPRETER_TIERED };
+
 TEST_F(CPUInitTest, DataRegister) {
     for (int reg = 0; reg <= 7; reg++)
         EXPECT_EQ(cpu->getDataRegister(reg), testNumber);
@@ -131,4 +273,1314 @@ TEST_F(InstructionTest, ClearByte)
     cpu->startNextCycle();
     EXPECT_EQ(memory->readByteFromMemory(0x17), 0);
     EXPECT_EQ(cpu->getAddressRegister(3), 0x10);
-}
\ No newline at end of file
+}
+TEST_F(InstructionTest, FillLoop)
+{
+    // The loop from program.X68, writing $AA to $1000-$1100
+    uint16_t program[] = {
+        0x207C, 0x0000, 0x1000, // MOVEA.L #$1000,A0
+        0x303C, 0x0101,         // MOVE.W #$101,D0
+        0x10BC, 0x00AA,         // NEXT MOVE.B #$AA,(A0)
+        0xD1FC, 0x0000, 0x0001, // ADDA.L #1,A0
+        0x907C, 0x0001,         // SUB.W #1,D0
+        0x66F0,                 // BNE NEXT
+        0x4E72, 0x2700          // STOP #$2700
+    };
+    loadProgram(*memory, program);
+
+    cpu->setProgramCounter(0x100);
+    while (cpu->startNextCycle());
+
+    EXPECT_EQ(memory->readByteFromMemory(0xFFF), 0);
+    for (uint32_t address = 0x1000; address <= 0x1100; address++)
+        EXPECT_EQ(memory->readByteFromMemory(address), 0xAA);
+    EXPECT_EQ(memory->readByteFromMemory(0x1101), 0);
+    EXPECT_EQ(cpu->getAddressRegister(0), 0x1101);
+    EXPECT_EQ(cpu->getDataRegister(0), 0x12340000);
+}
+TEST_F(InstructionTest, InstructionCacheCounters)
+{
+    uint16_t program[] = {
+        0x207C, 0x0000, 0x1000, // MOVEA.L #$1000,A0
+        0x303C, 0x0101,         // MOVE.W #$101,D0
+        0x10BC, 0x00AA,         // NEXT MOVE.B #$AA,(A0)
+        0xD1FC, 0x0000, 0x0001, // ADDA.L #1,A0
+        0x907C, 0x0001,         // SUB.W #1,D0
+        0x66F0,                 // BNE NEXT
+        0x4E72, 0x2700          // STOP #$2700
+    };
+    loadProgram(*memory, program);
+
+    cpu->setProgramCounter(0x100);
+    while (cpu->startNextCycle());
+
+    // Each of the 7 instructions is decoded once, then the loop body runs from the cache
+    EXPECT_EQ(cpu->getInstructionCacheMisses(), 7);
+    EXPECT_EQ(cpu->getInstructionCacheHits(), 2 + 257 * 4 + 1 - 7);
+}
+
+TEST_F(InstructionTest, PredecodeReachable)
+{
+    uint16_t program[] = {
+        0x6100, 0x00FE,         // BSR $200
+        0x7001,                 // MOVEQ #1,D0
+        0x6002,                 // BRA $10A
+        0x4AFC,                 // ILLEGAL, never reached
+        0x4E72, 0x2700          // STOP #$2700
+    };
+    uint16_t subroutine[] = {
+        0x7202,                 // MOVEQ #2,D1
+        0x4E75                  // RTS
+    };
+    loadProgram(*memory, program);
+    loadProgram(*memory, subroutine, 0x200);
+
+    EXPECT_EQ(cpu->predecodeReachable(0x100, { { 0x100, sizeof(program) }, { 0x200, sizeof(subroutine) } }), 6u);
+    cpu->setAddressRegister(7, 0x1000);
+    cpu->setProgramCounter(0x100);
+    cpu->setInterpreter(CPUCore::INTERPRETER_STEP);
+    EXPECT_EQ(cpu->run(), CPUCore::STOP_STOPPED);
+    EXPECT_EQ(cpu->getDataRegister(1), 2u);
+    EXPECT_EQ(cpu->getInstructionCacheMisses(), 0u);
+    EXPECT_EQ(cpu->getInstructionCacheHits(), 6u);
+
+    // More code than the cache holds, where the code the entry path branches to shares every
+    // cache entry with the entry path. The entry path is decoded and the rest is not.
+    Memory large(64);
+    CPUCore largeCpu(&large, 68000);
+    const uint32_t count = 6000;
+    const uint32_t far = 0x5000;
+    for (uint32_t i = 0; i < count; i++) {
+        large.writeWordToMemory(0x5280, 0x1000 + i * 2); // ADDQ.L #1,D0
+        large.writeWordToMemory(0x5280, far + i * 2);
+    }
+    large.writeWordToMemory(0x6000, 0x1000 + count * 2); // BRA.W far
+    large.writeWordToMemory((uint16_t)(far - (0x1002 + count * 2)), 0x1002 + count * 2);
+    large.writeWordToMemory(0x4E72, far + count * 2); // STOP #$2700
+    large.writeWordToMemory(0x2700, far + 2 + count * 2);
+
+    EXPECT_EQ(largeCpu.predecodeReachable(0x1000, { { 0x1000, count * 2 + 4 }, { far, count * 2 + 4 } }), 8192u);
+    largeCpu.setAllRegisters(0);
+    largeCpu.setProgramCounter(0x1000);
+    largeCpu.setInterpreter(CPUCore::INTERPRETER_STEP);
+    EXPECT_EQ(largeCpu.run(count + 1), CPUCore::STOP_BUDGET_EXHAUSTED);
+    EXPECT_EQ(largeCpu.getProgramCounter(), far);
+    EXPECT_EQ(largeCpu.getInstructionCacheMisses(), 0u);
+    EXPECT_EQ(largeCpu.run(), CPUCore::STOP_STOPPED);
+    EXPECT_EQ(largeCpu.getDataRegister(0), 2 * count);
+    EXPECT_EQ(largeCpu.getInstructionCacheMisses(), count + 1);
+}
+
+TEST_F(InstructionTest, SelfModifyingCode)
+{
+    uint16_t program[] = {
+        0x7001,                 // LOOP MOVEQ #1,D0
+        0x31FC, 0x7005, 0x0100, // MOVE.W #$7005,LOOP.W (changes the MOVEQ to MOVEQ #5,D0)
+        0x5341,                 // SUBQ.W #1,D1
+        0x66F4,                 // BNE LOOP
+        0x4E72, 0x2700          // STOP #$2700
+    };
+    loadProgram(*memory, program);
+
+    cpu->setDataRegister(1, 2);
+    cpu->setProgramCounter(0x100);
+    while (cpu->startNextCycle());
+
+    EXPECT_EQ(cpu->getDataRegister(0), 5);
+    EXPECT_EQ(cpu->getDataRegister(1), 0);
+
+    // A long write from an odd address reaches the first byte of an instruction three bytes on
+    uint16_t oddProgram[] = {
+        0x7400,                 // MOVEQ #0,D2
+        0x7201,                 // MOVEQ #1,D1
+        0x41F8, 0x010F,         // LEA LOOP+1.W,A0
+        0x263C, 0x714E, 0x7154, // MOVE.L #$714E7154,D3
+        0x4E71,                 // LOOP NOP
+        0x4E71,                 // NOP
+        0x5282,                 // ADDQ.L #1,D2
+        0x2083,                 // MOVE.L D3,(A0) (changes the ADDQ to ADDQ.L #2,D2)
+        0x51C9, 0xFFF6,         // DBF D1,LOOP
+        0x4E72, 0x2700          // STOP #$2700
+    };
+    RunResult result = expectInterpretersAgree(oddProgram, allInterpreters);
+    EXPECT_EQ(result.registers[2], 3);
+}
+
+TEST_F(InstructionTest, BlockFillLoop)
+{
+    uint16_t program[] = {
+        0x207C, 0x0000, 0x1000, // MOVEA.L #$1000,A0
+        0x303C, 0x0101,         // MOVE.W #$101,D0
+        0x10BC, 0x00AA,         // NEXT MOVE.B #$AA,(A0)
+        0xD1FC, 0x0000, 0x0001, // ADDA.L #1,A0
+        0x907C, 0x0001,         // SUB.W #1,D0
+        0x66F0,                 // BNE NEXT
+        0x4E72, 0x2700          // STOP #$2700
+    };
+    loadProgram(*memory, program);
+
+    cpu->setProgramCounter(0x100);
+    int dispatches = 1;
+    while (cpu->executeBlock())
+        dispatches++;
+
+    for (uint32_t address = 0x1000; address <= 0x1100; address++)
+        EXPECT_EQ(memory->readByteFromMemory(address), 0xAA);
+    EXPECT_EQ(memory->readByteFromMemory(0x1101), 0);
+    EXPECT_EQ(cpu->getAddressRegister(0), 0x1101);
+    EXPECT_EQ(cpu->getDataRegister(0), 0x12340000);
+
+    // The entry block, the loop body from NEXT, which is run as a single fill, and the STOP
+    EXPECT_EQ(cpu->getTranslatedBlockCount(), 3);
+    EXPECT_EQ(dispatches, 1);
+}
+
+TEST_F(InstructionTest, BlockSelfModifyingCode)
+{
+    uint16_t program[] = {
+        0x7001,                 // LOOP MOVEQ #1,D0
+        0x31FC, 0x7005, 0x0100, // MOVE.W #$7005,LOOP.W (changes the MOVEQ to MOVEQ #5,D0)
+        0x5341,                 // SUBQ.W #1,D1
+        0x66F4,                 // BNE LOOP
+        0x4E72, 0x2700          // STOP #$2700
+    };
+    loadProgram(*memory, program);
+
+    cpu->setDataRegister(1, 2);
+    cpu->setProgramCounter(0x100);
+    while (cpu->executeBlock());
+
+    EXPECT_EQ(cpu->getDataRegister(0), 5);
+    EXPECT_EQ(cpu->getDataRegister(1), 0);
+}
+
+// Shifts a value one place at a time, the way the 68000 manual describes, for checking aluShift against
+template<int Type, int Left, int Size>
+static uint32_t referenceShift(uint32_t value, int count, uint32_t extend, uint16_t &flags)
+{
+    const int bits = 8 << Size;
+    const uint32_t sign = signBit(Size);
+    uint32_t result = value & sizeMask(Size);
+    bool carry = Type == ROTATE_EXTEND && extend != 0;
+    bool overflow = false;
+
+    for (int i = 0; i < count; i++) {
+        bool out = Left ? (result & sign) != 0 : (result & 1) != 0;
+        uint32_t in = Type == ROTATE_EXTEND ? extend : Type == ROTATE ? out : Type == SHIFT_ARITHMETIC && !Left ? (result & sign) != 0 : 0;
+        uint32_t shifted = Left ? ((result << 1) | in) & sizeMask(Size) : (result >> 1) | (in << (bits - 1));
+        overflow |= Type == SHIFT_ARITHMETIC && Left && ((shifted ^ result) & sign) != 0;
+        result = shifted;
+        carry = out;
+        if (Type != ROTATE)
+            extend = out;
+    }
+
+    flags = ((result == 0) << SR_CCR_ZERO) | (((result & sign) != 0) << SR_CCR_NEGATIVE) | (carry << SR_CCR_CARRY)
+        | (overflow << SR_CCR_OVERFLOW) | (extend << SR_CCR_EXTEND);
+    return result;
+}
+
+template<int Type, int Left, int Size>
+static void checkShift(uint32_t value)
+{
+    for (int count = 0; count < 64; count++) {
+        for (uint32_t extend = 0; extend < 2; extend++) {
+            uint16_t flags, expectedFlags;
+            uint32_t expected = referenceShift<Type, Left, Size>(value, count, extend, expectedFlags);
+            uint32_t result = aluShift<Type, Left, Size>(value, count, extend, flags);
+            EXPECT_EQ(result, expected) << Type << Left << Size << " " << value << " " << count;
+            EXPECT_EQ(flags, expectedFlags) << Type << Left << Size << " " << value << " " << count;
+        }
+    }
+}
+
+template<int Size>
+static void checkShifts(uint32_t value)
+{
+    checkShift<SHIFT_ARITHMETIC, 0, Size>(value);
+    checkShift<SHIFT_ARITHMETIC, 1, Size>(value);
+    checkShift<SHIFT_LOGICAL, 0, Size>(value);
+    checkShift<SHIFT_LOGICAL, 1, Size>(value);
+    checkShift<ROTATE_EXTEND, 0, Size>(value);
+    checkShift<ROTATE_EXTEND, 1, Size>(value);
+    checkShift<ROTATE, 0, Size>(value);
+    checkShift<ROTATE, 1, Size>(value);
+}
+
+TEST_F(InstructionTest, AluKernels)
+{
+    // Every pair of bytes, with and without X, against the carry and overflow of wider arithmetic
+    for (uint32_t source = 0; source < 256; source++) {
+        for (uint32_t destination = 0; destination < 256; destination++) {
+            for (uint32_t extend = 0; extend < 2; extend++) {
+                uint16_t flags;
+                uint32_t sum = destination + source + extend;
+                int32_t signedSum = (int8_t)destination + (int8_t)source + (int)extend;
+                EXPECT_EQ(aluAdd<SIZE_BYTE>(source, destination, extend, flags), sum & 0xFF);
+                EXPECT_EQ(flags, logicalFlags(SIZE_BYTE, sum) | (sum > 0xFF ? 0x11 : 0) | (signedSum != (int8_t)sum ? 0x02 : 0));
+                EXPECT_EQ(flags, additionFlags(SIZE_BYTE, source, destination, sum & 0xFF));
+
+                uint32_t difference = destination - source - extend;
+                int32_t signedDifference = (int8_t)destination - (int8_t)source - (int)extend;
+                EXPECT_EQ(aluSubtract<SIZE_BYTE>(source, destination, extend, flags), difference & 0xFF);
+                EXPECT_EQ(flags, logicalFlags(SIZE_BYTE, difference) | (source + extend > destination ? 0x11 : 0)
+                    | (signedDifference != (int8_t)difference ? 0x02 : 0));
+                EXPECT_EQ(flags, subtractionFlags(SIZE_BYTE, source, destination, difference & 0xFF));
+            }
+        }
+    }
+
+    uint16_t flags;
+    EXPECT_EQ(aluAdd<SIZE_LONG>(0x7FFFFFFF, 0, 1, flags), 0x80000000u);
+    EXPECT_EQ(flags, 0x0A);
+    EXPECT_EQ(aluSubtract<SIZE_WORD>(1, 0, 0, flags), 0xFFFFu);
+    EXPECT_EQ(flags, 0x19);
+
+    uint32_t values[] = { 0, 1, 0x80, 0xC0, 0x40, 0x8001, 0x4000, 0xFFFFFFFF, 0x80000000, 0x40000000, 0xA5A5A5A5, 0x12345678 };
+    for (uint32_t value : values) {
+        checkShifts<SIZE_BYTE>(value);
+        checkShifts<SIZE_WORD>(value);
+        checkShifts<SIZE_LONG>(value);
+    }
+}
+
+TEST_F(InstructionTest, LazyConditionCodes)
+{
+    uint16_t program[] = {
+        0x70FF,         // MOVEQ #-1,D0
+        0x5200,         // ADDQ.B #1,D0 (sets X, Z and C)
+        0xB03C, 0x0001, // CMP.B #1,D0 (sets N and C, keeps X)
+        0x40C1,         // MOVE SR,D1
+        0x7401,         // MOVEQ #1,D2 (clears N, Z, V and C, keeps X)
+        0x40C3,         // MOVE SR,D3
+        0x6502,         // BCS SKIP
+        0x7801,         // MOVEQ #1,D4
+        0x4E72, 0x2700  // SKIP STOP #$2700
+    };
+    loadProgram(*memory, program);
+
+    cpu->setProgramCounter(0x100);
+    while (cpu->startNextCycle());
+
+    EXPECT_EQ(cpu->getDataRegister(0), 0xFFFFFF00);
+    EXPECT_EQ(cpu->getDataRegister(1), 0x12342019);
+    EXPECT_EQ(cpu->getDataRegister(3), 0x12342010);
+    EXPECT_EQ(cpu->getDataRegister(4), 1);
+    EXPECT_EQ(cpu->getStatusRegister(), 0x2700);
+}
+
+TEST_F(InstructionTest, InterpretersAgree)
+{
+    uint16_t program[] = {
+        0x207C, 0x0000, 0x1000, // MOVEA.L #$1000,A0
+        0x303C, 0x0101,         // MOVE.W #$101,D0
+        0x7203,                 // MOVEQ #3,D1
+        0x10C1,                 // NEXT MOVE.B D1,(A0)+
+        0xD241,                 // ADD.W D1,D1
+        0x31FC, 0x7205, 0x010E, // MOVE.W #$7205,NEXT+2.W (changes the ADD to MOVEQ #5,D1)
+        0x5340,                 // SUBQ.W #1,D0
+        0x66F2,                 // BNE NEXT
+        0x4E72, 0x2700          // STOP #$2700
+    };
+    RunResult result = expectInterpretersAgree(program, allInterpreters, [](CPUCore &cpu, Memory &, CPUCore::interpreters) {
+        cpu.setAllRegisters(0x1234ABCD);
+    });
+
+    EXPECT_EQ(result.memory[0x1000], 3);
+    EXPECT_EQ(result.memory[0x1001], 6);
+    EXPECT_EQ(result.memory[0x1002], 5);
+    EXPECT_EQ(result.memory[0x1100], 5);
+    EXPECT_EQ(result.memory[0x1101], 0);
+    EXPECT_EQ(result.registers[8], 0x1101);
+    EXPECT_EQ(result.registers[0], 0x12340000);
+    EXPECT_EQ(result.registers[1], 5);
+}
+
+TEST_F(InstructionTest, TieredExecution)
+{
+    uint16_t program[] = {
+        0x303C, 0x0100,         // MOVE.W #$100,D0
+        0x7200,                 // MOVEQ #0,D1
+        0xD240,                 // NEXT ADD.W D0,D1
+        0xB27C, 0x4000,         // CMP.W #$4000,D1
+        0x6502,                 // BCS SKIP
+        0x5341,                 // SUBQ.W #1,D1
+        0x5340,                 // SKIP SUBQ.W #1,D0
+        0x66F2,                 // BNE NEXT
+        0x4E72, 0x2700          // STOP #$2700
+    };
+    expectInterpretersAgree(program, { CPUCore::INTERPRETER_STEP, CPUCore::INTERPRETER_TIERED },
+        [](CPUCore &cpu, Memory &, CPUCore::interpreters) {
+            cpu.setTierThresholds(3, 8);
+        },
+        [](CPUCore &cpu, Memory &, CPUCore::interpreters interpreter) {
+            if (interpreter == CPUCore::INTERPRETER_TIERED) {
+                // Each block is stepped through twice before it is translated
+                EXPECT_GE(cpu.getTierExecutions(CPUCore::TIER_INTERPRETED), 4u);
+                EXPECT_GT(cpu.getTierExecutions(CPUCore::TIER_TRANSLATED), 0u);
+            }
+        });
+}
+
+TEST_F(InstructionTest, MemoryIdiomsMatchStepping)
+{
+    uint16_t program[] = {
+        0x207C, 0x0000, 0x1000, // MOVEA.L #$1000,A0
+        0x303C, 0x0040,         // MOVE.W #$40,D0
+        0x30FC, 0x1234,         // FILL MOVE.W #$1234,(A0)+
+        0x5340,                 // SUBQ.W #1,D0
+        0x66F8,                 // BNE FILL
+        0x40F8, 0x1F00,         // MOVE SR,$1F00.W
+        0x227C, 0x0000, 0x1000, // MOVEA.L #$1000,A1
+        0x247C, 0x0000, 0x1400, // MOVEA.L #$1400,A2
+        0x7208,                 // MOVEQ #8,D1
+        0x24D9,                 // COPY MOVE.L (A1)+,(A2)+
+        0x5381,                 // SUBQ.L #1,D1
+        0x66FA,                 // BNE COPY
+        0x40F8, 0x1F02,         // MOVE SR,$1F02.W
+        0x267C, 0x0000, 0x1800, // MOVEA.L #$1800,A3
+        0x141B,                 // LENGTH MOVE.B (A3)+,D2
+        0x66FC,                 // BNE LENGTH
+        0x40F8, 0x1F04,         // MOVE SR,$1F04.W
+        0x287C, 0x0000, 0x1800, // MOVEA.L #$1800,A4
+        0x764C,                 // MOVEQ #'L',D3
+        0xB61C,                 // FIND CMP.B (A4)+,D3
+        0x66FC,                 // BNE FIND
+        0x40F8, 0x1F06,         // MOVE SR,$1F06.W
+        0x2A7C, 0x0000, 0x1800, // MOVEA.L #$1800,A5
+        0x2C7C, 0x0000, 0x1810, // MOVEA.L #$1810,A6
+        0x181D,                 // COMPARE MOVE.B (A5)+,D4
+        0xB81E,                 // CMP.B (A6)+,D4
+        0x67FA,                 // BEQ COMPARE
+        0x4E72, 0x2700          // STOP #$2700
+    };
+    RunResult result = expectInterpretersAgree(program, { CPUCore::INTERPRETER_STEP, CPUCore::INTERPRETER_BLOCKS },
+        [](CPUCore &cpu, Memory &memory, CPUCore::interpreters) {
+            const char *strings[] = { "HELLO", "HELP" };
+            for (unsigned int i = 0; i < 2; i++) {
+                for (unsigned int j = 0; strings[i][j] != 0; j++)
+                    memory.writeByteToMemory(strings[i][j], 0x1800 + i * 0x10 + j);
+            }
+            cpu.setAllRegisters(0x1234ABCD);
+        });
+
+    EXPECT_EQ(result.registers[10], 0x1420);
+    EXPECT_EQ(result.registers[11], 0x1806);
+    EXPECT_EQ(result.registers[12], 0x1803);
+    EXPECT_EQ(result.registers[13], 0x1804);
+    EXPECT_EQ(result.memory[0x107F], 0x34);
+    EXPECT_EQ(result.memory[0x1080], 0);
+    EXPECT_EQ(result.memory[0x141F], 0x34);
+}
+
+TEST_F(InstructionTest, JitArithmeticLoop)
+{
+    uint16_t program[] = {
+        0x41F8, 0x1000,         // LEA $1000.W,A0
+        0x303C, 0x03E8,         // MOVE.W #1000,D0
+        0x7200,                 // MOVEQ #0,D1
+        0x7400,                 // MOVEQ #0,D2
+        0xD240,                 // NEXT ADD.W D0,D1
+        0x9441,                 // SUB.W D1,D2
+        0x30C1,                 // MOVE.W D1,(A0)+
+        0xD550,                 // ADD.W D2,(A0)
+        0x5389,                 // SUBQ.L #1,A1
+        0xB27C, 0x8000,         // CMP.W #$8000,D1
+        0x5340,                 // SUBQ.W #1,D0
+        0x66EE,                 // BNE NEXT
+        0x4E72, 0x2700          // STOP #$2700
+    };
+    RunResult result = expectInterpretersAgree(program, { CPUCore::INTERPRETER_STEP, CPUCore::INTERPRETER_JIT },
+        [](CPUCore &cpu, Memory &, CPUCore::interpreters) {
+            cpu.setAllRegisters(0x1234ABCD);
+        },
+        [](CPUCore &cpu, Memory &, CPUCore::interpreters interpreter) {
+            if (interpreter == CPUCore::INTERPRETER_JIT && JitCompiler::isSupported()) {
+                EXPECT_GT(cpu.getCompiledBlockCount(), 0u);
+            }
+        });
+
+    EXPECT_EQ(result.registers[8], 0x1000 + 2000);
+    EXPECT_EQ(result.registers[9], 0x1234ABCD - 1000);
+}
+
+// Only the flags BNE reads, and the X that CMP leaves alone, have to be worked out in the loop
+TEST_F(InstructionTest, JitDeadFlags)
+{
+    uint16_t program[] = {
+        0x7200,                 // MOVEQ #0,D1
+        0x303C, 0x03E8,         // MOVE.W #1000,D0
+        0xD280,                 // NEXT ADD.L D0,D1
+        0x5281,                 // ADDQ.L #1,D1
+        0xB280,                 // CMP.L D0,D1
+        0x5340,                 // SUBQ.W #1,D0
+        0x66F6,                 // BNE NEXT
+        0x4E72, 0x2700          // STOP #$2700
+    };
+    RunResult result = expectInterpretersAgree(program, { CPUCore::INTERPRETER_STEP, CPUCore::INTERPRETER_JIT }, nullptr,
+        [](CPUCore &cpu, Memory &, CPUCore::interpreters interpreter) {
+            if (interpreter == CPUCore::INTERPRETER_JIT && JitCompiler::isSupported()) {
+                EXPECT_GE(cpu.getEliminatedFlagUpdates(), 2u);
+            }
+            else {
+                EXPECT_EQ(cpu.getEliminatedFlagUpdates(), 0u);
+            }
+        });
+
+    EXPECT_EQ(result.registers[1], 1000u * 1001 / 2 + 1000);
+}
+
+TEST_F(InstructionTest, IdleLoopSleeps)
+{
+    uint16_t program[] = {
+        0x7000,                 // MOVEQ #0,D0
+        0xB038, 0x1800,         // WAIT CMP.B $1800.W,D0
+        0x67FA,                 // BEQ WAIT
+        0x4E72, 0x2700          // STOP #$2700
+    };
+
+    for (CPUCore::interpreters interpreter : allInterpreters) {
+        Memory memory(8);
+        CPUCore cpu(&memory, 68000);
+
+        loadProgram(memory, program);
+        cpu.setProgramCounter(0x100);
+        cpu.setInterpreter(interpreter);
+
+        // Another thread wakes the CPU while the program waits, as a device would, and the flag is
+        // then set on this thread. An event with nothing to do runs first, leaving the loop with
+        // nothing scheduled.
+        cpu.scheduleEvent(100, [](uint64_t) {});
+        std::thread device([&cpu]() {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            cpu.wake();
+        });
+        EXPECT_EQ(cpu.run(), CPUCore::STOP_WOKEN) << "Interpreter " << interpreter;
+        device.join();
+        EXPECT_EQ(cpu.getIdleWaitCount(), 1u) << "Interpreter " << interpreter;
+
+        memory.writeByteToMemory(1, 0x1800);
+        EXPECT_EQ(cpu.run(), CPUCore::STOP_STOPPED) << "Interpreter " << interpreter;
+        EXPECT_EQ(cpu.getDataRegister(0), 0u) << "Interpreter " << interpreter;
+
+        // Given a budget and with nothing due to set the flag, the loop sleeps once and uses up
+        // the rest of the budget rather than sleeping for every pass
+        Memory idleMemory(8);
+        CPUCore idleCpu(&idleMemory, 68000);
+        loadProgram(idleMemory, program);
+        idleCpu.setProgramCounter(0x100);
+        idleCpu.setInterpreter(interpreter);
+        std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+        EXPECT_EQ(idleCpu.run(1000002), CPUCore::STOP_BUDGET_EXHAUSTED) << "Interpreter " << interpreter;
+        EXPECT_LT(std::chrono::steady_clock::now() - started, std::chrono::milliseconds(500)) << "Interpreter " << interpreter;
+        EXPECT_EQ(idleCpu.getIdleWaitCount(), 1u) << "Interpreter " << interpreter;
+        EXPECT_EQ(idleCpu.getProgramCounter(), 0x106u) << "Interpreter " << interpreter;
+    }
+}
+
+// The usual ways of polling a flag are all recognised as idle loops
+TEST_F(InstructionTest, IdleLoopForms)
+{
+    uint16_t tstProgram[] = {
+        0x4A38, 0x1800,         // WAIT TST.B $1800.W
+        0x67FA,                 // BEQ WAIT
+        0x4E72, 0x2700          // STOP #$2700
+    };
+    uint16_t btstProgram[] = {
+        0x41F8, 0x1800,         // LEA $1800.W,A0
+        0x0810, 0x0003,         // WAIT BTST #3,(A0)
+        0x67FA,                 // BEQ WAIT
+        0x4E72, 0x2700          // STOP #$2700
+    };
+    uint16_t cmpiProgram[] = {
+        0x0C78, 0x0808, 0x1800, // WAIT CMPI.W #$0808,$1800.W
+        0x66F8,                 // BNE WAIT
+        0x4E72, 0x2700          // STOP #$2700
+    };
+    const uint16_t *programs[] = { tstProgram, btstProgram, cmpiProgram };
+    size_t lengths[] = { sizeof(tstProgram) / 2, sizeof(btstProgram) / 2, sizeof(cmpiProgram) / 2 };
+
+    for (CPUCore::interpreters interpreter : allInterpreters) {
+        for (int i = 0; i < 3; i++) {
+            Memory memory(8);
+            CPUCore cpu(&memory, 68000);
+
+            loadProgram(memory, programs[i], lengths[i], 0x100);
+            cpu.setProgramCounter(0x100);
+            cpu.setInterpreter(interpreter);
+
+            // The loop skips straight to the event setting the flag rather than making every pass
+            cpu.scheduleEvent(800000, [&memory](uint64_t) { memory.writeWordToMemory(0x0808, 0x1800); });
+            EXPECT_EQ(cpu.run(), CPUCore::STOP_STOPPED) << "Interpreter " << interpreter << ", program " << i;
+            EXPECT_GE(cpu.getCycleCount(), 800000u) << "Interpreter " << interpreter << ", program " << i;
+            EXPECT_LT(cpu.getCycleCount(), 800000u + 100) << "Interpreter " << interpreter << ", program " << i;
+            EXPECT_LT(cpu.getInstructionCacheHits() + cpu.getTierExecutions(CPUCore::TIER_TRANSLATED), 100u)
+                << "Interpreter " << interpreter << ", program " << i;
+        }
+    }
+}
+
+TEST_F(InstructionTest, SteadyStateAllocations)
+{
+    uint16_t program[] = {
+        0x207C, 0x0000, 0x1000, // MOVEA.L #$1000,A0
+        0x303C, 0x0FFF,         // MOVE.W #$FFF,D0
+        0x7200,                 // MOVEQ #0,D1
+        0xD240,                 // NEXT ADD.W D0,D1
+        0x10C1,                 // MOVE.B D1,(A0)+
+        0xB27C, 0x0080,         // CMP.W #$80,D1
+        0x6302,                 // BLS SKIP
+        0x5341,                 // SUBQ.W #1,D1
+        0x5340,                 // SKIP SUBQ.W #1,D0
+        0x66F0,                 // BNE NEXT
+        0x4E72, 0x2700          // STOP #$2700
+    };
+    CPUCore::interpreters interpreters[] = { CPUCore::INTERPRETER_STEP, CPUCore::INTERPRETER_BLOCKS, CPUCore::INTERPRETER_THREADED, CPUCore::INTERPRETER_JIT };
+
+    for (CPUCore::interpreters interpreter : interpreters) {
+        Memory memory(8);
+        CPUCore cpu(&memory, 68000);
+
+        loadProgram(memory, program);
+
+        cpu.setTracing(false);
+        cpu.setInterpreter(interpreter);
+
+        // The first run decodes, translates and compiles. The second finds everything ready.
+        for (int run = 0; run < 2; run++) {
+            cpu.setProgramCounter(0x100);
+            size_t allocations = allocationCount;
+            cpu.run();
+            if (run == 1) {
+                EXPECT_EQ(allocationCount - allocations, 0u) << "Interpreter " << interpreter;
+            }
+        }
+        EXPECT_EQ(cpu.getAddressRegister(0), 0x1FFF);
+        EXPECT_EQ(cpu.getDataRegister(0), 0);
+    }
+}
+
+TEST_F(InstructionTest, ExtendedInstructionsAgree)
+{
+    uint16_t program[] = {
+        0x7000,                 // MOVEQ #0,D0
+        0x223C, 0xFFFF, 0xFFFF, // MOVE.L #$FFFFFFFF,D1
+        0x7401,                 // MOVEQ #1,D2
+        0xD282,                 // ADD.L D2,D1 (sets X)
+        0xD180,                 // ADDX.L D0,D0
+        0x263C, 0x0F0F, 0x0F0F, // MOVE.L #$0F0F0F0F,D3
+        0x0A83, 0xFFFF, 0xFFFF, // EORI.L #$FFFFFFFF,D3
+        0xE88B,                 // LSR.L #4,D3
+        0x7804,                 // MOVEQ #4,D4
+        0x7A00,                 // MOVEQ #0,D5
+        0x5485,                 // LOOP ADDQ.L #2,D5
+        0x51CC, 0xFFFC,         // DBF D4,LOOP
+        0x7C07,                 // MOVEQ #7,D6
+        0xCCFC, 0x0006,         // MULU.W #6,D6
+        0x8CFC, 0x0005,         // DIVU.W #5,D6
+        0x4E72, 0x2700          // STOP #$2700
+    };
+    RunResult result = expectInterpretersAgree(program, allInterpreters, [](CPUCore &cpu, Memory &, CPUCore::interpreters) {
+        cpu.setAllRegisters(0x1234ABCD);
+    });
+
+    EXPECT_EQ(result.registers[0], 1);
+    EXPECT_EQ(result.registers[1], 0);
+    EXPECT_EQ(result.registers[3], 0x0F0F0F0F);
+    EXPECT_EQ(result.registers[4], 0x0000FFFF);
+    EXPECT_EQ(result.registers[5], 10);
+    EXPECT_EQ(result.registers[6], 0x00020008);
+}
+
+TEST_F(InstructionTest, ExceptionVectors)
+{
+    uint16_t program[] = {
+        0x4E43,         // TRAP #3
+        0x46FC, 0x0000, // MOVE #$0000,SR (drops to user mode)
+        0x4E70,         // RESET (privilege violation)
+        0x4E72, 0x2700  // STOP #$2700
+    };
+    uint16_t handler[] = {
+        0x5287,         // ADDQ.L #1,D7
+        0x4E73          // RTE
+    };
+    uint16_t privilegeHandler[] = {
+        0x7C01,         // MOVEQ #1,D6
+        0x4E72, 0x2700  // STOP #$2700
+    };
+    loadProgram(*memory, program);
+    loadProgram(*memory, handler, 0x200);
+    loadProgram(*memory, privilegeHandler, 0x300);
+    memory->writeLongToMemory(0x200, (VECTOR_TRAP + 3) * 4);
+    memory->writeLongToMemory(0x300, VECTOR_PRIVILEGE_VIOLATION * 4);
+
+    cpu->setDataRegister(7, 0);
+    cpu->setAddressRegister(7, 0x1000);
+    cpu->setProgramCounter(0x100);
+    while (cpu->startNextCycle());
+
+    EXPECT_EQ(cpu->getDataRegister(7), 1);
+    EXPECT_EQ(cpu->getDataRegister(6), 1);
+    // The privilege violation stacked the address of the RESET and the user mode SR
+    EXPECT_EQ(memory->readLongFromMemory(0xFFC), 0x106);
+    EXPECT_EQ(memory->readWordFromMemory(0xFFA), 0);
+    EXPECT_EQ(cpu->getAddressRegister(7), 0xFFA);
+    EXPECT_EQ(cpu->getStatusRegister(), 0x2700);
+}
+
+TEST_F(InstructionTest, CPUModels)
+{
+    uint16_t program[] = {
+        0x7003,                 // MOVEQ #3,D0
+        0x41F8, 0x0400,         // LEA $400,A0
+        0x43F0, 0x0400,         // LEA 0(A0,D0.W*4),A1 (the scale is ignored before the 68020)
+        0x4E40,                 // TRAP #0
+        0x0508, 0x0000,         // MOVEP.W 0(A0),D2 (unimplemented on the 68060)
+        0x46FC, 0x0000,         // MOVE #$0000,SR (drops to user mode)
+        0x40C3,                 // MOVE SR,D3 (privileged from the 68010 on)
+        0x42C4,                 // MOVE CCR,D4 (illegal on the 68000)
+        0x4E72, 0x2700          // STOP #$2700 (privilege violation)
+    };
+    uint16_t trapHandler[] = {
+        0x3C2F, 0x0006,         // MOVE.W 6(SP),D6 (the format word, from the 68010 on)
+        0x4E73                  // RTE
+    };
+    int models[] = { 68000, 68010, 68020, 68040, 68060 };
+    int endingVectors[] = { VECTOR_ILLEGAL_INSTRUCTION, VECTOR_PRIVILEGE_VIOLATION, VECTOR_PRIVILEGE_VIOLATION,
+        VECTOR_PRIVILEGE_VIOLATION, VECTOR_UNIMPLEMENTED_INTEGER };
+
+    for (int i = 0; i < 5; i++) {
+        Memory memory(8);
+        CPUCore cpu(&memory, models[i]);
+
+        loadProgram(memory, program);
+        loadProgram(memory, trapHandler, 0x300);
+        memory.writeLongToMemory(0x300, VECTOR_TRAP * 4);
+        // The other handlers load their vector number into D7 and stop
+        int vectors[] = { VECTOR_ILLEGAL_INSTRUCTION, VECTOR_PRIVILEGE_VIOLATION, VECTOR_UNIMPLEMENTED_INTEGER };
+        for (int j = 0; j < 3; j++) {
+            uint32_t handler = 0x340 + j * 0x10;
+            memory.writeWordToMemory(0x7E00 | vectors[j], handler); // MOVEQ #vector,D7
+            memory.writeWordToMemory(0x4E72, handler + 2); // STOP #$2700
+            memory.writeWordToMemory(0x2700, handler + 4);
+            memory.writeLongToMemory(handler, vectors[j] * 4);
+        }
+
+        cpu.setAllRegisters(0);
+        cpu.setAddressRegister(7, 0x1000);
+        cpu.setProgramCounter(0x100);
+        EXPECT_EQ(cpu.run(), CPUCore::STOP_STOPPED);
+
+        EXPECT_EQ(cpu.getDataRegister(7), (uint32_t)endingVectors[i]) << models[i];
+        EXPECT_EQ(cpu.getAddressRegister(1), models[i] >= 68020 ? 0x40Cu : 0x403u) << models[i];
+        // Format 0 with the offset of vector 32
+        EXPECT_EQ(cpu.getDataRegister(6), models[i] == 68000 ? 0u : 0x80u) << models[i];
+        // A 68060 stacks the address of the MOVEP in a four word frame
+        if (models[i] == 68060) {
+            EXPECT_EQ(memory.readLongFromMemory(0xFFA), 0x10Cu);
+        }
+
+        // The 68000 and 68010 have 24 address lines
+        memory.writeLongToMemory(0x12345678, 0x200);
+        if (models[i] < 68020) {
+            EXPECT_EQ(memory.readLongFromMemory(0xFF000200), 0x12345678u) << models[i];
+        }
+    }
+}
+
+TEST_F(InstructionTest, RunBudget)
+{
+    // The loop from program.X68, which runs 2 + 257 * 4 + 1 instructions
+    uint16_t program[] = {
+        0x207C, 0x0000, 0x1000, // MOVEA.L #$1000,A0
+        0x303C, 0x0101,         // MOVE.W #$101,D0
+        0x10BC, 0x00AA,         // NEXT MOVE.B #$AA,(A0)
+        0xD1FC, 0x0000, 0x0001, // ADDA.L #1,A0
+        0x907C, 0x0001,         // SUB.W #1,D0
+        0x66F0,                 // BNE NEXT
+        0x4E72, 0x2700          // STOP #$2700
+    };
+    for (CPUCore::interpreters interpreter : allInterpreters) {
+        Memory memory(8);
+        CPUCore cpu(&memory, 68000);
+
+        loadProgram(memory, program);
+
+        cpu.setProgramCounter(0x100);
+        cpu.setInterpreter(interpreter);
+        EXPECT_EQ(cpu.run(0), CPUCore::STOP_BUDGET_EXHAUSTED);
+        EXPECT_EQ(cpu.getProgramCounter(), 0x100);
+        EXPECT_EQ(cpu.run(2), CPUCore::STOP_BUDGET_EXHAUSTED);
+        EXPECT_EQ(cpu.getProgramCounter(), 0x10A);
+
+        // The rest of the loop, in slices too small for it to be run in one go
+        int slices = 1;
+        while (cpu.run(100) == CPUCore::STOP_BUDGET_EXHAUSTED)
+            slices++;
+        EXPECT_EQ(slices, 11);
+        EXPECT_EQ(cpu.getAddressRegister(0), 0x1101);
+        EXPECT_EQ(memory.readByteFromMemory(0x1100), 0xAA);
+        EXPECT_EQ(memory.readByteFromMemory(0x1101), 0);
+    }
+}
+
+// Compiled code leaves part-way through a pass when it writes over its own block, and only the
+// instructions it ran are taken from the budget
+TEST_F(InstructionTest, RunBudgetWriteOverCompiledBlock)
+{
+    uint16_t program[] = {
+        0x45F8, 0x00C0,         // LEA $C0.W,A2
+        0x343C, 0x4E71,         // MOVE.W #$4E71,D2
+        0x303C, 0x00C8,         // MOVE.W #200,D0
+        0x4E71,                 // LOOP NOP
+        0x4E71,                 // NOP
+        0x34C2,                 // MOVE.W D2,(A2)+ (reaches LOOP after 38 passes, then writes a NOP over itself)
+        0x5340,                 // SUBQ.W #1,D0
+        0x66F6,                 // BNE LOOP
+        0x4E72, 0x2700          // STOP #$2700
+    };
+    CPUCore::interpreters interpreters[] = { CPUCore::INTERPRETER_STEP, CPUCore::INTERPRETER_JIT, CPUCore::INTERPRETER_TIERED };
+    std::vector<uint32_t> stops[3];
+
+    for (int i = 0; i < 3; i++) {
+        Memory memory(8);
+        CPUCore cpu(&memory, 68000);
+
+        loadProgram(memory, program);
+        cpu.setProgramCounter(0x100);
+        cpu.setInterpreter(interpreters[i]);
+        while (cpu.run(101) == CPUCore::STOP_BUDGET_EXHAUSTED)
+            stops[i].push_back(cpu.getProgramCounter());
+        stops[i].push_back(cpu.getProgramCounter());
+        EXPECT_EQ(cpu.getAddressRegister(2), 0x112u);
+        EXPECT_EQ(cpu.getDataRegister(0), 0u);
+    }
+
+    EXPECT_EQ(stops[0].size(), 10u);
+    EXPECT_EQ(stops[1], stops[0]);
+    EXPECT_EQ(stops[2], stops[0]);
+}
+
+TEST_F(InstructionTest, RunStopReasons)
+{
+    uint16_t program[] = {
+        0x7203,                 // MOVEQ #3,D1
+        0x5381,                 // LOOP SUBQ.L #1,D1
+        0x66FC,                 // BNE LOOP
+        0x7005,                 // MOVEQ #5,D0
+        0x4E4F,                 // TRAP #15 (reads a character into D1)
+        0x7009,                 // MOVEQ #9,D0
+        0x4E4F,                 // TRAP #15 (halts)
+        0x4AFC                  // ILLEGAL
+    };
+    loadProgram(*memory, program);
+
+    std::stringstream input;
+    cpu->setInput(&input, false);
+    cpu->addBreakpoint(0x102);
+    cpu->setProgramCounter(0x100);
+
+    // The breakpoint is reached on each pass round the loop, and run steps over it when resuming
+    for (int pass = 0; pass < 3; pass++) {
+        EXPECT_EQ(cpu->run(), CPUCore::STOP_BREAKPOINT);
+        EXPECT_EQ(cpu->getProgramCounter(), 0x102);
+        EXPECT_EQ(cpu->getDataRegister(1), 3 - pass);
+    }
+    cpu->removeBreakpoint(0x102);
+
+    // With no input the TRAP stops at itself and reads the input once it has arrived
+    EXPECT_EQ(cpu->run(), CPUCore::STOP_PENDING_IO);
+    EXPECT_EQ(cpu->getProgramCounter(), 0x108);
+    input << "A";
+    EXPECT_EQ(cpu->run(), CPUCore::STOP_HALTED);
+    EXPECT_EQ(cpu->getDataRegister(1), 'A');
+    EXPECT_EQ(cpu->run(), CPUCore::STOP_ILLEGAL_INSTRUCTION);
+    EXPECT_EQ(cpu->getProgramCounter(), 0x110);
+}
+
+TEST_F(InstructionTest, CycleCounts)
+{
+    uint16_t program[] = {
+        0x7002,         // MOVEQ #2,D0 (4 cycles)
+        0x30C0,         // LOOP MOVE.W D0,(A0)+ (8)
+        0x51C8, 0xFFFC, // DBF D0,LOOP (10 taken, 14 when the count runs out)
+        0xE989,         // LSL.L #4,D1 (8 + 2 for each place)
+        0xC2FC, 0x0003, // MULU.W #3,D1 (38 + 4 for the immediate + 2 for each one bit)
+        0x4E72, 0x2700  // STOP #$2700 (4)
+    };
+    for (CPUCore::interpreters interpreter : allInterpreters) {
+        Memory memory(8);
+        CPUCore cpu(&memory, 68000);
+
+        loadProgram(memory, program);
+
+        cpu.setAddressRegister(0, 0x1000);
+        cpu.setProgramCounter(0x100);
+        cpu.setInterpreter(interpreter);
+
+        // The instruction that reaches the budget runs to the end, here the DBF leaving the loop
+        EXPECT_EQ(cpu.run(50, CPUCore::BUDGET_CYCLES), CPUCore::STOP_BUDGET_EXHAUSTED);
+        EXPECT_EQ(cpu.getCycleCount(), 4 + 3 * 8 + 2 * 10 + 14);
+        EXPECT_EQ(cpu.getProgramCounter(), 0x108);
+
+        EXPECT_EQ(cpu.run(), CPUCore::STOP_STOPPED);
+        EXPECT_EQ(cpu.getCycleCount(), 4 + 3 * 8 + 2 * 10 + 14 + 16 + 46 + 4);
+    }
+
+    // Loops closed by a Bcc, run in one go as a memory idiom or in compiled code, are charged for
+    // the branch falling through on the last pass
+    uint16_t idiomProgram[] = {
+        0x307C, 0x1000, // MOVEA.W #$1000,A0 (8)
+        0x7010,         // MOVEQ #16,D0 (4)
+        0x10FC, 0x0041, // LOOP MOVE.B #$41,(A0)+ (12)
+        0x5340,         // SUBQ.W #1,D0 (4)
+        0x66F8,         // BNE LOOP (10 taken, 8 not)
+        0x4E72, 0x2700  // STOP #$2700 (4)
+    };
+    uint16_t compiledProgram[] = {
+        0x303C, 0x03E8, // MOVE.W #1000,D0 (8)
+        0x7201,         // MOVEQ #1,D1 (4)
+        0xD441,         // LOOP ADD.W D1,D2 (4)
+        0x4E71,         // NOP (4)
+        0x5340,         // SUBQ.W #1,D0 (4)
+        0x66F8,         // BNE LOOP (10 taken, 8 not)
+        0x4E72, 0x2700  // STOP #$2700 (4)
+    };
+    for (CPUCore::interpreters interpreter : allInterpreters) {
+        Memory memory(8);
+        CPUCore cpu(&memory, 68000);
+
+        loadProgram(memory, idiomProgram);
+        cpu.setProgramCounter(0x100);
+        cpu.setInterpreter(interpreter);
+        EXPECT_EQ(cpu.run(), CPUCore::STOP_STOPPED);
+        EXPECT_EQ(cpu.getCycleCount(), 8 + 4 + 16 * (12 + 4) + 15 * 10 + 8 + 4) << "Interpreter " << interpreter;
+
+        Memory compiledMemory(8);
+        CPUCore compiledCpu(&compiledMemory, 68000);
+
+        loadProgram(compiledMemory, compiledProgram);
+        compiledCpu.setProgramCounter(0x100);
+        compiledCpu.setInterpreter(interpreter);
+        EXPECT_EQ(compiledCpu.run(), CPUCore::STOP_STOPPED);
+        EXPECT_EQ(compiledCpu.getCycleCount(), 8 + 4 + 1000 * (4 + 4 + 4) + 999 * 10 + 8 + 4) << "Interpreter " << interpreter;
+        if (interpreter == CPUCore::INTERPRETER_JIT) {
+            EXPECT_GT(compiledCpu.getTierExecutions(CPUCore::TIER_COMPILED), 0u);
+        }
+    }
+}
+
+TEST_F(InstructionTest, ScheduledEvents)
+{
+    uint16_t program[] = {
+        0x303C, 0x03E7, // MOVE.W #999,D0 (8 cycles)
+        0x5281,         // LOOP ADDQ.L #1,D1 (8)
+        0x51C8, 0xFFFC, // DBF D0,LOOP (10)
+        0x4E72, 0x2700  // STOP #$2700 (4)
+    };
+    for (CPUCore::interpreters interpreter : allInterpreters) {
+        Memory memory(8);
+        CPUCore cpu(&memory, 68000);
+        std::vector<uint64_t> ticks;
+        uint32_t countAtEvent = 0;
+
+        loadProgram(memory, program);
+
+        cpu.setProgramCounter(0x100);
+        cpu.setInterpreter(interpreter);
+        cpu.setDataRegister(1, 0);
+
+        // A timer repeating every 2000 cycles, a one-off event, and one cancelled before it runs
+        std::function<void(uint64_t)> tick = [&](uint64_t cycle) {
+            EXPECT_GE(cpu.getCycleCount(), cycle);
+            EXPECT_LT(cpu.getCycleCount(), cycle + 18);
+            ticks.push_back(cycle);
+            cpu.scheduleEvent(cycle + 2000, tick);
+        };
+        cpu.scheduleEvent(2000, tick);
+        cpu.scheduleEvent(1000, [&](uint64_t) { countAtEvent = cpu.getDataRegister(1); });
+        uint64_t cancelled = cpu.scheduleEvent(500, [&](uint64_t) { ADD_FAILURE() << "cancelled event ran"; });
+        EXPECT_TRUE(cpu.cancelEvent(cancelled));
+        EXPECT_FALSE(cpu.cancelEvent(cancelled));
+
+        EXPECT_EQ(cpu.run(), CPUCore::STOP_STOPPED);
+        EXPECT_EQ(cpu.getCycleCount(), 8u + 1000 * 8 + 999 * 10 + 14 + 4);
+        EXPECT_EQ(cpu.getDataRegister(1), 1000u);
+        // Each pass through the loop takes 18 cycles after the first 8
+        EXPECT_EQ(countAtEvent, (1000u - 8 + 17) / 18);
+        EXPECT_EQ(ticks.size(), 9u);
+        EXPECT_EQ(ticks.back(), 18000u);
+    }
+}
+
+TEST_F(InstructionTest, IdleLoopSkipsToEvent)
+{
+    uint16_t program[] = {
+        0x7000,                 // MOVEQ #0,D0
+        0xB038, 0x1800,         // WAIT CMP.B $1800.W,D0
+        0x67FA,                 // BEQ WAIT
+        0x4E72, 0x2700          // STOP #$2700
+    };
+    Memory memory(8);
+    CPUCore cpu(&memory, 68000);
+
+    loadProgram(memory, program);
+
+    cpu.setProgramCounter(0x100);
+    cpu.setInterpreter(CPUCore::INTERPRETER_BLOCKS);
+
+    // The device sets the flag a second of 8 MHz time later, which the loop reaches without sleeping
+    cpu.scheduleEvent(8000000, [&memory](uint64_t) { memory.writeByteToMemory(1, 0x1800); });
+    EXPECT_EQ(cpu.run(), CPUCore::STOP_STOPPED);
+
+    EXPECT_GE(cpu.getCycleCount(), 8000000u);
+    EXPECT_LT(cpu.getCycleCount(), 8000000u + 100);
+    EXPECT_EQ(cpu.getIdleWaitCount(), 0u);
+}
+
+TEST_F(InstructionTest, Interrupts)
+{
+    uint16_t program[] = {
+        0x46FC, 0x2700,         // MOVE #$2700,SR
+        0x5281,                 // LOOP ADDQ.L #1,D1
+        0x0C81, 0x0000, 0x0064, // CMPI.L #100,D1
+        0x66F6,                 // BNE LOOP
+        0x4E72, 0x2000,         // STOP #$2000
+        0x4E72, 0x2700,         // STOP #$2700
+        0x4E72, 0x2700,         // STOP #$2700
+        0x4E72, 0x2700          // STOP #$2700 (4)
+    };
+    uint16_t levelTwoHandler[] = {
+        0x5282,                 // ADDQ.L #1,D2
+        0x3617,                 // MOVE.W (SP),D3
+        0x2A2F, 0x0002,         // MOVE.L 2(SP),D5
+        0x0057, 0x0700,         // ORI.W #$0700,(SP) (returns with every level masked)
+        0x4E73                  // RTE
+    };
+    uint16_t levelSevenHandler[] = {
+        0x5286,                 // ADDQ.L #1,D6 (8 cycles)
+        0x4E73                  // RTE (20)
+    };
+    for (CPUCore::interpreters interpreter : allInterpreters) {
+        Memory memory(8);
+        CPUCore cpu(&memory, 68000);
+
+        loadProgram(memory, program);
+        loadProgram(memory, levelTwoHandler, 0x200);
+        loadProgram(memory, levelSevenHandler, 0x240);
+        memory.writeLongToMemory(0x200, (24 + 2) * 4);
+        memory.writeLongToMemory(0x240, (24 + 7) * 4);
+
+        cpu.setAllRegisters(0);
+        cpu.setAddressRegister(7, 0x2000);
+        cpu.setProgramCounter(0x100);
+        cpu.setInterpreter(interpreter);
+
+        // Level 2 is asserted while masked, and taken once STOP lowers the mask
+        cpu.scheduleEvent(100, [&cpu](uint64_t) { cpu.assertInterrupt(2); });
+        EXPECT_EQ(cpu.run(), CPUCore::STOP_STOPPED);
+        EXPECT_EQ(cpu.getDataRegister(1), 100u);
+        EXPECT_EQ(cpu.getDataRegister(2), 1u);
+        EXPECT_EQ(cpu.getDataRegister(3), 0x2000u);
+        EXPECT_EQ(cpu.getDataRegister(5), 0x112u);
+        EXPECT_EQ(cpu.getAddressRegister(7), 0x2000u);
+        EXPECT_EQ(cpu.getProgramCounter(), 0x116u);
+
+        // Level 7 gets through the mask, once for each time it is asserted. The stopped CPU waits
+        // for the event asserting it.
+        uint64_t wake = cpu.getCycleCount() + 1000;
+        cpu.scheduleEvent(wake, [&cpu](uint64_t) {
+            cpu.clearInterrupt(7);
+            cpu.assertInterrupt(7);
+        });
+        cpu.assertInterrupt(7);
+        EXPECT_EQ(cpu.run(), CPUCore::STOP_STOPPED);
+        EXPECT_EQ(cpu.getDataRegister(6), 1u);
+        EXPECT_EQ(cpu.getProgramCounter(), 0x11Au);
+        EXPECT_EQ(cpu.run(), CPUCore::STOP_STOPPED);
+        EXPECT_EQ(cpu.getDataRegister(6), 2u);
+        EXPECT_EQ(cpu.getCycleCount(), wake + 44 + 8 + 20 + 4);
+        EXPECT_EQ(cpu.getStatusRegister() & 0x0700, 0x0700);
+    }
+}
+
+TEST_F(InstructionTest, HostHandlers)
+{
+    uint16_t program[] = {
+        0x7205,                 // MOVEQ #5,D1
+        0x7407,                 // MOVEQ #7,D2
+        0x4E43,                 // TRAP #3 (adds D1 and D2 into D0 on the host)
+        0xA123, 0x1234,         // $A123 followed by a word its handler reads
+        0xF000,                 // $F000 (halts)
+        0x4E72, 0x2700          // STOP #$2700
+    };
+    for (CPUCore::interpreters interpreter : allInterpreters) {
+        Memory memory(8);
+        CPUCore cpu(&memory, 68000);
+
+        loadProgram(memory, program);
+
+        cpu.setAllRegisters(0);
+        cpu.setAddressRegister(7, 0x4000);
+        cpu.setProgramCounter(0x100);
+        cpu.setInterpreter(interpreter);
+
+        cpu.bindTrap(3, [](CPUCore &cpu, uint16_t) {
+            cpu.setDataRegister(0, cpu.getDataRegister(1) + cpu.getDataRegister(2));
+            return true;
+        });
+        EXPECT_TRUE(cpu.bindLineOpcode(0xA123, [&memory](CPUCore &cpu, uint16_t opcode) {
+            cpu.setDataRegister(3, memory.readWordFromMemory(cpu.getProgramCounter()));
+            cpu.setProgramCounter(cpu.getProgramCounter() + 2);
+            return true;
+        }));
+        EXPECT_TRUE(cpu.bindLineOpcode(0xF000, [](CPUCore &, uint16_t) { return false; }));
+        EXPECT_FALSE(cpu.bindLineOpcode(0x4E71, [](CPUCore &, uint16_t) { return true; }));
+
+        EXPECT_EQ(cpu.run(), CPUCore::STOP_HALTED);
+        EXPECT_EQ(cpu.getDataRegister(0), 12u);
+        EXPECT_EQ(cpu.getDataRegister(3), 0x1234u);
+        EXPECT_EQ(cpu.getProgramCounter(), 0x10Cu);
+        EXPECT_EQ(cpu.getAddressRegister(7), 0x4000u);
+
+        // Unbound, the decoded opcode goes back to taking the line 1010 exception, which has no vector
+        cpu.bindLineOpcode(0xA123, nullptr);
+        cpu.setProgramCounter(0x106);
+        EXPECT_EQ(cpu.run(), CPUCore::STOP_ILLEGAL_INSTRUCTION);
+    }
+}
+
+TEST_F(InstructionTest, StateSnapshots)
+{
+    uint16_t program[] = {
+        0x7003,                 // MOVEQ #3,D0
+        0x43F8, 0x0200,         // LEA $200,A1
+        0xD280,                 // loop: ADD.L D0,D1
+        0x2381, 0x0000,         // MOVE.L D1,0(A1,D0.W)
+        0x5340,                 // SUBQ.W #1,D0
+        0x66F6,                 // BNE loop
+        0x4E72, 0x2700          // STOP #$2700
+    };
+    loadProgram(*memory, program);
+
+    EXPECT_EQ(alignof(CPUState), 64u);
+    EXPECT_EQ((uintptr_t)cpu % alignof(CPUState), 0u);
+
+    cpu->setAllRegisters(0);
+    cpu->setProgramCounter(0x100);
+    cpu->setInterpreter(CPUCore::INTERPRETER_STEP);
+    // Stops after the first SUBQ, with its condition codes still to be worked out
+    EXPECT_EQ(cpu->run(5), CPUCore::STOP_BUDGET_EXHAUSTED);
+    CPUState snapshot = cpu->getState();
+
+    EXPECT_EQ(cpu->run(), CPUCore::STOP_STOPPED);
+    CPUState finished = cpu->getState();
+    EXPECT_EQ(cpu->getDataRegister(1), 6u);
+    EXPECT_EQ(memory->readLongFromMemory(0x201), 6u);
+    EXPECT_EQ(cpu->getStatusRegister(), 0x2700);
+
+    // Going back to the snapshot leaves the STOP state and runs the rest of the loop again
+    CPUCore::interpreters interpreters[] = { CPUCore::INTERPRETER_BLOCKS, CPUCore::INTERPRETER_THREADED, CPUCore::INTERPRETER_JIT, CPUCore::INTERPRETER_TIERED };
+    for (CPUCore::interpreters interpreter : interpreters) {
+        cpu->setState(snapshot);
+        cpu->setInterpreter(interpreter);
+        EXPECT_EQ(cpu->getProgramCounter(), 0x10Eu);
+        EXPECT_EQ(cpu->getDataRegister(0), 2u);
+        EXPECT_EQ(cpu->run(), CPUCore::STOP_STOPPED);
+        for (int reg = 0; reg < 8; reg++) {
+            EXPECT_EQ(cpu->getDataRegister(reg), finished.D[reg]);
+            EXPECT_EQ(cpu->getAddressRegister(reg), finished.A[reg]);
+        }
+        EXPECT_EQ(cpu->getStatusRegister(), 0x2700);
+    }
+}
+
+TEST_F(InstructionTest, DisassembleRange)
+{
+    uint16_t program[] = {
+        0x207C, 0x0000, 0x1000, // MOVEA.L #$1000,A0
+        0x303C, 0x0101,         // MOVE.W #$101,D0
+        0x10C1,                 // NEXT MOVE.B D1,(A0)+
+        0xD268, 0xFFFE,         // ADD.W -2(A0),D1
+        0x5340,                 // SUBQ.W #1,D0
+        0x66F6,                 // BNE NEXT
+        0x48E7, 0xF0C0,         // MOVEM.L D0-D3/A0-A1,-(SP)
+        0x4E4F,                 // TRAP #15
+        0x4AFC                  // ILLEGAL
+    };
+    loadProgram(*memory, program);
+
+    Disassembler disassembler(memory);
+    std::string listing;
+
+    EXPECT_EQ(disassembler.disassembleRange(0x100, 0x100 + sizeof(program), listing), 9);
+    EXPECT_EQ(listing,
+        "00000100  207C 0000 1000           MOVEA.L #$00001000,A0\n"
+        "00000106  303C 0101                MOVE.W #$0101,D0\n"
+        "0000010A  10C1                     MOVE.B D1,(A0)+\n"
+        "0000010C  D268 FFFE                ADD.W -$2(A0),D1\n"
+        "00000110  5340                     SUBQ.W #1,D0\n"
+        "00000112  66F6                     BNE.S $0000010A\n"
+        "00000114  48E7 F0C0                MOVEM.L D0-D3/A0-A1,-(A7)\n"
+        "00000118  4E4F                     TRAP #15\n"
+        "0000011A  4AFC                     DC.W $4AFC\n");
+
+    std::string text;
+    EXPECT_EQ(disassembler.disassembleInstruction(0x100, text), 6);
+    EXPECT_EQ(text, "MOVEA.L #$00001000,A0");
+}
+
+TEST_F(InstructionTest, DisassembleExtendedInstructions)
+{
+    uint16_t program[] = {
+        0xD180,                         // ADDX.L D0,D0
+        0x0A83, 0xFFFF, 0xFFFF,         // EORI.L #$FFFFFFFF,D3
+        0xE88B,                         // LSR.L #4,D3
+        0x51CC, 0xFFFC,                 // DBF D4,*-2
+        0xCCFC, 0x0006,                 // MULU.W #6,D6
+        0x46FC, 0x0000,                 // MOVE #0,SR
+        0x0839, 0x0003, 0x0000, 0x1000, // BTST #3,$1000.L
+        0xE3D0,                         // LSL.W (A0)
+        0x4E56, 0xFFF8                  // LINK A6,#-8
+    };
+    loadProgram(*memory, program);
+
+    Disassembler disassembler(memory);
+    std::string listing;
+
+    EXPECT_EQ(disassembler.disassembleRange(0x100, 0x100 + sizeof(program), listing), 9);
+    EXPECT_EQ(listing,
+        "00000100  D180                     ADDX.L D0,D0\n"
+        "00000102  0A83 FFFF FFFF           EORI.L #$FFFFFFFF,D3\n"
+        "00000108  E88B                     LSR.L #4,D3\n"
+        "0000010A  51CC FFFC                DBF D4,$00000108\n"
+        "0000010E  CCFC 0006                MULU.W #$0006,D6\n"
+        "00000112  46FC 0000                MOVE #$0000,SR\n"
+        "00000116  0839 0003 0000 1000      BTST #$3,$00001000.L\n"
+        "0000011E  E3D0                     LSL.W (A0)\n"
+        "00000120  4E56 FFF8                LINK A6,#-$8\n");
+}
+
+TEST_F(InstructionTest, DisassembleImage)
+{
+    const char *fileName = "disassemble_test.S68";
+    FILE *file = fopen(fileName, "w");
+    ASSERT_NE(file, nullptr);
+    fputs("S00600004844521B\n", file);
+    fputs("S1090100303C0101534072\n", file);
+    fputs("S1050106609A0B\n", file);
+    fputs("S9030100FB\n", file);
+    fclose(file);
+
+    Disassembler disassembler(memory);
+    std::string listing;
+    size_t count = disassembler.disassembleImage(fileName, listing);
+    remove(fileName);
+
+    EXPECT_EQ(count, 3);
+    EXPECT_EQ(listing,
+        "00000100  303C 0101                MOVE.W #$0101,D0\n"
+        "00000104  5340                     SUBQ.W #1,D0\n"
+        "00000106  609A                     BRA.S $000000A2\n");
+    EXPECT_EQ(memory->startingLocation, 0x100);
+}
+
+TEST_F(InstructionTest, RecompileImage)
+{
+    const char *fileName = "recompile_test.S68";
+    FILE *file = fopen(fileName, "w");
+    ASSERT_NE(file, nullptr);
+    // MOVEQ #3,D0 / LOOP BSR.S INC / SUBQ.W #1,D0 / BNE.S LOOP / STOP #$2700 / INC ADDQ.L #1,D1 / RTS, then a data word
+    fputs("S115010070036108534066FA4E72270052814E75FFFF9F\n", file);
+    fputs("S9030100FB\n", file);
+    fclose(file);
+
+    StaticRecompiler recompiler(memory);
+    std::string source;
+    size_t count = recompiler.recompileImage(fileName, source);
+    remove(fileName);
+
+    // The subroutine is found through the BSR, and the data word after its RTS is never reached
+    EXPECT_EQ(count, 7);
+    EXPECT_NE(source.find("address_0000010C"), std::string::npos);
+    EXPECT_EQ(source.find("address_00000110"), std::string::npos);
+}
+
+// Runs one instruction with D0 as its source and D1 as its destination, starting from a status
+// register and leaving the one the instruction sets in it. Returns D1.
+static uint32_t interpretOperation(CPUCore &cpu, Memory &memory, uint16_t opcode, uint32_t source, uint32_t destination, uint16_t &SR)
+{
+    memory.writeWordToMemory(opcode, 0x100);
+    cpu.setProgramCounter(0x100);
+    cpu.setDataRegister(0, source);
+    cpu.setDataRegister(1, destination);
+    cpu.setStatusRegister(SR);
+    cpu.startNextCycle();
+    SR = cpu.getStatusRegister();
+    return cpu.getDataRegister(1);
+}
+
+// Checks the arithmetic the recompiled code does against ADD, SUB and CMP Dn,Dn on the interpreter,
+// with every condition code clear and then set beforehand
+template<int Size>
+static void expectRecompiledArithmeticMatches(CPUCore &cpu, Memory &memory)
+{
+    static const uint32_t operands[] = { 0, 1, 0x7F, 0x80, 0xFF, 0x7FFF, 0x8000, 0xFFFF, 0x12345678, 0x7FFFFFFF, 0x80000000, 0xFFFFFFFF };
+    const uint16_t size = Size << 6;
+
+    for (uint32_t source : operands) {
+        for (uint32_t destination : operands) {
+            for (uint16_t initial : { 0x2700, 0x271F }) {
+                uint16_t interpreted = initial;
+                uint16_t recompiled = initial;
+                uint32_t reg = destination;
+                uint32_t result = interpretOperation(cpu, memory, 0xD200 | size, source, destination, interpreted);
+                recompiledWriteRegister<Size>(reg, recompiledAdd<Size>(recompiled, source, destination));
+                EXPECT_EQ(reg, result) << "ADD size " << Size << " " << source << "," << destination;
+                EXPECT_EQ(recompiled, interpreted) << "ADD size " << Size << " " << source << "," << destination;
+
+                interpreted = recompiled = initial;
+                reg = destination;
+                result = interpretOperation(cpu, memory, 0x9200 | size, source, destination, interpreted);
+                recompiledWriteRegister<Size>(reg, recompiledSubtract<Size>(recompiled, source, destination));
+                EXPECT_EQ(reg, result) << "SUB size " << Size << " " << source << "," << destination;
+                EXPECT_EQ(recompiled, interpreted) << "SUB size " << Size << " " << source << "," << destination;
+
+                interpreted = recompiled = initial;
+                interpretOperation(cpu, memory, 0xB200 | size, source, destination, interpreted);
+                recompiledSubtract<Size>(recompiled, source, destination, false);
+                EXPECT_EQ(recompiled, interpreted) << "CMP size " << Size << " " << source << "," << destination;
+            }
+        }
+    }
+}
+
+// The helpers recompiled code calls work out the same results and condition codes as the interpreter
+TEST_F(InstructionTest, RecompilerRuntime)
+{
+    expectRecompiledArithmeticMatches<SIZE_BYTE>(*cpu, *memory);
+    expectRecompiledArithmeticMatches<SIZE_WORD>(*cpu, *memory);
+    expectRecompiledArithmeticMatches<SIZE_LONG>(*cpu, *memory);
+
+    // Each condition against every combination of condition codes, as Scc D1 sees it
+    for (int condition = 0; condition < 16; condition++) {
+        for (uint16_t flags = 0; flags < 0x20; flags++) {
+            uint16_t SR = 0x2700 | flags;
+            uint32_t set = interpretOperation(*cpu, *memory, 0x50C1 | condition << 8, 0, 0, SR);
+            EXPECT_EQ(recompiledCondition(0x2700 | flags, condition), (set & 0xFF) == 0xFF)
+                << "Condition " << condition << " flags " << flags;
+        }
+    }
+
+    // Writes are caught only where they overlap the recompiled instructions, not data beside them
+    Memory codeMemory(8);
+    const RecompiledRange ranges[] = { { 0x100, 0x10C }, { 0x110, 0x114 } };
+    markRecompiledCode(codeMemory, ranges, 2);
+    EXPECT_TRUE(writesRecompiledCode(codeMemory, ranges, 2, 0x0FE, 4));
+    EXPECT_FALSE(writesRecompiledCode(codeMemory, ranges, 2, 0x0FE, 2));
+    EXPECT_TRUE(writesRecompiledCode(codeMemory, ranges, 2, 0x10A, 1));
+    EXPECT_FALSE(writesRecompiledCode(codeMemory, ranges, 2, 0x10C, 4));
+    EXPECT_TRUE(writesRecompiledCode(codeMemory, ranges, 2, 0x113, 1));
+    EXPECT_FALSE(writesRecompiledCode(codeMemory, ranges, 2, 0x114, 4));
+    EXPECT_FALSE(writesRecompiledCode(codeMemory, ranges, 2, 0x1000, 4));
+}